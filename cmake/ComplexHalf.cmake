@@ -0,0 +1,6 @@
+option (ENABLE_COMPLEX_HALF "Store dense state vector amplitudes in 16 bit half precision" OFF)
+
+if (ENABLE_COMPLEX_HALF)
+    # Half storage rounds to and from "real1" on every access, so the math type must be single precision.
+    set(ENABLE_COMPLEX8 ON)
+endif (ENABLE_COMPLEX_HALF)
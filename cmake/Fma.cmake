@@ -0,0 +1,5 @@
+option (ENABLE_FMA "Use FMA3 fused multiply/add instructions in the complex SIMD kernels, if available" OFF)
+
+if (ENABLE_FMA)
+    set(ENABLE_FMA ON)
+endif (ENABLE_FMA)
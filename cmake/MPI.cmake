@@ -0,0 +1,9 @@
+option (ENABLE_MPI "Shard the state vector across MPI ranks, via the QMPI layer" OFF)
+
+if (ENABLE_MPI)
+    find_package (MPI REQUIRED COMPONENTS CXX)
+    target_sources (qrack PRIVATE src/qmpi.cpp)
+    target_compile_definitions (qrack PUBLIC ENABLE_MPI=1)
+    target_include_directories (qrack PUBLIC ${MPI_CXX_INCLUDE_DIRS})
+    target_link_libraries (qrack ${MPI_CXX_LIBRARIES})
+endif (ENABLE_MPI)
@@ -0,0 +1,5 @@
+option (ENABLE_NUMA "Interleave state vector pages across NUMA nodes by first-touch, and pin pool workers" OFF)
+
+if (ENABLE_NUMA)
+    target_compile_definitions (qrack PUBLIC ENABLE_NUMA=1)
+endif (ENABLE_NUMA)
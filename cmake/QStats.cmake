@@ -0,0 +1,4 @@
+option (ENABLE_QSTATS "Track hot-path instrumentation counters, exposed via QInterface::GetStats()" OFF)
+if (ENABLE_QSTATS)
+    target_compile_definitions (qrack PUBLIC ENABLE_QSTATS=1)
+endif (ENABLE_QSTATS)
@@ -101,5 +101,5 @@ int main()
     std::cout << "After measurement (of value, key, or both):" << std::endl;
     std::cout << "Chance of match:" << qReg->ProbAll(TARGET_VALUE | (TARGET_KEY << valueLength)) << std::endl;
 
-    free(toLoad);
+    delete[] toLoad;
 }
@@ -48,15 +48,27 @@ struct Complex16x2Simd {
     }
     inline Complex16x2Simd operator*(const Complex16x2Simd& other) const
     {
+#if defined(__FMA__)
+        return _mm256_fmaddsub_pd(_val2, _mm256_shuffle_pd(other._val2, other._val2, 0),
+            _mm256_mul_pd(
+                _mm256_shuffle_pd(_val2, _val2, 5), _mm256_shuffle_pd(other._val2, other._val2, 15)));
+#else
         return _mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(_val2, _val2, 5),
                                  _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, other._val2), other._val2, 15)),
             _mm256_mul_pd(_val2, _mm256_shuffle_pd(other._val2, other._val2, 0)));
+#endif
     }
     inline Complex16x2Simd operator*=(const Complex16x2Simd& other)
     {
+#if defined(__FMA__)
+        _val2 = _mm256_fmaddsub_pd(_val2, _mm256_shuffle_pd(other._val2, other._val2, 0),
+            _mm256_mul_pd(
+                _mm256_shuffle_pd(_val2, _val2, 5), _mm256_shuffle_pd(other._val2, other._val2, 15)));
+#else
         _val2 = _mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(_val2, _val2, 5),
                                   _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, other._val2), other._val2, 15)),
             _mm256_mul_pd(_val2, _mm256_shuffle_pd(other._val2, other._val2, 0)));
+#endif
         return _val2;
     }
     inline Complex16x2Simd operator*(const double rhs) const { return _mm256_mul_pd(_val2, _mm256_set1_pd(rhs)); }
@@ -85,18 +97,36 @@ inline Complex16x2Simd matrixMul(
 {
     __m256d dupeLo = _mm256_permute2f128_pd(qubit._val2, qubit._val2, 0);
     __m256d dupeHi = _mm256_permute2f128_pd(qubit._val2, qubit._val2, 17);
+#if defined(__FMA__)
+    return _mm256_add_pd(_mm256_fmaddsub_pd(mtrxCol1._val2, _mm256_shuffle_pd(dupeLo, dupeLo, 0),
+                             _mm256_mul_pd(_mm256_shuffle_pd(mtrxCol1._val2, mtrxCol1._val2, 5),
+                                 _mm256_shuffle_pd(dupeLo, dupeLo, 15))),
+        _mm256_fmaddsub_pd(mtrxCol2._val2, _mm256_shuffle_pd(dupeHi, dupeHi, 0),
+            _mm256_mul_pd(
+                _mm256_shuffle_pd(mtrxCol2._val2, mtrxCol2._val2, 5), _mm256_shuffle_pd(dupeHi, dupeHi, 15))));
+#else
     return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(mtrxCol1._val2, mtrxCol1._val2, 5),
                                            _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, dupeLo), dupeLo, 15)),
                              _mm256_mul_pd(mtrxCol1._val2, _mm256_shuffle_pd(dupeLo, dupeLo, 0))),
         _mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(mtrxCol2._val2, mtrxCol2._val2, 5),
                           _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, dupeHi), dupeHi, 15)),
             _mm256_mul_pd(mtrxCol2._val2, _mm256_shuffle_pd(dupeHi, dupeHi, 0))));
+#endif
 }
 inline Complex16x2Simd matrixMul(
     const double& nrm, const Complex16x2Simd& mtrxCol1, const Complex16x2Simd& mtrxCol2, const Complex16x2Simd& qubit)
 {
     __m256d dupeLo = _mm256_permute2f128_pd(qubit._val2, qubit._val2, 0);
     __m256d dupeHi = _mm256_permute2f128_pd(qubit._val2, qubit._val2, 17);
+#if defined(__FMA__)
+    return _mm256_mul_pd(_mm256_set1_pd(nrm),
+        _mm256_add_pd(_mm256_fmaddsub_pd(mtrxCol1._val2, _mm256_shuffle_pd(dupeLo, dupeLo, 0),
+                          _mm256_mul_pd(_mm256_shuffle_pd(mtrxCol1._val2, mtrxCol1._val2, 5),
+                              _mm256_shuffle_pd(dupeLo, dupeLo, 15))),
+            _mm256_fmaddsub_pd(mtrxCol2._val2, _mm256_shuffle_pd(dupeHi, dupeHi, 0),
+                _mm256_mul_pd(
+                    _mm256_shuffle_pd(mtrxCol2._val2, mtrxCol2._val2, 5), _mm256_shuffle_pd(dupeHi, dupeHi, 15)))));
+#else
     return _mm256_mul_pd(_mm256_set1_pd(nrm),
         _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(mtrxCol1._val2, mtrxCol1._val2, 5),
                                         _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, dupeLo), dupeLo, 15)),
@@ -104,6 +134,7 @@ inline Complex16x2Simd matrixMul(
             _mm256_add_pd(_mm256_mul_pd(_mm256_shuffle_pd(mtrxCol2._val2, mtrxCol2._val2, 5),
                               _mm256_shuffle_pd(_mm256_sub_pd(ZERO_256D, dupeHi), dupeHi, 15)),
                 _mm256_mul_pd(mtrxCol2._val2, _mm256_shuffle_pd(dupeHi, dupeHi, 0)))));
+#endif
 }
 inline Complex16x2Simd operator*(const double lhs, const Complex16x2Simd& rhs)
 {
@@ -15,6 +15,7 @@
 #if defined(_WIN32)
 #include <intrin.h>
 #else
+#include <immintrin.h>
 #include <xmmintrin.h>
 #endif
 
@@ -47,15 +48,25 @@ struct Complex8x2Simd {
     }
     inline Complex8x2Simd operator*(const Complex8x2Simd& other) const
     {
+#if defined(__FMA__)
+        return _mm_fmaddsub_ps(_val2, _mm_shuffle_ps(other._val2, other._val2, 160),
+            _mm_mul_ps(_mm_shuffle_ps(_val2, _val2, 177), _mm_shuffle_ps(other._val2, other._val2, 245)));
+#else
         return _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(_val2, _val2, 177),
                               _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(other._val2, other._val2, 245))),
             _mm_mul_ps(_val2, _mm_shuffle_ps(other._val2, other._val2, 160)));
+#endif
     }
     inline Complex8x2Simd operator*=(const Complex8x2Simd& other)
     {
+#if defined(__FMA__)
+        _val2 = _mm_fmaddsub_ps(_val2, _mm_shuffle_ps(other._val2, other._val2, 160),
+            _mm_mul_ps(_mm_shuffle_ps(_val2, _val2, 177), _mm_shuffle_ps(other._val2, other._val2, 245)));
+#else
         _val2 = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(_val2, _val2, 177),
                                _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(other._val2, other._val2, 245))),
             _mm_mul_ps(_val2, _mm_shuffle_ps(other._val2, other._val2, 160)));
+#endif
         return _val2;
     }
     inline Complex8x2Simd operator*(const float rhs) const { return _mm_mul_ps(_val2, _mm_set1_ps(rhs)); }
@@ -84,18 +95,35 @@ inline Complex8x2Simd matrixMul(
 {
     __m128 dupeLo = _mm_shuffle_ps(qubit._val2, qubit._val2, 68);
     __m128 dupeHi = _mm_shuffle_ps(qubit._val2, qubit._val2, 238);
+#if defined(__FMA__)
+    return _mm_add_ps(
+        _mm_fmaddsub_ps(mtrxCol1._val2, _mm_shuffle_ps(dupeLo, dupeLo, 160),
+            _mm_mul_ps(_mm_shuffle_ps(mtrxCol1._val2, mtrxCol1._val2, 177), _mm_shuffle_ps(dupeLo, dupeLo, 245))),
+        _mm_fmaddsub_ps(mtrxCol2._val2, _mm_shuffle_ps(dupeHi, dupeHi, 160),
+            _mm_mul_ps(_mm_shuffle_ps(mtrxCol2._val2, mtrxCol2._val2, 177), _mm_shuffle_ps(dupeHi, dupeHi, 245))));
+#else
     return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(mtrxCol1._val2, mtrxCol1._val2, 177),
                                      _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(dupeLo, dupeLo, 245))),
                           _mm_mul_ps(mtrxCol1._val2, _mm_shuffle_ps(dupeLo, dupeLo, 160))),
         _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(mtrxCol2._val2, mtrxCol2._val2, 177),
                        _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(dupeHi, dupeHi, 245))),
             _mm_mul_ps(mtrxCol2._val2, _mm_shuffle_ps(dupeHi, dupeHi, 160))));
+#endif
 }
 inline Complex8x2Simd matrixMul(
     const float& nrm, const Complex8x2Simd& mtrxCol1, const Complex8x2Simd& mtrxCol2, const Complex8x2Simd& qubit)
 {
     __m128 dupeLo = _mm_shuffle_ps(qubit._val2, qubit._val2, 68);
     __m128 dupeHi = _mm_shuffle_ps(qubit._val2, qubit._val2, 238);
+#if defined(__FMA__)
+    return _mm_mul_ps(_mm_set1_ps(nrm),
+        _mm_add_ps(
+            _mm_fmaddsub_ps(mtrxCol1._val2, _mm_shuffle_ps(dupeLo, dupeLo, 160),
+                _mm_mul_ps(_mm_shuffle_ps(mtrxCol1._val2, mtrxCol1._val2, 177), _mm_shuffle_ps(dupeLo, dupeLo, 245))),
+            _mm_fmaddsub_ps(mtrxCol2._val2, _mm_shuffle_ps(dupeHi, dupeHi, 160),
+                _mm_mul_ps(
+                    _mm_shuffle_ps(mtrxCol2._val2, mtrxCol2._val2, 177), _mm_shuffle_ps(dupeHi, dupeHi, 245)))));
+#else
     return _mm_mul_ps(_mm_set1_ps(nrm),
         _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(mtrxCol1._val2, mtrxCol1._val2, 177),
                                   _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(dupeLo, dupeLo, 245))),
@@ -103,6 +131,7 @@ inline Complex8x2Simd matrixMul(
             _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(mtrxCol2._val2, mtrxCol2._val2, 177),
                            _mm_xor_ps(SIGNMASK, _mm_shuffle_ps(dupeHi, dupeHi, 245))),
                 _mm_mul_ps(mtrxCol2._val2, _mm_shuffle_ps(dupeHi, dupeHi, 160)))));
+#endif
 }
 inline Complex8x2Simd operator*(const float lhs, const Complex8x2Simd& rhs)
 {
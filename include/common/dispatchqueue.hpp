@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace Qrack {
+
+typedef std::function<void(void)> DispatchFn;
+
+/**
+ * "Qrack::DispatchQueue" is a lazily-started, single-consumer FIFO of deferred operations, mirroring the OpenCL
+ * engine's wait event queue for the CPU engine: gates are enqueued and the host thread returns immediately, while a
+ * single dispatch thread executes the operations in order. "Finish()" blocks until the queue is drained, and
+ * "IsFinished()" polls the same condition.
+ */
+class DispatchQueue {
+public:
+    DispatchQueue();
+    ~DispatchQueue();
+
+    /** Queue an operation for asynchronous, in-order execution. */
+    void Dispatch(const DispatchFn& fn);
+    /** Block until all queued operations have completed. */
+    void Finish();
+    /** Discard all operations not yet started, then block on any operation in flight. */
+    void Dump();
+    /** "true" if no operation is queued or in flight. */
+    bool IsFinished();
+
+private:
+    std::mutex queueMutex;
+    std::queue<DispatchFn> fns;
+    std::condition_variable queueCondition;
+    std::condition_variable finishCondition;
+    std::thread worker;
+    bool isStarted;
+    bool isWorking;
+    bool isStopping;
+
+    void WorkerLoop();
+};
+
+} // namespace Qrack
@@ -25,6 +25,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -57,9 +58,11 @@ enum OCLAPI {
     OCL_API_APPLY2X2_SINGLE_WIDE,
     OCL_API_APPLY2X2_NORM_SINGLE_WIDE,
     OCL_API_APPLY2X2_DOUBLE_WIDE,
+    OCL_API_APPLY2X2_BATCH,
     OCL_API_UNIFORMLYCONTROLLED,
     OCL_API_COMPOSE,
     OCL_API_COMPOSE_WIDE,
+    OCL_API_COMPOSE_SLICE,
     OCL_API_COMPOSE_MID,
     OCL_API_DECOMPOSEPROB,
     OCL_API_DECOMPOSEAMP,
@@ -71,8 +74,13 @@ enum OCLAPI {
     OCL_API_PROBMASKALL,
     OCL_API_X_SINGLE,
     OCL_API_X_SINGLE_WIDE,
+    OCL_API_X_MASK,
     OCL_API_Z_SINGLE,
     OCL_API_Z_SINGLE_WIDE,
+    OCL_API_PHASE_SINGLE,
+    OCL_API_PHASE_SINGLE_WIDE,
+    OCL_API_INVERT_SINGLE,
+    OCL_API_INVERT_SINGLE_WIDE,
     OCL_API_ROL,
     OCL_API_INC,
     OCL_API_CINC,
@@ -85,11 +93,14 @@ enum OCLAPI {
     OCL_API_INDEXEDLDA,
     OCL_API_INDEXEDADC,
     OCL_API_INDEXEDSBC,
+    OCL_API_INDEXEDCMP,
     OCL_API_HASH,
     OCL_API_APPROXCOMPARE,
     OCL_API_NORMALIZE,
     OCL_API_NORMALIZE_WIDE,
     OCL_API_UPDATENORM,
+    OCL_API_NONZERO_COUNT,
+    OCL_API_COMPACT_SPARSE,
     OCL_API_APPLYM,
     OCL_API_APPLYMREG,
     OCL_API_PHASEFLIP,
@@ -121,6 +132,26 @@ struct OCLKernelHandle {
     }
 };
 
+/** Accumulated profile of one kernel enum, in "QRACK_OCL_PROFILING" mode. Timings are nanoseconds, summed over every
+ * completed dispatch: "queueNs" is host queue residency, (QUEUED to SUBMIT,) "submitNs" is device wait, (SUBMIT to
+ * START,) and "runNs" is execution, (START to END). "byteCount" sums the sizes of all buffer arguments passed. */
+struct OCLKernelProfile {
+    cl_ulong callCount;
+    cl_ulong queueNs;
+    cl_ulong submitNs;
+    cl_ulong runNs;
+    cl_ulong byteCount;
+
+    OCLKernelProfile()
+        : callCount(0)
+        , queueNs(0)
+        , submitNs(0)
+        , runNs(0)
+        , byteCount(0)
+    {
+    }
+};
+
 class OCLDeviceCall {
 protected:
     std::lock_guard<std::mutex> guard;
@@ -155,8 +186,11 @@ public:
 
 protected:
     std::mutex waitEventsMutex;
+    std::mutex tuningMutex;
     std::map<OCLAPI, cl::Kernel> calls;
     std::map<OCLAPI, std::unique_ptr<std::mutex>> mutexes;
+    std::map<OCLAPI, size_t> preferredGroupSizes;
+    std::map<OCLAPI, std::map<size_t, double>> tuningSamples;
 
 public:
     OCLDeviceContext(cl::Platform& p, cl::Device& d, cl::Context& c, int cntxt_id)
@@ -166,9 +200,15 @@ public:
         , context_id(cntxt_id)
     {
         cl_int error;
-        queue = cl::CommandQueue(context, d, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &error);
+        // Profiling is enabled for first-use kernel work-group size tuning, (and for the "QRACK_OCL_PROFILING"
+        // per-kernel profile,) when the device supports it.
+        queue = cl::CommandQueue(
+            context, d, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE, &error);
         if (error != CL_SUCCESS) {
-            queue = cl::CommandQueue(context, d);
+            queue = cl::CommandQueue(context, d, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &error);
+            if (error != CL_SUCCESS) {
+                queue = cl::CommandQueue(context, d);
+            }
         }
 
         wait_events =
@@ -180,6 +220,84 @@ public:
 
     OCLDeviceCall Reserve(OCLAPI call) { return OCLDeviceCall(*(mutexes[call]), calls[call]); }
 
+    /// Best known local work-group size for a kernel on this device, or 0 if it has not been tuned.
+    size_t GetPreferredGroupSize(OCLAPI call)
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+        std::map<OCLAPI, size_t>::iterator it = preferredGroupSizes.find(call);
+        return (it == preferredGroupSizes.end()) ? 0 : it->second;
+    }
+
+    void SetPreferredGroupSize(OCLAPI call, size_t gs)
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+        preferredGroupSizes[call] = gs;
+    }
+
+    std::map<OCLAPI, size_t> GetPreferredGroupSizes()
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+        return preferredGroupSizes;
+    }
+
+    /** The next work-group size to benchmark for a kernel, cycling through powers of two between the kernel's
+     * preferred size multiple and its work-group size limit, or 0 once every candidate has a sample. */
+    size_t NextTuningCandidate(OCLAPI call)
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+
+        size_t minSize = calls[call].getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+        size_t maxSize = calls[call].getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+
+        size_t candidate = 1;
+        while (candidate < minSize) {
+            candidate <<= 1U;
+        }
+
+        std::map<size_t, double>& samples = tuningSamples[call];
+        while (candidate <= maxSize) {
+            if (samples.find(candidate) == samples.end()) {
+                return candidate;
+            }
+            candidate <<= 1U;
+        }
+
+        return 0;
+    }
+
+    /** Record a benchmark sample for a candidate work-group size. (Samples are normalized per work item, since
+     * successive dispatches of the same kernel vary in global size; the minimum observed time is kept.) */
+    void AddTuningSample(OCLAPI call, size_t candidate, double nsPerItem)
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+        std::map<size_t, double>& samples = tuningSamples[call];
+        std::map<size_t, double>::iterator it = samples.find(candidate);
+        if ((it == samples.end()) || (nsPerItem < it->second)) {
+            samples[candidate] = nsPerItem;
+        }
+    }
+
+    /** Adopt the fastest sampled work-group size for a kernel, (or "defaultSize," without any samples). */
+    size_t FinishTuning(OCLAPI call, size_t defaultSize)
+    {
+        std::lock_guard<std::mutex> guard(tuningMutex);
+
+        size_t best = defaultSize;
+        double bestTime = -1.0;
+        std::map<size_t, double>& samples = tuningSamples[call];
+        for (std::map<size_t, double>::iterator it = samples.begin(); it != samples.end(); it++) {
+            if ((bestTime < 0.0) || (it->second < bestTime)) {
+                best = it->first;
+                bestTime = it->second;
+            }
+        }
+
+        preferredGroupSizes[call] = best;
+        tuningSamples.erase(call);
+
+        return best;
+    }
+
     EventVecPtr ResetWaitEvents()
     {
         std::lock_guard<std::mutex> guard(waitEventsMutex);
@@ -220,10 +338,46 @@ public:
     int GetDefaultDeviceID() { return default_device_context->context_id; }
     /// Pick a default device, for QEngineOCL instances that don't specify a preferred device.
     void SetDefaultDeviceContext(DeviceContextPtr dcp);
-    /// Initialize the OCL environment, with the option to save the generated binaries. Binaries will be saved/loaded
-    /// from the folder path "home". This returns a Qrack::OCLInitResult object which should be passed to
-    /// SetDeviceContextPtrVector().
+    /** Allocate pinned (page-locked) host memory, backed by a CL_MEM_ALLOC_HOST_PTR buffer on the device context.
+     * Copies between this memory and device memory run at pinned (DMA) speeds, and, on devices with host-unified
+     * memory, access is zero-copy. Returns NULL if the driver cannot pin the requested size, in which case the
+     * caller should fall back to a pageable allocation.
+     */
+    void* AllocPinned(DeviceContextPtr devCntxt, size_t byteCount);
+    /// Get the buffer backing a pinned allocation, (or NULL, if the pointer did not come from AllocPinned()).
+    std::shared_ptr<cl::Buffer> GetPinnedBuffer(void* ptr);
+    /// Release a pinned allocation. (Returns "false," if the pointer did not come from AllocPinned().)
+    bool FreePinned(void* ptr);
+    /** Copy the contents of a buffer under one device context into a buffer under another, as directly as the
+     * platform topology permits. Same-context copies, (devices of one platform,) run as a single on-platform
+     * clEnqueueCopyBuffer, peer-to-peer where the driver supports it. Cross-context copies stream through
+     * double-buffered pinned staging chunks, the next source read overlapping the current destination write, so no
+     * full-size host copy is ever materialized. Blocks until the destination holds the full contents.
+     */
+    void MigrateBuffer(DeviceContextPtr srcCntxt, std::shared_ptr<cl::Buffer> srcBuffer, DeviceContextPtr destCntxt,
+        std::shared_ptr<cl::Buffer> destBuffer, size_t byteCount);
+    /// Initialize the OCL environment. Program binaries are cached in the folder path "home", keyed by device name,
+    /// driver version, and a hash of the kernel sources, so only the first process on a node ever JIT compiles, and
+    /// a stale binary is never loaded after a driver update or kernel change.
     static void InitOCL(bool buildFromSource = false, bool saveBinaries = false, std::string home = "*");
+    /// Whether first-use kernel work-group size tuning is active. (Disable with "QRACK_DISABLE_OCL_TUNING".)
+    static bool IsTuningEnabled() { return !getenv("QRACK_DISABLE_OCL_TUNING"); }
+    /** Whether per-kernel profile accumulation is active. (Enable with "QRACK_OCL_PROFILING". The command queues are
+     * always created with CL_QUEUE_PROFILING_ENABLE, for work-group size tuning, so opting in only adds the cost of
+     * reading back the event timestamps of every completed kernel.) */
+    static bool IsProfilingEnabled() { return getenv("QRACK_OCL_PROFILING") != NULL; }
+    /// Fold one completed kernel dispatch into the profile of its enum.
+    void AddKernelProfileSample(OCLAPI call, cl_ulong queueNs, cl_ulong submitNs, cl_ulong runNs, cl_ulong byteCount);
+    /// Get a snapshot of the accumulated per-kernel profiles.
+    std::map<OCLAPI, OCLKernelProfile> GetKernelProfiles();
+    /// Discard all accumulated per-kernel profiles.
+    void ResetKernelProfiles();
+    /// Write a per-kernel summary table, (calls, timings, and bytes, sorted by total execution time,) to a stream.
+    void DumpKernelProfiles(std::ostream& os);
+    /// Persist the tuned kernel work-group sizes of a device, next to the precompiled kernel binaries.
+    void SaveTuning(DeviceContextPtr devCntxt, std::string home = "*");
+    /// Load any previously persisted kernel work-group sizes for a device.
+    static void LoadTuning(DeviceContextPtr devCntxt, std::string path);
     /// Get default location for precompiled binaries:
     static std::string GetDefaultBinaryPath()
     {
@@ -250,9 +404,21 @@ private:
     static const std::vector<OCLKernelHandle> kernelHandles;
     static const std::string binary_file_prefix;
     static const std::string binary_file_ext;
+    static const std::string tuning_file_prefix;
+    static const std::string tuning_file_ext;
     std::vector<DeviceContextPtr> all_device_contexts;
     DeviceContextPtr default_device_context;
 
+    struct PinnedAlloc {
+        std::shared_ptr<cl::Buffer> buffer;
+        DeviceContextPtr devCntxt;
+    };
+    std::mutex pinned_mutex;
+    std::map<void*, PinnedAlloc> pinned_allocs;
+
+    std::mutex profile_mutex;
+    std::map<OCLAPI, OCLKernelProfile> kernel_profiles;
+
     OCLEngine(); // Private so that it can  not be called
     OCLEngine(OCLEngine const&); // copy constructor is private
     OCLEngine& operator=(OCLEngine const& rhs); // assignment operator is private
@@ -260,7 +426,7 @@ private:
 
     /// Make the program, from either source or binary
     static cl::Program MakeProgram(bool buildFromSource, cl::Program::Sources sources, std::string path,
-        std::shared_ptr<OCLDeviceContext> devCntxt);
+        std::shared_ptr<OCLDeviceContext> devCntxt, bool* loadedBinary = NULL);
     /// Save the program binary:
     static void SaveBinary(cl::Program program, std::string path, std::string fileName);
 
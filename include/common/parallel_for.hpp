@@ -13,6 +13,7 @@
 #pragma once
 
 #include <algorithm>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -21,6 +22,38 @@
 
 namespace Qrack {
 
+/**
+ * "Qrack::ConcurrencyBudget" partitions the host cores across simultaneously executing parallel loops. Every
+ * ParallelFor instance in the process, (QUnit's separated shard engines, QUnitMulti's per-device engines, and the
+ * asynchronous dispatch queues of the engines themselves,) draws workers from the one shared ThreadPool, so two
+ * concurrently running wide loops would otherwise each dispatch a full complement of tasks and oversubscribe the
+ * pool 2x, while a narrow loop running beside a wide one deserves only a sliver of it. Each loop registers its item
+ * count as a weight for the duration of its dispatch and receives a proportional share of its concurrency level,
+ * so shares rebalance automatically as shards compose and decompose. (A share is fixed at dispatch; loops already
+ * in flight aren't re-throttled, so proportions converge over successive loops rather than instantaneously.)
+ */
+class ConcurrencyBudget {
+public:
+    /// Get a pointer to the Instance of the singleton. (The instance will be instantiated, if it does not exist yet.)
+    static ConcurrencyBudget* Instance();
+
+    /// Register a loop of "weight" items for the duration of its dispatch, returning its proportional share of
+    /// "numCores", (always at least 1, and never more than "numCores").
+    int32_t Acquire(const int32_t& numCores, const uint64_t& weight);
+
+    /// Unregister a loop's weight, once its dispatch has joined.
+    void Release(const uint64_t& weight);
+
+private:
+    std::mutex budgetMutex;
+    uint64_t activeWeight;
+
+    ConcurrencyBudget(); // Private so that it can not be called
+    ConcurrencyBudget(ConcurrencyBudget const&); // copy constructor is private
+    ConcurrencyBudget& operator=(ConcurrencyBudget const& rhs); // assignment operator is private
+    static ConcurrencyBudget* m_pInstance;
+};
+
 class ParallelFor {
 private:
     int32_t numCores;
@@ -40,9 +73,12 @@ public:
 
     /**
      * Iterate through the permutations a maximum of end-begin times, allowing
-     * the caller to control the incrementation offset through 'inc'.
+     * the caller to control the incrementation offset through 'inc'. "stride" is the granularity at which workers
+     * claim work, (PSTRIDE by default); a caller whose increment function spreads the index across distant regions
+     * of the state vector can raise it, so each claim becomes one cache-tile pass over the regions it touches.
      */
-    void par_for_inc(const bitCapInt begin, const bitCapInt itemCount, IncrementFunc, ParallelFunc fn);
+    void par_for_inc(const bitCapInt begin, const bitCapInt itemCount, IncrementFunc, ParallelFunc fn,
+        const bitCapInt stride = PSTRIDE);
 
     /** Call fn once for every numerical value between begin and end. */
     void par_for(const bitCapInt begin, const bitCapInt end, ParallelFunc fn);
@@ -131,6 +131,7 @@ public:
         , isReadLocked(true)
     {
     }
+    bitCapInt get_capacity() { return capacity; }
     virtual complex read(const bitCapInt& i) = 0;
     virtual void write(const bitCapInt& i, const complex& c) = 0;
     /// Optimized "write" that is only guaranteed to write if either amplitude is nonzero. (Useful for the result of 2x2
@@ -139,6 +140,8 @@ public:
     virtual void clear() = 0;
     virtual void copy_in(const complex* inArray) = 0;
     virtual void copy_out(complex* outArray) = 0;
+    /// Ranged "copy_out," so callers can stream the state through a bounded staging buffer
+    virtual void copy_out(complex* outArray, const bitCapInt& offset, const bitCapInt& length) = 0;
     virtual void copy(StateVectorPtr toCopy) = 0;
     virtual void get_probs(real1* outArray) = 0;
     virtual bool is_sparse() = 0;
@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Qrack {
+
+/**
+ * "Qrack::ThreadPool" manages a single, long-lived set of worker threads, shared by all ParallelFor instances in the
+ * process. Each worker owns a deque of pending tasks; tasks are dispatched round-robin, and an idle worker steals from
+ * the back of its siblings' deques, so imbalanced work distributions rebalance without repeated thread creation and
+ * teardown.
+ */
+class ThreadPool {
+public:
+    /// Get a pointer to the Instance of the singleton. (The instance will be instantiated, if it does not exist yet.)
+    static ThreadPool* Instance();
+
+    /// Get the count of worker threads in the pool. (This is the hardware concurrency, at instantiation.)
+    int GetWorkerCount() { return (int)workers.size(); }
+
+    /// "true" if the calling thread is one of the pool's own workers. (Submitting and then blocking on pool tasks from
+    /// a pool worker can deadlock; callers should run inline, instead.)
+    static bool IsPoolThread();
+
+    /** Queue a task for asynchronous execution on the pool, returning a future for its result. */
+    template <typename Fn> auto Dispatch(Fn fn) -> std::future<decltype(fn())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::move(fn));
+        Push([task]() { (*task)(); });
+        return task->get_future();
+    }
+
+    ~ThreadPool();
+
+private:
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<std::deque<std::function<void()>>>> queues;
+    std::mutex poolMutex;
+    std::condition_variable poolCondition;
+    unsigned int dispatchIndex;
+    bool isStopping;
+
+    ThreadPool(); // Private so that it can not be called
+    ThreadPool(ThreadPool const&); // copy constructor is private
+    ThreadPool& operator=(ThreadPool const& rhs); // assignment operator is private
+    static ThreadPool* m_pInstance;
+
+    void Push(std::function<void()> task);
+    void Worker(const unsigned int w);
+    bool Pop(const unsigned int w, std::function<void()>& task);
+};
+
+} // namespace Qrack
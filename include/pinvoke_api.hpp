@@ -43,6 +43,13 @@ MICROSOFT_QUANTUM_DECL void allocateQubit(_In_ unsigned sid, _In_ unsigned qid);
 MICROSOFT_QUANTUM_DECL void release(_In_ unsigned sid, _In_ unsigned q);
 MICROSOFT_QUANTUM_DECL unsigned num_qubits(_In_ unsigned sid);
 
+// instrumentation counters, (only when built with the ENABLE_QSTATS CMake option)
+#if ENABLE_QSTATS
+MICROSOFT_QUANTUM_DECL void GetStats(_In_ unsigned sid, size_t* gateSweeps, size_t* fusionHits,
+    size_t* separationTries, size_t* separationHits, unsigned* maxShardWidth);
+MICROSOFT_QUANTUM_DECL void ResetStats(_In_ unsigned sid);
+#endif
+
 // single-qubit gates
 MICROSOFT_QUANTUM_DECL void X(_In_ unsigned sid, _In_ unsigned q);
 MICROSOFT_QUANTUM_DECL void Y(_In_ unsigned sid, _In_ unsigned q);
@@ -53,6 +60,24 @@ MICROSOFT_QUANTUM_DECL void T(_In_ unsigned sid, _In_ unsigned q);
 MICROSOFT_QUANTUM_DECL void AdjS(_In_ unsigned sid, _In_ unsigned q);
 MICROSOFT_QUANTUM_DECL void AdjT(_In_ unsigned sid, _In_ unsigned q);
 
+// batched gate submission
+
+enum GateOpcode {
+    GateX = 0,
+    GateY = 1,
+    GateZ = 2,
+    GateH = 3,
+    GateS = 4,
+    GateT = 5,
+    GateAdjS = 6,
+    GateAdjT = 7,
+    /// Generic single qubit operator; consumes 8 doubles from the "matrices" stream
+    GateMtrx = 8
+};
+
+MICROSOFT_QUANTUM_DECL void ApplyGateBatch(_In_ unsigned sid, _In_ unsigned n, _In_reads_(n) unsigned* opcodes,
+    _In_reads_(n) unsigned* targets, _In_reads_(n) unsigned* controlLens, unsigned* controls, double* matrices);
+
 // multi-controlled single-qubit gates
 
 MICROSOFT_QUANTUM_DECL void MCX(_In_ unsigned sid, _In_ unsigned n, _In_reads_(n) unsigned* c, _In_ unsigned q);
@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2020. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "qengine_cpu.hpp"
+
+#if ENABLE_OPENCL
+#include "common/oclengine.hpp"
+#include "qengine_opencl.hpp"
+#endif
+
+namespace Qrack {
+
+/**
+ * Per-host calibration profile for QINTERFACE_AUTO engine selection.
+ *
+ * The right choice between QEngineCPU and QEngineOCL, (and between the sparse and dense state vector flavors,)
+ * depends on the width of the register and on the host's actual hardware, so hand-tuned crossover tables go stale
+ * with every deployment. Calibrate() runs a one-time microbenchmark of the Apply2x2 inner loop at several widths per
+ * engine and stores the measured crossover widths on disk; CreateQuantumInterface() then consults the profile
+ * whenever QINTERFACE_AUTO is requested, re-resolving per instantiation, so a QUnit with an auto subengine re-decides
+ * as its shards grow and shrink through Compose() and Decompose().
+ *
+ * The profile lives at the path in the QRACK_CALIBRATION_PATH environment variable, or "~/.qrack_calibration" by
+ * default. Without a profile on disk, conservative built-in defaults apply, (matching the hand-tuned constants they
+ * replace,) rather than benchmarking implicitly at first use.
+ */
+class EngineCalibration {
+protected:
+    /// Widths probed by Calibrate(), chosen to bracket realistic dispatch-bound and sweep-bound shard sizes.
+    static const bitLenInt CALIBRATION_WIDTH_MIN = 8U;
+    static const bitLenInt CALIBRATION_WIDTH_MAX = 18U;
+    /// Default crossover width, at/above which an accelerator is assumed to win, when no profile is on disk.
+    static const bitLenInt DEFAULT_OCL_CROSSOVER_QUBITS = 12U;
+    /// Default width below which the dense state vector flavor is assumed to always win, when no profile is on disk.
+    static const bitLenInt DEFAULT_SPARSE_MIN_QUBITS = 16U;
+
+    bool isCalibrated;
+    bitLenInt oclCrossoverQubits;
+    bitLenInt sparseMinQubits;
+
+    EngineCalibration()
+        : isCalibrated(false)
+        , oclCrossoverQubits(DEFAULT_OCL_CROSSOVER_QUBITS)
+        , sparseMinQubits(DEFAULT_SPARSE_MIN_QUBITS)
+    {
+        Load();
+    }
+
+    static std::string GetProfilePath()
+    {
+        if (getenv("QRACK_CALIBRATION_PATH")) {
+            return std::string(getenv("QRACK_CALIBRATION_PATH"));
+        }
+#if defined(_WIN32) && !defined(__CYGWIN__)
+        return std::string(getenv("HOMEDRIVE") ? getenv("HOMEDRIVE") : "") +
+            std::string(getenv("HOMEPATH") ? getenv("HOMEPATH") : "") + "\\.qrack_calibration";
+#else
+        return std::string(getenv("HOME") ? getenv("HOME") : "") + "/.qrack_calibration";
+#endif
+    }
+
+    /// Time "reps" full-register sweeps of single-bit gates, (the Apply2x2 inner loop,) in seconds.
+    static double TimeApply2x2(QInterfacePtr qReg, const bitLenInt& width, const bitCapIntOcl& reps)
+    {
+        // One throwaway sweep faults the buffers in, so allocation is not charged to either engine:
+        for (bitLenInt q = 0; q < width; q++) {
+            qReg->H(q);
+        }
+        qReg->Finish();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (bitCapIntOcl r = 0; r < reps; r++) {
+            for (bitLenInt q = 0; q < width; q++) {
+                qReg->H(q);
+            }
+        }
+        qReg->Finish();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    /// Time "reps" self-inverting single-bit gate pairs on one qubit, leaving the state low-density, in seconds.
+    static double TimeApply2x2LowDensity(QInterfacePtr qReg, const bitCapIntOcl& reps)
+    {
+        qReg->H(0);
+        qReg->H(0);
+        qReg->Finish();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (bitCapIntOcl r = 0; r < reps; r++) {
+            qReg->H(0);
+            qReg->H(0);
+        }
+        qReg->Finish();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    /// Repetition count per width, sized so each probe sweeps a comparable total amplitude volume.
+    static bitCapIntOcl RepsForWidth(const bitLenInt& width)
+    {
+        bitCapIntOcl reps = (bitCapIntOcl)(pow2Ocl(24U) / pow2Ocl(width));
+        if (reps < 4U) {
+            reps = 4U;
+        }
+        if (reps > 512U) {
+            reps = 512U;
+        }
+        return reps;
+    }
+
+public:
+    static EngineCalibration& Instance()
+    {
+        static EngineCalibration instance;
+        return instance;
+    }
+
+    /// True when a measured profile, (from disk or a Calibrate() run,) backs the thresholds, rather than defaults.
+    bool IsCalibrated() { return isCalibrated; }
+
+    /// Width at/above which the measured profile picks QEngineOCL over QEngineCPU.
+    bitLenInt GetOclCrossoverQubits() { return oclCrossoverQubits; }
+
+    /// Width below which the measured profile picks the dense state vector flavor, even when sparse is requested.
+    bitLenInt GetSparseMinQubits() { return sparseMinQubits; }
+
+    /// Resolve QINTERFACE_AUTO to a concrete engine type, for a register of "qubitCount" width.
+    QInterfaceEngine SelectEngine(const bitLenInt& qubitCount)
+    {
+#if ENABLE_OPENCL
+        return (qubitCount < oclCrossoverQubits) ? QINTERFACE_CPU : QINTERFACE_OPENCL;
+#else
+        return QINTERFACE_CPU;
+#endif
+    }
+
+    /// Resolve the state vector flavor: a sparse request is honored only at/above the measured worthwhile width.
+    bool SelectSparse(const bitLenInt& qubitCount, const bool& requestedSparse)
+    {
+        return requestedSparse && (qubitCount >= sparseMinQubits);
+    }
+
+    /// Read the profile from disk. Returns false, (leaving the defaults,) when none exists or the format is wrong.
+    bool Load()
+    {
+        std::ifstream ifs(GetProfilePath());
+        if (!ifs) {
+            return false;
+        }
+
+        std::string magic;
+        std::string key1, key2;
+        int crossover, sparseMin;
+        ifs >> magic >> key1 >> crossover >> key2 >> sparseMin;
+        if (!ifs || (magic != "qrack-calibration-v1") || (key1 != "ocl-crossover") || (key2 != "sparse-min")) {
+            return false;
+        }
+
+        oclCrossoverQubits = (bitLenInt)crossover;
+        sparseMinQubits = (bitLenInt)sparseMin;
+        isCalibrated = true;
+
+        return true;
+    }
+
+    /// Write the current thresholds to disk, (so the microbenchmark run is one-time per host).
+    bool Save()
+    {
+        std::ofstream ofs(GetProfilePath());
+        if (!ofs) {
+            return false;
+        }
+
+        ofs << "qrack-calibration-v1" << std::endl;
+        ofs << "ocl-crossover " << (int)oclCrossoverQubits << std::endl;
+        ofs << "sparse-min " << (int)sparseMinQubits << std::endl;
+
+        return (bool)ofs;
+    }
+
+    /**
+     * Run the one-time microbenchmark and persist the profile: the Apply2x2 inner loop is timed at several widths
+     * per engine, and each threshold is the lowest width where the candidate stays ahead through the top width, (so
+     * one noisy probe in the middle of the range can't pick a crossover the wider probes contradict).
+     */
+    void Calibrate()
+    {
+        bitLenInt nOclCrossover = CALIBRATION_WIDTH_MAX + 1U;
+        bitLenInt nSparseMin = CALIBRATION_WIDTH_MAX + 1U;
+
+#if ENABLE_OPENCL
+        for (bitLenInt width = CALIBRATION_WIDTH_MAX; width >= CALIBRATION_WIDTH_MIN; width -= 2U) {
+            const bitCapIntOcl reps = RepsForWidth(width);
+
+            QInterfacePtr cpuReg = std::make_shared<QEngineCPU>(width, 0);
+            const double cpuTime = TimeApply2x2(cpuReg, width, reps);
+            cpuReg = NULL;
+
+            QInterfacePtr oclReg = std::make_shared<QEngineOCL>(width, 0);
+            const double oclTime = TimeApply2x2(oclReg, width, reps);
+            oclReg = NULL;
+
+            if (oclTime < cpuTime) {
+                nOclCrossover = width;
+            } else {
+                break;
+            }
+        }
+#endif
+
+        for (bitLenInt width = CALIBRATION_WIDTH_MAX; width >= CALIBRATION_WIDTH_MIN; width -= 2U) {
+            const bitCapIntOcl reps = RepsForWidth(width);
+
+            QInterfacePtr denseReg = std::make_shared<QEngineCPU>(width, 0);
+            const double denseTime = TimeApply2x2LowDensity(denseReg, reps);
+            denseReg = NULL;
+
+            QInterfacePtr sparseReg = std::make_shared<QEngineCPU>(
+                width, 0, nullptr, CMPLX_DEFAULT_ARG, false, true, false, -1, true, true);
+            const double sparseTime = TimeApply2x2LowDensity(sparseReg, reps);
+            sparseReg = NULL;
+
+            if (sparseTime < denseTime) {
+                nSparseMin = width;
+            } else {
+                break;
+            }
+        }
+
+        oclCrossoverQubits = nOclCrossover;
+        sparseMinQubits = nSparseMin;
+        isCalibrated = true;
+
+        Save();
+    }
+};
+
+} // namespace Qrack
@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QCircuit is a recorded-gate representation of a quantum circuit, layered over
+// QInterface. Gates are buffered as data, peephole-fused at record time, and the
+// fused circuit can then be replayed against any QInterface instance any number of
+// times, paying circuit analysis once instead of per-execution dispatch.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <set>
+
+#include "qinterface.hpp"
+
+namespace Qrack {
+
+struct QCircuitGate;
+typedef std::shared_ptr<QCircuitGate> QCircuitGatePtr;
+
+/**
+ * A single recorded circuit operation: an arbitrary 2x2 unitary on one target qubit, associated with a set of control
+ * qubits. Each control permutation maps to its own 2x2 "payload" matrix, (any permutation without a payload acts as the
+ * identity,) so one QCircuitGate can hold what would otherwise be several controlled and anti-controlled gates on the
+ * same target, to be applied in a single uniformly controlled sweep.
+ */
+struct QCircuitGate {
+    bitLenInt target;
+    /** Per-control-permutation 2x2 payload matrix. Bit "i" of each key is the state of the i-th lowest control index. */
+    std::map<bitCapInt, BitOp> payloads;
+    std::set<bitLenInt> controls;
+
+    /** An uncontrolled single bit gate. */
+    QCircuitGate(const bitLenInt& trgt, const complex* mtrx);
+
+    /** A single bit gate fired by one permutation of a set of control qubits. */
+    QCircuitGate(const bitLenInt& trgt, const complex* mtrx, const std::set<bitLenInt>& ctrls, const bitCapInt& perm);
+
+    /** Can "other" be merged into this gate? (Same target and same control set.) */
+    bool CanCombine(QCircuitGatePtr other);
+
+    /** Merge "other" into this gate, as if applied after it. (Caller checks CanCombine first.) */
+    void Combine(QCircuitGatePtr other);
+
+    /** Would applying this gate be (approximately or exactly) a no-op? */
+    bool IsIdentity();
+
+    /** Are all payloads diagonal, (phase-only)? Diagonal gates commute across shared qubits. */
+    bool IsPhase();
+
+    /** Can "other" be recorded before this gate without changing the circuit? (Do the two gates commute?) */
+    bool CanPass(QCircuitGatePtr other);
+
+    /** Expand the payload map into the flat 4 * 2^k matrix array of QInterface::UniformlyControlledSingleBit. */
+    std::unique_ptr<complex[]> MakeUniformlyControlledPayload();
+
+    /** The control set, in the ascending index order assumed by the payload permutation keys. */
+    std::vector<bitLenInt> GetControlsVector() { return std::vector<bitLenInt>(controls.begin(), controls.end()); }
+};
+
+class QCircuit;
+typedef std::shared_ptr<QCircuit> QCircuitPtr;
+
+/**
+ * A "Qrack::QCircuit" records gates as data instead of executing them. At record time, each appended gate is commuted
+ * backward past any gates it passes and merged into the first compatible gate it reaches, (successive 2x2s on the same
+ * target compose, diagonal gates commute across shared qubits, and exact inverses cancel,) so the fused circuit holds
+ * the minimal number of state vector sweeps. Run() replays the fused circuit against any QInterface instance via the
+ * ApplySingleBit/ApplyControlledSingleBit/UniformlyControlledSingleBit primitives, so a parameterized ansatz replayed
+ * thousands of times pays for circuit analysis once.
+ */
+class QCircuit {
+protected:
+    bitLenInt qubitCount;
+    std::list<QCircuitGatePtr> gates;
+
+public:
+    QCircuit()
+        : qubitCount(0)
+        , gates()
+    {
+        // Intentionally left blank.
+    }
+
+    bitLenInt GetQubitCount() { return qubitCount; }
+
+    /** The number of state vector sweeps a Run() call will dispatch, after fusion. */
+    size_t GetGateCount() { return gates.size(); }
+
+    /** Record a gate, fusing it into the existing circuit where commutation allows. */
+    void AppendGate(QCircuitGatePtr nGate);
+
+    /** Replay the (fused) circuit against a simulator instance. (The recording is not consumed.) */
+    void Run(QInterfacePtr qsim) { Run(qsim.get()); }
+    void Run(QInterface* qsim);
+
+    /** Record an arbitrary single bit unitary transformation. */
+    void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex)
+    {
+        AppendGate(std::make_shared<QCircuitGate>(qubitIndex, mtrx));
+    }
+
+    /** Record an arbitrary single bit unitary transformation, with arbitrary control bits. */
+    void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+    {
+        std::set<bitLenInt> ctrls(controls, controls + controlLen);
+        AppendGate(std::make_shared<QCircuitGate>(target, mtrx, ctrls, pow2Mask(controlLen)));
+    }
+
+    /** Record an arbitrary single bit unitary transformation, with arbitrary (anti-)control bits. */
+    void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+    {
+        std::set<bitLenInt> ctrls(controls, controls + controlLen);
+        AppendGate(std::make_shared<QCircuitGate>(target, mtrx, ctrls, 0));
+    }
+};
+} // namespace Qrack
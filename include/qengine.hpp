@@ -30,6 +30,47 @@ protected:
     /// The value stored in runningNorm should always be the total probability implied by the norm of all amplitudes,
     /// summed, at each update. To normalize, we should always multiply by 1/sqrt(runningNorm).
     real1 runningNorm;
+    /// Total probability discarded by amplitude-threshold truncation, since the state was last wholly replaced.
+    real1 truncationError;
+
+    /// A Prob/ProbReg/ProbMask result, with the per-qubit dirty versions and running norm it was computed under.
+    struct ProbCacheEntry {
+        real1 prob;
+        real1 nrm;
+        std::vector<uint64_t> versions;
+    };
+    /**
+     * Cached mask probability reductions, keyed by (mask, permutation). Control software frequently re-queries the
+     * same mask between gates that provably don't touch its qubits, so each result is kept with the dirty versions
+     * of its mask qubits, (and the running norm,) at computation, and is returned without re-reducing the state
+     * vector while those still hold. The map holds one entry per distinct queried key and is cleared whenever the
+     * whole state is replaced, (or the engine width changes).
+     */
+    std::map<std::pair<bitCapInt, bitCapInt>, ProbCacheEntry> probCache;
+    /// Per-qubit dirty counters for probCache, bumped by any gate that can change probabilities involving the qubit.
+    /// (Qubits past the end of the vector are guaranteed not to appear in any cached entry.)
+    std::vector<uint64_t> probCacheVersions;
+
+    /// Mark one qubit's probabilities dirty.
+    void DirtyProbQubit(const bitLenInt& qubit);
+    /// Mark the probabilities of every qubit set in "mask" dirty.
+    void DirtyProbMask(const bitCapInt& mask);
+    /// Mark the probabilities of every qubit power in an Apply2x2-style sorted powers array dirty.
+    void DirtyProbPowers(const bitCapInt* qPowersSorted, const bitLenInt& count);
+    /// Drop all cached probability reductions, for operations that replace the state wholesale.
+    void DirtyProbAll();
+    /// Return true and load "prob" if a still-valid cached reduction exists for the key; stale entries are erased.
+    bool ProbCacheLookup(const bitCapInt& mask, const bitCapInt& permutation, real1& prob);
+    /// Record a freshly computed reduction under the current qubit versions and running norm.
+    void ProbCacheStore(const bitCapInt& mask, const bitCapInt& permutation, const real1& prob);
+
+    virtual void SetQubitCount(bitLenInt qb)
+    {
+        // A width change reindexes the per-qubit versions, so all cached reductions are dropped.
+        DirtyProbAll();
+        probCacheVersions.clear();
+        QInterface::SetQubitCount(qb);
+    }
 
     complex GetNonunitaryPhase()
     {
@@ -47,6 +88,7 @@ public:
         : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
         , useHostRam(useHostMem)
         , runningNorm(ONE_R1)
+        , truncationError(ZERO_R1)
     {
         if (qBitCount > (sizeof(bitCapInt) * bitsInByte)) {
             throw std::invalid_argument(
@@ -61,6 +103,17 @@ public:
 
     virtual ~QEngine() { Finish(); }
 
+    /**
+     * Get the total probability discarded by amplitude-threshold truncation, since the state was last wholly
+     * replaced.
+     *
+     * Every NormalizeState() sweep with a nonzero threshold, (see QInterface::SetAmplitudeFloor(),) zeroes the
+     * amplitudes below it; their summed relative probability accumulates here, bounding how far reported results
+     * can have drifted from exact simulation. (The OpenCL engine zeroes inside its normalization kernel and does
+     * not yet account its discards.)
+     */
+    virtual real1 GetTruncationError() { return truncationError; }
+
     virtual bool ForceM(bitLenInt qubitIndex, bool result, bool doForce = true, bool doApply = true);
     virtual bitCapInt ForceM(const bitLenInt* bits, const bitLenInt& length, const bool* values, bool doApply = true);
     virtual bitCapInt ForceMReg(
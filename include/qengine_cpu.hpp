@@ -14,6 +14,7 @@
 
 #include <memory>
 
+#include "common/dispatchqueue.hpp"
 #include "common/parallel_for.hpp"
 #include "qengine.hpp"
 #include "statevector.hpp"
@@ -34,10 +35,22 @@ void rotate(BidirectionalIterator first, BidirectionalIterator middle, Bidirecti
 class QEngineCPU : virtual public QEngine, public ParallelFor {
 protected:
     StateVectorPtr stateVec;
+    StateVectorPtr pooledStateVec;
     bool isSparse;
+    DispatchQueue dispatchQueue;
 
+    /** A freshly constructed or reset engine stays in the permutation basis, as one stored index and phase, and the
+     * buffer is only filled on first need, (see MaterializeLazyPerm(),) making SetPermutation() O(1). */
+    bool isLazyPerm;
+    bitCapInt lazyPerm;
+    complex lazyPhase;
+
+    StateVectorArrayPtr CastStateVecArray() { return std::dynamic_pointer_cast<StateVectorArray>(stateVec); }
     StateVectorSparsePtr CastStateVecSparse() { return std::dynamic_pointer_cast<StateVectorSparse>(stateVec); }
 
+    /** Queue a deferred operation on the dispatch thread. (All synchronous methods "Finish()," first.) */
+    void Dispatch(DispatchFn fn) { dispatchQueue.Dispatch(fn); }
+
 public:
     QEngineCPU(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp = nullptr,
         complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = false, bool randomGlobalPhase = true, bool ignored = false,
@@ -46,13 +59,31 @@ public:
 
     virtual ~QEngineCPU()
     {
-        // Intentionally left blank
+        // A deferred permutation state dies with the buffer, so there's nothing to materialize:
+        isLazyPerm = false;
+        Finish();
+    }
+
+    virtual void Finish()
+    {
+        dispatchQueue.Finish();
+        MaterializeLazyPerm();
     }
+    virtual bool isFinished() { return dispatchQueue.IsFinished(); }
 
-    virtual void FreeStateVec() { stateVec = NULL; }
+    virtual void FreeStateVec()
+    {
+        isLazyPerm = false;
+        Finish();
+        stateVec = NULL;
+    }
 
     virtual void SetQuantumState(const complex* inputState);
     virtual void GetQuantumState(complex* outputState);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void SaveState(const std::string& path);
+    virtual void LoadState(const std::string& path);
     virtual void GetProbs(real1* outputProbs);
     virtual complex GetAmplitude(bitCapInt perm);
     virtual void SetAmplitude(bitCapInt perm, complex amp);
@@ -71,6 +102,9 @@ public:
     virtual void Dispose(bitLenInt start, bitLenInt length);
     virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
 
+    using QEngine::X;
+    virtual void X(bitLenInt start, bitLenInt length);
+
     /** @} */
 
     /**
@@ -122,6 +156,8 @@ public:
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
     virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
     virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
     virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
         bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
@@ -138,6 +174,7 @@ public:
     virtual real1 Prob(bitLenInt qubitIndex);
     virtual real1 ProbAll(bitCapInt fullRegister);
     virtual real1 ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation);
+    virtual void ProbRegAll(const bitLenInt& start, const bitLenInt& length, real1* probsArray);
     virtual real1 ProbMask(const bitCapInt& mask, const bitCapInt& permutation);
     virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
     virtual bool ApproxCompare(QInterfacePtr toCompare)
@@ -152,10 +189,17 @@ public:
 protected:
     virtual StateVectorPtr AllocStateVec(bitCapInt elemCount);
     virtual void ResetStateVec(StateVectorPtr sv);
+    void MaterializeLazyPerm();
 
     void DecomposeDispose(bitLenInt start, bitLenInt length, QEngineCPUPtr dest);
     virtual void Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
         const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh = REAL1_DEFAULT_ARG);
+    /// The deferred body of Apply2x2, run in-order on the dispatch thread:
+    void Apply2x2Dispatched(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
+        const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh);
+    /// Single bit diagonal and anti-diagonal matrix special cases of Apply2x2, (returning "false" if inapplicable):
+    bool Apply2x2Special(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
+        const bitCapInt* qPowersSorted, bool doCalcNorm);
     virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
     virtual void ApplyM(bitCapInt mask, bitCapInt result, complex nrm);
 
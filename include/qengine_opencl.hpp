@@ -17,6 +17,7 @@
 #endif
 
 #include <list>
+#include <map>
 #include <mutex>
 
 #include "common/oclengine.hpp"
@@ -26,9 +27,15 @@
 #define CMPLX_NORM_LEN 6
 #define REAL_ARG_LEN 2
 
+// Caps on the fused single-qubit gate batch: gates per launch, and distinct target qubits per launch. The qubit cap
+// fixes the private amplitude block size of the "apply2x2batch" kernel, (which holds 2^GATE_BATCH_MAX_QUBITS
+// amplitudes per work item,) so the kernel source must agree with it.
+#define GATE_BATCH_MAX_GATES 16
+#define GATE_BATCH_MAX_QUBITS 4
+
 namespace Qrack {
 
-enum SPECIAL_2X2 { NONE = 0, PAULIX, PAULIZ };
+enum SPECIAL_2X2 { NONE = 0, PAULIX, PAULIZ, PHASE, INVERT };
 
 typedef std::shared_ptr<cl::Buffer> BufferPtr;
 
@@ -42,13 +49,16 @@ struct QueueItem {
     size_t localGroupSize;
     std::vector<BufferPtr> buffers;
     size_t localBuffSize;
+    /// When nonzero, this dispatch benchmarks the candidate work-group size, for first-use kernel tuning.
+    size_t tuningCandidate;
 
-    QueueItem(OCLAPI ac, size_t wic, size_t lgs, std::vector<BufferPtr> b, size_t lbs)
+    QueueItem(OCLAPI ac, size_t wic, size_t lgs, std::vector<BufferPtr> b, size_t lbs, size_t tc = 0)
         : api_call(ac)
         , workItemCount(wic)
         , localGroupSize(lgs)
         , buffers(b)
         , localBuffSize(lbs)
+        , tuningCandidate(tc)
     {
     }
 };
@@ -120,6 +130,47 @@ protected:
     unsigned int procElemCount;
     bool unlockHostMem;
     cl_int lockSyncFlags;
+    /**
+     * Pending batched single-qubit gates, (4 matrix components per gate, with each gate's target qubit power, and the
+     * distinct involved powers,) deferred so that a short program of gates costs one kernel enqueue instead of one
+     * per gate. Deep, narrow circuits are bound by per-enqueue driver overhead, not by kernel arithmetic. The batch
+     * is flushed by any other kernel dispatch, (via GetFreePoolItem(),) by any read of the state, (via
+     * ResetWaitEvents() or clFinish(),) or by exceeding the GATE_BATCH_MAX_GATES/GATE_BATCH_MAX_QUBITS caps.
+     */
+    std::vector<complex> gateBatchMtrxs;
+    std::vector<bitCapIntOcl> gateBatchTargets;
+    std::vector<bitCapIntOcl> gateBatchQPowers;
+    /// True while FlushGateBatch() replays a lone pending gate through the specialized single-gate kernel path.
+    bool isBatchReplay;
+    /**
+     * True while the partial-norm readback of the last norm-calculating kernel is still deferred. Rather than
+     * blocking on the reduction at dispatch, the host returns immediately and lets it run behind subsequently
+     * enqueued work; JoinRunningNorm() sums the partials into runningNorm only when the value is actually consumed,
+     * (by the next normalizing gate's scale factor, by NormalizeState(), or by a probability read). While deferred,
+     * runningNorm holds REAL1_DEFAULT_ARG, so every unit-norm fast path test stays conservatively disabled.
+     */
+    bool isNormPending;
+    /// Work group count of the deferred partial-norm reduction awaiting summation.
+    size_t nrmPendingGroups;
+    /**
+     * Device-side copy of the last classical lookup table passed to an Indexed*() method or Hash(), with a host
+     * shadow of its contents for validation. Lookup-dominated circuits, (like ordered search,) call the indexed
+     * operations many times with the same table, so re-uploading it per call wastes bus bandwidth; the cached buffer
+     * is reused whenever the requested table matches the shadow byte-for-byte, and rebuilt otherwise. (The kernels
+     * read the table through the "constant" address space, so the one upload also lands in constant cache.)
+     */
+    BufferPtr valuesBuffer;
+    std::unique_ptr<unsigned char[]> valuesShadow;
+    bitCapIntOcl valuesShadowPower;
+    /**
+     * Device-side copy of the last uniformly controlled matrix array, with a host shadow for delta detection.
+     * Variational ansatz loops re-apply the same uniformly controlled rotation with fresh angles every iteration,
+     * so the persistent buffer is updated in place, and only the contiguous span of 2x2 matrices that actually
+     * differs from the shadow is re-uploaded, rather than the whole 2^k array per call.
+     */
+    BufferPtr uniformMtrxBuffer;
+    std::unique_ptr<complex[]> uniformMtrxShadow;
+    bitCapIntOcl uniformMtrxCount;
 
 public:
     /// 1 / OclMemDenom is the maximum fraction of total OCL device RAM that a single state vector should occupy, by
@@ -134,7 +185,8 @@ public:
      *
      * "devID" is the index of an OpenCL device in the OCLEngine singleton, to select the device to run this engine on.
      * If "useHostMem" is set false, as by default, the QEngineOCL will attempt to allocate the state vector object
-     * only on device memory. If "useHostMem" is set true, general host RAM will be used for the state vector buffers.
+     * only on device memory. If "useHostMem" is set true, host RAM will be used for the state vector buffers, (pinned by the OpenCL driver,
+     * when possible, so transfers run at DMA speed).
      * If the state vector is too large to allocate only on device memory, the QEngineOCL will attempt to fall back to
      * allocating it in general host RAM.
      *
@@ -171,11 +223,14 @@ public:
         }
 
         if (sv) {
+            // Pinned allocations are tracked (and unmapped) by the OCLEngine singleton:
+            if (!OCLEngine::Instance()->FreePinned(sv)) {
 #if defined(_WIN32)
-            _aligned_free(sv);
+                _aligned_free(sv);
 #else
-            free(sv);
+                free(sv);
 #endif
+            }
         }
 
         if (doReset) {
@@ -195,6 +250,7 @@ public:
     /* Operations that have an improved implementation. */
     using QEngine::X;
     virtual void X(bitLenInt target);
+    virtual void X(bitLenInt start, bitLenInt length);
     using QEngine::Z;
     virtual void Z(bitLenInt target);
 
@@ -241,6 +297,8 @@ public:
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
     virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
     virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
 
     virtual real1 Prob(bitLenInt qubit);
@@ -260,6 +318,11 @@ public:
     virtual void SetQuantumState(const complex* inputState);
     virtual void GetQuantumState(complex* outputState);
     virtual void GetProbs(real1* outputProbs);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual bitCapIntOcl CountNonzero(real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void GetSparseQuantumState(
+        std::map<bitCapInt, complex>& outputMap, real1 norm_thresh = REAL1_DEFAULT_ARG);
     virtual complex GetAmplitude(bitCapInt perm);
     virtual void SetAmplitude(bitCapInt perm, complex amp);
 
@@ -272,7 +335,7 @@ public:
     virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
     virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
     virtual void Finish() { clFinish(); };
-    virtual bool isFinished() { return (wait_queue_items.size() == 0); };
+    virtual bool isFinished() { return (wait_queue_items.size() == 0) && (gateBatchTargets.size() == 0); };
 
     virtual QInterfacePtr Clone();
 
@@ -286,6 +349,7 @@ protected:
     virtual BufferPtr MakeStateVecBuffer(complex* nStateVec);
 
     virtual void Compose(OCLAPI apiCall, bitCapIntOcl* bciArgs, QEngineOCLPtr toCopy);
+    virtual void ComposePipelined(bitCapIntOcl* bciArgs, QEngineOCLPtr toCopy);
 
     virtual void INCDECC(
         bitCapInt toMod, const bitLenInt& inOutStart, const bitLenInt& length, const bitLenInt& carryIndex);
@@ -301,6 +365,10 @@ protected:
 
     real1 ParSum(real1* toSum, bitCapIntOcl maxI);
 
+    /// Sum the deferred partial-norm reduction of the last norm-calculating kernel into runningNorm, if one is
+    /// outstanding.
+    void JoinRunningNorm();
+
     /**
      * Finishes the asynchronous wait event list or queue of OpenCL events.
      *
@@ -346,6 +414,10 @@ protected:
         bitCapIntOcl valuesLength = 0);
     void CArithmeticCall(OCLAPI api_call, bitCapIntOcl (&bciArgs)[BCI_ARG_LEN], bitCapIntOcl* controlPowers,
         const bitLenInt controlLen, unsigned char* values = NULL, bitCapIntOcl valuesLength = 0);
+    /// Return a device buffer holding the "values" lookup table, reusing the cached upload when the contents match.
+    BufferPtr GetValuesBuffer(unsigned char* values, bitCapIntOcl valuesPower);
+    /// Return the persistent uniformly controlled matrix buffer, uploading only the 2x2 matrices that changed.
+    BufferPtr GetUniformMtrxBuffer(EventVecPtr waitVec, const complex* mtrxs, bitCapIntOcl mtrxCount);
 
     using QEngine::Apply2x2;
     virtual void Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
@@ -359,6 +431,14 @@ protected:
     virtual void ApplyM(bitCapInt mask, bool result, complex nrm);
     virtual void ApplyM(bitCapInt mask, bitCapInt result, complex nrm);
 
+    /// Append a single-qubit gate to the pending fused-dispatch batch, flushing first if the caps would be exceeded.
+    void BatchGate(const complex* mtrx, const bitCapIntOcl& qPower);
+    /**
+     * Dispatch all pending batched single-qubit gates as one "apply2x2batch" kernel launch. (A lone pending gate is
+     * instead replayed through Apply2x2(), to keep the specialized single-gate kernel treatment.)
+     */
+    void FlushGateBatch();
+
     /* Utility functions used by the operations above. */
     void QueueCall(OCLAPI api_call, size_t workItemCount, size_t localGroupSize, std::vector<BufferPtr> args,
         size_t localBuffSize = 0);
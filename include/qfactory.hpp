@@ -12,7 +12,12 @@
 
 #pragma once
 
+#include "qcalibration.hpp"
 #include "qengine_cpu.hpp"
+#include "qfusion.hpp"
+#include "qjournal.hpp"
+#include "qpager.hpp"
+#include "qstabilizerhybrid.hpp"
 
 #if ENABLE_OPENCL
 #include "qengine_opencl.hpp"
@@ -21,12 +26,28 @@
 #include "qunit.hpp"
 #endif
 
+#if ENABLE_MPI
+#include "qmpi.hpp"
+#endif
+
 namespace Qrack {
 
+/** The first non-enum factory argument is always the register width, which is what QINTERFACE_AUTO resolves on. */
+template <typename T, typename... Ts> inline bitLenInt FactoryWidthArg(T qBitCount, Ts... args)
+{
+    return (bitLenInt)qBitCount;
+}
+
 /** Factory method to create specific engine implementations. */
 template <typename... Ts>
 QInterfacePtr CreateQuantumInterface(QInterfaceEngine engine, QInterfaceEngine subengine, Ts... args)
 {
+    // A QINTERFACE_AUTO top-level engine resolves here, from the calibration profile; a QINTERFACE_AUTO subengine is
+    // deliberately passed through, so that wrappers like QUnit re-decide per shard width at every instantiation.
+    if (engine == QINTERFACE_AUTO) {
+        engine = EngineCalibration::Instance().SelectEngine(FactoryWidthArg(args...));
+    }
+
     switch (engine) {
     case QINTERFACE_CPU:
         return std::make_shared<QEngineCPU>(args...);
@@ -34,6 +55,18 @@ QInterfacePtr CreateQuantumInterface(QInterfaceEngine engine, QInterfaceEngine s
     case QINTERFACE_OPENCL:
         return std::make_shared<QEngineOCL>(args...);
 #endif
+    case QINTERFACE_QFUSION:
+        return std::make_shared<QFusion>(subengine, args...);
+    case QINTERFACE_QPAGER:
+        return std::make_shared<QPager>(subengine, args...);
+    case QINTERFACE_JOURNAL:
+        return std::make_shared<QJournal>(subengine, args...);
+#if ENABLE_MPI
+    case QINTERFACE_QMPI:
+        return std::make_shared<QMPI>(subengine, args...);
+#endif
+    case QINTERFACE_STABILIZER_HYBRID:
+        return std::make_shared<QStabilizerHybrid>(subengine, args...);
     case QINTERFACE_QUNIT:
         return std::make_shared<QUnit>(subengine, args...);
 #if ENABLE_OPENCL
@@ -47,6 +80,10 @@ QInterfacePtr CreateQuantumInterface(QInterfaceEngine engine, QInterfaceEngine s
 
 template <typename... Ts> QInterfacePtr CreateQuantumInterface(QInterfaceEngine engine, Ts... args)
 {
+    if (engine == QINTERFACE_AUTO) {
+        engine = EngineCalibration::Instance().SelectEngine(FactoryWidthArg(args...));
+    }
+
     switch (engine) {
     case QINTERFACE_CPU:
         return std::make_shared<QEngineCPU>(args...);
@@ -0,0 +1,229 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QFusion adds an optional "gate fusion" layer on top of a QEngine or QUnit.
+// Single bit gates are buffered in per-bit 2x2 complex matrices, to reduce the cost
+// of successive application of single bit gates to the same bit.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include "bitbuffer.hpp"
+#include "qinterface.hpp"
+
+namespace Qrack {
+
+class QFusion;
+typedef std::shared_ptr<QFusion> QFusionPtr;
+
+/**
+ * A "Qrack::QFusion" is a "gate fusion" layer between a QEngine or QUnit instance and the qubit gate API. Successive
+ * single bit gates on the same qubit are composed into a single buffered 2x2 complex matrix per qubit, (and successive
+ * INC/DEC operations into a single signed offset per register,) which is only applied to the underlying engine when an
+ * operation that cannot be buffered forces a flush, such as an entangling gate, measurement, or direct state vector
+ * access.
+ */
+class QFusion : public QInterface {
+protected:
+    /** Buffering is only worth the overhead above this total qubit count. */
+    static const bitLenInt MIN_FUSION_BITS = 3U;
+
+    QInterfacePtr qReg;
+
+    /** Per-bit pending operation. (An ArithmeticBuffer is shared by every bit of its register.) */
+    std::vector<BitBufferPtr> bitBuffers;
+    /** Per-bit list of target bits whose pending buffers are controlled by this bit. */
+    std::vector<std::vector<bitLenInt>> bitControls;
+
+public:
+    QFusion(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
+        complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = true, bool randomGlobalPhase = true,
+        bool useHostMem = false, int deviceID = -1, bool useHardwareRNG = true, bool useSparseStateVec = false,
+        real1 norm_thresh = REAL1_DEFAULT_ARG);
+    /** Wrap an existing QEngine or QUnit instance in a (fresh) gate fusion layer. */
+    QFusion(QInterfacePtr target);
+
+    virtual void SetQuantumState(const complex* inputState);
+    virtual void GetQuantumState(complex* outputState);
+    virtual void GetProbs(real1* outputProbs);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS)
+    {
+        FlushAll();
+        qReg->GetQuantumStateChunked(callback, chunkElems);
+    }
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS)
+    {
+        FlushAll();
+        qReg->GetProbsChunked(callback, chunkElems);
+    }
+    virtual complex GetAmplitude(bitCapInt perm);
+    virtual void SetAmplitude(bitCapInt perm, complex amp);
+    virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
+
+    virtual void SetRandomSeed(uint32_t seed)
+    {
+        QInterface::SetRandomSeed(seed);
+        qReg->SetRandomSeed(seed);
+    }
+
+    virtual bitLenInt Compose(QFusionPtr toCopy);
+    virtual bitLenInt Compose(QInterfacePtr toCopy) { return Compose(std::dynamic_pointer_cast<QFusion>(toCopy)); }
+    virtual bitLenInt Compose(QFusionPtr toCopy, bitLenInt start);
+    virtual bitLenInt Compose(QInterfacePtr toCopy, bitLenInt start)
+    {
+        return Compose(std::dynamic_pointer_cast<QFusion>(toCopy), start);
+    }
+    virtual void Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest);
+    virtual void Dispose(bitLenInt start, bitLenInt length);
+    virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
+
+    virtual void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex);
+    virtual void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+        bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+        const bitCapInt& mtrxSkipValueMask);
+    virtual void CSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+
+    virtual bool ForceM(bitLenInt qubit, bool result, bool doForce = true, bool doApply = true);
+    virtual bitCapInt ForceM(const bitLenInt* bits, const bitLenInt& length, const bool* values, bool doApply = true);
+    virtual bitCapInt ForceMReg(
+        bitLenInt start, bitLenInt length, bitCapInt result, bool doForce = true, bool doApply = true);
+
+    virtual void ROL(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void ROR(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void INC(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void CINC(
+        bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen);
+    virtual void DEC(bitCapInt toSub, bitLenInt start, bitLenInt length);
+    virtual void CDEC(
+        bitCapInt toSub, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen);
+    virtual void INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex);
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex,
+        bitLenInt carryIndex);
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex,
+        bitLenInt carryIndex);
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+
+    virtual void ZeroPhaseFlip(bitLenInt start, bitLenInt length);
+    virtual void CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex);
+    virtual void PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length);
+    virtual void PhaseFlip();
+    virtual bitCapInt IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, unsigned char* values, bool resetValue = true);
+    virtual bitCapInt IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
+    virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
+
+    virtual void Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+
+    virtual real1 Prob(bitLenInt qubitIndex);
+    virtual real1 ProbAll(bitCapInt fullRegister);
+    virtual real1 ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation);
+    virtual real1 ProbMask(const bitCapInt& mask, const bitCapInt& permutation);
+
+    virtual bool ApproxCompare(QFusionPtr toCompare);
+    virtual bool ApproxCompare(QInterfacePtr toCompare)
+    {
+        return ApproxCompare(std::dynamic_pointer_cast<QFusion>(toCompare));
+    }
+    virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void Finish()
+    {
+        FlushAll();
+        qReg->Finish();
+    }
+    virtual bool isFinished() { return qReg->isFinished(); }
+    virtual bool TrySeparate(bitLenInt start, bitLenInt length = 1);
+#if ENABLE_QSTATS
+    virtual QInterfaceStats GetStats()
+    {
+        QInterfaceStats stats = qReg->GetStats();
+        stats.fusionHits += (size_t)fusionHitCount;
+        return stats;
+    }
+    virtual void ResetStats()
+    {
+        QInterface::ResetStats();
+        qReg->ResetStats();
+    }
+#endif
+    virtual QInterfacePtr Clone();
+
+protected:
+    virtual void SetQubitCount(bitLenInt qb)
+    {
+        QInterface::SetQubitCount(qb);
+        bitBuffers.resize(qb);
+        bitControls.resize(qb);
+    }
+
+    /** Compose (or directly apply) a single bit gate into the target bit's buffer. */
+    void BufferGate(const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen,
+        const bitLenInt& qubitIndex, const complex* mtrx);
+    /** Compose (or directly apply) an INC/DEC offset into the register's buffer. */
+    void BufferArithmetic(
+        bitLenInt* controls, bitLenInt controlLen, int toAdd, bitLenInt inOutStart, bitLenInt length);
+
+    /** Apply the pending buffer on a bit, (after any pending buffers controlled by the bit). */
+    void FlushBit(const bitLenInt& qubitIndex);
+    void FlushReg(const bitLenInt& start, const bitLenInt& length);
+    void FlushList(const bitLenInt* bitList, const bitLenInt& bitListLen);
+    void FlushMask(const bitCapInt& mask);
+    void FlushAll();
+
+    /** Throw away the pending buffer on a bit, without applying it. */
+    void DiscardBit(const bitLenInt& qubitIndex);
+    void DiscardAll();
+
+    /** Remove a pending buffer's back references from "bitControls," without applying or nulling it. */
+    void EraseControlRefs(const BitBufferPtr& bfr, const bitLenInt& qubitIndex);
+};
+} // namespace Qrack
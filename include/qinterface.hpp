@@ -14,15 +14,20 @@
 #define _USE_MATH_DEFINES
 
 #include <ctime>
+#include <functional>
 #include <map>
 #include <math.h>
 #include <memory>
+#include <string>
 #include <vector>
 
-#if ENABLE_UINT128
-#include <ostream>
+#if ENABLE_QSTATS
+#include <atomic>
 #endif
 
+#include <future>
+#include <ostream>
+
 #include "common/parallel_for.hpp"
 #include "common/qrack_types.hpp"
 #include "common/rdrandwrapper.hpp"
@@ -81,6 +86,24 @@ enum QInterfaceEngine {
      */
     QINTERFACE_OPENCL,
 
+    /**
+     * Create a QFusion, which is a gate fusion layer between a QEngine and its caller, (or between a QUnit and its
+     * QEngine types).
+     */
+    QINTERFACE_QFUSION,
+
+    /**
+     * Create a QPager, which breaks up the state vector of a QEngine into pages, each of which fits a single device
+     * allocation, so that the total state vector can exceed the maximum single allocation of the device.
+     */
+    QINTERFACE_QPAGER,
+
+    /**
+     * Create a QStabilizerHybrid, which tracks Clifford-only circuits in an O(n^2) memory stabilizer tableau, and
+     * transparently converts to its underlying QEngine type on the first non-Clifford operation.
+     */
+    QINTERFACE_STABILIZER_HYBRID,
+
     /**
      * Create a QUnit, which utilizes other QInterface classes to minimize the amount of work that's needed for any
      * given operation based on the entanglement of the bits involved.
@@ -96,6 +119,26 @@ enum QInterfaceEngine {
      */
     QINTERFACE_QUNIT_MULTI,
 
+    /**
+     * Create a QMPI, which shards the state vector of a QEngine across the ranks of an MPI communicator, one
+     * contiguous slice per rank, so that the total state vector can exceed the memory of any single node. (Only
+     * available in ENABLE_MPI builds.)
+     */
+    QINTERFACE_QMPI,
+
+    /**
+     * Create a QJournal, which wraps any other QInterface engine and optionally records every dispatched operation
+     * to an append-only journal file, so that the state can be rebuilt with Replay() from a snapshot plus a gate
+     * tail after a crash or migration.
+     */
+    QINTERFACE_JOURNAL,
+
+    /**
+     * Defer the CPU/OpenCL choice (and the sparse/dense state vector flavor) to the per-host calibration profile in
+     * Qrack::EngineCalibration, resolved per instantiation by CreateQuantumInterface() based on register width.
+     */
+    QINTERFACE_AUTO,
+
     QINTERFACE_FIRST = QINTERFACE_CPU,
 #if ENABLE_OPENCL
     QINTERFACE_OPTIMAL = QINTERFACE_OPENCL,
@@ -106,6 +149,74 @@ enum QInterfaceEngine {
     QINTERFACE_MAX
 };
 
+#if ENABLE_QSTATS
+/**
+ * A snapshot of hot-path instrumentation counters, as returned by QInterface::GetStats(). Only compiled in when the
+ * ENABLE_QSTATS CMake option is on, since the atomic counter updates are not free on the hot paths they measure.
+ */
+struct QInterfaceStats {
+    /// Primitive 2x2 state vector sweeps executed, (including controlled variants)
+    size_t apply2x2Count;
+    /// Gates absorbed into a pending QFusion buffer, instead of sweeping the state vector
+    size_t fusionHits;
+    /// QUnit qubit separability checks attempted, (via explicit TrySeparate() or internal probability checks)
+    size_t separationTries;
+    /// Single qubits successfully split out of a larger QUnit "shard," (including by measurement collapse)
+    size_t separationHits;
+    /// Widest currently-entangled subsystem, in qubits, (total width, for monolithic engines)
+    bitLenInt maxShardWidth;
+
+    QInterfaceStats()
+        : apply2x2Count(0)
+        , fusionHits(0)
+        , separationTries(0)
+        , separationHits(0)
+        , maxShardWidth(0)
+    {
+    }
+};
+#endif
+
+/// Default chunk element count of the streaming GetQuantumStateChunked()/GetProbsChunked() variants, (4 MiB of double
+/// precision amplitudes)
+#define QRACK_STREAM_CHUNK_ELEMS 0x40000U
+
+/// Callback receiving a chunk of amplitudes starting at basis state "offset." The chunk pointer is only valid for the
+/// duration of the call.
+typedef std::function<void(const complex* chunk, const bitCapInt& offset, const bitCapInt& length)> StateChunkCallback;
+/// Callback receiving a chunk of basis state probabilities starting at basis state "offset"
+typedef std::function<void(const real1* chunk, const bitCapInt& offset, const bitCapInt& length)> ProbChunkCallback;
+
+/// First batch fill size of the double-buffered Rand() pages. (The fill size doubles per refill, up to
+/// QRACK_RAND_PAGE_MAX, so engines that rarely call Rand() pay almost nothing, while sampling-heavy loops reach full
+/// batches.)
+#define QRACK_RAND_PAGE_MIN 0x20U
+/// Maximum batch fill size (and allocation size) of the double-buffered Rand() pages
+#define QRACK_RAND_PAGE_MAX 0x1000U
+
+/// Offset of the amplitude data in a state vector snapshot file. The header is padded to this (page) boundary, so the
+/// amplitude data can be memory-mapped directly.
+#define QRACK_SNAPSHOT_DATA_OFFSET 4096U
+/// Format version of the state vector snapshot file layout
+#define QRACK_SNAPSHOT_VERSION 1U
+
+/**
+ * On-disk header of a state vector snapshot file, as written by QInterface::SaveState(). The raw amplitude buffer
+ * follows, at byte offset QRACK_SNAPSHOT_DATA_OFFSET.
+ */
+struct StateSnapshotHeader {
+    /// "QRKS"
+    char magic[4];
+    /// QRACK_SNAPSHOT_VERSION
+    uint32_t version;
+    /// Width of the saved register, in qubits
+    uint32_t qubitCount;
+    /// sizeof(complex) of the writer, (which differs between single and double amplitude precision builds)
+    uint32_t ampBytes;
+    /// 0x0102030405060708, to detect a byte order mismatch between writer and reader
+    uint64_t endianTag;
+};
+
 /**
  * A "Qrack::QInterface" is an abstract interface exposing qubit permutation
  * state vector with methods to operate on it as by gates and register-like
@@ -121,16 +232,37 @@ protected:
     qrack_rand_gen_ptr rand_generator;
     std::uniform_real_distribution<real1> rand_distribution;
     std::shared_ptr<RdRandom> hardware_rand_generator;
+    std::unique_ptr<real1[]> randPage1;
+    std::unique_ptr<real1[]> randPage2;
+    std::future<void> randFillFuture;
+    size_t randOffset = 0;
+    size_t randPageEntries1 = 0;
+    size_t randPageEntries2 = 0;
+    size_t randPageFillSize = QRACK_RAND_PAGE_MIN;
+    bool isRandPageTwo = false;
+    bool didRandBufferInit = false;
     bool doNormalize;
     bool randGlobalPhase;
     real1 amplitudeFloor;
 
+#if ENABLE_QSTATS
+    std::atomic<size_t> apply2x2Count;
+    std::atomic<size_t> fusionHitCount;
+    std::atomic<size_t> separationTryCount;
+    std::atomic<size_t> separationHitCount;
+#endif
+
     virtual void SetQubitCount(bitLenInt qb)
     {
         qubitCount = qb;
         maxQPower = pow2(qubitCount);
     }
 
+    /// Check a snapshot file header against this build and register width, throwing std::invalid_argument on mismatch
+    static void ValidateSnapshotHeader(const StateSnapshotHeader& header, const bitLenInt& qubitCount);
+    /// Write a snapshot file header for this build and register width, zero-padded to QRACK_SNAPSHOT_DATA_OFFSET
+    static void WriteSnapshotHeader(std::ostream& os, const bitLenInt& qubitCount);
+
     static inline bitLenInt log2(bitCapInt n)
     {
         bitLenInt pow = 0;
@@ -173,6 +305,14 @@ protected:
 
     bool IsIdentity(const complex* mtrx, const bool isControlled = false);
 
+    /// Batch fill one Rand() page, by RDRAND burst. (Only the hardware RNG path is page-buffered; see Rand().)
+    void FillRandPage(real1* page, size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            page[i] = hardware_rand_generator->Next();
+        }
+    }
+
 public:
     QInterface(bitLenInt n, qrack_rand_gen_ptr rgp = nullptr, bool doNorm = false, bool useHardwareRNG = true,
         bool randomGlobalPhase = true, real1 norm_thresh = REAL1_DEFAULT_ARG)
@@ -181,6 +321,12 @@ public:
         , doNormalize(doNorm)
         , randGlobalPhase(randomGlobalPhase)
         , amplitudeFloor(norm_thresh)
+#if ENABLE_QSTATS
+        , apply2x2Count(0)
+        , fusionHitCount(0)
+        , separationTryCount(0)
+        , separationHitCount(0)
+#endif
     {
         SetQubitCount(n);
 
@@ -207,12 +353,24 @@ public:
     }
 
     QInterface()
+#if ENABLE_QSTATS
+        : apply2x2Count(0)
+        , fusionHitCount(0)
+        , separationTryCount(0)
+        , separationHitCount(0)
+#endif
     {
         // Intentionally left blank
     }
 
     /** Destructor of QInterface */
-    virtual ~QInterface(){};
+    virtual ~QInterface()
+    {
+        // A background Rand() page fill might still be writing into the pages:
+        if (randFillFuture.valid()) {
+            randFillFuture.get();
+        }
+    };
 
     virtual void SetRandomSeed(uint32_t seed)
     {
@@ -227,14 +385,71 @@ public:
     /** Get the maximum number of basis states, namely \f$ n^2 \f$ for \f$ n \f$ qubits*/
     bitCapInt GetMaxQPower() { return maxQPower; }
 
-    /** Generate a random real number between 0 and 1 */
+    /** Set the minimum squared-amplitude norm kept by normalization sweeps; amplitudes below it are zeroed.
+     *
+     * (With the sparse state vector representation, a zeroed amplitude's entry is also erased, so truncation
+     * compacts storage as density falls. See QEngine::GetTruncationError() for the accumulated discarded
+     * probability.)
+     */
+    virtual void SetAmplitudeFloor(real1 norm_thresh) { amplitudeFloor = norm_thresh; }
+
+    /** Get the minimum squared-amplitude norm kept by normalization sweeps */
+    virtual real1 GetAmplitudeFloor() { return amplitudeFloor; }
+
+    /** Generate a random real number between 0 and 1
+     *
+     * With the hardware RNG, values come from double-buffered, batch-filled pages, so hot measurement loops just pop
+     * a buffered value, while the spent page refills on a background thread, by RDRAND burst. Fills start at
+     * QRACK_RAND_PAGE_MIN values and double per refill up to QRACK_RAND_PAGE_MAX, so engines that rarely call
+     * Rand() pay almost nothing for the buffering. The PRNG path is never buffered: "rand_generator" is commonly
+     * shared across all subunit engines of a layered stack, so a background draw-ahead would race other engines'
+     * draws on the (non-thread-safe) generator, and would make seeded runs scheduling-dependent.
+     */
     real1 Rand()
     {
-        if (hardware_rand_generator != NULL) {
-            return hardware_rand_generator->Next();
-        } else {
+        if (hardware_rand_generator == NULL) {
             return rand_distribution(*rand_generator);
         }
+
+        if (!didRandBufferInit) {
+            randPage1 = std::unique_ptr<real1[]>(new real1[QRACK_RAND_PAGE_MAX]);
+            randPage2 = std::unique_ptr<real1[]>(new real1[QRACK_RAND_PAGE_MAX]);
+            randPageEntries1 = randPageFillSize;
+            FillRandPage(randPage1.get(), randPageEntries1);
+            if (randPageFillSize < QRACK_RAND_PAGE_MAX) {
+                randPageFillSize <<= 1U;
+            }
+            randPageEntries2 = randPageFillSize;
+            randFillFuture = std::async(std::launch::async, [&]() { FillRandPage(randPage2.get(), randPageEntries2); });
+            isRandPageTwo = false;
+            randOffset = 0;
+            didRandBufferInit = true;
+        }
+
+        real1 toRet = (isRandPageTwo ? randPage2 : randPage1).get()[randOffset];
+        randOffset++;
+
+        if (randOffset >= (isRandPageTwo ? randPageEntries2 : randPageEntries1)) {
+            // The other page is (or will be) filled; the spent page refills in the background, while the other page
+            // is consumed.
+            randFillFuture.get();
+            if (randPageFillSize < QRACK_RAND_PAGE_MAX) {
+                randPageFillSize <<= 1U;
+            }
+            if (isRandPageTwo) {
+                randPageEntries2 = randPageFillSize;
+                randFillFuture =
+                    std::async(std::launch::async, [&]() { FillRandPage(randPage2.get(), randPageEntries2); });
+            } else {
+                randPageEntries1 = randPageFillSize;
+                randFillFuture =
+                    std::async(std::launch::async, [&]() { FillRandPage(randPage1.get(), randPageEntries1); });
+            }
+            isRandPageTwo = !isRandPageTwo;
+            randOffset = 0;
+        }
+
+        return toRet;
     }
 
     /** Set an arbitrary pure quantum state representation
@@ -255,6 +470,41 @@ public:
      */
     virtual void GetProbs(real1* outputProbs) = 0;
 
+    /** Stream the pure quantum state through "callback," in chunks of at most "chunkElems" amplitudes
+     *
+     * Engines that can produce the state incrementally never materialize a full 2^n host buffer, so amplitudes can be
+     * piped to compression or a socket with bounded scratch memory. (The generic implementation falls back to a full
+     * copy through GetQuantumState().)
+     *
+     * \warning PSEUDO-QUANTUM
+     */
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+
+    /** Stream all basis state probabilities through "callback," in chunks of at most "chunkElems" entries
+     *
+     * \warning PSEUDO-QUANTUM
+     */
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+
+    /** Save the pure quantum state as a binary snapshot file at "path"
+     *
+     * The snapshot is a StateSnapshotHeader, zero-padded to QRACK_SNAPSHOT_DATA_OFFSET bytes, followed by the raw
+     * amplitude buffer, so the amplitude data is page-aligned for memory mapping on load.
+     *
+     * \warning PSEUDO-QUANTUM
+     */
+    virtual void SaveState(const std::string& path);
+
+    /** Restore the pure quantum state from a snapshot file written by SaveState()
+     *
+     * The snapshot width, amplitude precision, and byte order must match this instance; throws std::invalid_argument,
+     * otherwise. (QEngineCPU maps the file's amplitude data copy-on-write as its live state vector buffer, rather
+     * than reading it through an intermediate copy.)
+     *
+     * \warning PSEUDO-QUANTUM
+     */
+    virtual void LoadState(const std::string& path);
+
     /** Get the representational amplitude of a full permutation
      *
      * \warning PSEUDO-QUANTUM
@@ -490,6 +740,16 @@ public:
      */
     virtual void TimeEvolve(Hamiltonian h, real1 timeDiff);
 
+    /**
+     * Compiled variant of TimeEvolve, for repeated Trotter steps of the same timestep size.
+     *
+     * One Trotter slice of the Hamiltonian is recorded into a QCircuit, so each op's matrix exponential is computed
+     * exactly once for "timeDiff," commuting terms on the same target and control set fuse into single (uniformly
+     * controlled) state vector sweeps, and the fused slice is replayed "trotterSteps" times through the engine's
+     * asynchronous gate dispatch. The result is the same as calling TimeEvolve(h, timeDiff) "trotterSteps" times.
+     */
+    virtual void TimeEvolve(Hamiltonian h, real1 timeDiff, bitCapInt trotterSteps);
+
     /**
      * Apply a swap with arbitrary control bits.
      */
@@ -1830,6 +2090,31 @@ public:
     virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values) = 0;
 
+    /**
+     * Flip the carry qubit for every superposed index register value whose
+     * classical table entry is less than "greaterPerm"
+     *
+     * "indexStart" is the start index of "indexLength" qubits that act as an
+     * index into the "values" array, with entries "valueLength" bits wide, in
+     * the same layout convention as IndexedLDA(). For each superposed
+     * permutation of the index register, the qubit at "carryIndex" is flipped
+     * if and only if values[index] < greaterPerm, entangling the carry with
+     * the index register. (This is the borrow of a MOS 6502 style CMP against
+     * "greaterPerm," without loading the table entry into a quantum register
+     * at all.)
+     *
+     * A comparison of a table load against a classical bound would otherwise
+     * take an IndexedLDA() or IndexedADC() into a scratch register plus a
+     * comparison such as CPhaseFlipIfLess(), each a full sweep of the state
+     * vector; since the table entry is classical per index permutation, the
+     * load, the comparison, and the carry write fuse into a single sweep, and
+     * the scratch register is never needed. The operation is its own inverse.
+     * See QInterface::IndexedLDA for general context on indexed loads from
+     * classical memory.
+     */
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values) = 0;
+
     /** Transform a length of qubit register via lookup through a hash table. The hash table must be a one-to-one
      * function, otherwise the behavior of this method is undefined. The value array definition convention is the same
      * as IndexedLDA(). Essentially, this is an IndexedLDA() operation that replaces the index register with the value
@@ -2011,6 +2296,20 @@ public:
      */
     virtual bool TrySeparate(bitLenInt start, bitLenInt length = 1) { return false; }
 
+#if ENABLE_QSTATS
+    /**
+     * Report a snapshot of hot-path instrumentation counters. Layered types, (like Qrack::QUnit and Qrack::QFusion,)
+     * override this to aggregate over their component engines. Only available when compiled with the ENABLE_QSTATS
+     * CMake option.
+     */
+    virtual QInterfaceStats GetStats();
+
+    /**
+     * Zero all instrumentation counters, (including those of any component engines).
+     */
+    virtual void ResetStats();
+#endif
+
     /**
      *  Clone this QInterface
      */
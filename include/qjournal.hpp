@@ -0,0 +1,331 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QJournal is an optional append-only operation journal layered over any QInterface
+// engine. Each dispatched gate is recorded compactly (opcode, qubits, parameters) as
+// it is forwarded, and Replay() rebuilds the state deterministically from a journal
+// file, so a crashed or migrated run recovers from a snapshot plus a gate tail
+// instead of requiring a full 2^n dump per gate.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <fstream>
+
+#include "qinterface.hpp"
+
+namespace Qrack {
+
+/// Format version of the operation journal file layout
+#define QRACK_JOURNAL_VERSION 1U
+
+/**
+ * On-disk header of an operation journal file, as written by QJournal::StartJournal(). The operation records follow
+ * immediately, each an opcode byte and its fixed parameter encoding.
+ */
+struct JournalFileHeader {
+    /// "QRKJ"
+    char magic[4];
+    /// QRACK_JOURNAL_VERSION
+    uint32_t version;
+    /// Width of the register when the journal was started, in qubits
+    uint32_t qubitCount;
+    /// sizeof(complex) of the writer, (which differs between single and double amplitude precision builds)
+    uint32_t ampBytes;
+    /// 0x0102030405060708, to detect a byte order mismatch between writer and reader
+    uint64_t endianTag;
+};
+
+/** Opcodes of the journal record stream. (Stable on-disk values; append only.) */
+enum JournalOpCode {
+    JOURNAL_OP_SINGLE_BIT = 0,
+    JOURNAL_OP_CTRLD_SINGLE_BIT,
+    JOURNAL_OP_ANTI_CTRLD_SINGLE_BIT,
+    JOURNAL_OP_UNIFORMLY_CTRLD_SINGLE_BIT,
+    JOURNAL_OP_SWAP,
+    JOURNAL_OP_ISWAP,
+    JOURNAL_OP_SQRTSWAP,
+    JOURNAL_OP_ISQRTSWAP,
+    JOURNAL_OP_FSIM,
+    JOURNAL_OP_CSWAP,
+    JOURNAL_OP_ANTI_CSWAP,
+    JOURNAL_OP_CSQRTSWAP,
+    JOURNAL_OP_ANTI_CSQRTSWAP,
+    JOURNAL_OP_CISQRTSWAP,
+    JOURNAL_OP_ANTI_CISQRTSWAP,
+    JOURNAL_OP_FORCE_M,
+    JOURNAL_OP_SET_PERMUTATION,
+    JOURNAL_OP_SET_AMPLITUDE,
+    JOURNAL_OP_STATE,
+    JOURNAL_OP_ROL,
+    JOURNAL_OP_ROR,
+    JOURNAL_OP_INC,
+    JOURNAL_OP_CINC,
+    JOURNAL_OP_INCC,
+    JOURNAL_OP_INCS,
+    JOURNAL_OP_INCSC,
+    JOURNAL_OP_INCSC_NO_OVERFLOW,
+    JOURNAL_OP_INCBCD,
+    JOURNAL_OP_INCBCDC,
+    JOURNAL_OP_DECC,
+    JOURNAL_OP_DECSC,
+    JOURNAL_OP_DECSC_NO_OVERFLOW,
+    JOURNAL_OP_DECBCDC,
+    JOURNAL_OP_MUL,
+    JOURNAL_OP_DIV,
+    JOURNAL_OP_MULMODNOUT,
+    JOURNAL_OP_IMULMODNOUT,
+    JOURNAL_OP_POWMODNOUT,
+    JOURNAL_OP_CMUL,
+    JOURNAL_OP_CDIV,
+    JOURNAL_OP_CMULMODNOUT,
+    JOURNAL_OP_CIMULMODNOUT,
+    JOURNAL_OP_CPOWMODNOUT,
+    JOURNAL_OP_ZEROPHASEFLIP,
+    JOURNAL_OP_CPHASEFLIPIFLESS,
+    JOURNAL_OP_PHASEFLIPIFLESS,
+    JOURNAL_OP_PHASEFLIP,
+    JOURNAL_OP_INDEXEDLDA,
+    JOURNAL_OP_INDEXEDADC,
+    JOURNAL_OP_INDEXEDSBC,
+    JOURNAL_OP_HASH,
+    JOURNAL_OP_DISPOSE,
+    JOURNAL_OP_DISPOSE_PERM,
+    JOURNAL_OP_NORMALIZE,
+    JOURNAL_OP_UPDATE_RUNNING_NORM,
+    JOURNAL_OP_INDEXEDCMP
+};
+
+class QJournal;
+typedef std::shared_ptr<QJournal> QJournalPtr;
+
+/**
+ * A "Qrack::QJournal" is an operation journal layer between a QInterface engine and the qubit gate API. While a
+ * journal file is open, every state-mutating operation is appended to it as a compact binary record (opcode, qubits,
+ * parameters) and flushed, as it is forwarded to the underlying engine; read-only operations forward without a
+ * record. The compound gate API funnels through the same primitives the journal records, so the journal is complete
+ * for any circuit, at primitive granularity.
+ *
+ * Replay() re-dispatches a journal file against the current state, so crash recovery is LoadState() of the last
+ * Checkpoint() snapshot plus Replay() of the journal tail. Measured outcomes are recorded in the journal and forced
+ * on replay, so replay never depends on RNG state. Operations that cannot be encoded parametrically, (Compose(),
+ * Decompose(), and SetQuantumState(),) journal an inline state record instead, at full 2^n cost - rare at the
+ * engine level, but worth knowing before journaling a register-resizing workload.
+ *
+ * Permutation-valued parameters are stored as 64 bits, which covers any register a state vector journal could
+ * realistically span.
+ */
+class QJournal : public QInterface {
+protected:
+    QInterfaceEngine engineType;
+    int deviceID;
+    bool useHostRam;
+    bool useRDRAND;
+    bool isSparse;
+
+    QInterfacePtr qReg;
+
+    std::string journalPath;
+    std::ofstream journalStream;
+
+public:
+    QJournal(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
+        complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = false, bool randomGlobalPhase = true,
+        bool useHostMem = false, int deviceId = -1, bool useHardwareRNG = true, bool useSparseStateVec = false,
+        real1 norm_thresh = REAL1_DEFAULT_ARG);
+
+    /** Begin journaling to "path," (truncating any previous journal there). Pair with a SaveState() of the current
+     * state, or start from a known permutation, so the journal has a recoverable base. */
+    virtual void StartJournal(const std::string& path);
+    /** Stop journaling and close the journal file. */
+    virtual void StopJournal();
+    virtual bool IsJournaling() { return journalStream.is_open(); }
+    /** Save a state snapshot to "snapshotPath" and truncate the open journal, so the journal tail stays short:
+     * recovery is LoadState() of the snapshot plus Replay() of the journal. */
+    virtual void Checkpoint(const std::string& snapshotPath);
+    /** Re-dispatch a journal file against the current state. Journaling must be stopped first. A torn trailing
+     * record, (from a crash mid-append,) is ignored. */
+    virtual void Replay(const std::string& path);
+
+    virtual void SetQuantumState(const complex* inputState);
+    virtual void GetQuantumState(complex* outputState) { qReg->GetQuantumState(outputState); }
+    virtual void GetProbs(real1* outputProbs) { qReg->GetProbs(outputProbs); }
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS)
+    {
+        qReg->GetQuantumStateChunked(callback, chunkElems);
+    }
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS)
+    {
+        qReg->GetProbsChunked(callback, chunkElems);
+    }
+    virtual complex GetAmplitude(bitCapInt perm) { return qReg->GetAmplitude(perm); }
+    virtual void SetAmplitude(bitCapInt perm, complex amp);
+    virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
+
+    virtual void SetRandomSeed(uint32_t seed)
+    {
+        QInterface::SetRandomSeed(seed);
+        qReg->SetRandomSeed(seed);
+    }
+
+    virtual bitLenInt Compose(QJournalPtr toCopy);
+    virtual bitLenInt Compose(QInterfacePtr toCopy) { return Compose(std::dynamic_pointer_cast<QJournal>(toCopy)); }
+    virtual bitLenInt Compose(QJournalPtr toCopy, bitLenInt start);
+    virtual bitLenInt Compose(QInterfacePtr toCopy, bitLenInt start)
+    {
+        return Compose(std::dynamic_pointer_cast<QJournal>(toCopy), start);
+    }
+    virtual void Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest);
+    virtual void Dispose(bitLenInt start, bitLenInt length);
+    virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
+
+    using QInterface::UniformlyControlledSingleBit;
+    using QInterface::ForceM;
+    using QInterface::ForceMReg;
+
+    virtual void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex);
+    virtual void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+        bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+        const bitCapInt& mtrxSkipValueMask);
+    virtual void CSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+
+    virtual bool ForceM(bitLenInt qubit, bool result, bool doForce = true, bool doApply = true);
+
+    virtual void ROL(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void ROR(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void INC(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void CINC(
+        bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen);
+    virtual void INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex);
+    virtual void INCSC(
+        bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECSC(
+        bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+
+    virtual void ZeroPhaseFlip(bitLenInt start, bitLenInt length);
+    virtual void CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex);
+    virtual void PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length);
+    virtual void PhaseFlip();
+    virtual bitCapInt IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, unsigned char* values, bool resetValue = true);
+    virtual bitCapInt IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
+    virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
+
+    virtual void Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+
+    virtual real1 Prob(bitLenInt qubitIndex) { return qReg->Prob(qubitIndex); }
+    virtual real1 ProbAll(bitCapInt fullRegister) { return qReg->ProbAll(fullRegister); }
+    virtual real1 ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation)
+    {
+        return qReg->ProbReg(start, length, permutation);
+    }
+    virtual real1 ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
+    {
+        return qReg->ProbMask(mask, permutation);
+    }
+
+    virtual bool ApproxCompare(QJournalPtr toCompare) { return qReg->ApproxCompare(toCompare->qReg); }
+    virtual bool ApproxCompare(QInterfacePtr toCompare)
+    {
+        return ApproxCompare(std::dynamic_pointer_cast<QJournal>(toCompare));
+    }
+    virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual bool TrySeparate(bitLenInt start, bitLenInt length = 1) { return qReg->TrySeparate(start, length); }
+    virtual void Finish() { qReg->Finish(); }
+    virtual bool isFinished() { return qReg->isFinished(); }
+#if ENABLE_QSTATS
+    virtual QInterfaceStats GetStats() { return qReg->GetStats(); }
+    virtual void ResetStats()
+    {
+        QInterface::ResetStats();
+        qReg->ResetStats();
+    }
+#endif
+    virtual QInterfacePtr Clone();
+
+protected:
+    QInterfacePtr MakeEngine(bitLenInt length, bitCapInt perm);
+
+    bool Journaling() { return journalStream.is_open(); }
+
+    /// Append the opcode byte of a new record
+    void WriteOp(const JournalOpCode& op);
+    /// Append a qubit index or count
+    void WriteBit(const bitLenInt& bit);
+    /// Append a permutation-valued parameter, as 64 bits
+    void WriteCap(const bitCapInt& cap);
+    void WriteReal(const real1& r);
+    void WriteCmplx(const complex& c);
+    /// Append a 2x2 matrix, (4 amplitudes)
+    void WriteMtrx(const complex* mtrx);
+    /// Append a control list: the count, then the indices
+    void WriteControls(const bitLenInt* controls, const bitLenInt& controlLen);
+    void WriteBytes(const unsigned char* data, size_t byteCount);
+    /// Flush the stream, so every completed record survives a crash
+    void EndRecord();
+
+    /// Append an inline state record of the engine's current width and amplitudes, for operations without a
+    /// parametric encoding
+    void LogState();
+
+    static bitLenInt ReadBit(std::ifstream& ifs);
+    static bitCapInt ReadCap(std::ifstream& ifs);
+    static real1 ReadReal(std::ifstream& ifs);
+    static complex ReadCmplx(std::ifstream& ifs);
+    static std::vector<bitLenInt> ReadControls(std::ifstream& ifs);
+
+    /// Dispatch one journal record against this instance; returns false on a (torn) incomplete record
+    bool ReplayOp(std::ifstream& ifs, const JournalOpCode& op);
+};
+} // namespace Qrack
@@ -0,0 +1,245 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QMPI distributes a state vector across the ranks of an MPI communicator, one
+// contiguous slice of amplitudes per rank, so that the total state vector can
+// exceed the memory of any single node.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include "config.h"
+
+#if !ENABLE_MPI
+#error MPI has not been enabled
+#endif
+
+#include <functional>
+
+#include <mpi.h>
+
+#include "qinterface.hpp"
+
+namespace Qrack {
+
+class QMPI;
+typedef std::shared_ptr<QMPI> QMPIPtr;
+
+/**
+ * A "Qrack::QMPI" shards a state vector across the 2^n ranks of MPI_COMM_WORLD, each rank holding one contiguous
+ * slice of amplitudes in a local QEngine instance, with the same split geometry as QPager: the rank index is the
+ * value of the top n ("split") qubits. The program runs SPMD - every rank constructs the same QMPI and applies the
+ * identical gate stream, and any QMPI method may be an MPI collective, so no rank may ever skip one.
+ *
+ * Single bit and controlled single bit gates on "low" (in-slice) qubits are applied to every slice independently,
+ * with no communication at all; gates on "split" (rank-selecting) qubits reduce to per-slice phase factors, whole
+ * slice exchanges, or chunked pairwise amplitude streams between partner ranks, mirroring QPager's page
+ * diagonal/anti-diagonal/general three-way split. Register-wide operations whose qubits are all in-slice are
+ * block-diagonal in the split qubits and also run communication-free on every slice. Operations without a
+ * distributed implementation fall back to gathering the whole state vector into a full-width local engine on every
+ * rank, (so they must still fit on one node,) operating, and re-scattering - the direct analog of QPager's
+ * CombineEngines() contract, and just as much of a last resort.
+ *
+ * Measurement and random global phase draws are decided on rank 0 and broadcast, so that hardware RNG streams
+ * (which differ per node) cannot let the ranks' amplitudes diverge.
+ */
+class QMPI : public QInterface {
+protected:
+    QInterfaceEngine engineType;
+    int deviceID;
+    bool useHostRam;
+    bool useRDRAND;
+    bool isSparse;
+
+    int rank;
+    int rankCount;
+    /** Count of the high "split" qubits whose value selects the rank, log2(rankCount). */
+    bitLenInt splitQubits;
+    bitLenInt qubitsPerSlice;
+
+    /** This rank's slice of the state vector. */
+    QInterfacePtr qSlice;
+
+public:
+    QMPI(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
+        complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = false, bool randomGlobalPhase = true,
+        bool useHostMem = false, int deviceId = -1, bool useHardwareRNG = true, bool useSparseStateVec = false,
+        real1 norm_thresh = REAL1_DEFAULT_ARG);
+
+    virtual void SetQuantumState(const complex* inputState);
+    virtual void GetQuantumState(complex* outputState);
+    virtual void GetProbs(real1* outputProbs);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual complex GetAmplitude(bitCapInt perm);
+    virtual void SetAmplitude(bitCapInt perm, complex amp);
+    virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
+
+    virtual void SetRandomSeed(uint32_t seed)
+    {
+        QInterface::SetRandomSeed(seed);
+        qSlice->SetRandomSeed(seed);
+    }
+
+    virtual bitLenInt Compose(QMPIPtr toCopy);
+    virtual bitLenInt Compose(QInterfacePtr toCopy) { return Compose(std::dynamic_pointer_cast<QMPI>(toCopy)); }
+    virtual bitLenInt Compose(QMPIPtr toCopy, bitLenInt start);
+    virtual bitLenInt Compose(QInterfacePtr toCopy, bitLenInt start)
+    {
+        return Compose(std::dynamic_pointer_cast<QMPI>(toCopy), start);
+    }
+    virtual void Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest);
+    virtual void Dispose(bitLenInt start, bitLenInt length);
+    virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
+
+    virtual void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex);
+    virtual void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+        bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+        const bitCapInt& mtrxSkipValueMask);
+    virtual void CSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+
+    virtual bool ForceM(bitLenInt qubit, bool result, bool doForce = true, bool doApply = true);
+
+    virtual void ROL(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void ROR(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void INC(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void CINC(
+        bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen);
+    virtual void INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex);
+    virtual void INCSC(
+        bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECSC(
+        bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+
+    virtual void ZeroPhaseFlip(bitLenInt start, bitLenInt length);
+    virtual void CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex);
+    virtual void PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length);
+    virtual void PhaseFlip();
+    virtual bitCapInt IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, unsigned char* values, bool resetValue = true);
+    virtual bitCapInt IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
+    virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
+
+    virtual void Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+
+    virtual real1 Prob(bitLenInt qubitIndex);
+    virtual real1 ProbAll(bitCapInt fullRegister);
+    virtual real1 ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation);
+    virtual real1 ProbMask(const bitCapInt& mask, const bitCapInt& permutation);
+
+    virtual bool ApproxCompare(QMPIPtr toCompare);
+    virtual bool ApproxCompare(QInterfacePtr toCompare)
+    {
+        return ApproxCompare(std::dynamic_pointer_cast<QMPI>(toCompare));
+    }
+    virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void Finish() { qSlice->Finish(); }
+    virtual bool isFinished() { return qSlice->isFinished(); }
+#if ENABLE_QSTATS
+    virtual QInterfaceStats GetStats()
+    {
+        QInterfaceStats stats = QInterface::GetStats();
+        stats.apply2x2Count += qSlice->GetStats().apply2x2Count;
+        return stats;
+    }
+    virtual void ResetStats()
+    {
+        QInterface::ResetStats();
+        qSlice->ResetStats();
+    }
+#endif
+    virtual QInterfacePtr Clone();
+
+protected:
+    virtual void SetQubitCount(bitLenInt qb)
+    {
+        if (qb <= splitQubits) {
+            throw std::invalid_argument("QMPI requires more qubits than log2 of the MPI rank count");
+        }
+        QInterface::SetQubitCount(qb);
+        qubitsPerSlice = qb - splitQubits;
+    }
+
+    /** The number of amplitudes in each rank's slice. */
+    bitCapIntOcl SliceLength() { return pow2Ocl(qubitsPerSlice); }
+
+    QInterfacePtr MakeSlice(bitLenInt length, bitCapInt perm);
+
+    /** Gather the whole distributed state vector into a full-width local engine, identically on every rank. */
+    QInterfacePtr GatherFull();
+    /** Re-scatter a full-width local engine across the ranks, at a (possibly changed) total qubit count. */
+    void ScatterFull(QInterfacePtr whole, bitLenInt nQubitCount);
+    /** Run "fn" against the slice when the operation's qubits are all in-slice, (so it is block-diagonal in the
+     * split qubits,) or else against a gathered full-width engine. */
+    void LocalOrGatherOp(bitLenInt highestQubit, std::function<void(QInterfacePtr)> fn);
+
+    /** Multiply every amplitude of this rank's slice by a scalar factor. */
+    void ScaleSlice(const complex& scale);
+    /** The total probability weight this rank's slice holds, (not normalized). */
+    real1 SliceNorm();
+    /** Sum a per-rank partial over all ranks, (in double precision, identically on every rank). */
+    real1 AllSum(real1 part);
+    /** Broadcast a host buffer from "root," in MPI-safe chunk sizes. */
+    void BcastChunked(void* buffer, size_t byteCount, int root);
+    /** Exchange this rank's whole slice with "partner," chunk by chunk. */
+    void ExchangeSlices(const int& partner);
+
+    /** Apply a single bit gate to a "split" (rank-selecting) qubit, streaming partner-rank amplitude chunks. */
+    void ApplySplitSingleBit(const bitLenInt* intraControls, const bitLenInt& intraControlLen, const bool& anti,
+        const int& metaMask, const int& metaPerm, const complex* mtrx, const bitLenInt& target);
+    void ApplyEitherControlledSingleBit(
+        const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target,
+        const complex* mtrx);
+};
+} // namespace Qrack
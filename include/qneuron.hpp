@@ -186,6 +186,51 @@ public:
         }
     }
 
+    /** Perform one learning iteration over a whole batch of classical training examples
+     *
+     * "inputs" are full-register permutation values, as would be passed to QInterface::SetPermutation() before a
+     * Learn() or LearnPermutation() call, and "expected" are the matching true binary output categories. "eta" is a
+     * volatility or "learning rate" parameter with a maximum value of 1.
+     *
+     * Examples are grouped by the permutation of this neuron's input bits, so each distinct input permutation is
+     * prepared in "qReg" only once, (instead of once per example,) and each group trains only its own variational
+     * parameter, (instead of sweeping all of them,) since the angle updates of distinct input permutations are
+     * independent of each other.
+     */
+    void LearnBatch(const std::vector<bitCapInt>& inputs, const std::vector<bool>& expected, real1 eta)
+    {
+        // Group example indices by the projection of the input onto this neuron's control bits:
+        std::map<bitCapInt, std::vector<size_t>> groups;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            bitCapInt perm = 0;
+            for (bitLenInt j = 0; j < inputCount; j++) {
+                if (inputs[i] & pow2(inputIndices[j])) {
+                    perm |= pow2(j);
+                }
+            }
+            groups[perm].push_back(i);
+        }
+
+        std::map<bitCapInt, std::vector<size_t>>::iterator gIt;
+        for (gIt = groups.begin(); gIt != groups.end(); gIt++) {
+            std::vector<size_t>& group = gIt->second;
+
+            // Prepare the shared input state once, for every example in the group. (Predict() resets the output
+            // bit per example, and the register bits outside this neuron's inputs have no effect on it.)
+            qReg->SetPermutation(inputs[group[0]]);
+
+            for (size_t i = 0; i < group.size(); i++) {
+                bool e = expected[group[i]];
+                real1 startProb = Predict(e, true);
+                Unpredict(e);
+                if ((ONE_R1 - startProb) <= tolerance) {
+                    continue;
+                }
+                LearnInternal(e, eta, gIt->first, startProb);
+            }
+        }
+    }
+
 protected:
     real1 LearnInternal(bool expected, real1 eta, bitCapInt perm, real1 startProb)
     {
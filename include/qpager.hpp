@@ -0,0 +1,258 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QPager breaks a state vector up into pages of contiguous amplitudes, each of which
+// fits a single QEngine allocation, so that the total state vector can exceed the
+// maximum single allocation of an (OpenCL) device.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <functional>
+
+#include "qinterface.hpp"
+
+namespace Qrack {
+
+class QPager;
+typedef std::shared_ptr<QPager> QPagerPtr;
+
+/**
+ * A "Qrack::QPager" splits a QEngine state vector into 2^n equal "pages," each of which is a separate QEngine
+ * instance small enough to fit in a single device memory allocation. Single bit and controlled single bit gates on
+ * "low" (in-page) qubits are applied to every page independently, (and therefore never need the whole state vector
+ * resident at once,) while gates on "high" (page-selecting) qubits are applied as page swaps, page phase factors, or
+ * streamed page-pair updates. Operations without a paged implementation temporarily combine the pages into a single
+ * engine, which therefore must still fit in one allocation; the paged fast paths cover the Apply2x2 hot path.
+ *
+ * The maximum page size is taken from the (OpenCL) device allocation limit, or else can be set explicitly in qubits
+ * with the "QRACK_MAX_PAGE_QB" environment variable.
+ *
+ * With more than one OpenCL device available, (or passed in "devList,") pages are sharded across the devices in
+ * contiguous page index blocks, so that a single fully entangled state vector runs on every device at once; only
+ * gates on page-selecting qubits split across devices exchange amplitudes between them, (through host memory).
+ */
+class QPager : public QInterface {
+protected:
+    /** Default page size for engine types without a device allocation limit, when "QRACK_MAX_PAGE_QB" is not set. */
+    static const bitLenInt DEFAULT_MAX_PAGE_QUBITS = 18U;
+
+    QInterfaceEngine engineType;
+    bitLenInt maxPageQubits;
+    bitLenInt qubitsPerPage;
+    int deviceID;
+    bool useHostRam;
+    bool useRDRAND;
+    bool isSparse;
+
+    std::vector<QInterfacePtr> qPages;
+    /** Devices over which pages are sharded, in contiguous page index blocks. */
+    std::vector<int> deviceIDs;
+
+public:
+    QPager(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
+        complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = false, bool randomGlobalPhase = true,
+        bool useHostMem = false, int deviceId = -1, bool useHardwareRNG = true, bool useSparseStateVec = false,
+        real1 norm_thresh = REAL1_DEFAULT_ARG, std::vector<bitLenInt> devList = {});
+
+    virtual void SetQuantumState(const complex* inputState);
+    virtual void GetQuantumState(complex* outputState);
+    virtual void GetProbs(real1* outputProbs);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual complex GetAmplitude(bitCapInt perm);
+    virtual void SetAmplitude(bitCapInt perm, complex amp);
+    virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
+
+    virtual void SetRandomSeed(uint32_t seed)
+    {
+        QInterface::SetRandomSeed(seed);
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->SetRandomSeed(seed);
+        }
+    }
+
+    virtual bitLenInt Compose(QPagerPtr toCopy);
+    virtual bitLenInt Compose(QInterfacePtr toCopy) { return Compose(std::dynamic_pointer_cast<QPager>(toCopy)); }
+    virtual bitLenInt Compose(QPagerPtr toCopy, bitLenInt start);
+    virtual bitLenInt Compose(QInterfacePtr toCopy, bitLenInt start)
+    {
+        return Compose(std::dynamic_pointer_cast<QPager>(toCopy), start);
+    }
+    virtual void Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest);
+    virtual void Dispose(bitLenInt start, bitLenInt length);
+    virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
+
+    virtual void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex);
+    virtual void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+        bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+        const bitCapInt& mtrxSkipValueMask);
+    virtual void CSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void CISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+    virtual void AntiCISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2);
+
+    virtual bool ForceM(bitLenInt qubit, bool result, bool doForce = true, bool doApply = true);
+    virtual bitCapInt ForceM(const bitLenInt* bits, const bitLenInt& length, const bool* values, bool doApply = true);
+    virtual bitCapInt ForceMReg(
+        bitLenInt start, bitLenInt length, bitCapInt result, bool doForce = true, bool doApply = true);
+
+    virtual void ROL(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void ROR(bitLenInt shift, bitLenInt start, bitLenInt length);
+    virtual void INC(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void CINC(
+        bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen);
+    virtual void INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex);
+    virtual void INCSC(
+        bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length);
+    virtual void INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECSC(
+        bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex);
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex);
+    virtual void MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length);
+    virtual void MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length);
+    virtual void CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+    virtual void CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen);
+
+    virtual void ZeroPhaseFlip(bitLenInt start, bitLenInt length);
+    virtual void CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex);
+    virtual void PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length);
+    virtual void PhaseFlip();
+    virtual bitCapInt IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, unsigned char* values, bool resetValue = true);
+    virtual bitCapInt IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
+    virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
+
+    virtual void Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+
+    virtual real1 Prob(bitLenInt qubitIndex);
+    virtual real1 ProbAll(bitCapInt fullRegister);
+    virtual real1 ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation);
+    virtual real1 ProbMask(const bitCapInt& mask, const bitCapInt& permutation);
+
+    virtual bool ApproxCompare(QPagerPtr toCompare);
+    virtual bool ApproxCompare(QInterfacePtr toCompare)
+    {
+        return ApproxCompare(std::dynamic_pointer_cast<QPager>(toCompare));
+    }
+    virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG);
+    virtual void Finish()
+    {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->Finish();
+        }
+    }
+    virtual bool isFinished()
+    {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            if (!qPages[i]->isFinished()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    virtual bool TrySeparate(bitLenInt start, bitLenInt length = 1);
+#if ENABLE_QSTATS
+    virtual QInterfaceStats GetStats()
+    {
+        QInterfaceStats stats = QInterface::GetStats();
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            stats.apply2x2Count += qPages[i]->GetStats().apply2x2Count;
+        }
+        return stats;
+    }
+    virtual void ResetStats()
+    {
+        QInterface::ResetStats();
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->ResetStats();
+        }
+    }
+#endif
+    virtual QInterfacePtr Clone();
+
+protected:
+    virtual void SetQubitCount(bitLenInt qb)
+    {
+        QInterface::SetQubitCount(qb);
+        qubitsPerPage = (qb < maxPageQubits) ? qb : maxPageQubits;
+        // With multiple devices, pages are shrunk (if necessary) until there is at least one per device, so that a
+        // fully entangled state vector still shards across every device.
+        while ((pow2Ocl(qubitCount - qubitsPerPage) < deviceIDs.size()) && (qubitsPerPage > 1U)) {
+            qubitsPerPage--;
+        }
+    }
+
+    /** The number of amplitudes in each (separated) page. */
+    bitCapIntOcl PageLength() { return (bitCapIntOcl)(maxQPower / qPages.size()); }
+
+    /** The device that hosts a given page, assigning contiguous page index blocks across "deviceIDs." */
+    int PageDevice(const bitCapIntOcl& pageIndex, const bitCapIntOcl& pageCount)
+    {
+        if (pageCount < deviceIDs.size()) {
+            return deviceIDs[pageIndex];
+        }
+        return deviceIDs[(size_t)((pageIndex * deviceIDs.size()) / pageCount)];
+    }
+
+    QInterfacePtr MakePage(bitLenInt length, bitCapInt perm, int devID);
+
+    /** Merge all pages into a single (allocation-limited) engine, for operations without a paged implementation. */
+    void CombineEngines();
+    /** Split a combined engine back into pages of "qubitsPerPage" qubits. */
+    void SeparateEngines();
+    /** Combine, run "fn" against the combined engine, and separate again. */
+    void CombineAndOp(std::function<void(QInterfacePtr)> fn);
+
+    /** Multiply every amplitude of a page by a scalar factor. */
+    void ScalePage(QInterfacePtr page, const complex& scale);
+    /** Apply a single bit gate to a "high" (page-selecting) qubit, streaming one page pair at a time. */
+    void ApplyHighSingleBit(const bitLenInt* intraControls, const bitLenInt& intraControlLen, const bool& anti,
+        const bitCapIntOcl& metaMask, const bitCapIntOcl& metaPerm, const complex* mtrx, const bitLenInt& target);
+    void ApplyEitherControlledSingleBit(
+        const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target,
+        const complex* mtrx);
+};
+} // namespace Qrack
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2020. All rights reserved.
+//
+// QStabilizer is a CHP-style Clifford circuit simulator, after the algorithm of
+// Aaronson and Gottesman, "Improved simulation of stabilizer circuits,"
+// https://arxiv.org/abs/quant-ph/0406196
+//
+// It tracks a stabilizer tableau in O(n^2) memory, rather than a 2^n amplitude state
+// vector, so Clifford-only circuits of hundreds of qubits are tractable. It is not a
+// Qrack::QInterface; Qrack::QStabilizerHybrid wraps it behind that API, with
+// automatic fallback to a state vector engine on the first non-Clifford operation.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include <vector>
+
+#include "common/qrack_types.hpp"
+
+namespace Qrack {
+
+class QStabilizer;
+typedef std::shared_ptr<QStabilizer> QStabilizerPtr;
+
+class QStabilizer {
+protected:
+    bitLenInt qubitCount;
+
+    // The tableau has (2n + 1) rows: 0 to (n - 1) are the destabilizer generators, n to (2n - 1) are the stabilizer
+    // generators, and row 2n is scratch space. "x[i][j]"/"z[i][j]" are the X/Z Pauli components of row i on qubit j,
+    // and "r[i]" is the phase exponent of the row, 0 or 2, for a sign of i^r.
+    std::vector<std::vector<bool>> x;
+    std::vector<std::vector<bool>> z;
+    std::vector<uint8_t> r;
+
+    qrack_rand_gen_ptr rand_generator;
+    std::uniform_real_distribution<real1> rand_distribution;
+
+public:
+    QStabilizer(bitLenInt n, bitCapInt perm = 0, qrack_rand_gen_ptr rgp = nullptr);
+
+    QStabilizerPtr Clone() { return std::make_shared<QStabilizer>(*this); }
+
+    bitLenInt GetQubitCount() { return qubitCount; }
+
+    real1 Rand() { return rand_distribution(*rand_generator); }
+
+    void SetPermutation(bitCapInt perm);
+
+    void CNOT(bitLenInt control, bitLenInt target);
+    void CZ(bitLenInt control, bitLenInt target);
+    void CY(bitLenInt control, bitLenInt target);
+    void H(bitLenInt qubit);
+    /// Phase gate, i.e. diag(1, i)
+    void S(bitLenInt qubit);
+    /// Inverse phase gate, i.e. diag(1, -i)
+    void IS(bitLenInt qubit);
+    void X(bitLenInt qubit);
+    void Y(bitLenInt qubit);
+    void Z(bitLenInt qubit);
+    void Swap(bitLenInt qubit1, bitLenInt qubit2);
+    void ISwap(bitLenInt qubit1, bitLenInt qubit2);
+
+    /// Returns "true" if the Z measurement of the qubit is deterministic, (so the qubit is in a Z basis eigenstate,
+    /// separable from the rest of the register).
+    bool IsSeparableZ(const bitLenInt& target);
+    bool IsSeparableX(const bitLenInt& target);
+    bool IsSeparableY(const bitLenInt& target);
+    /// Returns 0 if the qubit is entangled, or 1/2/3 if it is a separable Z/X/Y basis eigenstate.
+    uint8_t IsSeparable(const bitLenInt& target);
+
+    /// Measure the qubit in the Z basis. If "doForce" is true, the outcome is forced to "result," (which is only
+    /// valid if the measurement is random or already consistent).
+    bool ForceM(const bitLenInt& target, bool result, bool doForce = true);
+    bool M(const bitLenInt& target) { return ForceM(target, false, false); }
+
+    /// Probability of measuring the qubit as "true," which is always 0, 1, or 1/2 for a stabilizer state.
+    real1 Prob(const bitLenInt& qubit);
+
+    /// Append the other register to the end of this one, (a tensor product of unentangled states).
+    bitLenInt Compose(QStabilizerPtr toCopy);
+
+    /// Returns "true" if every qubit in the range is a separable single-qubit eigenstate, such that
+    /// DecomposeDispose() can split the tableau without falling back to a state vector.
+    bool CanDecomposeDispose(const bitLenInt& start, const bitLenInt& length);
+
+    /// Remove the (separable, per-qubit eigenstate) qubit range from the register, optionally copying its state into
+    /// "dest". Check CanDecomposeDispose() first; the state is undefined on failure, otherwise.
+    void DecomposeDispose(const bitLenInt& start, const bitLenInt& length, QStabilizerPtr dest);
+
+    /// Convert the stabilizer state to a ket, (for conversion to a state vector engine). "outputState" receives all
+    /// 2^n amplitudes, so this is only tractable at state-vector-feasible widths.
+    void GetQuantumState(complex* outputState);
+
+protected:
+    /// Phase exponent of i contributed to a Pauli product by single-qubit components (x1, z1) times (x2, z2)
+    int8_t PhaseExp(const bool& x1, const bool& z1, const bool& x2, const bool& z2);
+
+    void RowCopy(const bitLenInt& i, const bitLenInt& k);
+    void RowSwap(const bitLenInt& i, const bitLenInt& k);
+    /// Set row i to the single Pauli indexed by b: X_b for b < n, or Z_(b - n), otherwise.
+    void RowSet(const bitLenInt& i, const bitLenInt& b);
+    /// Left-multiply row i by row k, tracking the phase.
+    void RowMult(const bitLenInt& i, const bitLenInt& k);
+
+    /// Do Gaussian elimination of the stabilizer rows, returning the number of X-bearing generators, g, (such that
+    /// the state has 2^g nonzero amplitudes).
+    bitLenInt Gaussian();
+    /// After Gaussian(), set the scratch row to a basis state consistent with the Z-only stabilizer generators.
+    void Seed(const bitLenInt& g);
+    /// Write the amplitude of the basis state currently in the scratch row.
+    void SetBasisState(const real1& nrm, complex* outputState);
+
+    /// Remove a single qubit that is in a deterministic Z eigenstate from the tableau.
+    void DisposeDeterministicZ(const bitLenInt& target);
+};
+} // namespace Qrack
@@ -0,0 +1,367 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2020. All rights reserved.
+//
+// QStabilizerHybrid fronts a Qrack::QStabilizer Clifford tableau simulator with the
+// QInterface API. While every operation applied is a Clifford gate, (or a measurement,)
+// the state is tracked in O(n^2) memory; the first non-Clifford operation converts the
+// tableau to a ket and transparently switches to a state vector engine.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#pragma once
+
+#include "qinterface.hpp"
+#include "qstabilizer.hpp"
+
+namespace Qrack {
+
+class QStabilizerHybrid;
+typedef std::shared_ptr<QStabilizerHybrid> QStabilizerHybridPtr;
+
+/**
+ * A "Qrack::QStabilizerHybrid" internally switched between a Qrack::QStabilizer Clifford tableau simulator and a
+ * state vector engine, depending on whether the circuit applied so far is Clifford-only. (Note that, in stabilizer
+ * mode, the state is tracked up to global phase.)
+ */
+class QStabilizerHybrid : public QInterface {
+protected:
+    QInterfaceEngine engineType;
+    QStabilizerPtr stabilizer;
+    QInterfacePtr engine;
+    int devID;
+    complex phaseFactor;
+    bool useHostRam;
+    bool useRDRAND;
+    bool isSparse;
+
+public:
+    QStabilizerHybrid(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0,
+        qrack_rand_gen_ptr rgp = nullptr, complex phaseFac = CMPLX_DEFAULT_ARG, bool doNorm = true,
+        bool randomGlobalPhase = true, bool useHostMem = false, int deviceID = -1, bool useHardwareRNG = true,
+        bool useSparseStateVec = false, real1 norm_thresh = REAL1_DEFAULT_ARG);
+
+    /** "true" while the state is still tracked as a Clifford tableau, rather than a ket. */
+    virtual bool IsStabilizer() { return (stabilizer != NULL); }
+
+    /** Convert the tableau to a ket, in the underlying state vector engine type. (Irreversible.) */
+    virtual void SwitchToEngine();
+
+    virtual void SetQuantumState(const complex* inputState);
+    virtual void GetQuantumState(complex* outputState);
+    virtual void GetProbs(real1* outputProbs);
+    virtual complex GetAmplitude(bitCapInt perm);
+    virtual void SetAmplitude(bitCapInt perm, complex amp);
+    virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
+
+    virtual bitLenInt Compose(QStabilizerHybridPtr toCopy);
+    virtual bitLenInt Compose(QInterfacePtr toCopy)
+    {
+        return Compose(std::dynamic_pointer_cast<QStabilizerHybrid>(toCopy));
+    }
+    virtual bitLenInt Compose(QStabilizerHybridPtr toCopy, bitLenInt start);
+    virtual bitLenInt Compose(QInterfacePtr toCopy, bitLenInt start)
+    {
+        return Compose(std::dynamic_pointer_cast<QStabilizerHybrid>(toCopy), start);
+    }
+    virtual void Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest);
+    virtual void Dispose(bitLenInt start, bitLenInt length);
+    virtual void Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm);
+
+    virtual void ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex);
+    virtual void ApplySinglePhase(const complex topLeft, const complex bottomRight, bitLenInt qubitIndex);
+    virtual void ApplySingleInvert(const complex topRight, const complex bottomLeft, bitLenInt qubitIndex);
+    virtual void ApplyControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyControlledSinglePhase(const bitLenInt* controls, const bitLenInt& controlLen,
+        const bitLenInt& target, const complex topLeft, const complex bottomRight);
+    virtual void ApplyControlledSingleInvert(const bitLenInt* controls, const bitLenInt& controlLen,
+        const bitLenInt& target, const complex topRight, const complex bottomLeft);
+    virtual void ApplyAntiControlledSingleBit(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx);
+    virtual void ApplyAntiControlledSinglePhase(const bitLenInt* controls, const bitLenInt& controlLen,
+        const bitLenInt& target, const complex topLeft, const complex bottomRight);
+    virtual void ApplyAntiControlledSingleInvert(const bitLenInt* controls, const bitLenInt& controlLen,
+        const bitLenInt& target, const complex topRight, const complex bottomLeft);
+    virtual void UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+        bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+        const bitCapInt& mtrxSkipValueMask)
+    {
+        SwitchToEngine();
+        engine->UniformlyControlledSingleBit(
+            controls, controlLen, qubitIndex, mtrxs, mtrxSkipPowers, mtrxSkipLen, mtrxSkipValueMask);
+    }
+    virtual void CSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->CSwap(controls, controlLen, qubit1, qubit2);
+    }
+    virtual void AntiCSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->AntiCSwap(controls, controlLen, qubit1, qubit2);
+    }
+    virtual void CSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->CSqrtSwap(controls, controlLen, qubit1, qubit2);
+    }
+    virtual void AntiCSqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->AntiCSqrtSwap(controls, controlLen, qubit1, qubit2);
+    }
+    virtual void CISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->CISqrtSwap(controls, controlLen, qubit1, qubit2);
+    }
+    virtual void AntiCISqrtSwap(
+        const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+    {
+        SwitchToEngine();
+        engine->AntiCISqrtSwap(controls, controlLen, qubit1, qubit2);
+    }
+
+    virtual bool ForceM(bitLenInt qubit, bool result, bool doForce = true, bool doApply = true);
+
+    virtual void ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->ROL(shift, start, length);
+    }
+    virtual void ROR(bitLenInt shift, bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->ROR(shift, start, length);
+    }
+    virtual void INC(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->INC(toAdd, start, length);
+    }
+    virtual void CINC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls,
+        bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CINC(toAdd, inOutStart, length, controls, controlLen);
+    }
+    virtual void INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->INCC(toAdd, start, length, carryIndex);
+    }
+    virtual void INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex)
+    {
+        SwitchToEngine();
+        engine->INCS(toAdd, start, length, overflowIndex);
+    }
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex,
+        bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->INCSC(toAdd, start, length, overflowIndex, carryIndex);
+    }
+    virtual void INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->INCSC(toAdd, start, length, carryIndex);
+    }
+    virtual void INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->INCBCD(toAdd, start, length);
+    }
+    virtual void INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->INCBCDC(toAdd, start, length, carryIndex);
+    }
+    virtual void DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->DECC(toSub, start, length, carryIndex);
+    }
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex,
+        bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->DECSC(toSub, start, length, overflowIndex, carryIndex);
+    }
+    virtual void DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->DECSC(toSub, start, length, carryIndex);
+    }
+    virtual void DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+    {
+        SwitchToEngine();
+        engine->DECBCDC(toSub, start, length, carryIndex);
+    }
+    virtual void MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->MUL(toMul, inOutStart, carryStart, length);
+    }
+    virtual void DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->DIV(toDiv, inOutStart, carryStart, length);
+    }
+    virtual void MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->MULModNOut(toMul, modN, inStart, outStart, length);
+    }
+    virtual void IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->IMULModNOut(toMul, modN, inStart, outStart, length);
+    }
+    virtual void POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->POWModNOut(base, modN, inStart, outStart, length);
+    }
+    virtual void CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CMUL(toMul, inOutStart, carryStart, length, controls, controlLen);
+    }
+    virtual void CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CDIV(toDiv, inOutStart, carryStart, length, controls, controlLen);
+    }
+    virtual void CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    }
+    virtual void CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CIMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    }
+    virtual void CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+        bitLenInt* controls, bitLenInt controlLen)
+    {
+        SwitchToEngine();
+        engine->CPOWModNOut(base, modN, inStart, outStart, length, controls, controlLen);
+    }
+
+    virtual void ZeroPhaseFlip(bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->ZeroPhaseFlip(start, length);
+    }
+    virtual void CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
+    {
+        SwitchToEngine();
+        engine->CPhaseFlipIfLess(greaterPerm, start, length, flagIndex);
+    }
+    virtual void PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
+    {
+        SwitchToEngine();
+        engine->PhaseFlipIfLess(greaterPerm, start, length);
+    }
+    virtual void PhaseFlip()
+    {
+        // In stabilizer mode, the state is tracked up to global phase, so this is a no-op there.
+        if (engine) {
+            engine->PhaseFlip();
+        }
+    }
+    virtual bitCapInt IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, unsigned char* values, bool resetValue = true)
+    {
+        SwitchToEngine();
+        return engine->IndexedLDA(indexStart, indexLength, valueStart, valueLength, values, resetValue);
+    }
+    virtual bitCapInt IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values)
+    {
+        SwitchToEngine();
+        return engine->IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    }
+    virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
+        bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values)
+    {
+        SwitchToEngine();
+        return engine->IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    }
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values)
+    {
+        SwitchToEngine();
+        engine->IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, values);
+    }
+    virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values)
+    {
+        SwitchToEngine();
+        engine->Hash(start, length, values);
+    }
+
+    virtual void Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2);
+    virtual void SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+    {
+        SwitchToEngine();
+        engine->SqrtSwap(qubitIndex1, qubitIndex2);
+    }
+    virtual void ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+    {
+        SwitchToEngine();
+        engine->ISqrtSwap(qubitIndex1, qubitIndex2);
+    }
+    virtual void FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+    {
+        SwitchToEngine();
+        engine->FSim(theta, phi, qubitIndex1, qubitIndex2);
+    }
+
+    virtual real1 Prob(bitLenInt qubitIndex);
+    virtual real1 ProbAll(bitCapInt fullRegister);
+
+    virtual bool ApproxCompare(QStabilizerHybridPtr toCompare);
+    virtual bool ApproxCompare(QInterfacePtr toCompare)
+    {
+        return ApproxCompare(std::dynamic_pointer_cast<QStabilizerHybrid>(toCompare));
+    }
+    virtual void UpdateRunningNorm(real1 norm_thresh = REAL1_DEFAULT_ARG)
+    {
+        if (engine) {
+            engine->UpdateRunningNorm(norm_thresh);
+        }
+    }
+    virtual void NormalizeState(real1 nrm = REAL1_DEFAULT_ARG, real1 norm_thresh = REAL1_DEFAULT_ARG)
+    {
+        if (engine) {
+            engine->NormalizeState(nrm, norm_thresh);
+        }
+    }
+    virtual void Finish()
+    {
+        if (engine) {
+            engine->Finish();
+        }
+    }
+    virtual bool isFinished() { return !engine || engine->isFinished(); }
+    virtual QInterfacePtr Clone();
+
+protected:
+    /// "true" if the 2x2 matrix is Hadamard, (up to numerical precision)
+    bool IsHGate(const complex* mtrx);
+};
+} // namespace Qrack
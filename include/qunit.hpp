@@ -75,6 +75,10 @@ public:
     complex amp0;
     complex amp1;
     bool isPlusMinus;
+    // Whether a separation check has already been paid for with the shard in its current state. Cleared whenever a
+    // gate dirties the shard, so separation is only re-attempted on qubits whose history since the last check makes
+    // success plausible.
+    bool isSepChecked;
     // Shards which this shard controls
     ShardToPhaseMap controlsShards;
     // Shards which this shard (anti-)controls
@@ -102,6 +106,7 @@ public:
         , amp0(ONE_CMPLX)
         , amp1(ZERO_CMPLX)
         , isPlusMinus(false)
+        , isSepChecked(false)
         , controlsShards()
         , antiControlsShards()
         , targetOfShards()
@@ -119,6 +124,7 @@ public:
         , amp0(ONE_CMPLX)
         , amp1(ZERO_CMPLX)
         , isPlusMinus(false)
+        , isSepChecked(false)
         , controlsShards()
         , antiControlsShards()
         , targetOfShards()
@@ -139,6 +145,7 @@ public:
         , amp0(ONE_CMPLX)
         , amp1(ZERO_CMPLX)
         , isPlusMinus(false)
+        , isSepChecked(false)
         , controlsShards()
         , antiControlsShards()
         , targetOfShards()
@@ -150,6 +157,7 @@ public:
     {
         isProbDirty = true;
         isPhaseDirty = true;
+        isSepChecked = false;
     }
 
     bool ClampAmps(real1 norm_thresh)
@@ -661,6 +669,7 @@ protected:
     bool useRDRAND;
     bool isSparse;
     bool freezeBasis;
+    real1 separabilityThreshold;
 
     virtual void SetQubitCount(bitLenInt qb)
     {
@@ -668,7 +677,7 @@ protected:
         QInterface::SetQubitCount(qb);
     }
 
-    QInterfacePtr MakeEngine(bitLenInt length, bitCapInt perm);
+    virtual QInterfacePtr MakeEngine(bitLenInt length, bitCapInt perm);
 
 public:
     QUnit(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
@@ -681,6 +690,8 @@ public:
     virtual void SetQuantumState(const complex* inputState);
     virtual void GetQuantumState(complex* outputState);
     virtual void GetProbs(real1* outputProbs);
+    virtual void GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
+    virtual void GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems = QRACK_STREAM_CHUNK_ELEMS);
     virtual complex GetAmplitude(bitCapInt perm);
     virtual void SetAmplitude(bitCapInt perm, complex amp);
     virtual void SetPermutation(bitCapInt perm, complex phaseFac = CMPLX_DEFAULT_ARG);
@@ -843,6 +854,8 @@ public:
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
     virtual bitCapInt IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
         bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values);
+    virtual void IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+        bitLenInt carryIndex, unsigned char* values);
     virtual void Hash(bitLenInt start, bitLenInt length, unsigned char* values);
     virtual void Swap(bitLenInt qubit1, bitLenInt qubit2);
     virtual void ISwap(bitLenInt qubit1, bitLenInt qubit2);
@@ -872,6 +885,16 @@ public:
     virtual void Dump();
 
     virtual bool TrySeparate(bitLenInt start, bitLenInt length = 1);
+    /**
+     * Set the error budget, (as squared secondary Schmidt coefficient,) that TrySeparate() may spend to cut a weakly
+     * entangled qubit out of its unit. (The default of 0 restricts TrySeparate() to exactly separable qubits. The
+     * environment variable "QRACK_QUNIT_SEPARABILITY_THRESHOLD" overrides the default, at construction.)
+     */
+    virtual void SetSeparabilityThreshold(real1 thresh) { separabilityThreshold = thresh; }
+#if ENABLE_QSTATS
+    virtual QInterfaceStats GetStats();
+    virtual void ResetStats();
+#endif
 
     virtual QInterfacePtr Clone();
 
@@ -946,6 +969,8 @@ protected:
 
     virtual void SeparateBit(bool value, bitLenInt qubit, bool doDispose = true);
 
+    virtual bool TrySchmidtSeparate(bitLenInt qubit);
+
     void OrderContiguous(QInterfacePtr unit);
 
     virtual void Detach(bitLenInt start, bitLenInt length, QUnitPtr dest);
@@ -978,6 +1003,8 @@ protected:
 
     void ApplyBuffer(
         ShardToPhaseMap::iterator phaseShard, const bitLenInt& control, const bitLenInt& target, const bool& isAnti);
+    void ApplyBulkPhaseBuffers(const bitLenInt& bitIndex, ShardToPhaseMap& bufferMap, const bool& isControl,
+        const bool& isAnti, const std::set<bitLenInt>& exceptPartners);
     void ApplyBufferMap(const bitLenInt& bitIndex, ShardToPhaseMap bufferMap, const RevertExclusivity& exclusivity,
         const bool& isControl, const bool& isAnti, std::set<bitLenInt> exceptPartners, const bool& dumpSkipped);
     void RevertBasis2Qb(const bitLenInt& i, const RevertExclusivity& exclusivity = INVERT_AND_PHASE,
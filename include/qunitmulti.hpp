@@ -23,7 +23,7 @@
 namespace Qrack {
 
 struct QEngineInfo {
-    QEngineOCLPtr unit;
+    QInterfacePtr unit;
     bitLenInt deviceIndex;
 
     QEngineInfo()
@@ -32,7 +32,7 @@ struct QEngineInfo {
     {
     }
 
-    QEngineInfo(QEngineOCLPtr u, bitLenInt devIndex)
+    QEngineInfo(QInterfacePtr u, bitLenInt devIndex)
         : unit(u)
         , deviceIndex(devIndex)
     {
@@ -53,6 +53,12 @@ struct QEngineInfo {
 struct DeviceInfo {
     int id;
     bitCapInt maxSize;
+    // Relative compute throughput proxy (compute units times clock frequency); only ratios between devices matter.
+    size_t throughput;
+    // Whether device memory is host-unified, in which case migrating a state vector doesn't cross a bus.
+    bool isHostUnified;
+    // Whether this is the host CPU pseudo-device, whose shards are QEngineCPU instances rather than QEngineOCL.
+    bool isCpu;
 
     bool operator<(const DeviceInfo& other) const { return maxSize < other.maxSize; }
     bool operator>(const DeviceInfo& other) const { return maxSize > other.maxSize; }
@@ -66,6 +72,7 @@ class QUnitMulti : public QUnit, public ParallelFor {
 protected:
     int defaultDeviceID;
     std::vector<DeviceInfo> deviceList;
+    bitLenInt cpuDeviceIndex;
 
 public:
     QUnitMulti(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState = 0, qrack_rand_gen_ptr rgp = nullptr,
@@ -89,8 +96,14 @@ public:
     virtual void GetProbs(real1* outputProbs);
 
 protected:
+    virtual QInterfacePtr MakeEngine(bitLenInt length, bitCapInt perm);
+
     virtual std::vector<QEngineInfo> GetQInfos();
 
+    /** Move "unit" to the deviceList entry at "devIndex", replacing its engine type (and rebinding every shard that
+     * references it) when the move crosses the host/accelerator boundary. */
+    virtual void SetUnitDevice(QInterfacePtr unit, bitLenInt devIndex);
+
     virtual void SeparateBit(bool value, bitLenInt qubit, bool doDispose = true);
 
     virtual void Detach(bitLenInt start, bitLenInt length, QUnitPtr dest)
@@ -14,21 +14,39 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <set>
 
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "common/parallel_for.hpp"
 #include "common/qrack_types.hpp"
 
+#if ENABLE_NUMA
+#include "common/threadpool.hpp"
+#endif
+
+#if ENABLE_COMPLEX_HALF
+#include <cstdint>
+#include <cstring>
+#endif
+
 #if ENABLE_UINT128
 #if BOOST_AVAILABLE
 #include <boost/functional/hash.hpp>
 #include <unordered_map>
 #define SparseStateVecMap std::unordered_map<bitCapInt, complex>
+#define SPARSE_MAP_HAS_RESERVE 1
 #else
 #include <map>
 #define SparseStateVecMap std::map<bitCapInt, complex>
+#define SPARSE_MAP_HAS_RESERVE 0
 #endif
 #else
 #if QBCAPPOW > 7
@@ -36,42 +54,193 @@
 #endif
 #include <unordered_map>
 #define SparseStateVecMap std::unordered_map<bitCapInt, complex>
+#define SPARSE_MAP_HAS_RESERVE 1
 #endif
 
 namespace Qrack {
 
+#if ENABLE_COMPLEX_HALF
+/**
+ * Half-precision dense amplitude storage: amplitudes are rounded to IEEE 754 "binary16" on write() and widened back
+ * to single precision on read(), so all arithmetic, (including reductions like par_norm,) still accumulates in
+ * "real1" single precision; only the resident buffer is halved. The conversions are portable bit manipulation, with
+ * round-to-nearest-even on narrowing, so no compiler fp16 extension is required.
+ */
+struct complexHalf {
+    uint16_t re;
+    uint16_t im;
+};
+
+inline uint16_t half_from_float(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16U) & 0x8000U);
+    uint32_t mant = bits & 0x007FFFFFU;
+    const int32_t exp = (int32_t)((bits >> 23U) & 0xFFU) - 127 + 15;
+
+    if (((bits >> 23U) & 0xFFU) == 0xFFU) {
+        // Infinity, or NaN, (with the payload truncated to a quiet bit):
+        return sign | 0x7C00U | (mant ? 0x0200U : 0U);
+    }
+    if (exp >= 0x1F) {
+        // Overflow to infinity:
+        return sign | 0x7C00U;
+    }
+    if (exp <= 0) {
+        if (exp < -10) {
+            // Underflow to (signed) zero:
+            return sign;
+        }
+        // Subnormal half: shift the (restored implicit) leading 1 into the 10 bit significand.
+        mant |= 0x00800000U;
+        const uint32_t shift = (uint32_t)(14 - exp);
+        uint16_t halfMant = (uint16_t)(mant >> shift);
+        const uint32_t rem = mant & ((1U << shift) - 1U);
+        const uint32_t halfway = 1U << (shift - 1U);
+        if ((rem > halfway) || ((rem == halfway) && (halfMant & 1U))) {
+            halfMant++;
+        }
+        return sign | halfMant;
+    }
+    // Normal half, (a carried round may overflow the significand into the exponent, which is still correct):
+    uint16_t toRet = sign | (uint16_t)(exp << 10U) | (uint16_t)(mant >> 13U);
+    const uint32_t rem = mant & 0x1FFFU;
+    if ((rem > 0x1000U) || ((rem == 0x1000U) && (toRet & 1U))) {
+        toRet++;
+    }
+    return toRet;
+}
+
+inline float half_to_float(uint16_t h)
+{
+    const uint32_t sign = ((uint32_t)(h & 0x8000U)) << 16U;
+    uint32_t exp = (h >> 10U) & 0x1FU;
+    uint32_t mant = h & 0x03FFU;
+    uint32_t bits;
+
+    if (exp == 0x1FU) {
+        bits = sign | 0x7F800000U | (mant << 13U);
+    } else if (exp == 0U) {
+        if (mant == 0U) {
+            bits = sign;
+        } else {
+            // Normalize the subnormal:
+            exp = 113U;
+            while (!(mant & 0x0400U)) {
+                mant <<= 1U;
+                exp--;
+            }
+            bits = sign | (exp << 23U) | ((mant & 0x03FFU) << 13U);
+        }
+    } else {
+        bits = sign | ((exp + 112U) << 23U) | (mant << 13U);
+    }
+
+    float toRet;
+    std::memcpy(&toRet, &bits, sizeof(toRet));
+    return toRet;
+}
+
+inline complexHalf amp_store(const complex& c)
+{
+    complexHalf toRet;
+    toRet.re = half_from_float(real(c));
+    toRet.im = half_from_float(imag(c));
+    return toRet;
+}
+
+inline complex amp_load(const complexHalf& c) { return complex(half_to_float(c.re), half_to_float(c.im)); }
+
+typedef complexHalf ampStorage;
+#else
+typedef complex ampStorage;
+
+inline const complex& amp_store(const complex& c) { return c; }
+
+inline const complex& amp_load(const complex& c) { return c; }
+#endif
+
 class StateVectorArray : public StateVector {
 protected:
-    complex* amplitudes;
+    ampStorage* amplitudes;
+    /// Nonzero exactly when "amplitudes" is a memory mapping to munmap, rather than an allocation to free
+    size_t mappedBytes;
 
-    static real1 normHelper(const complex& c) { return norm(c); }
+    static real1 normHelper(const ampStorage& c) { return norm(amp_load(c)); }
 
-    complex* Alloc(bitCapInt elemCount)
+    ampStorage* Alloc(bitCapInt elemCount)
     {
+        alloc_count()++;
 // elemCount is always a power of two, but might be smaller than QRACK_ALIGN_SIZE
 #if defined(__APPLE__)
-        void* toRet;
-        posix_memalign(&toRet, QRACK_ALIGN_SIZE,
-            ((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
+        void* toRetPtr;
+        posix_memalign(&toRetPtr, QRACK_ALIGN_SIZE,
+            ((sizeof(ampStorage) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
                 ? QRACK_ALIGN_SIZE
-                : sizeof(complex) * (bitCapIntOcl)elemCount);
-        return (complex*)toRet;
+                : sizeof(ampStorage) * (bitCapIntOcl)elemCount);
+        ampStorage* toRet = (ampStorage*)toRetPtr;
 #elif defined(_WIN32) && !defined(__CYGWIN__)
-        return (complex*)_aligned_malloc(((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
-                ? QRACK_ALIGN_SIZE
-                : sizeof(complex) * (bitCapIntOcl)elemCount,
-            QRACK_ALIGN_SIZE);
+        ampStorage* toRet =
+            (ampStorage*)_aligned_malloc(((sizeof(ampStorage) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
+                    ? QRACK_ALIGN_SIZE
+                    : sizeof(ampStorage) * (bitCapIntOcl)elemCount,
+                QRACK_ALIGN_SIZE);
 #else
-        return (complex*)aligned_alloc(QRACK_ALIGN_SIZE,
-            ((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
+        ampStorage* toRet = (ampStorage*)aligned_alloc(QRACK_ALIGN_SIZE,
+            ((sizeof(ampStorage) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
                 ? QRACK_ALIGN_SIZE
-                : sizeof(complex) * (bitCapIntOcl)elemCount);
+                : sizeof(ampStorage) * (bitCapIntOcl)elemCount);
 #endif
+#if ENABLE_NUMA
+        if (toRet) {
+            FirstTouch(toRet, elemCount);
+        }
+#endif
+        return toRet;
     }
 
+#if ENABLE_NUMA
+    /**
+     * Zero the fresh buffer in equal contiguous slices, one per (pinned) pool worker, so first-touch policy
+     * interleaves the backing pages across the NUMA nodes that will service them, rather than leaving them all on the
+     * allocating thread's node. (Work stealing makes the worker-to-slice mapping approximate, but a round-robin
+     * dispatch of exactly one slice per worker is stable in the common case.)
+     */
+    void FirstTouch(ampStorage* amps, bitCapInt elemCount)
+    {
+        if (ThreadPool::IsPoolThread()) {
+            // Blocking on more pool tasks from a pool worker could deadlock, so touch inline.
+            std::fill(amps, amps + (bitCapIntOcl)elemCount, amp_store(ZERO_CMPLX));
+            return;
+        }
+
+        bitCapIntOcl maxLcv = (bitCapIntOcl)elemCount;
+        bitCapIntOcl workers = (bitCapIntOcl)ThreadPool::Instance()->GetWorkerCount();
+        bitCapIntOcl slice = (maxLcv + (workers - 1U)) / workers;
+        std::vector<std::future<void>> futures;
+        for (bitCapIntOcl offset = 0; offset < maxLcv; offset += slice) {
+            bitCapIntOcl length = ((maxLcv - offset) < slice) ? (maxLcv - offset) : slice;
+            futures.push_back(ThreadPool::Instance()->Dispatch(
+                [amps, offset, length]() { std::fill(amps + offset, amps + offset + length, amp_store(ZERO_CMPLX)); }));
+        }
+        for (size_t i = 0; i < futures.size(); i++) {
+            futures[i].get();
+        }
+    }
+#endif
+
     virtual void Free()
     {
         if (amplitudes) {
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+            if (mappedBytes) {
+                munmap(amplitudes, mappedBytes);
+                mappedBytes = 0;
+                amplitudes = NULL;
+                return;
+            }
+#endif
 #if defined(_WIN32)
             _aligned_free(amplitudes);
 #else
@@ -82,30 +251,65 @@ protected:
     }
 
 public:
+    /// Running count of buffer allocations, for benchmark instrumentation. (Callers may reset it.)
+    static std::atomic<size_t>& alloc_count()
+    {
+        static std::atomic<size_t> allocCount(0U);
+        return allocCount;
+    }
+
     StateVectorArray(bitCapInt cap)
         : StateVector(cap)
+        , mappedBytes(0)
     {
         amplitudes = Alloc(capacity);
     }
 
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    /// Adopt a memory-mapped amplitude buffer, (such as a snapshot file mapping,) to be munmap'ed on Free()
+    StateVectorArray(bitCapInt cap, ampStorage* mappedAmps, size_t mappedLen)
+        : StateVector(cap)
+        , amplitudes(mappedAmps)
+        , mappedBytes(mappedLen)
+    {
+        // Intentionally left blank.
+    }
+#endif
+
     virtual ~StateVectorArray() { Free(); }
 
-    complex read(const bitCapInt& i) { return amplitudes[(bitCapIntOcl)i]; };
+    complex read(const bitCapInt& i) { return amp_load(amplitudes[(bitCapIntOcl)i]); };
 
-    void write(const bitCapInt& i, const complex& c) { amplitudes[(bitCapIntOcl)i] = c; };
+    void write(const bitCapInt& i, const complex& c) { amplitudes[(bitCapIntOcl)i] = amp_store(c); };
 
     void write2(const bitCapInt& i1, const complex& c1, const bitCapInt& i2, const complex& c2)
     {
-        amplitudes[(bitCapIntOcl)i1] = c1;
-        amplitudes[(bitCapIntOcl)i2] = c2;
+        amplitudes[(bitCapIntOcl)i1] = amp_store(c1);
+        amplitudes[(bitCapIntOcl)i2] = amp_store(c2);
     };
 
-    void clear() { std::fill(amplitudes, amplitudes + (bitCapIntOcl)capacity, ZERO_CMPLX); }
+    void clear() { std::fill(amplitudes, amplitudes + (bitCapIntOcl)capacity, amp_store(ZERO_CMPLX)); }
+
+#if ENABLE_COMPLEX_HALF
+    void copy_in(const complex* copyIn) { std::transform(copyIn, copyIn + (bitCapIntOcl)capacity, amplitudes, amp_store); }
 
+    void copy_out(complex* copyOut) { std::transform(amplitudes, amplitudes + (bitCapIntOcl)capacity, copyOut, amp_load); }
+
+    void copy_out(complex* copyOut, const bitCapInt& offset, const bitCapInt& length)
+    {
+        std::transform(amplitudes + (bitCapIntOcl)offset, amplitudes + (bitCapIntOcl)(offset + length), copyOut, amp_load);
+    }
+#else
     void copy_in(const complex* copyIn) { std::copy(copyIn, copyIn + (bitCapIntOcl)capacity, amplitudes); }
 
     void copy_out(complex* copyOut) { std::copy(amplitudes, amplitudes + (bitCapIntOcl)capacity, copyOut); }
 
+    void copy_out(complex* copyOut, const bitCapInt& offset, const bitCapInt& length)
+    {
+        std::copy(amplitudes + (bitCapIntOcl)offset, amplitudes + (bitCapIntOcl)(offset + length), copyOut);
+    }
+#endif
+
     void copy(StateVectorPtr toCopy) { copy(std::dynamic_pointer_cast<StateVectorArray>(toCopy)); }
 
     void copy(StateVectorArrayPtr toCopy)
@@ -119,33 +323,83 @@ public:
     }
 
     bool is_sparse() { return false; }
+
+    /// Reduce the capacity in place, keeping the low "nCap" amplitudes, without reallocating or moving the buffer.
+    /// Where supported, the physical pages of the dropped tail are returned to the OS; the virtual range stays
+    /// reserved until Free().
+    void shrink(const bitCapInt& nCap)
+    {
+        if (nCap >= capacity) {
+            return;
+        }
+
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+        // "madvise" operates on whole pages, so the range is trimmed inward to page boundaries, to avoid dropping
+        // bytes that are not ours.
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        char* tail = (char*)(amplitudes + (bitCapIntOcl)nCap);
+        char* end = (char*)(amplitudes + (bitCapIntOcl)capacity);
+        size_t tailOff = ((size_t)tail) % pageSize;
+        if (tailOff) {
+            tail += pageSize - tailOff;
+        }
+        end -= ((size_t)end) % pageSize;
+        if (tail < end) {
+            madvise(tail, end - tail, MADV_DONTNEED);
+        }
+#endif
+
+        capacity = nCap;
+    }
 };
 
 class StateVectorSparse : public StateVector, public ParallelFor {
 protected:
-    SparseStateVecMap amplitudes;
-    std::mutex mtx;
+    // The map is striped across independently locked shards, so parallel sweeps don't serialize on one mutex.
+    size_t shardCount;
+    std::vector<SparseStateVecMap> amplitudes;
+    std::unique_ptr<std::mutex[]> mtxs;
+
+    size_t Shard(const bitCapInt& i)
+    {
+        // Sparse set bit patterns are often highly structured, so the index is mixed before striping.
+        bitCapIntOcl h = (bitCapIntOcl)i;
+        h ^= h >> 17U;
+        h *= (bitCapIntOcl)0x9E3779B9UL;
+        h ^= h >> 11U;
+        return (size_t)h & (shardCount - 1U);
+    }
 
     complex readUnlocked(const bitCapInt& i)
     {
-        auto it = amplitudes.find(i);
-        return (it == amplitudes.end()) ? ZERO_CMPLX : it->second;
+        SparseStateVecMap& shard = amplitudes[Shard(i)];
+        auto it = shard.find(i);
+        return (it == shard.end()) ? ZERO_CMPLX : it->second;
     }
 
     complex readLocked(const bitCapInt& i)
     {
-        mtx.lock();
-        auto it = amplitudes.find(i);
-        bool isFound = (it != amplitudes.end());
-        mtx.unlock();
-        return isFound ? it->second : ZERO_CMPLX;
+        size_t s = Shard(i);
+        mtxs[s].lock();
+        auto it = amplitudes[s].find(i);
+        complex toRet = (it == amplitudes[s].end()) ? ZERO_CMPLX : it->second;
+        mtxs[s].unlock();
+        return toRet;
     }
 
 public:
     StateVectorSparse(bitCapInt cap)
         : StateVector(cap)
+        , shardCount(1U)
         , amplitudes()
     {
+        // A power of two, a few times the thread count, keeps per-sweep collision odds low.
+        size_t minShards = 4U * (size_t)GetConcurrencyLevel();
+        while (shardCount < minShards) {
+            shardCount <<= 1U;
+        }
+        amplitudes.resize(shardCount);
+        mtxs = std::unique_ptr<std::mutex[]>(new std::mutex[shardCount]);
     }
 
     complex read(const bitCapInt& i) { return isReadLocked ? readLocked(i) : readUnlocked(i); }
@@ -154,23 +408,22 @@ public:
     {
         bool isCSet = (c != ZERO_CMPLX);
 
-        mtx.lock();
+        size_t s = Shard(i);
+        mtxs[s].lock();
 
-        auto it = amplitudes.find(i);
-        bool isFound = (it != amplitudes.end());
-        if (isCSet == isFound) {
-            mtx.unlock();
-            if (isCSet) {
+        auto it = amplitudes[s].find(i);
+        bool isFound = (it != amplitudes[s].end());
+        if (isCSet) {
+            if (isFound) {
                 it->second = c;
-            }
-        } else {
-            if (isCSet) {
-                amplitudes[i] = c;
             } else {
-                amplitudes.erase(it);
+                amplitudes[s][i] = c;
             }
-            mtx.unlock();
+        } else if (isFound) {
+            amplitudes[s].erase(it);
         }
+
+        mtxs[s].unlock();
     }
 
     void write2(const bitCapInt& i1, const complex& c1, const bitCapInt& i2, const complex& c2)
@@ -181,42 +434,44 @@ public:
             return;
         }
 
+        size_t s1 = Shard(i1);
+        size_t s2 = Shard(i2);
+
+        // Both shards are held at once, always acquired in index order, so concurrent pair writes can't deadlock.
+        mtxs[(s1 < s2) ? s1 : s2].lock();
+        if (s1 != s2) {
+            mtxs[(s1 < s2) ? s2 : s1].lock();
+        }
+
         if (isC1Set && isC2Set) {
-            mtx.lock();
-            amplitudes[i1] = c1;
-            amplitudes[i2] = c2;
-            mtx.unlock();
+            amplitudes[s1][i1] = c1;
+            amplitudes[s2][i2] = c2;
         } else if (isC1Set) {
-            mtx.lock();
-            amplitudes.erase(i2);
-            amplitudes[i1] = c1;
-            mtx.unlock();
+            amplitudes[s2].erase(i2);
+            amplitudes[s1][i1] = c1;
         } else {
-            mtx.lock();
-            amplitudes.erase(i1);
-            amplitudes[i2] = c2;
-            mtx.unlock();
+            amplitudes[s1].erase(i1);
+            amplitudes[s2][i2] = c2;
+        }
+
+        if (s1 != s2) {
+            mtxs[(s1 < s2) ? s2 : s1].unlock();
         }
+        mtxs[(s1 < s2) ? s1 : s2].unlock();
     }
 
     void clear()
     {
-        mtx.lock();
-        amplitudes.clear();
-        mtx.unlock();
+        for (size_t s = 0; s < shardCount; s++) {
+            mtxs[s].lock();
+            amplitudes[s].clear();
+            mtxs[s].unlock();
+        }
     }
 
     void copy_in(const complex* copyIn)
     {
-        mtx.lock();
-        for (bitCapInt i = 0; i < capacity; i++) {
-            if (copyIn[(bitCapIntOcl)i] == ZERO_CMPLX) {
-                amplitudes.erase(i);
-            } else {
-                amplitudes[i] = copyIn[(bitCapIntOcl)i];
-            }
-        }
-        mtx.unlock();
+        par_for(0, capacity, [&](const bitCapInt i, const int cpu) { write(i, copyIn[(bitCapIntOcl)i]); });
     }
 
     void copy_out(complex* copyOut)
@@ -226,13 +481,102 @@ public:
         }
     }
 
+    void copy_out(complex* copyOut, const bitCapInt& offset, const bitCapInt& length)
+    {
+        for (bitCapInt i = 0; i < length; i++) {
+            copyOut[(bitCapIntOcl)i] = read(offset + i);
+        }
+    }
+
     void copy(const StateVectorPtr toCopy) { copy(std::dynamic_pointer_cast<StateVectorSparse>(toCopy)); }
 
     void copy(StateVectorSparsePtr toCopy)
     {
-        mtx.lock();
-        amplitudes = toCopy->amplitudes;
-        mtx.unlock();
+        for (size_t s = 0; s < shardCount; s++) {
+            mtxs[s].lock();
+        }
+        if (shardCount == toCopy->shardCount) {
+            amplitudes = toCopy->amplitudes;
+        } else {
+            for (size_t s = 0; s < shardCount; s++) {
+                amplitudes[s].clear();
+            }
+            for (size_t s = 0; s < toCopy->shardCount; s++) {
+                for (auto it = toCopy->amplitudes[s].begin(); it != toCopy->amplitudes[s].end(); it++) {
+                    amplitudes[Shard(it->first)][it->first] = it->second;
+                }
+            }
+        }
+        for (size_t s = shardCount; s > 0; s--) {
+            mtxs[s - 1U].unlock();
+        }
+    }
+
+    /**
+     * Fill this (empty) vector with the sparse tensor product of "lowVec" and "highVec", with the "highVec"
+     * permutations shifted up by "highStart". Inserting the |low| x |high| product pairs through write() would
+     * serialize on the destination shard mutexes, so each thread instead buckets its contiguous slice of the product
+     * by destination shard without locking, and then every shard is merged by exactly one thread, (which owns it
+     * exclusively,) with its capacity reserved from the exact bucket totals, first.
+     */
+    void compose(StateVectorSparsePtr lowVec, StateVectorSparsePtr highVec, const bitLenInt& highStart)
+    {
+        std::vector<bitCapInt> lowSet = lowVec->iterable();
+        std::vector<bitCapInt> highSet = highVec->iterable();
+
+        // Each source amplitude would otherwise be re-read, (and re-hashed,) once per product pair:
+        std::vector<complex> lowAmps(lowSet.size());
+        std::vector<complex> highAmps(highSet.size());
+        par_for(0, lowSet.size(),
+            [&](const bitCapInt i, const int cpu) { lowAmps[(bitCapIntOcl)i] = lowVec->read(lowSet[(bitCapIntOcl)i]); });
+        par_for(0, highSet.size(), [&](const bitCapInt i, const int cpu) {
+            highAmps[(bitCapIntOcl)i] = highVec->read(highSet[(bitCapIntOcl)i]);
+        });
+
+        const bitCapIntOcl lowSize = (bitCapIntOcl)lowSet.size();
+        const bitCapIntOcl maxI = lowSize * (bitCapIntOcl)highSet.size();
+        const size_t threadCount = (size_t)GetConcurrencyLevel();
+        const bitCapIntOcl slice = (maxI + (threadCount - 1U)) / threadCount;
+
+        typedef std::vector<std::pair<bitCapInt, complex>> ShardBucket;
+        std::vector<std::vector<ShardBucket>> buckets(threadCount, std::vector<ShardBucket>(shardCount));
+
+        par_for(0, threadCount, [&](const bitCapInt tId, const int cpu) {
+            const size_t t = (size_t)(bitCapIntOcl)tId;
+            const bitCapIntOcl offset = ((bitCapIntOcl)t) * slice;
+            const bitCapIntOcl top = ((offset + slice) < maxI) ? (offset + slice) : maxI;
+            std::vector<ShardBucket>& myBuckets = buckets[t];
+            for (bitCapIntOcl i = offset; i < top; i++) {
+                const bitCapIntOcl lowPerm = i % lowSize;
+                const bitCapIntOcl highPerm = (i - lowPerm) / lowSize;
+                const complex amp = lowAmps[lowPerm] * highAmps[highPerm];
+                if (amp == ZERO_CMPLX) {
+                    continue;
+                }
+                const bitCapInt perm = lowSet[lowPerm] | (highSet[highPerm] << highStart);
+                myBuckets[Shard(perm)].push_back(std::pair<bitCapInt, complex>(perm, amp));
+            }
+        });
+
+        par_for(0, shardCount, [&](const bitCapInt sId, const int cpu) {
+            const size_t s = (size_t)(bitCapIntOcl)sId;
+            size_t total = 0;
+            for (size_t t = 0; t < threadCount; t++) {
+                total += buckets[t][s].size();
+            }
+            if (total == 0) {
+                return;
+            }
+#if SPARSE_MAP_HAS_RESERVE
+            amplitudes[s].reserve(amplitudes[s].size() + total);
+#endif
+            for (size_t t = 0; t < threadCount; t++) {
+                ShardBucket& bucket = buckets[t][s];
+                for (size_t j = 0; j < bucket.size(); j++) {
+                    amplitudes[s][bucket[j].first] = bucket[j].second;
+                }
+            }
+        });
     }
 
     void get_probs(real1* outArray)
@@ -242,7 +586,16 @@ public:
         }
     }
 
-    bool is_sparse() { return (amplitudes.size() < (capacity >> ONE_BCI)); }
+    size_t size()
+    {
+        size_t toRet = 0;
+        for (size_t s = 0; s < shardCount; s++) {
+            toRet += amplitudes[s].size();
+        }
+        return toRet;
+    }
+
+    bool is_sparse() { return (size() < (bitCapIntOcl)(capacity >> ONE_BCI)); }
 
     std::vector<bitCapInt> iterable()
     {
@@ -252,16 +605,15 @@ public:
         std::vector<std::vector<bitCapInt>> toRet(threadCount);
         std::vector<std::vector<bitCapInt>>::iterator toRetIt;
 
-        mtx.lock();
-
-        par_for(0, amplitudes.size(), [&](const bitCapInt lcv, const int cpu) {
-            auto it = amplitudes.begin();
-            std::advance(it, lcv);
-            toRet[cpu].push_back(it->first);
+        par_for(0, shardCount, [&](const bitCapInt lcv, const int cpu) {
+            size_t s = (size_t)(bitCapIntOcl)lcv;
+            mtxs[s].lock();
+            for (auto it = amplitudes[s].begin(); it != amplitudes[s].end(); it++) {
+                toRet[cpu].push_back(it->first);
+            }
+            mtxs[s].unlock();
         });
 
-        mtx.unlock();
-
         for (i = (toRet.size() - 1); i >= 0; i--) {
             if (toRet[i].size() == 0) {
                 toRetIt = toRet.begin();
@@ -316,28 +668,30 @@ public:
         std::vector<std::set<bitCapInt>> toRet(threadCount);
         std::vector<std::set<bitCapInt>>::iterator toRetIt;
 
-        mtx.lock();
-
         if ((filterMask == 0) && (filterValues == 0)) {
-            par_for(0, amplitudes.size(), [&](const bitCapInt lcv, const int cpu) {
-                auto it = amplitudes.begin();
-                std::advance(it, lcv);
-                toRet[cpu].insert(it->first & unsetMask);
+            par_for(0, shardCount, [&](const bitCapInt lcv, const int cpu) {
+                size_t s = (size_t)(bitCapIntOcl)lcv;
+                mtxs[s].lock();
+                for (auto it = amplitudes[s].begin(); it != amplitudes[s].end(); it++) {
+                    toRet[cpu].insert(it->first & unsetMask);
+                }
+                mtxs[s].unlock();
             });
         } else {
             bitCapInt unfilterMask = ~filterMask;
 
-            par_for(0, amplitudes.size(), [&](const bitCapInt lcv, const int cpu) {
-                auto it = amplitudes.begin();
-                std::advance(it, lcv);
-                if ((it->first & filterMask) == filterValues) {
-                    toRet[cpu].insert(it->first & unsetMask & unfilterMask);
+            par_for(0, shardCount, [&](const bitCapInt lcv, const int cpu) {
+                size_t s = (size_t)(bitCapIntOcl)lcv;
+                mtxs[s].lock();
+                for (auto it = amplitudes[s].begin(); it != amplitudes[s].end(); it++) {
+                    if ((it->first & filterMask) == filterValues) {
+                        toRet[cpu].insert(it->first & unsetMask & unfilterMask);
+                    }
                 }
+                mtxs[s].unlock();
             });
         }
 
-        mtx.unlock();
-
         for (i = (toRet.size() - 1); i >= 0; i--) {
             if (toRet[i].size() == 0) {
                 toRetIt = toRet.begin();
@@ -347,7 +701,6 @@ public:
         }
 
         if (toRet.size() == 0) {
-            mtx.unlock();
             return {};
         }
 
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include "common/dispatchqueue.hpp"
+
+namespace Qrack {
+
+DispatchQueue::DispatchQueue()
+    : isStarted(false)
+    , isWorking(false)
+    , isStopping(false)
+{
+    // The dispatch thread is started lazily, on the first Dispatch() call.
+}
+
+DispatchQueue::~DispatchQueue()
+{
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        isStopping = true;
+    }
+    queueCondition.notify_all();
+    if (isStarted) {
+        worker.join();
+    }
+}
+
+void DispatchQueue::Dispatch(const DispatchFn& fn)
+{
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        fns.push(fn);
+        if (!isStarted) {
+            isStarted = true;
+            worker = std::thread([this]() { WorkerLoop(); });
+        }
+    }
+    queueCondition.notify_one();
+}
+
+void DispatchQueue::Finish()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    finishCondition.wait(lock, [this]() { return fns.empty() && !isWorking; });
+}
+
+void DispatchQueue::Dump()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (!fns.empty()) {
+        fns.pop();
+    }
+    finishCondition.wait(lock, [this]() { return !isWorking; });
+}
+
+bool DispatchQueue::IsFinished()
+{
+    std::lock_guard<std::mutex> guard(queueMutex);
+    return fns.empty() && !isWorking;
+}
+
+void DispatchQueue::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;) {
+        queueCondition.wait(lock, [this]() { return !fns.empty() || isStopping; });
+        if (fns.empty()) {
+            // Only on isStopping, with nothing left to run:
+            return;
+        }
+        DispatchFn fn = std::move(fns.front());
+        fns.pop();
+        isWorking = true;
+        lock.unlock();
+        fn();
+        lock.lock();
+        isWorking = false;
+        if (fns.empty()) {
+            finishCondition.notify_all();
+        }
+    }
+}
+
+} // namespace Qrack
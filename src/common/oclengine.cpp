@@ -10,6 +10,9 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 
@@ -51,13 +54,20 @@ const std::vector<OCLKernelHandle> OCLEngine::kernelHandles = {
     OCLKernelHandle(OCL_API_APPLY2X2_SINGLE_WIDE, "apply2x2singlewide"),
     OCLKernelHandle(OCL_API_APPLY2X2_NORM_SINGLE_WIDE, "apply2x2normsinglewide"),
     OCLKernelHandle(OCL_API_APPLY2X2_DOUBLE_WIDE, "apply2x2doublewide"),
+    OCLKernelHandle(OCL_API_APPLY2X2_BATCH, "apply2x2batch"),
     OCLKernelHandle(OCL_API_UNIFORMLYCONTROLLED, "uniformlycontrolled"),
     OCLKernelHandle(OCL_API_X_SINGLE, "xsingle"),
     OCLKernelHandle(OCL_API_X_SINGLE_WIDE, "xsinglewide"),
+    OCLKernelHandle(OCL_API_X_MASK, "xmask"),
     OCLKernelHandle(OCL_API_Z_SINGLE, "zsingle"),
     OCLKernelHandle(OCL_API_Z_SINGLE_WIDE, "zsinglewide"),
+    OCLKernelHandle(OCL_API_PHASE_SINGLE, "phasesingle"),
+    OCLKernelHandle(OCL_API_PHASE_SINGLE_WIDE, "phasesinglewide"),
+    OCLKernelHandle(OCL_API_INVERT_SINGLE, "invertsingle"),
+    OCLKernelHandle(OCL_API_INVERT_SINGLE_WIDE, "invertsinglewide"),
     OCLKernelHandle(OCL_API_COMPOSE, "compose"),
     OCLKernelHandle(OCL_API_COMPOSE_WIDE, "compose"),
+    OCLKernelHandle(OCL_API_COMPOSE_SLICE, "composeslice"),
     OCLKernelHandle(OCL_API_COMPOSE_MID, "composemid"),
     OCLKernelHandle(OCL_API_DECOMPOSEPROB, "decomposeprob"),
     OCLKernelHandle(OCL_API_DECOMPOSEAMP, "decomposeamp"),
@@ -79,11 +89,14 @@ const std::vector<OCLKernelHandle> OCLEngine::kernelHandles = {
     OCLKernelHandle(OCL_API_INDEXEDLDA, "indexedLda"),
     OCLKernelHandle(OCL_API_INDEXEDADC, "indexedAdc"),
     OCLKernelHandle(OCL_API_INDEXEDSBC, "indexedSbc"),
+    OCLKernelHandle(OCL_API_INDEXEDCMP, "indexedCmp"),
     OCLKernelHandle(OCL_API_HASH, "hash"),
     OCLKernelHandle(OCL_API_APPROXCOMPARE, "approxcompare"),
     OCLKernelHandle(OCL_API_NORMALIZE, "nrmlze"),
     OCLKernelHandle(OCL_API_NORMALIZE_WIDE, "nrmlzewide"),
     OCLKernelHandle(OCL_API_UPDATENORM, "updatenorm"),
+    OCLKernelHandle(OCL_API_NONZERO_COUNT, "nonzerocount"),
+    OCLKernelHandle(OCL_API_COMPACT_SPARSE, "compactsparse"),
     OCLKernelHandle(OCL_API_APPLYM, "applym"),
     OCLKernelHandle(OCL_API_APPLYMREG, "applymreg"),
     OCLKernelHandle(OCL_API_PHASEFLIP, "phaseflip"),
@@ -107,6 +120,30 @@ const std::vector<OCLKernelHandle> OCLEngine::kernelHandles = {
 
 const std::string OCLEngine::binary_file_prefix("qrack_ocl_dev_");
 const std::string OCLEngine::binary_file_ext(".ir");
+const std::string OCLEngine::tuning_file_prefix("qrack_ocl_tune_");
+const std::string OCLEngine::tuning_file_ext(".cfg");
+
+// FNV-1a, over the kernel sources that are actually compiled in, so that cached binaries are invalidated whenever the
+// kernels (or the precision headers selected at build time) change.
+static unsigned long long HashKernelSource(const unsigned char* src, unsigned int len, unsigned long long hash)
+{
+    for (unsigned int i = 0; i < len; i++) {
+        hash ^= (unsigned long long)src[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Device names and driver version strings can contain characters that are not safe in file names.
+static std::string SanitizeCacheKey(std::string key)
+{
+    for (size_t i = 0; i < key.size(); i++) {
+        if (!isalnum(key[i]) && (key[i] != '.') && (key[i] != '-')) {
+            key[i] = '_';
+        }
+    }
+    return key;
+}
 
 std::vector<DeviceContextPtr> OCLEngine::GetDeviceContextPtrVector() { return all_device_contexts; }
 void OCLEngine::SetDeviceContextPtrVector(std::vector<DeviceContextPtr> vec, DeviceContextPtr dcp)
@@ -119,11 +156,139 @@ void OCLEngine::SetDeviceContextPtrVector(std::vector<DeviceContextPtr> vec, Dev
 
 void OCLEngine::SetDefaultDeviceContext(DeviceContextPtr dcp) { default_device_context = dcp; }
 
+void* OCLEngine::AllocPinned(DeviceContextPtr devCntxt, size_t byteCount)
+{
+    cl_int error;
+    std::shared_ptr<cl::Buffer> buffer = std::make_shared<cl::Buffer>(
+        devCntxt->context, CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_WRITE, byteCount, (void*)NULL, &error);
+    if (error != CL_SUCCESS) {
+        return NULL;
+    }
+
+    // The mapping is held for the lifetime of the allocation, so the host pointer stays stable, and driver copies
+    // between this memory and device memory run at pinned (DMA) speeds.
+    void* toRet = devCntxt->queue.enqueueMapBuffer(
+        *buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, byteCount, NULL, NULL, &error);
+    if (error != CL_SUCCESS) {
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> pinnedLock(pinned_mutex);
+    pinned_allocs[toRet] = PinnedAlloc{ buffer, devCntxt };
+
+    return toRet;
+}
+
+std::shared_ptr<cl::Buffer> OCLEngine::GetPinnedBuffer(void* ptr)
+{
+    std::lock_guard<std::mutex> pinnedLock(pinned_mutex);
+    std::map<void*, PinnedAlloc>::iterator it = pinned_allocs.find(ptr);
+    if (it == pinned_allocs.end()) {
+        return NULL;
+    }
+    return it->second.buffer;
+}
+
+bool OCLEngine::FreePinned(void* ptr)
+{
+    PinnedAlloc pinned;
+    {
+        std::lock_guard<std::mutex> pinnedLock(pinned_mutex);
+        std::map<void*, PinnedAlloc>::iterator it = pinned_allocs.find(ptr);
+        if (it == pinned_allocs.end()) {
+            return false;
+        }
+        pinned = it->second;
+        pinned_allocs.erase(it);
+    }
+
+    cl::Event unmapEvent;
+    pinned.devCntxt->queue.enqueueUnmapMemObject(*(pinned.buffer), ptr, NULL, &unmapEvent);
+    unmapEvent.wait();
+
+    return true;
+}
+
+// Staging chunk for cross-context buffer migration, (4 MiB, well past PCIe transfer ramp-up, but small enough that
+// double-buffering overlap starts almost immediately).
+#define OCL_MIGRATE_CHUNK_BYTES ((size_t)(1U << 22U))
+
+void OCLEngine::MigrateBuffer(DeviceContextPtr srcCntxt, std::shared_ptr<cl::Buffer> srcBuffer,
+    DeviceContextPtr destCntxt, std::shared_ptr<cl::Buffer> destBuffer, size_t byteCount)
+{
+    if (srcCntxt->context_id == destCntxt->context_id) {
+        // Same context, (same platform): a single on-platform copy, peer-to-peer where the driver supports it.
+        cl::Event copyEvent;
+        srcCntxt->queue.enqueueCopyBuffer(*srcBuffer, *destBuffer, 0, 0, byteCount, NULL, &copyEvent);
+        copyEvent.wait();
+        return;
+    }
+
+    // Cross-context: stream through two host staging chunks, so the read of the next chunk from the source device
+    // overlaps the write of the current chunk to the destination device, and no full-size host copy is ever
+    // materialized. Staging is pinned by the source driver when it permits, so the source leg runs at DMA speed;
+    // the destination leg streams from the same stable, mapped host memory.
+    size_t chunkBytes = OCL_MIGRATE_CHUNK_BYTES;
+    if (chunkBytes > byteCount) {
+        chunkBytes = byteCount;
+    }
+
+    void* stage[2];
+    bool isPinned[2];
+    for (int p = 0; p < 2; p++) {
+        stage[p] = AllocPinned(srcCntxt, chunkBytes);
+        isPinned[p] = (stage[p] != NULL);
+        if (!isPinned[p]) {
+            stage[p] = (void*)new unsigned char[chunkBytes];
+        }
+    }
+
+    size_t chunkCount = (byteCount + chunkBytes - 1U) / chunkBytes;
+    cl::Event readEvents[2], writeEvents[2];
+    bool writePending[2] = { false, false };
+
+    srcCntxt->queue.enqueueReadBuffer(*srcBuffer, CL_FALSE, 0, chunkBytes, stage[0], NULL, &(readEvents[0]));
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        int p = i & 1U;
+        size_t offset = i * chunkBytes;
+        size_t sz = ((offset + chunkBytes) > byteCount) ? (byteCount - offset) : chunkBytes;
+
+        readEvents[p].wait();
+
+        // Kick off the next read into the other staging chunk, as soon as its previous write has drained:
+        if ((i + 1U) < chunkCount) {
+            int q = (i + 1U) & 1U;
+            if (writePending[q]) {
+                writeEvents[q].wait();
+                writePending[q] = false;
+            }
+            size_t nOffset = (i + 1U) * chunkBytes;
+            size_t nSz = ((nOffset + chunkBytes) > byteCount) ? (byteCount - nOffset) : chunkBytes;
+            srcCntxt->queue.enqueueReadBuffer(*srcBuffer, CL_FALSE, nOffset, nSz, stage[q], NULL, &(readEvents[q]));
+        }
+
+        destCntxt->queue.enqueueWriteBuffer(*destBuffer, CL_FALSE, offset, sz, stage[p], NULL, &(writeEvents[p]));
+        writePending[p] = true;
+    }
+
+    for (int p = 0; p < 2; p++) {
+        if (writePending[p]) {
+            writeEvents[p].wait();
+        }
+        if (isPinned[p]) {
+            FreePinned(stage[p]);
+        } else {
+            delete[](unsigned char*) stage[p];
+        }
+    }
+}
+
 OCLEngine::OCLEngine(OCLEngine const&) {}
 OCLEngine& OCLEngine::operator=(OCLEngine const& rhs) { return *this; }
 
-cl::Program OCLEngine::MakeProgram(
-    bool buildFromSource, cl::Program::Sources sources, std::string path, std::shared_ptr<OCLDeviceContext> devCntxt)
+cl::Program OCLEngine::MakeProgram(bool buildFromSource, cl::Program::Sources sources, std::string path,
+    std::shared_ptr<OCLDeviceContext> devCntxt, bool* loadedBinary)
 {
     FILE* clBinFile;
     cl::Program program;
@@ -159,6 +324,9 @@ cl::Program OCLEngine::MakeProgram(
                           << std::endl;
             } else {
                 std::cout << "Loaded binary from: " << path << std::endl;
+                if (loadedBinary) {
+                    *loadedBinary = true;
+                }
             }
         }
     }
@@ -198,6 +366,11 @@ void OCLEngine::SaveBinary(cl::Program program, std::string path, std::string fi
     }
 
     FILE* clBinFile = fopen((path + fileName).c_str(), "w");
+    if (!clBinFile) {
+        std::cout << "Binary error: Could not write to " << (path + fileName) << ". (Skipping cache save.)"
+                  << std::endl;
+        return;
+    }
 #if defined(__APPLE__) || (defined(_WIN32) && !defined(__CYGWIN__))
     std::vector<char*> clBinaries = program.getInfo<CL_PROGRAM_BINARIES>();
     char* clBinary = clBinaries[clBinIndex];
@@ -210,6 +383,123 @@ void OCLEngine::SaveBinary(cl::Program program, std::string path, std::string fi
     fclose(clBinFile);
 }
 
+void OCLEngine::LoadTuning(DeviceContextPtr devCntxt, std::string path)
+{
+    FILE* tuneFile = fopen(path.c_str(), "r");
+    if (!tuneFile) {
+        return;
+    }
+
+    int api;
+    unsigned long gs;
+    while (fscanf(tuneFile, "%d %lu", &api, &gs) == 2) {
+        if ((api > OCL_API_UNKNOWN) && (api <= OCL_API_IFULLADD) && (gs > 0)) {
+            devCntxt->SetPreferredGroupSize((OCLAPI)api, (size_t)gs);
+        }
+    }
+    fclose(tuneFile);
+
+    std::cout << "Loaded kernel tuning from: " << path << std::endl;
+}
+
+void OCLEngine::SaveTuning(DeviceContextPtr devCntxt, std::string home)
+{
+    if (home == "*") {
+        home = GetDefaultBinaryPath();
+    }
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    _mkdir(home.c_str());
+#else
+    mkdir(home.c_str(), 0700);
+#endif
+
+    int devIndex = -1;
+    for (unsigned int i = 0; i < all_device_contexts.size(); i++) {
+        if (all_device_contexts[i] == devCntxt) {
+            devIndex = i;
+            break;
+        }
+    }
+    if (devIndex < 0) {
+        return;
+    }
+
+    std::string path = home + tuning_file_prefix + std::to_string(devIndex) + tuning_file_ext;
+    FILE* tuneFile = fopen(path.c_str(), "w");
+    if (!tuneFile) {
+        return;
+    }
+
+    std::map<OCLAPI, size_t> sizes = devCntxt->GetPreferredGroupSizes();
+    for (std::map<OCLAPI, size_t>::iterator it = sizes.begin(); it != sizes.end(); it++) {
+        fprintf(tuneFile, "%d %lu\n", (int)it->first, (unsigned long)it->second);
+    }
+    fclose(tuneFile);
+}
+
+void OCLEngine::AddKernelProfileSample(
+    OCLAPI call, cl_ulong queueNs, cl_ulong submitNs, cl_ulong runNs, cl_ulong byteCount)
+{
+    std::lock_guard<std::mutex> guard(profile_mutex);
+    OCLKernelProfile& profile = kernel_profiles[call];
+    profile.callCount++;
+    profile.queueNs += queueNs;
+    profile.submitNs += submitNs;
+    profile.runNs += runNs;
+    profile.byteCount += byteCount;
+}
+
+std::map<OCLAPI, OCLKernelProfile> OCLEngine::GetKernelProfiles()
+{
+    std::lock_guard<std::mutex> guard(profile_mutex);
+    return kernel_profiles;
+}
+
+void OCLEngine::ResetKernelProfiles()
+{
+    std::lock_guard<std::mutex> guard(profile_mutex);
+    kernel_profiles.clear();
+}
+
+void OCLEngine::DumpKernelProfiles(std::ostream& os)
+{
+    std::map<OCLAPI, OCLKernelProfile> profiles = GetKernelProfiles();
+
+    // Busiest kernels first, by total execution time:
+    std::vector<std::pair<OCLAPI, OCLKernelProfile>> rows(profiles.begin(), profiles.end());
+    std::sort(rows.begin(), rows.end(),
+        [](const std::pair<OCLAPI, OCLKernelProfile>& l, const std::pair<OCLAPI, OCLKernelProfile>& r) {
+            return l.second.runNs > r.second.runNs;
+        });
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << std::left << std::setw(28) << "kernel" << std::right << std::setw(10) << "calls" << std::setw(14)
+       << "queue (ms)" << std::setw(14) << "submit (ms)" << std::setw(14) << "run (ms)" << std::setw(14) << "MB"
+       << std::endl;
+
+    for (unsigned int i = 0; i < rows.size(); i++) {
+        std::string name = std::to_string((int)rows[i].first);
+        for (unsigned int j = 0; j < kernelHandles.size(); j++) {
+            if (kernelHandles[j].oclapi == rows[i].first) {
+                name = kernelHandles[j].kernelname;
+                break;
+            }
+        }
+
+        const OCLKernelProfile& profile = rows[i].second;
+        os << std::left << std::setw(28) << name << std::right << std::setw(10) << profile.callCount << std::fixed
+           << std::setprecision(3) << std::setw(14) << (profile.queueNs / 1000000.0) << std::setw(14)
+           << (profile.submitNs / 1000000.0) << std::setw(14) << (profile.runNs / 1000000.0) << std::setw(14)
+           << (profile.byteCount / 1048576.0) << std::endl;
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
 void OCLEngine::InitOCL(bool buildFromSource, bool saveBinaries, std::string home)
 {
 
@@ -265,14 +555,21 @@ void OCLEngine::InitOCL(bool buildFromSource, bool saveBinaries, std::string hom
     // create the programs that we want to execute on the devices
     cl::Program::Sources sources;
 
+    unsigned long long srcHash = 0xcbf29ce484222325ULL;
+// (qheader_half.cl provides a half-precision amplitude header, but it is not selected here until QEngineOCL's host
+// staging paths convert gate matrices and reduction buffers to and from half.)
 #if ENABLE_PURE32
     sources.push_back({ (const char*)qheader32_cl, (long unsigned int)qheader32_cl_len });
+    srcHash = HashKernelSource(qheader32_cl, qheader32_cl_len, srcHash);
 #elif ENABLE_COMPLEX8
     sources.push_back({ (const char*)qheader_float_cl, (long unsigned int)qheader_float_cl_len });
+    srcHash = HashKernelSource(qheader_float_cl, qheader_float_cl_len, srcHash);
 #else
     sources.push_back({ (const char*)qheader_double_cl, (long unsigned int)qheader_double_cl_len });
+    srcHash = HashKernelSource(qheader_double_cl, qheader_double_cl_len, srcHash);
 #endif
     sources.push_back({ (const char*)qengine_cl, (long unsigned int)qengine_cl_len });
+    srcHash = HashKernelSource(qengine_cl, qengine_cl_len, srcHash);
 
     int plat_id = -1;
     std::vector<cl::Context> all_contexts;
@@ -286,11 +583,17 @@ void OCLEngine::InitOCL(bool buildFromSource, bool saveBinaries, std::string hom
         std::shared_ptr<OCLDeviceContext> devCntxt = std::make_shared<OCLDeviceContext>(
             devPlatVec[i], all_devices[i], all_contexts[all_contexts.size() - 1], plat_id);
 
-        std::string fileName = binary_file_prefix + std::to_string(i) + binary_file_ext;
+        // Binaries are cached per device model and driver, keyed also by a hash of the kernel sources, so that a
+        // driver update or a change to the kernels transparently invalidates the cache instead of loading a stale
+        // (or incompatible) binary.
+        std::string devKey = SanitizeCacheKey(
+            all_devices[i].getInfo<CL_DEVICE_NAME>() + "_" + all_devices[i].getInfo<CL_DRIVER_VERSION>());
+        std::string fileName = binary_file_prefix + devKey + "_" + std::to_string(srcHash) + binary_file_ext;
         std::string clBinName = home + fileName;
 
         std::cout << "Device #" << i << ", ";
-        cl::Program program = MakeProgram(buildFromSource, sources, clBinName, devCntxt);
+        bool loadedBinary = false;
+        cl::Program program = MakeProgram(buildFromSource, sources, clBinName, devCntxt, &loadedBinary);
 
         cl_int buildError = program.build({ all_devices[i] }, "-cl-denorms-are-zero -cl-fast-relaxed-math");
         if (buildError != CL_SUCCESS) {
@@ -318,11 +621,15 @@ void OCLEngine::InitOCL(bool buildFromSource, bool saveBinaries, std::string hom
             all_dev_contexts[i]->mutexes.emplace(kernelHandles[j].oclapi, new std::mutex);
         }
 
-        if (saveBinaries) {
+        // If this process had to JIT compile, cache the result, so only the first process on a node ever compiles.
+        // (Identical devices later in the list share the key and load the binary saved here.)
+        if (saveBinaries || !loadedBinary) {
             std::cout << "OpenCL program #" << i << ", ";
             SaveBinary(program, home, fileName);
         }
 
+        LoadTuning(devCntxt, home + tuning_file_prefix + std::to_string(i) + tuning_file_ext);
+
         if (i == dev) {
             default_dev_context = all_dev_contexts[i];
             default_platform = all_platforms[plat_id];
@@ -16,61 +16,213 @@
 #include <future>
 #include <math.h>
 
-#if ENABLE_UINT128
-#include <mutex>
-#endif
-
 #include "common/parallel_for.hpp"
+#include "common/threadpool.hpp"
 
-#if ENABLE_UINT128
-#define DECLARE_ATOMIC_BITCAPINT()                                                                                     \
-    std::mutex idxLock;                                                                                                \
-    bitCapInt idx;
-#define ATOMIC_ASYNC(...)                                                                                              \
-    std::async(std::launch::async, [__VA_ARGS__, &idxLock]()
-#define ATOMIC_INC()                                                                                                   \
-    idxLock.lock();                                                                                                    \
-    i = idx++;                                                                                                         \
-    idxLock.unlock();
-#else
-#define DECLARE_ATOMIC_BITCAPINT() std::atomic<bitCapIntOcl> idx;
+// A lock-free 64-bit block counter suffices even for the big-integer builds: each claimed unit is a whole PSTRIDE
+// block of iterations, so the counter could only wrap past (2^64 * PSTRIDE) total iterations, and each worker
+// derives its wide (bitCapInt) index from the claimed block locally.
+#define DECLARE_ATOMIC_BITCAPINT() std::atomic<uint64_t> idx;
 #define ATOMIC_ASYNC(...)                                                                                              \
-    std::async(std::launch::async, [__VA_ARGS__]()
-#define ATOMIC_INC() i = idx++;
-#endif
+    ThreadPool::Instance()->Dispatch([__VA_ARGS__]()
+#define ATOMIC_INC() i = (bitCapInt)idx++;
 
 namespace Qrack {
 
+ConcurrencyBudget* ConcurrencyBudget::m_pInstance = NULL;
+
+ConcurrencyBudget* ConcurrencyBudget::Instance()
+{
+    if (!m_pInstance) {
+        m_pInstance = new ConcurrencyBudget();
+    }
+    return m_pInstance;
+}
+
+ConcurrencyBudget::ConcurrencyBudget()
+    : activeWeight(0)
+{
+}
+
+int32_t ConcurrencyBudget::Acquire(const int32_t& numCores, const uint64_t& weight)
+{
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    activeWeight += weight;
+    if (weight >= activeWeight) {
+        // This loop is the only one registered; it gets the whole budget.
+        return numCores;
+    }
+    int32_t share = (int32_t)(((uint64_t)numCores * weight) / activeWeight);
+    if (share < 1) {
+        share = 1;
+    }
+    return share;
+}
+
+void ConcurrencyBudget::Release(const uint64_t& weight)
+{
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    activeWeight -= weight;
+}
+
+namespace {
+// Cap registered weights so that the proportional share multiplication above can't overflow 64 bits, (which the
+// big-integer builds' item counts otherwise could). Ratios between loops this wide and anything narrower saturate
+// anyway.
+const uint64_t MAX_BUDGET_WEIGHT = ((uint64_t)1U << 48U);
+
+// Scope guard holding one loop's registration with the shared ConcurrencyBudget, for the span of its dispatch.
+struct BudgetedCores {
+    int32_t cores;
+    uint64_t weight;
+
+    BudgetedCores(const int32_t numCores, const bitCapInt itemCount)
+        : weight((itemCount > (bitCapInt)MAX_BUDGET_WEIGHT) ? MAX_BUDGET_WEIGHT : (uint64_t)itemCount)
+    {
+        cores = ConcurrencyBudget::Instance()->Acquire(numCores, weight);
+    }
+    ~BudgetedCores() { ConcurrencyBudget::Instance()->Release(weight); }
+};
+} // namespace
+
+/*
+ * Body of par_for_inc, specialized over a narrow native index type. Iteration counters, stride math, and the shared
+ * (lock-free) work counter all run in "IterInt" machine words, and indexes only widen to bitCapInt at the gate
+ * closure boundary. (With the 128-bit build, the generic path claims PSTRIDE blocks from a lock-free
+ * std::atomic<uint64_t> counter and widens to bitCapInt per worker, but still pays the wide stride math per
+ * iteration, which QUnit's many small shards would feel.)
+ */
+template <typename IterInt>
+void par_for_inc_t(const int32_t numCores, const bitCapInt begin, const IterInt itemCount, IncrementFunc inc,
+    ParallelFunc fn, const IterInt stride)
+{
+    if (ThreadPool::IsPoolThread()) {
+        // We're already inside a pool task; blocking on more pool tasks could deadlock, so run inline.
+        for (IterInt j = 0; j < itemCount; j++) {
+            fn(inc(begin + j, 0), 0);
+        }
+        return;
+    }
+
+    if (itemCount <= (IterInt)numCores) {
+        std::vector<std::future<void>> futures((size_t)itemCount);
+        uint32_t cpu;
+        for (cpu = 0; cpu < itemCount; cpu++) {
+            IterInt j = cpu;
+            futures[cpu] = ThreadPool::Instance()->Dispatch([j, cpu, begin, inc, fn]() { fn(inc(begin + j, cpu), cpu); });
+        }
+        for (cpu = 0; cpu < itemCount; cpu++) {
+            futures[cpu].get();
+        }
+    } else if ((itemCount / stride) < (IterInt)numCores) {
+        IterInt parStride = itemCount / (IterInt)numCores;
+        IterInt remainder = itemCount - (parStride * (IterInt)numCores);
+        std::vector<std::future<void>> futures(numCores);
+        int32_t cpu, count;
+        IterInt offset = 0;
+        for (cpu = 0; cpu < numCores; cpu++) {
+            IterInt workUnit = parStride;
+            if (remainder > 0) {
+                workUnit++;
+                remainder--;
+            }
+            futures[cpu] = ThreadPool::Instance()->Dispatch([cpu, workUnit, offset, begin, inc, fn]() {
+                for (IterInt j = 0; j < workUnit; j++) {
+                    fn(inc(begin + (offset + j), cpu), cpu);
+                }
+            });
+            offset += workUnit;
+        }
+        count = cpu;
+        for (cpu = 0; cpu < count; cpu++) {
+            futures[cpu].get();
+        }
+    } else {
+        std::atomic<IterInt> idx;
+        idx = 0;
+        std::vector<std::future<void>> futures(numCores);
+        for (int cpu = 0; cpu < numCores; cpu++) {
+            futures[cpu] = ThreadPool::Instance()->Dispatch([cpu, &idx, begin, itemCount, stride, inc, fn]() {
+                IterInt i, j, l;
+                IterInt k = 0;
+                for (;;) {
+                    i = idx++;
+                    l = i * stride;
+                    for (j = 0; j < stride; j++) {
+                        k = j + l;
+                        /* Easiest to clamp on end. */
+                        if (k >= itemCount) {
+                            break;
+                        }
+                        fn(inc(begin + k, cpu), cpu);
+                    }
+                    if (k >= itemCount) {
+                        break;
+                    }
+                }
+            });
+        }
+
+        for (int cpu = 0; cpu < numCores; cpu++) {
+            futures[cpu].get();
+        }
+    }
+}
+
 /*
  * Iterate through the permutations a maximum of end-begin times, allowing the
  * caller to control the incrementation offset through 'inc'.
  */
-void ParallelFor::par_for_inc(const bitCapInt begin, const bitCapInt itemCount, IncrementFunc inc, ParallelFunc fn)
+void ParallelFor::par_for_inc(
+    const bitCapInt begin, const bitCapInt itemCount, IncrementFunc inc, ParallelFunc fn, const bitCapInt stride)
 {
-    if (itemCount <= (bitCapInt)numCores) {
+    // Pool-thread re-entry runs inline, (checked below and in par_for_inc_t,) so it registers no weight.
+    BudgetedCores budget(numCores, ThreadPool::IsPoolThread() ? 0 : itemCount);
+
+    // Narrow native counters cover any range whose item count fits them. (QUnit keeps most shards tiny, so the
+    // narrowest specialization is the common case.)
+    if ((itemCount >> 31U) == 0) {
+        par_for_inc_t<uint32_t>(budget.cores, begin, (uint32_t)itemCount, inc, fn, (uint32_t)stride);
+        return;
+    }
+#if ENABLE_UINT128
+    if ((itemCount >> 63U) == 0) {
+        par_for_inc_t<uint64_t>(budget.cores, begin, (uint64_t)itemCount, inc, fn, (uint64_t)stride);
+        return;
+    }
+#endif
+    if (ThreadPool::IsPoolThread()) {
+        // We're already inside a pool task; blocking on more pool tasks could deadlock, so run inline.
+        for (bitCapInt j = 0; j < itemCount; j++) {
+            fn(inc(begin + j, 0), 0);
+        }
+        return;
+    }
+
+    if (itemCount <= (bitCapInt)budget.cores) {
         std::vector<std::future<void>> futures((bitCapIntOcl)itemCount);
         bitCapInt j;
         uint32_t cpu;
         for (cpu = 0; cpu < itemCount; cpu++) {
             j = begin + cpu;
-            futures[cpu] = std::async(std::launch::async, [j, cpu, inc, fn]() { fn(inc(j, cpu), cpu); });
+            futures[cpu] = ThreadPool::Instance()->Dispatch([j, cpu, inc, fn]() { fn(inc(j, cpu), cpu); });
         }
         for (cpu = 0; cpu < itemCount; cpu++) {
             futures[cpu].get();
         }
-    } else if ((itemCount / PSTRIDE) < (bitCapInt)numCores) {
-        bitCapInt parStride = itemCount / (bitCapInt)numCores;
-        bitCapInt remainder = itemCount - (parStride * numCores);
-        std::vector<std::future<void>> futures(numCores);
+    } else if ((itemCount / stride) < (bitCapInt)budget.cores) {
+        bitCapInt parStride = itemCount / (bitCapInt)budget.cores;
+        bitCapInt remainder = itemCount - (parStride * budget.cores);
+        std::vector<std::future<void>> futures(budget.cores);
         int32_t cpu, count;
         bitCapInt offset = begin;
-        for (cpu = 0; cpu < numCores; cpu++) {
+        for (cpu = 0; cpu < budget.cores; cpu++) {
             bitCapInt workUnit = parStride;
             if (remainder > 0) {
                 workUnit++;
                 remainder--;
             }
-            futures[cpu] = std::async(std::launch::async, [cpu, workUnit, offset, inc, fn]() {
+            futures[cpu] = ThreadPool::Instance()->Dispatch([cpu, workUnit, offset, inc, fn]() {
                 for (bitCapInt j = 0; j < workUnit; j++) {
                     fn(inc(offset + j, cpu), cpu);
                 }
@@ -84,15 +236,16 @@ void ParallelFor::par_for_inc(const bitCapInt begin, const bitCapInt itemCount,
     } else {
         DECLARE_ATOMIC_BITCAPINT();
         idx = 0;
-        std::vector<std::future<void>> futures(numCores);
-        for (int cpu = 0; cpu < numCores; cpu++) {
-            futures[cpu] = ATOMIC_ASYNC(cpu, &idx, begin, itemCount, inc, fn)
+        std::vector<std::future<void>> futures(budget.cores);
+        for (int cpu = 0; cpu < budget.cores; cpu++) {
+            futures[cpu] = ATOMIC_ASYNC(cpu, &idx, begin, itemCount, stride, inc, fn)
             {
-                bitCapInt i, j, k, l;
+                bitCapInt i, j, l;
+                bitCapInt k = 0;
                 for (;;) {
                     ATOMIC_INC();
-                    l = i * PSTRIDE;
-                    for (j = 0; j < PSTRIDE; j++) {
+                    l = i * stride;
+                    for (j = 0; j < stride; j++) {
                         k = j + l;
                         /* Easiest to clamp on end. */
                         if (k >= itemCount) {
@@ -107,7 +260,7 @@ void ParallelFor::par_for_inc(const bitCapInt begin, const bitCapInt itemCount,
             });
         }
 
-        for (int cpu = 0; cpu < numCores; cpu++) {
+        for (int cpu = 0; cpu < budget.cores; cpu++) {
             futures[cpu].get();
         }
     }
@@ -232,7 +385,15 @@ void ParallelFor::par_for_mask(
             return i;
         };
 
-        par_for_inc(begin, (end - begin) >> maskLen, incFn, fn);
+        // When the largest mask power exceeds a whole work block, each block pairs amplitudes separated by a huge
+        // stride, and PSTRIDE-sized claims bounce every worker between distant cache tiles and TLB entries. Claiming
+        // square-of-PSTRIDE tiles instead turns each claim into one pass over matched low- and high-half tiles,
+        // (L2-sized, at the default PSTRIDE of 64,) visiting both halves of every pair within the tiles before
+        // moving on.
+        const bitCapInt blockedStride = (bitCapInt)PSTRIDE * (bitCapInt)PSTRIDE;
+        bitCapInt stride = (maskArray[maskLen - 1] > blockedStride) ? blockedStride : (bitCapInt)PSTRIDE;
+
+        par_for_inc(begin, (end - begin) >> maskLen, incFn, fn, stride);
     }
 
     for (bitLenInt i = 0; i < maskLen; i++) {
@@ -241,16 +402,141 @@ void ParallelFor::par_for_mask(
     delete[] masks;
 }
 
+/*
+ * Body of par_norm, specialized over a narrow native index type, on the same pattern as par_for_inc_t above.
+ */
+template <typename IterInt>
+real1 par_norm_t(const int32_t numCores, const IterInt maxQPower, const StateVectorPtr stateArray, real1 norm_thresh)
+{
+    real1 nrmSqr = 0;
+    if (ThreadPool::IsPoolThread()) {
+        // We're already inside a pool task; blocking on more pool tasks could deadlock, so run inline.
+        real1 nrm;
+        for (IterInt j = 0; j < maxQPower; j++) {
+            nrm = norm(stateArray->read(j));
+            if (nrm >= norm_thresh) {
+                nrmSqr += nrm;
+            }
+        }
+        return nrmSqr;
+    }
+
+    if (maxQPower <= (IterInt)numCores) {
+        std::vector<std::future<real1>> futures((size_t)maxQPower);
+        uint32_t cpu;
+        for (cpu = 0; cpu < maxQPower; cpu++) {
+            IterInt j = cpu;
+            futures[cpu] = ThreadPool::Instance()->Dispatch([j, stateArray, &norm_thresh]() {
+                real1 nrm = norm(stateArray->read(j));
+                if (nrm < norm_thresh) {
+                    nrm = ZERO_R1;
+                }
+                return nrm;
+            });
+        }
+        for (cpu = 0; cpu < maxQPower; cpu++) {
+            nrmSqr += futures[cpu].get();
+        }
+    } else if ((maxQPower / PSTRIDE) < (IterInt)numCores) {
+        IterInt parStride = maxQPower / (IterInt)numCores;
+        IterInt remainder = maxQPower - (parStride * (IterInt)numCores);
+        std::vector<std::future<real1>> futures(numCores);
+        int32_t cpu, count;
+        IterInt offset = 0;
+        for (cpu = 0; cpu < numCores; cpu++) {
+            IterInt workUnit = parStride;
+            if (remainder > 0) {
+                workUnit++;
+                remainder--;
+            }
+            futures[cpu] = ThreadPool::Instance()->Dispatch([workUnit, offset, stateArray, &norm_thresh]() {
+                real1 result = 0.0;
+                real1 nrm;
+                for (IterInt j = 0; j < workUnit; j++) {
+                    nrm = norm(stateArray->read(offset + j));
+                    if (nrm >= norm_thresh) {
+                        result += nrm;
+                    }
+                }
+                return result;
+            });
+            offset += workUnit;
+        }
+        count = cpu;
+        for (cpu = 0; cpu < count; cpu++) {
+            nrmSqr += futures[cpu].get();
+        }
+    } else {
+        std::atomic<IterInt> idx;
+        idx = 0;
+        std::vector<std::future<real1>> futures(numCores);
+        for (int cpu = 0; cpu != numCores; ++cpu) {
+            futures[cpu] = ThreadPool::Instance()->Dispatch([&idx, maxQPower, stateArray, &norm_thresh]() {
+                real1 sqrNorm = 0.0;
+                real1 nrm;
+                IterInt i, j;
+                IterInt k = 0;
+                for (;;) {
+                    i = idx++;
+                    for (j = 0; j < (IterInt)PSTRIDE; j++) {
+                        k = i * (IterInt)PSTRIDE + j;
+                        if (k >= maxQPower)
+                            break;
+
+                        nrm = norm(stateArray->read(k));
+                        if (nrm >= norm_thresh) {
+                            sqrNorm += nrm;
+                        }
+                    }
+                    if (k >= maxQPower)
+                        break;
+                }
+                return sqrNorm;
+            });
+        }
+
+        for (int32_t cpu = 0; cpu != numCores; ++cpu) {
+            nrmSqr += futures[cpu].get();
+        }
+    }
+
+    return nrmSqr;
+}
+
 real1 ParallelFor::par_norm(const bitCapInt maxQPower, const StateVectorPtr stateArray, real1 norm_thresh)
 {
+    // Pool-thread re-entry runs inline, (checked below and in par_norm_t,) so it registers no weight.
+    BudgetedCores budget(numCores, ThreadPool::IsPoolThread() ? 0 : maxQPower);
+
+    if ((maxQPower >> 31U) == 0) {
+        return par_norm_t<uint32_t>(budget.cores, (uint32_t)maxQPower, stateArray, norm_thresh);
+    }
+#if ENABLE_UINT128
+    if ((maxQPower >> 63U) == 0) {
+        return par_norm_t<uint64_t>(budget.cores, (uint64_t)maxQPower, stateArray, norm_thresh);
+    }
+#endif
+
     real1 nrmSqr = 0;
-    if (maxQPower <= (bitCapInt)numCores) {
+    if (ThreadPool::IsPoolThread()) {
+        // We're already inside a pool task; blocking on more pool tasks could deadlock, so run inline.
+        real1 nrm;
+        for (bitCapInt j = 0; j < maxQPower; j++) {
+            nrm = norm(stateArray->read(j));
+            if (nrm >= norm_thresh) {
+                nrmSqr += nrm;
+            }
+        }
+        return nrmSqr;
+    }
+
+    if (maxQPower <= (bitCapInt)budget.cores) {
         std::vector<std::future<real1>> futures((bitCapIntOcl)maxQPower);
         bitCapInt j;
         uint32_t cpu;
         for (cpu = 0; cpu < maxQPower; cpu++) {
             j = cpu;
-            futures[cpu] = std::async(std::launch::async, [j, stateArray, &norm_thresh]() {
+            futures[cpu] = ThreadPool::Instance()->Dispatch([j, stateArray, &norm_thresh]() {
                 real1 nrm = norm(stateArray->read(j));
                 if (nrm < norm_thresh) {
                     nrm = ZERO_R1;
@@ -261,19 +547,19 @@ real1 ParallelFor::par_norm(const bitCapInt maxQPower, const StateVectorPtr stat
         for (cpu = 0; cpu < maxQPower; cpu++) {
             nrmSqr += futures[cpu].get();
         }
-    } else if ((maxQPower / PSTRIDE) < (bitCapInt)numCores) {
-        bitCapInt parStride = maxQPower / numCores;
-        bitCapInt remainder = maxQPower - (parStride * numCores);
-        std::vector<std::future<real1>> futures(numCores);
+    } else if ((maxQPower / PSTRIDE) < (bitCapInt)budget.cores) {
+        bitCapInt parStride = maxQPower / budget.cores;
+        bitCapInt remainder = maxQPower - (parStride * budget.cores);
+        std::vector<std::future<real1>> futures(budget.cores);
         int32_t cpu, count;
         bitCapInt offset = 0;
-        for (cpu = 0; cpu < numCores; cpu++) {
+        for (cpu = 0; cpu < budget.cores; cpu++) {
             bitCapInt workUnit = parStride;
             if (remainder > 0) {
                 workUnit++;
                 remainder--;
             }
-            futures[cpu] = std::async(std::launch::async, [workUnit, offset, stateArray, &norm_thresh]() {
+            futures[cpu] = ThreadPool::Instance()->Dispatch([workUnit, offset, stateArray, &norm_thresh]() {
                 real1 result = 0.0;
                 real1 nrm;
                 for (bitCapInt j = 0; j < workUnit; j++) {
@@ -293,8 +579,8 @@ real1 ParallelFor::par_norm(const bitCapInt maxQPower, const StateVectorPtr stat
     } else {
         DECLARE_ATOMIC_BITCAPINT();
         idx = 0;
-        std::vector<std::future<real1>> futures(numCores);
-        for (int cpu = 0; cpu != numCores; ++cpu) {
+        std::vector<std::future<real1>> futures(budget.cores);
+        for (int cpu = 0; cpu != budget.cores; ++cpu) {
             futures[cpu] = ATOMIC_ASYNC(&idx, maxQPower, stateArray, &norm_thresh)
             {
                 real1 sqrNorm = 0.0;
@@ -320,7 +606,7 @@ real1 ParallelFor::par_norm(const bitCapInt maxQPower, const StateVectorPtr stat
             });
         }
 
-        for (int32_t cpu = 0; cpu != numCores; ++cpu) {
+        for (int32_t cpu = 0; cpu != budget.cores; ++cpu) {
             nrmSqr += futures[cpu].get();
         }
     }
@@ -60,6 +60,19 @@ inline real1 arg(const cmplx cmp)
     bitCapInt lcv, i;                                                                \
     bitCapInt Nthreads = get_global_size(0);
 
+#define PREP_PHASE_2X2()                                                             \
+    bitCapInt lcv, i;                                                                \
+    bitCapInt Nthreads = get_global_size(0);                                         \
+    cmplx topLeft = vload2(0, cmplxPtr);                                             \
+    cmplx bottomRight = vload2(3, cmplxPtr);
+
+#define PREP_INVERT_2X2()                                                            \
+    bitCapInt lcv, i;                                                                \
+    bitCapInt Nthreads = get_global_size(0);                                         \
+    cmplx topRight = vload2(1, cmplxPtr);                                            \
+    cmplx bottomLeft = vload2(2, cmplxPtr);                                          \
+    cmplx Y0;
+
 #define PUSH_APART_GEN()                                                             \
     iHigh = lcv;                                                                     \
     i = 0U;                                                                          \
@@ -97,6 +110,19 @@ inline real1 arg(const cmplx cmp)
 #define APPLY_Z()                                                                    \
     stateVec[i | OFFSET2_ARG] = -stateVec[i | OFFSET2_ARG];
 
+#define APPLY_PHASE()                                                                \
+    if ((topLeft.x != ONE_R1) || (topLeft.y != ZERO_R1)) {                           \
+        stateVec[i] = zmul(topLeft, stateVec[i]);                                    \
+    }                                                                                \
+    if ((bottomRight.x != ONE_R1) || (bottomRight.y != ZERO_R1)) {                   \
+        stateVec[i | OFFSET2_ARG] = zmul(bottomRight, stateVec[i | OFFSET2_ARG]);    \
+    }
+
+#define APPLY_INVERT()                                                               \
+    Y0 = stateVec[i];                                                                \
+    stateVec[i] = zmul(topRight, stateVec[i | OFFSET2_ARG]);                         \
+    stateVec[i | OFFSET2_ARG] = zmul(bottomLeft, Y0);
+
 #define SUM_2X2()                                                                    \
     locID = get_local_id(0);                                                         \
     locNthreads = get_local_size(0);                                                 \
@@ -248,6 +274,69 @@ void kernel apply2x2normsinglewide(global cmplx* stateVec, constant real1* cmplx
     SUM_2X2();
 }
 
+// Each work item owns the 2^blockQubits amplitudes spanned by the batch's distinct qubit powers, so a short program
+// of single-qubit gates applies with one read and one write of each amplitude, in one kernel launch. The private
+// block size must be (1 << GATE_BATCH_MAX_QUBITS), from qengine_opencl.hpp. After the blockQubits sorted powers,
+// "qPowers" carries each gate's stride within the private block, in application order.
+void kernel apply2x2batch(global cmplx* stateVec, constant cmplx* mtrxs, constant bitCapInt* bitCapIntPtr, constant bitCapInt* qPowers)
+{
+    bitCapInt Nthreads, lcv;
+
+    Nthreads = get_global_size(0);
+    bitCapInt maxI = bitCapIntPtr[0];
+    bitCapInt gateCount = bitCapIntPtr[1];
+    bitCapInt blockQubits = bitCapIntPtr[2];
+    bitCapInt blockPower = ONE_BCI << blockQubits;
+
+    cmplx amps[16];
+    cmplx Y0;
+    bitCapInt i, iHigh, iLow, j, offset, stride, g;
+    bitLenInt p;
+
+    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
+        iHigh = lcv;
+        i = 0U;
+        for (p = 0U; p < blockQubits; p++) {
+            iLow = iHigh & (qPowers[p] - ONE_BCI);
+            i |= iLow;
+            iHigh = (iHigh ^ iLow) << ONE_BCI;
+        }
+        i |= iHigh;
+
+        for (j = 0U; j < blockPower; j++) {
+            offset = 0U;
+            for (p = 0U; p < blockQubits; p++) {
+                if (j & (ONE_BCI << p)) {
+                    offset |= qPowers[p];
+                }
+            }
+            amps[j] = stateVec[i | offset];
+        }
+
+        for (g = 0U; g < gateCount; g++) {
+            stride = qPowers[blockQubits + g];
+            for (j = 0U; j < blockPower; j++) {
+                if (j & stride) {
+                    continue;
+                }
+                Y0 = amps[j];
+                amps[j] = zmul(mtrxs[g << 2U], Y0) + zmul(mtrxs[(g << 2U) | 1U], amps[j | stride]);
+                amps[j | stride] = zmul(mtrxs[(g << 2U) | 2U], Y0) + zmul(mtrxs[(g << 2U) | 3U], amps[j | stride]);
+            }
+        }
+
+        for (j = 0U; j < blockPower; j++) {
+            offset = 0U;
+            for (p = 0U; p < blockQubits; p++) {
+                if (j & (ONE_BCI << p)) {
+                    offset |= qPowers[p];
+                }
+            }
+            stateVec[i | offset] = amps[j];
+        }
+    }
+}
+
 void kernel xsingle(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
 {
     PREP_SPECIAL_2X2();
@@ -271,6 +360,26 @@ void kernel xsinglewide(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr
     APPLY_X();
 }
 
+void kernel xmask(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
+{
+    bitCapInt Nthreads, lcv;
+
+    Nthreads = get_global_size(0);
+    bitCapInt maxI = bitCapIntPtr[0];
+    bitCapInt mask = bitCapIntPtr[1];
+
+    bitCapInt otherRes;
+    cmplx Y0;
+    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
+        otherRes = lcv ^ mask;
+        if (lcv < otherRes) {
+            Y0 = stateVec[lcv];
+            stateVec[lcv] = stateVec[otherRes];
+            stateVec[otherRes] = Y0;
+        }
+    }
+}
+
 void kernel zsingle(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
 {
     PREP_Z_2X2();
@@ -294,6 +403,52 @@ void kernel zsinglewide(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr
     APPLY_Z();
 }
 
+void kernel phasesingle(global cmplx* stateVec, constant real1* cmplxPtr, constant bitCapInt* bitCapIntPtr)
+{
+    PREP_PHASE_2X2();
+
+    bitCapInt qMask = bitCapIntPtr[3];
+
+    for (lcv = ID; lcv < MAXI_ARG; lcv += Nthreads) {
+        PUSH_APART_1();
+        APPLY_PHASE();
+    }
+}
+
+void kernel phasesinglewide(global cmplx* stateVec, constant real1* cmplxPtr, constant bitCapInt* bitCapIntPtr)
+{
+    PREP_PHASE_2X2();
+
+    bitCapInt qMask = bitCapIntPtr[2];
+
+    lcv = ID;
+    PUSH_APART_1();
+    APPLY_PHASE();
+}
+
+void kernel invertsingle(global cmplx* stateVec, constant real1* cmplxPtr, constant bitCapInt* bitCapIntPtr)
+{
+    PREP_INVERT_2X2();
+
+    bitCapInt qMask = bitCapIntPtr[3];
+
+    for (lcv = ID; lcv < MAXI_ARG; lcv += Nthreads) {
+        PUSH_APART_1();
+        APPLY_INVERT();
+    }
+}
+
+void kernel invertsinglewide(global cmplx* stateVec, constant real1* cmplxPtr, constant bitCapInt* bitCapIntPtr)
+{
+    PREP_INVERT_2X2();
+
+    bitCapInt qMask = bitCapIntPtr[2];
+
+    lcv = ID;
+    PUSH_APART_1();
+    APPLY_INVERT();
+}
+
 void kernel uniformlycontrolled(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant bitCapInt* qPowers, constant cmplx4* mtrxs, constant real1* nrmIn, global real1* nrmParts, local real1* lProbBuffer)
 {
     bitCapInt Nthreads, lcv, locID, locNthreads;
@@ -316,8 +471,23 @@ void kernel uniformlycontrolled(global cmplx* stateVec, constant bitCapInt* bitC
 
     bitCapInt i, offset;
     bitCapInt j, jHigh, jLow, p;
+    bitCapInt iter, iterPow;
+
+    // Per-thread blocks are visited in Gray-code order of the iteration index, so successive iterations flip a
+    // single high address bit; control permutations change one bit at a time, and the previous matrix fetch mostly
+    // survives in the constant cache. (The iteration count is rounded up to a power of two, over which the Gray
+    // reflection is a bijection, and any out-of-range index is skipped.)
+    iterPow = ONE_BCI;
+    while ((iterPow * Nthreads) < maxI) {
+        iterPow <<= ONE_BCI;
+    }
+
+    for (iter = 0U; iter < iterPow; iter++) {
+        lcv = ID + ((iter ^ (iter >> ONE_BCI)) * Nthreads);
+        if (lcv >= maxI) {
+            continue;
+        }
 
-    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
         i = lcv & targetMask;
         i |= (lcv ^ i) << ONE_BCI;
 
@@ -396,6 +566,27 @@ void kernel composewide(global cmplx* stateVec1, global cmplx* stateVec2, consta
     nStateVec[lcv] = zmul(stateVec1[lcv & args.z], stateVec2[(lcv & args.w) >> args.y]);
 }
 
+void kernel composeslice(global cmplx* stateVec1, global cmplx* stateVec2, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec)
+{
+    bitCapInt Nthreads, lcv, i;
+
+    Nthreads = get_global_size(0);
+
+    bitCapInt4 args = vload4(0, bitCapIntPtr);
+    // For reference:
+    //bitCapInt sliceLen = args.x;
+    //bitCapInt qubitCount = args.y;
+    //bitCapInt startMask = args.z;
+    //bitCapInt endMask = args.w;
+    bitCapInt offset = bitCapIntPtr[4];
+
+    // The same mapping as "compose," restricted to the output slice fed by one already-transferred tile of stateVec2:
+    for (lcv = ID; lcv < args.x; lcv += Nthreads) {
+        i = lcv + offset;
+        nStateVec[i] = zmul(stateVec1[i & args.z], stateVec2[(i & args.w) >> args.y]);
+    }
+}
+
 void kernel composemid(global cmplx* stateVec1, global cmplx* stateVec2, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec)
 {
     bitCapInt Nthreads, lcv;
@@ -1170,46 +1361,46 @@ void kernel div(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global
     }
 }
 
-// The conditional in the body of kernel loop would majorly hurt performance:
-#define MODNOUT(indexIn, indexOut)                                                                       \
+// The out register is |0> going forward, (or holds the map image going in reverse,) so each source/target pair
+// straddles the out==0 subspace and the amplitude moves in place, with no nStateVec materialization:
+#define MODNOUT(indexSrc, indexDest)                                                                     \
     bitCapInt Nthreads, lcv;                                                                             \
                                                                                                          \
     Nthreads = get_global_size(0);                                                                       \
     bitCapInt maxI = bitCapIntPtr[0];                                                                    \
     bitCapInt toMul = bitCapIntPtr[1];                                                                   \
     bitCapInt inMask = bitCapIntPtr[2];                                                                  \
-    bitCapInt outMask = bitCapIntPtr[3];                                                                 \
-    bitCapInt otherMask = bitCapIntPtr[4];                                                               \
     bitCapInt len = bitCapIntPtr[5];                                                                     \
-    bitCapInt lowMask = (ONE_BCI << len) - ONE_BCI;                                                      \
     bitCapInt inStart = bitCapIntPtr[6];                                                                 \
     bitCapInt outStart = bitCapIntPtr[7];                                                                \
     bitCapInt skipMask = bitCapIntPtr[8];                                                                \
     bitCapInt modN = bitCapIntPtr[9];                                                                    \
-    bitCapInt otherRes, inRes, outRes;                                                                   \
+    bitCapInt inRes, outRes;                                                                             \
     bitCapInt i, iHigh, iLow;                                                                            \
     for (lcv = ID; lcv < maxI; lcv += Nthreads) {                                                        \
         iHigh = lcv;                                                                                     \
         iLow = iHigh & skipMask;                                                                         \
         i = iLow | (iHigh ^ iLow) << len;                                                                \
                                                                                                          \
-        otherRes = i & otherMask;                                                                        \
         inRes = i & inMask;                                                                              \
         outRes = (((inRes >> inStart) * toMul) % modN) << outStart;                                      \
-        nStateVec[indexOut] = stateVec[indexIn];                                                         \
+        if (outRes) {                                                                                    \
+            stateVec[indexDest] = stateVec[indexSrc];                                                    \
+            stateVec[indexSrc] = (cmplx)(ZERO_R1, ZERO_R1);                                              \
+        }                                                                                                \
     }
 
-void kernel mulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec)
+void kernel mulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
 {
-    MODNOUT(i, (inRes | outRes | otherRes));
+    MODNOUT(i, (i | outRes));
 }
 
-void kernel imulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec)
+void kernel imulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
 {
-    MODNOUT((inRes | outRes | otherRes), i);
+    MODNOUT((i | outRes), i);
 }
 
-void kernel powmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec)
+void kernel powmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr)
 {
     bitCapInt Nthreads, lcv;
 
@@ -1217,22 +1408,18 @@ void kernel powmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr,
     bitCapInt maxI = bitCapIntPtr[0];
     bitCapInt base = bitCapIntPtr[1];
     bitCapInt inMask = bitCapIntPtr[2];
-    bitCapInt outMask = bitCapIntPtr[3];
-    bitCapInt otherMask = bitCapIntPtr[4];
     bitCapInt len = bitCapIntPtr[5];
-    bitCapInt lowMask = (ONE_BCI << len) - ONE_BCI;
     bitCapInt inStart = bitCapIntPtr[6];
     bitCapInt outStart = bitCapIntPtr[7];
     bitCapInt skipMask = bitCapIntPtr[8];
     bitCapInt modN = bitCapIntPtr[9];
-    bitCapInt otherRes, inRes, outRes, inInt;
+    bitCapInt inRes, outRes, inInt;
     bitCapInt i, iHigh, iLow, powRes, pw;
     for (lcv = ID; lcv < maxI; lcv += Nthreads) {
         iHigh = lcv;
         iLow = iHigh & skipMask;
         i = iLow | (iHigh ^ iLow) << len;
 
-        otherRes = i & otherMask;
         inRes = i & inMask;
         inInt = inRes >> inStart;
 
@@ -1245,8 +1432,10 @@ void kernel powmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr,
         }
 
         outRes = (powRes % modN) << outStart;
-
-        nStateVec[inRes | outRes | otherRes] = stateVec[i];
+        if (outRes) {
+            stateVec[i | outRes] = stateVec[i];
+            stateVec[i] = (cmplx)(ZERO_R1, ZERO_R1);
+        }
     }
 }
 
@@ -1496,8 +1685,9 @@ void kernel cdiv(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, globa
     }
 }
 
-// The conditional in the body of kernel loop would majorly hurt performance:
-#define CMODNOUT(indexIn, indexOut)                                                                      \
+// The amplitudes move in place within the all-controls-on subspace of stateVec, and every partial-control subspace
+// is simply left untouched, so there is no nStateVec and no CMOD_FINISH() subspace copying:
+#define CMODNOUT(indexSrc, indexDest)                                                                    \
     bitCapInt Nthreads, lcv;                                                                             \
                                                                                                          \
     Nthreads = get_global_size(0);                                                                       \
@@ -1506,43 +1696,39 @@ void kernel cdiv(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, globa
     bitCapInt controlLen = bitCapIntPtr[2];                                                              \
     bitCapInt controlMask = bitCapIntPtr[3];                                                             \
     bitCapInt inMask = bitCapIntPtr[4];                                                                  \
-    bitCapInt outMask = bitCapIntPtr[5];                                                                 \
     bitCapInt modN = bitCapIntPtr[6];                                                                    \
     bitCapInt len = bitCapIntPtr[7];                                                                     \
-    bitCapInt lowMask = (ONE_BCI << len) - ONE_BCI;                                                      \
     bitCapInt inStart = bitCapIntPtr[8];                                                                 \
     bitCapInt outStart = bitCapIntPtr[9];                                                                \
                                                                                                          \
-    bitCapInt otherMask = (maxI - ONE_BCI) ^ (inMask | outMask | controlMask);                           \
     maxI >>= (controlLen + len);                                                                         \
                                                                                                          \
-    bitCapInt otherRes, outRes, inRes;                                                                   \
-    bitCapInt i, iHigh, iLow, j;                                                                         \
-    bitLenInt p, k;                                                                                      \
-    bitCapInt partControlMask;                                                                           \
+    bitCapInt outRes, inRes;                                                                             \
+    bitCapInt i, iHigh, iLow;                                                                            \
+    bitLenInt p;                                                                                         \
                                                                                                          \
     for (lcv = ID; lcv < maxI; lcv += Nthreads) {                                                        \
         CMOD_START();                                                                                    \
                                                                                                          \
-        otherRes = i & otherMask;                                                                        \
         inRes = i & inMask;                                                                              \
         outRes = (((inRes >> inStart) * toMul) % modN) << outStart;                                      \
-        nStateVec[indexOut] = stateVec[indexIn];                                                         \
-                                                                                                         \
-        CMOD_FINISH();                                                                                   \
+        if (outRes) {                                                                                    \
+            stateVec[indexDest] = stateVec[indexSrc];                                                    \
+            stateVec[indexSrc] = (cmplx)(ZERO_R1, ZERO_R1);                                              \
+        }                                                                                                \
     }
 
-void kernel cmulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec, constant bitCapInt* controlPowers)
+void kernel cmulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant bitCapInt* controlPowers)
 {
-    CMODNOUT((i | controlMask), (inRes | outRes | otherRes | controlMask));
+    CMODNOUT((i | controlMask), (i | outRes | controlMask));
 }
 
-void kernel cimulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec, constant bitCapInt* controlPowers)
+void kernel cimulmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant bitCapInt* controlPowers)
 {
-    CMODNOUT((inRes | outRes | otherRes | controlMask), (i | controlMask));
+    CMODNOUT((i | outRes | controlMask), (i | controlMask));
 }
 
-void kernel cpowmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec, constant bitCapInt* controlPowers)
+void kernel cpowmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant bitCapInt* controlPowers)
 {
     bitCapInt Nthreads, lcv;
 
@@ -1552,24 +1738,19 @@ void kernel cpowmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr
     bitCapInt controlLen = bitCapIntPtr[2];
     bitCapInt controlMask = bitCapIntPtr[3];
     bitCapInt inMask = bitCapIntPtr[4];
-    bitCapInt outMask = bitCapIntPtr[5];
     bitCapInt modN = bitCapIntPtr[6];
     bitCapInt len = bitCapIntPtr[7];
-    bitCapInt lowMask = (ONE_BCI << len) - ONE_BCI;
     bitCapInt inStart = bitCapIntPtr[8];
     bitCapInt outStart = bitCapIntPtr[9];
 
-    bitCapInt otherMask = (maxI - ONE_BCI) ^ (inMask | outMask | controlMask);
     maxI >>= (controlLen + len);
 
-    bitCapInt otherRes, outRes, inRes, inInt;
-    bitCapInt i, iHigh, iLow, j, powRes, pw;
-    bitLenInt p, k;
-    bitCapInt partControlMask;
+    bitCapInt outRes, inRes, inInt;
+    bitCapInt i, iHigh, iLow, powRes, pw;
+    bitLenInt p;
     for (lcv = ID; lcv < maxI; lcv += Nthreads) {
         CMOD_START();
 
-        otherRes = i & otherMask;
         inRes = i & inMask;
         inInt = inRes >> inStart;
 
@@ -1582,10 +1763,10 @@ void kernel cpowmodnout(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr
         }
 
         outRes = (powRes % modN) << outStart;
-
-        nStateVec[inRes | outRes | otherRes | controlMask] = stateVec[i | controlMask];
-
-        CMOD_FINISH();
+        if (outRes) {
+            stateVec[i | outRes | controlMask] = stateVec[i | controlMask];
+            stateVec[i | controlMask] = (cmplx)(ZERO_R1, ZERO_R1);
+        }
     }
 }
 
@@ -1705,6 +1886,38 @@ void kernel indexedSbc(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr,
     }
 }
 
+void kernel indexedCmp(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant bitLenInt* values)
+{
+    bitCapInt Nthreads, lcv;
+
+    Nthreads = get_global_size(0);
+    bitCapInt maxI = bitCapIntPtr[0];
+    bitCapInt inputStart = bitCapIntPtr[1];
+    bitCapInt inputMask = bitCapIntPtr[2];
+    bitCapInt greaterPerm = bitCapIntPtr[3];
+    bitCapInt carryMask = bitCapIntPtr[4];
+    bitCapInt valueBytes = bitCapIntPtr[5];
+    bitCapInt inputInt, value;
+    bitCapInt i, iLow, iHigh, j;
+    cmplx amp;
+    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
+        iHigh = lcv;
+        iLow = iHigh & (carryMask - ONE_BCI);
+        i = iLow | ((iHigh ^ iLow) << ONE_BCI);
+
+        inputInt = (i & inputMask) >> inputStart;
+        value = 0U;
+        for (j = 0U; j < valueBytes; j++) {
+            value |= values[inputInt * valueBytes + j] << (8U * j);
+        }
+        if (value < greaterPerm) {
+            amp = stateVec[i];
+            stateVec[i] = stateVec[i | carryMask];
+            stateVec[i | carryMask] = amp;
+        }
+    }
+}
+
 void kernel hash(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, global cmplx* nStateVec, constant bitLenInt* values)
 {
     bitCapInt Nthreads, lcv;
@@ -1949,3 +2162,56 @@ void kernel phaseflipifless(global cmplx* stateVec, constant bitCapInt* bitCapIn
             stateVec[lcv] = -stateVec[lcv];
     }
 }
+
+void kernel nonzerocount(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant real1* args_ptr, global bitCapInt* countParts, local bitCapInt* lCountBuffer)
+{
+    bitCapInt Nthreads, lcv, locID, locNthreads;
+
+    Nthreads = get_global_size(0);
+    bitCapInt maxI = bitCapIntPtr[0];
+    real1 norm_thresh = args_ptr[0];
+
+    bitCapInt partCount = 0U;
+    cmplx amp;
+    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
+        amp = stateVec[lcv];
+        if (dot(amp, amp) > norm_thresh) {
+            partCount++;
+        }
+    }
+
+    locID = get_local_id(0);
+    locNthreads = get_local_size(0);
+    lCountBuffer[locID] = partCount;
+
+    for (lcv = (locNthreads >> ONE_BCI); lcv > 0U; lcv >>= ONE_BCI) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (locID < lcv) {
+            lCountBuffer[locID] += lCountBuffer[locID + lcv];
+        }
+    }
+
+    if (locID == 0U) {
+        countParts[get_group_id(0)] = lCountBuffer[0];
+    }
+}
+
+void kernel compactsparse(global cmplx* stateVec, constant bitCapInt* bitCapIntPtr, constant real1* args_ptr, global bitCapInt* indicesOut, global cmplx* ampsOut, volatile global uint* pairCount)
+{
+    bitCapInt Nthreads, lcv;
+
+    Nthreads = get_global_size(0);
+    bitCapInt maxI = bitCapIntPtr[0];
+    real1 norm_thresh = args_ptr[0];
+
+    cmplx amp;
+    uint outIndex;
+    for (lcv = ID; lcv < maxI; lcv += Nthreads) {
+        amp = stateVec[lcv];
+        if (dot(amp, amp) > norm_thresh) {
+            outIndex = atomic_inc(pairCount);
+            indicesOut[outIndex] = lcv;
+            ampsOut[outIndex] = amp;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+// Half-precision amplitude storage for the kernel set, (the device-side analog of ENABLE_COMPLEX_HALF,) halving
+// state vector footprint and transfer volume on bandwidth-bound kernels like apply2x2single. NOTE: QEngineOCL still
+// stages kernel arguments, (gate matrices and reduction buffers,) as single-precision host "real1"/"complex," so
+// OCLEngine does not select this header yet; doing so first requires half conversion in those host staging paths.
+
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+
+#define cmplx half2
+#define cmplx2 half4
+#define cmplx4 half8
+#define real1 half
+#define ZERO_R1 0.0h
+#define ONE_R1 1.0h
+#define ONE_BCI 1UL
+#define SineShift M_PI_2_H
+#define PI_R1 M_PI_H
+#define min_norm 1e-5h
+#define bitCapInt ulong
+#define bitCapInt2 ulong2
+#define bitCapInt4 ulong4
+#define bitLenInt unsigned char
@@ -0,0 +1,124 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// This is a multithreaded, universal quantum register simulation, allowing
+// (nonphysical) register cloning and direct measurement of probability and
+// phase, to leverage what advantages classical emulation of qubits can have.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include "common/threadpool.hpp"
+
+#if ENABLE_NUMA && defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Qrack {
+
+ThreadPool* ThreadPool::m_pInstance = NULL;
+
+namespace {
+thread_local bool isWorkerThread = false;
+}
+
+ThreadPool* ThreadPool::Instance()
+{
+    if (!m_pInstance) {
+        m_pInstance = new ThreadPool();
+    }
+    return m_pInstance;
+}
+
+bool ThreadPool::IsPoolThread() { return isWorkerThread; }
+
+ThreadPool::ThreadPool()
+    : dispatchIndex(0)
+    , isStopping(false)
+{
+    unsigned int workerCount = std::thread::hardware_concurrency();
+    if (workerCount == 0) {
+        workerCount = 1;
+    }
+
+    for (unsigned int w = 0; w < workerCount; w++) {
+        queues.emplace_back(new std::deque<std::function<void()>>());
+    }
+    for (unsigned int w = 0; w < workerCount; w++) {
+        workers.emplace_back([this, w]() { Worker(w); });
+#if ENABLE_NUMA && defined(__linux__)
+        // Pin each worker to one hardware thread, so that first-touched state vector pages stay on the NUMA node of
+        // the worker that touched them, instead of migrating behind the scheduler's back.
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(w % workerCount, &cpuSet);
+        pthread_setaffinity_np(workers[w].native_handle(), sizeof(cpu_set_t), &cpuSet);
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        isStopping = true;
+    }
+    poolCondition.notify_all();
+    for (unsigned int w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+}
+
+void ThreadPool::Push(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        queues[dispatchIndex % queues.size()]->push_front(task);
+        dispatchIndex++;
+    }
+    poolCondition.notify_one();
+}
+
+bool ThreadPool::Pop(const unsigned int w, std::function<void()>& task)
+{
+    // Caller holds poolMutex. Drain our own deque from the front, first:
+    if (!queues[w]->empty()) {
+        task = std::move(queues[w]->front());
+        queues[w]->pop_front();
+        return true;
+    }
+    // Otherwise, steal from the back of a sibling's deque:
+    for (unsigned int i = 1; i < queues.size(); i++) {
+        const unsigned int victim = (w + i) % queues.size();
+        if (!queues[victim]->empty()) {
+            task = std::move(queues[victim]->back());
+            queues[victim]->pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Worker(const unsigned int w)
+{
+    isWorkerThread = true;
+    std::function<void()> task;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+            while (!Pop(w, task)) {
+                if (isStopping) {
+                    return;
+                }
+                poolCondition.wait(lock);
+            }
+        }
+        task();
+        task = NULL;
+    }
+}
+
+} // namespace Qrack
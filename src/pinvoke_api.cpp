@@ -473,6 +473,35 @@ MICROSOFT_QUANTUM_DECL unsigned num_qubits(_In_ unsigned sid)
     return (unsigned)simulators[sid]->GetQubitCount();
 }
 
+#if ENABLE_QSTATS
+/**
+ * (External API) Report the simulator's hot-path instrumentation counters. (Only available when the library is built
+ * with the ENABLE_QSTATS CMake option.)
+ */
+MICROSOFT_QUANTUM_DECL void GetStats(_In_ unsigned sid, size_t* gateSweeps, size_t* fusionHits,
+    size_t* separationTries, size_t* separationHits, unsigned* maxShardWidth)
+{
+    SIMULATOR_LOCK_GUARD(sid)
+
+    QInterfaceStats stats = simulators[sid]->GetStats();
+    *gateSweeps = stats.apply2x2Count;
+    *fusionHits = stats.fusionHits;
+    *separationTries = stats.separationTries;
+    *separationHits = stats.separationHits;
+    *maxShardWidth = (unsigned)stats.maxShardWidth;
+}
+
+/**
+ * (External API) Zero the simulator's hot-path instrumentation counters.
+ */
+MICROSOFT_QUANTUM_DECL void ResetStats(_In_ unsigned sid)
+{
+    SIMULATOR_LOCK_GUARD(sid)
+
+    simulators[sid]->ResetStats();
+}
+#endif
+
 /**
  * (External API) "X" Gate
  */
@@ -561,6 +590,102 @@ MICROSOFT_QUANTUM_DECL void AdjT(_In_ unsigned sid, _In_ unsigned q)
     simulator->T(shards[simulator][q]);
 }
 
+/**
+ * (External API) Apply a batch of encoded gates in a single native call. "opcodes," "targets," and "controlLens" each
+ * have "n" elements. The "controls" array is consumed in order, "controlLens[i]" entries per gate, and any gate with a
+ * nonzero control count is applied as its controlled variant. Gates with the "GateMtrx" opcode consume 8 doubles from
+ * "matrices," (a row-major 2x2 operator, as alternating real and imaginary components). This amortizes the interop
+ * crossing and simulator lock of the single-gate entry points over the whole batch, and it decodes to the same
+ * phase/invert fast path calls, (with the same adjoint convention as the single-gate entry points).
+ */
+MICROSOFT_QUANTUM_DECL void ApplyGateBatch(_In_ unsigned sid, _In_ unsigned n, _In_reads_(n) unsigned* opcodes,
+    _In_reads_(n) unsigned* targets, _In_reads_(n) unsigned* controlLens, unsigned* controls, double* matrices)
+{
+    SIMULATOR_LOCK_GUARD(sid)
+
+    const complex hGate[4] = { complex(M_SQRT1_2, ZERO_R1), complex(M_SQRT1_2, ZERO_R1), complex(M_SQRT1_2, ZERO_R1),
+        complex(-M_SQRT1_2, ZERO_R1) };
+
+    QInterfacePtr simulator = simulators[sid];
+    std::vector<bitLenInt> ctrlsArray;
+    unsigned* ctrl = controls;
+    double* mtrxComps = matrices;
+
+    for (unsigned i = 0; i < n; i++) {
+        bitLenInt target = shards[simulator][targets[i]];
+        unsigned controlLen = controlLens[i];
+
+        ctrlsArray.resize(controlLen);
+        for (unsigned j = 0; j < controlLen; j++) {
+            ctrlsArray[j] = shards[simulator][ctrl[j]];
+        }
+        ctrl += controlLen;
+
+        complex mtrx[4];
+        if (opcodes[i] == GateMtrx) {
+            for (unsigned j = 0; j < 4; j++) {
+                mtrx[j] = complex((real1)mtrxComps[2 * j], (real1)mtrxComps[(2 * j) + 1]);
+            }
+            mtrxComps += 8;
+        }
+
+        bool isInvert = false;
+        const complex* gateMtrx = NULL;
+        complex top = ONE_CMPLX;
+        complex bottom = ONE_CMPLX;
+        switch (opcodes[i]) {
+        case GateX:
+            isInvert = true;
+            break;
+        case GateY:
+            isInvert = true;
+            top = -I_CMPLX;
+            bottom = I_CMPLX;
+            break;
+        case GateZ:
+            bottom = -ONE_CMPLX;
+            break;
+        case GateH:
+            gateMtrx = hGate;
+            break;
+        case GateS:
+            bottom = -I_CMPLX;
+            break;
+        case GateT:
+            bottom = complex(M_SQRT1_2, -M_SQRT1_2);
+            break;
+        case GateAdjS:
+            bottom = I_CMPLX;
+            break;
+        case GateAdjT:
+            bottom = complex(M_SQRT1_2, M_SQRT1_2);
+            break;
+        case GateMtrx:
+        default:
+            gateMtrx = mtrx;
+            break;
+        }
+
+        if (controlLen == 0) {
+            if (gateMtrx) {
+                simulator->ApplySingleBit(gateMtrx, target);
+            } else if (isInvert) {
+                simulator->ApplySingleInvert(top, bottom, target);
+            } else {
+                simulator->ApplySinglePhase(top, bottom, target);
+            }
+        } else {
+            if (gateMtrx) {
+                simulator->ApplyControlledSingleBit(&(ctrlsArray[0]), controlLen, target, gateMtrx);
+            } else if (isInvert) {
+                simulator->ApplyControlledSingleInvert(&(ctrlsArray[0]), controlLen, target, top, bottom);
+            } else {
+                simulator->ApplyControlledSinglePhase(&(ctrlsArray[0]), controlLen, target, top, bottom);
+            }
+        }
+    }
+}
+
 /**
  * (External API) Controlled "X" Gate
  */
@@ -0,0 +1,214 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QCircuit is a recorded-gate representation of a quantum circuit, layered over
+// QInterface. Gates are buffered as data, peephole-fused at record time, and the
+// fused circuit can then be replayed against any QInterface instance any number of
+// times, paying circuit analysis once instead of per-execution dispatch.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include <cfloat>
+
+#include "qcircuit.hpp"
+
+namespace Qrack {
+
+QCircuitGate::QCircuitGate(const bitLenInt& trgt, const complex* mtrx)
+    : target(trgt)
+    , payloads()
+    , controls()
+{
+    BitOp payload(new complex[4], std::default_delete<complex[]>());
+    std::copy(mtrx, mtrx + 4, payload.get());
+    payloads[0] = payload;
+}
+
+QCircuitGate::QCircuitGate(
+    const bitLenInt& trgt, const complex* mtrx, const std::set<bitLenInt>& ctrls, const bitCapInt& perm)
+    : target(trgt)
+    , payloads()
+    , controls(ctrls)
+{
+    BitOp payload(new complex[4], std::default_delete<complex[]>());
+    std::copy(mtrx, mtrx + 4, payload.get());
+    payloads[perm] = payload;
+}
+
+bool QCircuitGate::CanCombine(QCircuitGatePtr other)
+{
+    return (target == other->target) && (controls == other->controls);
+}
+
+void QCircuitGate::Combine(QCircuitGatePtr other)
+{
+    std::map<bitCapInt, BitOp>::iterator oIt;
+    for (oIt = other->payloads.begin(); oIt != other->payloads.end(); oIt++) {
+        std::map<bitCapInt, BitOp>::iterator pIt = payloads.find(oIt->first);
+        if (pIt == payloads.end()) {
+            // We act as the identity for this permutation, so "other" just passes through.
+            BitOp payload(new complex[4], std::default_delete<complex[]>());
+            std::copy(oIt->second.get(), oIt->second.get() + 4, payload.get());
+            payloads[oIt->first] = payload;
+            continue;
+        }
+
+        // "other" is applied after this gate, so it left-multiplies our payload.
+        complex* left = oIt->second.get();
+        complex* right = pIt->second.get();
+        BitOp product(new complex[4], std::default_delete<complex[]>());
+        product.get()[0] = (left[0] * right[0]) + (left[1] * right[2]);
+        product.get()[1] = (left[0] * right[1]) + (left[1] * right[3]);
+        product.get()[2] = (left[2] * right[0]) + (left[3] * right[2]);
+        product.get()[3] = (left[2] * right[1]) + (left[3] * right[3]);
+
+        // If a matrix component is very close to zero, we assume it's floating-point-error on a composition that has
+        // an exactly 0 component, number theoretically. (If it's not exactly 0 by number theory, it's numerically
+        // negligible, and we're safe.)
+        for (int i = 0; i < 4; i++) {
+            real1 nrm = norm(product.get()[i]);
+            if (nrm < min_norm) {
+                product.get()[i] = complex(ZERO_R1, ZERO_R1);
+            } else if ((ONE_R1 - nrm) < min_norm) {
+                product.get()[i] /= std::sqrt(nrm);
+            }
+        }
+
+        pIt->second = product;
+    }
+
+    // Payloads that composed to the identity, (within floating-point rounding of the composition,) can be dropped from
+    // the map entirely.
+    std::map<bitCapInt, BitOp>::iterator pIt = payloads.begin();
+    while (pIt != payloads.end()) {
+        complex* mtrx = pIt->second.get();
+        if ((norm(mtrx[1]) <= REAL1_EPSILON) && (norm(mtrx[2]) <= REAL1_EPSILON) &&
+            (norm(mtrx[0] - ONE_CMPLX) <= REAL1_EPSILON) && (norm(mtrx[3] - ONE_CMPLX) <= REAL1_EPSILON)) {
+            pIt = payloads.erase(pIt);
+        } else {
+            pIt++;
+        }
+    }
+}
+
+bool QCircuitGate::IsIdentity()
+{
+    // Combine() erases identity payloads, so an empty map is the identity for every control permutation.
+    return payloads.size() == 0;
+}
+
+bool QCircuitGate::IsPhase()
+{
+    std::map<bitCapInt, BitOp>::iterator pIt;
+    for (pIt = payloads.begin(); pIt != payloads.end(); pIt++) {
+        if ((norm(pIt->second.get()[1]) > min_norm) || (norm(pIt->second.get()[2]) > min_norm)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool QCircuitGate::CanPass(QCircuitGatePtr other)
+{
+    // Control qubits act diagonally, so shared controls always commute. The cases that don't, are a target qubit
+    // shared with anything that isn't also diagonal on it:
+    if ((other->controls.find(target) != other->controls.end()) && !IsPhase()) {
+        return false;
+    }
+    if ((controls.find(other->target) != controls.end()) && !other->IsPhase()) {
+        return false;
+    }
+    if (target == other->target) {
+        return IsPhase() && other->IsPhase();
+    }
+
+    return true;
+}
+
+std::unique_ptr<complex[]> QCircuitGate::MakeUniformlyControlledPayload()
+{
+    bitCapInt maxPerm = pow2(controls.size());
+    std::unique_ptr<complex[]> toRet(new complex[4U * (bitCapIntOcl)maxPerm]);
+    for (bitCapInt perm = 0; perm < maxPerm; perm++) {
+        complex* mtrx = toRet.get() + 4U * (bitCapIntOcl)perm;
+        std::map<bitCapInt, BitOp>::iterator pIt = payloads.find(perm);
+        if (pIt == payloads.end()) {
+            mtrx[0] = ONE_CMPLX;
+            mtrx[1] = ZERO_CMPLX;
+            mtrx[2] = ZERO_CMPLX;
+            mtrx[3] = ONE_CMPLX;
+        } else {
+            std::copy(pIt->second.get(), pIt->second.get() + 4, mtrx);
+        }
+    }
+
+    return toRet;
+}
+
+void QCircuit::AppendGate(QCircuitGatePtr nGate)
+{
+    if (nGate->target >= qubitCount) {
+        qubitCount = nGate->target + 1U;
+    }
+    std::set<bitLenInt>::iterator cIt;
+    for (cIt = nGate->controls.begin(); cIt != nGate->controls.end(); cIt++) {
+        if (*cIt >= qubitCount) {
+            qubitCount = *cIt + 1U;
+        }
+    }
+
+    // Commute the new gate backward past everything it passes, and merge it into the first compatible gate it
+    // reaches. (If the merge composes to the identity, the pair cancels out of the circuit entirely.)
+    std::list<QCircuitGatePtr>::reverse_iterator gIt;
+    for (gIt = gates.rbegin(); gIt != gates.rend(); gIt++) {
+        if ((*gIt)->CanCombine(nGate)) {
+            (*gIt)->Combine(nGate);
+            if ((*gIt)->IsIdentity()) {
+                gates.erase(std::next(gIt).base());
+            }
+            return;
+        }
+        if (!(*gIt)->CanPass(nGate)) {
+            break;
+        }
+    }
+
+    gates.push_back(nGate);
+}
+
+void QCircuit::Run(QInterface* qsim)
+{
+    std::list<QCircuitGatePtr>::iterator gIt;
+    for (gIt = gates.begin(); gIt != gates.end(); gIt++) {
+        QCircuitGatePtr gate = *gIt;
+
+        if (gate->controls.size() == 0) {
+            qsim->ApplySingleBit(gate->payloads[0].get(), gate->target);
+            continue;
+        }
+
+        std::vector<bitLenInt> ctrls = gate->GetControlsVector();
+
+        if (gate->payloads.size() == 1U) {
+            bitCapInt perm = gate->payloads.begin()->first;
+            complex* mtrx = gate->payloads.begin()->second.get();
+            if (perm == pow2Mask(ctrls.size())) {
+                qsim->ApplyControlledSingleBit(&(ctrls[0]), ctrls.size(), gate->target, mtrx);
+                continue;
+            }
+            if (perm == 0) {
+                qsim->ApplyAntiControlledSingleBit(&(ctrls[0]), ctrls.size(), gate->target, mtrx);
+                continue;
+            }
+        }
+
+        // Several control permutations with distinct payloads apply in a single sweep, as a uniformly controlled gate.
+        std::unique_ptr<complex[]> mtrxs = gate->MakeUniformlyControlledPayload();
+        qsim->UniformlyControlledSingleBit(&(ctrls[0]), ctrls.size(), gate->target, mtrxs.get());
+    }
+}
+} // namespace Qrack
@@ -17,6 +17,8 @@ namespace Qrack {
 /// "Circular shift left" - shift bits left, and carry last bits.
 void QEngineCPU::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -53,6 +55,8 @@ void QEngineCPU::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
 /// Add integer (without sign)
 void QEngineCPU::INC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -89,6 +93,8 @@ void QEngineCPU::INC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length)
 void QEngineCPU::CINC(
     bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
 {
+    Finish();
+
     if (controlLen == 0) {
         INC(toAdd, inOutStart, length);
         return;
@@ -136,6 +142,8 @@ void QEngineCPU::CINC(
 void QEngineCPU::INCDECC(
     bitCapInt toMod, const bitLenInt& inOutStart, const bitLenInt& length, const bitLenInt& carryIndex)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -181,6 +189,8 @@ void QEngineCPU::INCDECC(
  */
 void QEngineCPU::INCS(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt overflowIndex)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -231,6 +241,8 @@ void QEngineCPU::INCS(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, b
 void QEngineCPU::INCDECSC(
     bitCapInt toMod, const bitLenInt& inOutStart, const bitLenInt& length, const bitLenInt& carryIndex)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -277,6 +289,8 @@ void QEngineCPU::INCDECSC(
 void QEngineCPU::INCDECSC(bitCapInt toMod, const bitLenInt& inOutStart, const bitLenInt& length,
     const bitLenInt& overflowIndex, const bitLenInt& carryIndex)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -322,6 +336,8 @@ void QEngineCPU::INCDECSC(bitCapInt toMod, const bitLenInt& inOutStart, const bi
 void QEngineCPU::MULDIV(const IOFn& inFn, const IOFn& outFn, const bitCapInt& toMul, const bitLenInt& inOutStart,
     const bitLenInt& carryStart, const bitLenInt& length)
 {
+    Finish();
+
     bitCapInt lowMask = pow2Mask(length);
     bitCapInt highMask = lowMask << length;
     bitCapInt inOutMask = lowMask << inOutStart;
@@ -375,6 +391,8 @@ void QEngineCPU::DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart
 void QEngineCPU::CMULDIV(const IOFn& inFn, const IOFn& outFn, const bitCapInt& toMul, const bitLenInt& inOutStart,
     const bitLenInt& carryStart, const bitLenInt& length, const bitLenInt* controls, const bitLenInt controlLen)
 {
+    Finish();
+
     bitCapInt lowMask = pow2Mask(length);
     bitCapInt highMask = lowMask << length;
     bitCapInt inOutMask = lowMask << inOutStart;
@@ -472,27 +490,32 @@ void QEngineCPU::CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStar
 void QEngineCPU::ModNOut(const MFn& kernelFn, const bitCapInt& modN, const bitLenInt& inStart,
     const bitLenInt& outStart, const bitLenInt& length, const bool& inverse)
 {
+    Finish();
+
     bitCapInt lowMask = pow2Mask(length);
     bitCapInt inMask = lowMask << inStart;
-    bitCapInt outMask = lowMask << outStart;
-    bitCapInt otherMask = (maxQPower - ONE_BCI) ^ (inMask | outMask);
 
-    StateVectorPtr nStateVec = AllocStateVec(maxQPower);
-    nStateVec->clear();
-    stateVec->isReadLocked = false;
+    // In place, only the out register's probabilities change:
+    DirtyProbMask(lowMask << outStart);
 
+    // The map pairs each |in, 0> basis state with |in, f(in)>, and the out register starts in |0> going forward, (or
+    // holds f(in) going in reverse,) so every source/target pair straddles the out==0 subspace and the amplitudes can
+    // be moved in place. This replaces the full-size zeroed nStateVec and pointer swap the copying form paid per call.
     par_for_skip(0, maxQPower, pow2(outStart), length, [&](const bitCapInt lcv, const int cpu) {
-        bitCapInt otherRes = lcv & otherMask;
         bitCapInt inRes = lcv & inMask;
         bitCapInt outRes = (kernelFn(inRes >> inStart) % modN) << outStart;
+        if (outRes == 0) {
+            // f(in) == 0: the amplitude is already in its final slot.
+            return;
+        }
         if (inverse) {
-            nStateVec->write(lcv, stateVec->read(inRes | outRes | otherRes));
+            stateVec->write(lcv, stateVec->read(lcv | outRes));
+            stateVec->write(lcv | outRes, ZERO_CMPLX);
         } else {
-            nStateVec->write(inRes | outRes | otherRes, stateVec->read(lcv));
+            stateVec->write(lcv | outRes, stateVec->read(lcv));
+            stateVec->write(lcv, ZERO_CMPLX);
         }
     });
-
-    ResetStateVec(nStateVec);
 }
 
 void QEngineCPU::MULModNOut(bitCapInt toMod, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
@@ -529,58 +552,45 @@ void QEngineCPU::CModNOut(const MFn& kernelFn, const bitCapInt& modN, const bitL
     const bitLenInt& outStart, const bitLenInt& length, const bitLenInt* controls, const bitLenInt& controlLen,
     const bool& inverse)
 {
-    bitCapInt lowPower = pow2(length);
-    bitCapInt lowMask = lowPower - ONE_BCI;
+    Finish();
+
+    bitCapInt lowMask = pow2Mask(length);
     bitCapInt inMask = lowMask << inStart;
-    bitCapInt outMask = lowMask << outStart;
+
+    // In place, only the out register's probabilities change:
+    DirtyProbMask(lowMask << outStart);
 
     bitCapInt* skipPowers = new bitCapInt[controlLen + length];
-    bitCapInt* controlPowers = new bitCapInt[controlLen];
     bitCapInt controlMask = 0;
     for (bitLenInt i = 0; i < controlLen; i++) {
-        controlPowers[i] = pow2(controls[i]);
-        skipPowers[i] = controlPowers[i];
-        controlMask |= controlPowers[i];
+        skipPowers[i] = pow2(controls[i]);
+        controlMask |= skipPowers[i];
     }
     for (bitLenInt i = 0; i < length; i++) {
         skipPowers[i + controlLen] = pow2(outStart + i);
     }
     std::sort(skipPowers, skipPowers + controlLen + length);
 
-    bitCapInt otherMask = (maxQPower - ONE_BCI) ^ (inMask | outMask | controlMask);
-
-    StateVectorPtr nStateVec = AllocStateVec(maxQPower);
-    nStateVec->clear();
-    stateVec->isReadLocked = false;
-
+    // As in ModNOut, the amplitudes move in place between the out==0 subspace and its image, but here only within the
+    // all-controls-on subspace; every partial-control subspace is simply left untouched, where the copying form had to
+    // ferry all of them through nStateVec.
     par_for_mask(0, maxQPower, skipPowers, controlLen + length, [&](const bitCapInt lcv, const int cpu) {
-        bitCapInt otherRes = lcv & otherMask;
         bitCapInt inRes = lcv & inMask;
         bitCapInt outRes = (kernelFn(inRes >> inStart) % modN) << outStart;
-
+        if (outRes == 0) {
+            return;
+        }
+        bitCapInt origRes = lcv | controlMask;
         if (inverse) {
-            nStateVec->write(lcv | controlMask, stateVec->read(inRes | outRes | otherRes | controlMask));
+            stateVec->write(origRes, stateVec->read(origRes | outRes));
+            stateVec->write(origRes | outRes, ZERO_CMPLX);
         } else {
-            nStateVec->write(inRes | outRes | otherRes | controlMask, stateVec->read(lcv | controlMask));
-        }
-        nStateVec->write(lcv, stateVec->read(lcv));
-
-        bitCapInt partControlMask;
-        for (bitCapInt j = ONE_BCI; j < pow2Mask(controlLen); j++) {
-            partControlMask = 0;
-            for (bitLenInt k = 0; k < controlLen; k++) {
-                if ((j >> k) & ONE_BCI) {
-                    partControlMask |= controlPowers[k];
-                }
-            }
-            nStateVec->write(lcv | partControlMask, stateVec->read(lcv | partControlMask));
+            stateVec->write(origRes | outRes, stateVec->read(origRes));
+            stateVec->write(origRes, ZERO_CMPLX);
         }
     });
 
     delete[] skipPowers;
-    delete[] controlPowers;
-
-    ResetStateVec(nStateVec);
 }
 
 void QEngineCPU::CMULModNOut(bitCapInt toMod, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
@@ -624,6 +634,8 @@ void QEngineCPU::CPOWModNOut(bitCapInt toMod, bitCapInt modN, bitLenInt inStart,
 /// Add BCD integer (without sign)
 void QEngineCPU::INCBCD(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -695,6 +707,8 @@ void QEngineCPU::INCBCD(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length)
 void QEngineCPU::INCDECBCDC(
     bitCapInt toMod, const bitLenInt& inOutStart, const bitLenInt& length, const bitLenInt& carryIndex)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -780,8 +794,12 @@ void QEngineCPU::INCDECBCDC(
 bitCapInt QEngineCPU::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
     bitLenInt valueLength, unsigned char* values, bool resetValue)
 {
+    Finish();
+
     if (resetValue) {
+        // SetReg() dispatches gates; wait for them before touching the state vector directly:
         SetReg(valueStart, valueLength, 0);
+        Finish();
     }
 
     bitLenInt valueBytes = (valueLength + 7U) / 8U;
@@ -830,6 +848,8 @@ bitCapInt QEngineCPU::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bi
 bitCapInt QEngineCPU::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
     bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values)
 {
+    Finish();
+
 
     // This a quantum/classical interface method, similar to IndexedLDA.
     // Like IndexedLDA, up to a page of classical memory is loaded based on a quantum mechanically coherent offset by
@@ -846,6 +866,8 @@ bitCapInt QEngineCPU::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bi
         // If the carry is set, we carry 1 in. We always initially clear the carry after testing for carry in.
         carryIn = 1;
         X(carryIndex);
+        // X() dispatches; wait for it before touching the state vector directly:
+        Finish();
     }
 
     // We calloc a new stateVector for output.
@@ -929,6 +951,8 @@ bitCapInt QEngineCPU::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bi
 bitCapInt QEngineCPU::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart,
     bitLenInt valueLength, bitLenInt carryIndex, unsigned char* values)
 {
+    Finish();
+
     // This a quantum/classical interface method, similar to IndexedLDA.
     // Like IndexedLDA, up to a page of classical memory is loaded based on a quantum mechanically coherent offset by
     // the "inputStart" register. Instead of just loading this page superposed into "outputStart," though, its values
@@ -945,6 +969,8 @@ bitCapInt QEngineCPU::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bi
         // If the carry is set, we borrow 1 going in. We always initially clear the carry after testing for borrow in.
         carryIn = 0;
         X(carryIndex);
+        // X() dispatches; wait for it before touching the state vector directly:
+        Finish();
     }
 
     // We calloc a new stateVector for output.
@@ -1027,9 +1053,58 @@ bitCapInt QEngineCPU::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bi
     return (bitCapInt)(average + (ONE_R1 / 2));
 }
 
+/// Flip the carry for each superposed index whose classical table entry is less than "greaterPerm"
+void QEngineCPU::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    Finish();
+
+    // This a quantum/classical interface method, similar to IndexedLDA.
+    // Like IndexedLDA, up to a page of classical memory is addressed by a quantum mechanically coherent offset in the
+    // "indexStart" register. Instead of loading the addressed values into an output register, though, each is compared
+    // against the classical bound "greaterPerm," and the qubit at "carryIndex" is flipped where the value is less.
+    // (This is the borrow of a 6502 CMP against "greaterPerm.") Since the table entry is a classical function of the
+    // index permutation, the load, the comparison, and the carry write fuse into a single in-place sweep, where a
+    // comparison via IndexedLDA()/IndexedADC() plus CPhaseFlipIfLess() would take a full (reallocating) sweep apiece.
+
+    DirtyProbQubit(carryIndex);
+
+    bitLenInt valueBytes = (valueLength + 7U) / 8U;
+    bitCapInt carryMask = pow2(carryIndex);
+    bitCapInt inputMask = bitRegMask(indexStart, indexLength);
+
+    stateVec->isReadLocked = false;
+
+    // Flipping the carry permutes each basis state with its partner across the carry bit, so every work item owns a
+    // pair, swapping in place, with no new state vector allocation:
+    ParallelFunc fn = [&](const bitCapInt lcv, const int cpu) {
+        bitCapIntOcl inputInt = (bitCapIntOcl)((lcv & inputMask) >> indexStart);
+        bitCapInt value = 0;
+        for (bitCapIntOcl j = 0; j < valueBytes; j++) {
+            value |= values[inputInt * valueBytes + j] << (8U * j);
+        }
+        if (value < greaterPerm) {
+            complex amp = stateVec->read(lcv);
+            stateVec->write(lcv, stateVec->read(lcv | carryMask));
+            stateVec->write(lcv | carryMask, amp);
+        }
+    };
+
+    if (stateVec->is_sparse()) {
+        // One base index per pair with any nonzero member, carry bit cleared:
+        par_for_set(CastStateVecSparse()->iterable(carryMask, 0, 0), fn);
+    } else {
+        par_for_skip(0, maxQPower, carryMask, 1, fn);
+    }
+
+    stateVec->isReadLocked = true;
+}
+
 /// Transform a length of qubit register via lookup through a hash table.
 void QEngineCPU::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
 {
+    Finish();
+
     bitLenInt bytes = (length + 7U) / 8U;
     bitCapInt inputMask = bitRegMask(start, length);
 
@@ -1059,6 +1134,8 @@ void QEngineCPU::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
 
 void QEngineCPU::FullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt carryInSumOut, bitLenInt carryOut)
 {
+    Finish();
+
     bitCapInt input1Mask = pow2(inputBit1);
     bitCapInt input2Mask = pow2(inputBit2);
     bitCapInt carryInSumOutMask = pow2(carryInSumOut);
@@ -1067,6 +1144,9 @@ void QEngineCPU::FullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt car
     bitCapInt qPowers[2] = { carryInSumOutMask, carryOutMask };
     std::sort(qPowers, qPowers + 2);
 
+    // In place, only the sum and carry-out bits change:
+    DirtyProbPowers(qPowers, 2);
+
     par_for_mask(0, maxQPower, qPowers, 2, [&](const bitCapInt lcv, const int cpu) {
         // Carry-in, sum bit in
         complex ins0c0 = stateVec->read(lcv);
@@ -1123,6 +1203,8 @@ void QEngineCPU::FullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt car
 
 void QEngineCPU::IFullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt carryInSumOut, bitLenInt carryOut)
 {
+    Finish();
+
     bitCapInt input1Mask = pow2(inputBit1);
     bitCapInt input2Mask = pow2(inputBit2);
     bitCapInt carryInSumOutMask = pow2(carryInSumOut);
@@ -1131,6 +1213,9 @@ void QEngineCPU::IFullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt ca
     bitCapInt qPowers[2] = { carryInSumOutMask, carryOutMask };
     std::sort(qPowers, qPowers + 2);
 
+    // In place, only the sum and carry-out bits change:
+    DirtyProbPowers(qPowers, 2);
+
     par_for_mask(0, maxQPower, qPowers, 2, [&](const bitCapInt lcv, const int cpu) {
         // Carry-in, sum bit out
         complex outs0c0 = stateVec->read(lcv);
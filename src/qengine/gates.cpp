@@ -16,6 +16,11 @@ namespace Qrack {
 
 void QEngineCPU::ApplyM(bitCapInt regMask, bitCapInt result, complex nrm)
 {
+    Finish();
+
+    // Collapse renormalizes every amplitude, so no cached reduction survives.
+    DirtyProbAll();
+
     ParallelFunc fn = [&](const bitCapInt i, const int cpu) {
         if ((i & regMask) == result) {
             stateVec->write(i, nrm * stateVec->read(i));
@@ -33,9 +38,42 @@ void QEngineCPU::ApplyM(bitCapInt regMask, bitCapInt result, complex nrm)
     runningNorm = ONE_R1;
 }
 
+/// Apply X ("not") gate to each bit in "length," starting from bit index "start," in a single sweep
+void QEngineCPU::X(bitLenInt start, bitLenInt length)
+{
+    // One bit keeps the dispatched Apply2x2 special case; the multi-bit gate is the single-sweep permutation, below.
+    if (length < 2U) {
+        if (length == 1U) {
+            X(start);
+        }
+        return;
+    }
+
+    Finish();
+
+    // An X on every bit of the register sends each permutation to its XOR with the register mask, so an n-bit register
+    // is one state vector pass, instead of n.
+    bitCapInt regMask = bitRegMask(start, length);
+
+    StateVectorPtr nStateVec = AllocStateVec(maxQPower);
+    stateVec->isReadLocked = false;
+
+    ParallelFunc fn = [&](const bitCapInt lcv, const int cpu) { nStateVec->write(lcv ^ regMask, stateVec->read(lcv)); };
+
+    if (stateVec->is_sparse()) {
+        par_for_set(CastStateVecSparse()->iterable(), fn);
+    } else {
+        par_for(0, maxQPower, fn);
+    }
+
+    ResetStateVec(nStateVec);
+}
+
 /// Phase flip always - equivalent to Z X Z X on any bit in the QEngineCPU
 void QEngineCPU::PhaseFlip()
 {
+    Finish();
+
     // This gate has no physical consequence. We only enable it for "book-keeping," if the engine is not using global
     // phase offsets.
     if (randGlobalPhase) {
@@ -10,6 +10,8 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
 #include "oclengine.hpp"
@@ -26,6 +28,16 @@ namespace Qrack {
 #define APPLY2X2_WIDE 0x08
 #define APPLY2X2_X 0x10
 #define APPLY2X2_Z 0x20
+#define APPLY2X2_PHASE 0x40
+#define APPLY2X2_INVERT 0x80
+
+// Upper bound on pipelined Compose transfer tiles, to keep per-dispatch overhead negligible:
+#define QRACK_COMPOSE_MAX_TILES 16U
+
+// 1 / QRACK_SPARSE_OCL_DENOM is the maximum nonzero fraction at which GetQuantumState() prefers device-side
+// compaction to a dense transfer. (An (index, amplitude) pair is about twice the size of a dense amplitude, and the
+// deciding count costs one extra on-device sweep.)
+#define QRACK_SPARSE_OCL_DENOM 4U
 
 // These are commonly used emplace patterns, for OpenCL buffer I/O.
 #define DISPATCH_TEMP_WRITE(waitVec, buff, size, array, clEvent)                                                       \
@@ -77,6 +89,11 @@ QEngineOCL::QEngineOCL(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_
     , wait_refs()
     , nrmArray(NULL)
     , unlockHostMem(false)
+    , isBatchReplay(false)
+    , isNormPending(false)
+    , nrmPendingGroups(0)
+    , valuesShadowPower(0)
+    , uniformMtrxCount(0)
 {
     maxQPowerOcl = pow2Ocl(qubitCount);
     InitOCL(devID);
@@ -91,18 +108,28 @@ void QEngineOCL::LockSync(cl_int flags)
     if (stateVec) {
         unlockHostMem = true;
         lockSyncStateBuffer = stateBuffer;
+        queue.enqueueMapBuffer(*lockSyncStateBuffer, CL_TRUE, flags, 0, sizeof(complex) * maxQPowerOcl, NULL);
+        return;
+    }
+
+    unlockHostMem = false;
+    stateVec = AllocStateVec(maxQPowerOcl, true);
+    if (OCLEngine::Instance()->GetPinnedBuffer(stateVec)) {
+        // Pinned staging memory is kept mapped by the OCLEngine singleton, so an explicit read at DMA speed
+        // replaces the pageable copy-and-map round trip, and no separate map call is needed.
+        lockSyncStateBuffer = NULL;
+        queue.enqueueReadBuffer(*stateBuffer, CL_TRUE, 0, sizeof(complex) * maxQPowerOcl, stateVec);
+        return;
+    }
+
+    if (lockSyncFlags & CL_MAP_WRITE) {
+        lockSyncStateBuffer = MakeStateVecBuffer(stateVec);
     } else {
-        unlockHostMem = false;
-        stateVec = AllocStateVec(maxQPowerOcl, true);
-        if (lockSyncFlags & CL_MAP_WRITE) {
-            lockSyncStateBuffer = MakeStateVecBuffer(stateVec);
-        } else {
-            // The OpenCL device will never have to read from this buffer, hence we can set it CL_MEM_WRITE_ONLY
-            lockSyncStateBuffer = std::make_shared<cl::Buffer>(
-                context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(complex) * maxQPowerOcl, stateVec);
-        }
-        WAIT_COPY(*stateBuffer, *lockSyncStateBuffer, sizeof(complex) * maxQPowerOcl);
+        // The OpenCL device will never have to read from this buffer, hence we can set it CL_MEM_WRITE_ONLY
+        lockSyncStateBuffer = std::make_shared<cl::Buffer>(
+            context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(complex) * maxQPowerOcl, stateVec);
     }
+    WAIT_COPY(*stateBuffer, *lockSyncStateBuffer, sizeof(complex) * maxQPowerOcl);
 
     queue.enqueueMapBuffer(*lockSyncStateBuffer, CL_TRUE, flags, 0, sizeof(complex) * maxQPowerOcl, NULL);
 }
@@ -110,6 +137,21 @@ void QEngineOCL::LockSync(cl_int flags)
 void QEngineOCL::UnlockSync()
 {
     EventVecPtr waitVec = ResetWaitEvents();
+
+    if (!unlockHostMem && !lockSyncStateBuffer) {
+        // The lock was staged through pinned memory, which needs no unmap; an explicit write at DMA speed commits
+        // any changes.
+        if (lockSyncFlags & CL_MAP_WRITE) {
+            queue.enqueueWriteBuffer(
+                *stateBuffer, CL_TRUE, 0, sizeof(complex) * maxQPowerOcl, stateVec, waitVec.get());
+        }
+        wait_refs.clear();
+        FreeStateVec();
+        stateVec = NULL;
+        lockSyncFlags = 0;
+        return;
+    }
+
     cl::Event unmapEvent;
     queue.enqueueUnmapMemObject(*lockSyncStateBuffer, stateVec, waitVec.get(), &unmapEvent);
     unmapEvent.wait();
@@ -133,6 +175,8 @@ void QEngineOCL::clFinish(bool doHard)
         return;
     }
 
+    FlushGateBatch();
+
     while (wait_queue_items.size() > 1) {
         device_context->WaitOnAllEvents();
         PopQueue(NULL, CL_COMPLETE);
@@ -193,6 +237,9 @@ size_t QEngineOCL::FixGroupSize(size_t wic, size_t gs)
 
 PoolItemPtr QEngineOCL::GetFreePoolItem()
 {
+    // Any pending batched gates must dispatch (and claim their own pool item) ahead of the caller's kernel:
+    FlushGateBatch();
+
     std::lock_guard<std::mutex> lock(queue_mutex);
 
     while (wait_queue_items.size() >= poolItems.size()) {
@@ -204,6 +251,8 @@ PoolItemPtr QEngineOCL::GetFreePoolItem()
 
 EventVecPtr QEngineOCL::ResetWaitEvents(bool waitQueue)
 {
+    FlushGateBatch();
+
     if (waitQueue) {
         while (wait_queue_items.size() > 1) {
             device_context->WaitOnAllEvents();
@@ -225,7 +274,24 @@ void QEngineOCL::WaitCall(
 void QEngineOCL::QueueCall(
     OCLAPI api_call, size_t workItemCount, size_t localGroupSize, std::vector<BufferPtr> args, size_t localBuffSize)
 {
-    QueueItem item(api_call, workItemCount, localGroupSize, args, localBuffSize);
+    size_t tuningCandidate = 0;
+    size_t tuned = device_context->GetPreferredGroupSize(api_call);
+    if (tuned) {
+        localGroupSize = FixGroupSize(workItemCount, tuned);
+    } else if (OCLEngine::IsTuningEnabled()) {
+        // On first use of a kernel, (per device,) each candidate work-group size is benchmarked on a real dispatch,
+        // then the fastest is adopted and persisted, next to the precompiled binaries.
+        tuningCandidate = device_context->NextTuningCandidate(api_call);
+        if (tuningCandidate == 0) {
+            tuned = device_context->FinishTuning(api_call, localGroupSize);
+            OCLEngine::Instance()->SaveTuning(device_context);
+            localGroupSize = FixGroupSize(workItemCount, tuned);
+        } else {
+            localGroupSize = FixGroupSize(workItemCount, tuningCandidate);
+        }
+    }
+
+    QueueItem item(api_call, workItemCount, localGroupSize, args, localBuffSize, tuningCandidate);
 
     queue_mutex.lock();
     bool isBase = (wait_queue_items.size() == 0);
@@ -246,6 +312,7 @@ void QEngineOCL::PopQueue(cl_event event, cl_int type)
 {
     queue_mutex.lock();
 
+    QueueItem item = wait_queue_items.front();
     wait_queue_items.pop_front();
 
     poolItems.front()->probArray = NULL;
@@ -261,6 +328,44 @@ void QEngineOCL::PopQueue(cl_event event, cl_int type)
 
     queue_mutex.unlock();
 
+    if (item.tuningCandidate) {
+        cl_ulong tStart = 0;
+        cl_ulong tEnd = 0;
+        if ((clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &tStart, NULL) ==
+                CL_SUCCESS) &&
+            (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &tEnd, NULL) == CL_SUCCESS)) {
+            // Normalized per work item, since successive dispatches of the same kernel vary in global size.
+            device_context->AddTuningSample(
+                item.api_call, item.tuningCandidate, ((double)(tEnd - tStart)) / ((double)item.workItemCount));
+        } else {
+            // Without queue profiling support, the candidates all tie, and tuning settles on the smallest, which is
+            // the kernel's preferred work-group size multiple, (the same as the untuned default).
+            device_context->AddTuningSample(item.api_call, item.tuningCandidate, 0.0);
+        }
+    }
+
+    // (A forcibly drained item has no event handle, so it goes unsampled.)
+    if (event && OCLEngine::IsProfilingEnabled()) {
+        cl_ulong tQueued = 0;
+        cl_ulong tSubmit = 0;
+        cl_ulong tStart = 0;
+        cl_ulong tEnd = 0;
+        if ((clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &tQueued, NULL) ==
+                CL_SUCCESS) &&
+            (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &tSubmit, NULL) ==
+                CL_SUCCESS) &&
+            (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &tStart, NULL) ==
+                CL_SUCCESS) &&
+            (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &tEnd, NULL) == CL_SUCCESS)) {
+            cl_ulong byteCount = 0;
+            for (unsigned int i = 0; i < item.buffers.size(); i++) {
+                byteCount += item.buffers[i]->getInfo<CL_MEM_SIZE>();
+            }
+            OCLEngine::Instance()->AddKernelProfileSample(
+                item.api_call, tSubmit - tQueued, tStart - tSubmit, tEnd - tStart, byteCount);
+        }
+    }
+
     DispatchQueue(event, type);
 }
 
@@ -335,17 +440,32 @@ void QEngineOCL::SetDevice(const int& dID, const bool& forceReInit)
 
         // In this branch, the QEngineOCL was previously allocated, and now we need to copy its memory to a buffer
         // that's accessible in a new device. (The old buffer is definitely not accessible to the new device.)
-        if (!isSameContext) {
+        // Host-backed amplitudes are staged through a fresh host copy; device-local buffers instead migrate
+        // directly, through OCLEngine::MigrateBuffer(), once the new context's buffer exists, below.
+        if (!isSameContext && stateVec) {
             nStateVec = AllocStateVec(maxQPowerOcl, true);
             LockSync(CL_MAP_READ);
             std::copy(stateVec, stateVec + maxQPowerOcl, nStateVec);
             UnlockSync();
         }
 
-        // We're about to switch to a new device, so finish the queue, first.
+        // We're about to switch to a new device, so collect any deferred norm reduction, (the old device's partials
+        // buffer does not migrate,) and finish the queue, first.
+        JoinRunningNorm();
         clFinish(true);
+
+        // The cached lookup table and uniformly controlled matrix buffers belong to the old context, so drop them
+        // across context boundaries:
+        if (!isSameContext) {
+            valuesBuffer = NULL;
+            valuesShadowPower = 0;
+            uniformMtrxBuffer = NULL;
+            uniformMtrxCount = 0;
+        }
     }
 
+    DeviceContextPtr oldDeviceContext = device_context;
+    BufferPtr oldStateBuffer = stateBuffer;
     cl::Context oldContext = context;
     device_context = OCLEngine::Instance()->GetDeviceContextPtr(dID);
     deviceID = device_context->context_id;
@@ -373,11 +493,19 @@ void QEngineOCL::SetDevice(const int& dID, const bool& forceReInit)
         usingHostRam = true;
         if (didInit && !stateVec && !nStateVec) {
             nStateVec = AllocStateVec(maxQPowerOcl, true);
-            BufferPtr nStateBuffer = MakeStateVecBuffer(nStateVec);
-            oldQueue.enqueueCopyBuffer(*stateBuffer, *nStateBuffer, 0, 0, sizeof(complex) * maxQPowerOcl);
-            oldQueue.finish();
-            ResetStateVec(nStateVec);
-            ResetStateBuffer(nStateBuffer);
+            if (isSameContext) {
+                BufferPtr nStateBuffer = MakeStateVecBuffer(nStateVec);
+                oldQueue.enqueueCopyBuffer(*stateBuffer, *nStateBuffer, 0, 0, sizeof(complex) * maxQPowerOcl);
+                oldQueue.finish();
+                ResetStateVec(nStateVec);
+                ResetStateBuffer(nStateBuffer);
+            } else {
+                // Cross-context, to a host-backed destination: one read drains the old device into the new host
+                // allocation, which the new context then wraps in place.
+                oldQueue.enqueueReadBuffer(*oldStateBuffer, CL_TRUE, 0, sizeof(complex) * maxQPowerOcl, nStateVec);
+                ResetStateVec(nStateVec);
+                ResetStateBuffer(MakeStateVecBuffer(stateVec));
+            }
             nStateVec = NULL;
         }
     } else {
@@ -439,12 +567,19 @@ void QEngineOCL::SetDevice(const int& dID, const bool& forceReInit)
     if (didInit) {
         // In this branch, the QEngineOCL was previously allocated, and now we need to copy its memory to a buffer
         // that's accessible in a new device, if the old buffer is not.
-        if (!usingHostRam && nStateVec) {
+        if (!isSameContext && !usingHostRam && !stateVec && !nStateVec) {
+            // Cross-context, device-local on both sides: stream directly between the devices, through OCLEngine's
+            // double-buffered pinned staging, never materializing a full host copy.
+            BufferPtr nStateBuffer = MakeStateVecBuffer(NULL);
+            OCLEngine::Instance()->MigrateBuffer(
+                oldDeviceContext, oldStateBuffer, device_context, nStateBuffer, sizeof(complex) * maxQPowerOcl);
+            ResetStateBuffer(nStateBuffer);
+        } else if (!usingHostRam && nStateVec) {
             // We did not have host allocation, so we copied from device-local memory to host memory, above.
             // Now, we copy to the new device's memory.
             stateBuffer = MakeStateVecBuffer(NULL);
             queue.enqueueWriteBuffer(*stateBuffer, CL_TRUE, 0, sizeof(complex) * maxQPowerOcl, nStateVec);
-            FreeAligned(nStateVec);
+            FreeStateVec(nStateVec);
             ResetStateVec(NULL);
         } else if (nStateVec) {
             // We had host allocation; we will continue to have it.
@@ -483,10 +618,23 @@ real1 QEngineOCL::ParSum(real1* toSum, bitCapIntOcl maxI)
     return totNorm;
 }
 
+void QEngineOCL::JoinRunningNorm()
+{
+    if (!isNormPending) {
+        return;
+    }
+
+    isNormPending = false;
+    WAIT_REAL1_SUM(*nrmBuffer, nrmPendingGroups, nrmArray, &runningNorm);
+}
+
 void QEngineOCL::InitOCL(int devID) { SetDevice(devID, true); }
 
 void QEngineOCL::ResetStateVec(complex* nStateVec)
 {
+    // Every whole-state-vector rewrite, (arithmetic, Compose, and the like,) lands here.
+    DirtyProbAll();
+
     if (stateVec) {
         FreeStateVec();
         stateVec = nStateVec;
@@ -497,6 +645,9 @@ void QEngineOCL::ResetStateBuffer(BufferPtr nStateBuffer) { stateBuffer = nState
 
 void QEngineOCL::SetPermutation(bitCapInt perm, complex phaseFac)
 {
+    DirtyProbAll();
+    truncationError = ZERO_R1;
+
     EventVecPtr waitVec = ResetWaitEvents();
 
     cl::Event fillEvent1;
@@ -511,14 +662,16 @@ void QEngineOCL::SetPermutation(bitCapInt perm, complex phaseFac)
         amp = phaseFac;
     }
 
-    fillEvent1.wait();
-    wait_refs.clear();
+    // The single-amplitude fill only depends on the zero-fill, so it's chained on the device-side event, rather than
+    // blocking the host; a shot loop's reset returns as soon as both fills are enqueued.
+    std::vector<cl::Event> waitFill(1, fillEvent1);
 
     device_context->wait_events->emplace_back();
-    queue.enqueueFillBuffer(*stateBuffer, amp, sizeof(complex) * (bitCapIntOcl)perm, sizeof(complex), NULL,
+    queue.enqueueFillBuffer(*stateBuffer, amp, sizeof(complex) * (bitCapIntOcl)perm, sizeof(complex), &waitFill,
         &(device_context->wait_events->back()));
     queue.flush();
 
+    isNormPending = false;
     runningNorm = ONE_R1;
 }
 
@@ -528,6 +681,73 @@ void QEngineOCL::ArithmeticCall(
     CArithmeticCall(api_call, bciArgs, NULL, 0, values, valuesPower);
 }
 
+BufferPtr QEngineOCL::GetValuesBuffer(unsigned char* values, bitCapIntOcl valuesPower)
+{
+    // Lookup-dominated circuits pass the same table across many calls, so reuse the last upload when the contents
+    // still match the host shadow. (The caller is free to mutate or free its array between calls, hence the shadow
+    // copy is both the comparison key and the source of the device upload.)
+    if (valuesBuffer && (valuesPower == valuesShadowPower) &&
+        (memcmp(valuesShadow.get(), values, (size_t)valuesPower) == 0)) {
+        return valuesBuffer;
+    }
+
+    valuesShadow = std::unique_ptr<unsigned char[]>(new unsigned char[valuesPower]);
+    std::copy(values, values + valuesPower, valuesShadow.get());
+    valuesShadowPower = valuesPower;
+
+    // Any kernel still queued against the old buffer holds its own reference, so dropping ours here is safe.
+    valuesBuffer = std::make_shared<cl::Buffer>(
+        context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, sizeof(unsigned char) * valuesPower, valuesShadow.get());
+
+    return valuesBuffer;
+}
+
+BufferPtr QEngineOCL::GetUniformMtrxBuffer(EventVecPtr waitVec, const complex* mtrxs, bitCapIntOcl mtrxCount)
+{
+    const bitCapIntOcl elemCount = mtrxCount << 2U;
+
+    if (uniformMtrxBuffer && (mtrxCount == uniformMtrxCount)) {
+        // An ansatz iteration typically refreshes the angles of a few matrices in the 2^k array, so the persistent
+        // buffer is patched in place: only the contiguous span of 2x2 matrices differing from the host shadow rides
+        // the bus, and a byte-identical array is no upload at all.
+        bitCapIntOcl first = 0;
+        while ((first < mtrxCount) &&
+            (memcmp(uniformMtrxShadow.get() + (first << 2U), mtrxs + (first << 2U), sizeof(complex) << 2U) == 0)) {
+            first++;
+        }
+        if (first == mtrxCount) {
+            return uniformMtrxBuffer;
+        }
+        bitCapIntOcl last = mtrxCount - 1U;
+        while ((last > first) &&
+            (memcmp(uniformMtrxShadow.get() + (last << 2U), mtrxs + (last << 2U), sizeof(complex) << 2U) == 0)) {
+            last--;
+        }
+
+        const bitCapIntOcl spanElems = (last + 1U - first) << 2U;
+        std::copy(mtrxs + (first << 2U), mtrxs + (first << 2U) + spanElems, uniformMtrxShadow.get() + (first << 2U));
+
+        // The shadow is stable host memory, and the write waits on the prior dispatches still reading the buffer:
+        device_context->wait_events->emplace_back();
+        queue.enqueueWriteBuffer(*uniformMtrxBuffer, CL_FALSE, sizeof(complex) * (first << 2U),
+            sizeof(complex) * spanElems, uniformMtrxShadow.get() + (first << 2U), waitVec.get(),
+            &(device_context->wait_events->back()));
+        queue.flush();
+
+        return uniformMtrxBuffer;
+    }
+
+    uniformMtrxShadow = std::unique_ptr<complex[]>(new complex[elemCount]);
+    std::copy(mtrxs, mtrxs + elemCount, uniformMtrxShadow.get());
+    uniformMtrxCount = mtrxCount;
+
+    // Any kernel still queued against the old buffer holds its own reference, so dropping ours here is safe.
+    uniformMtrxBuffer = std::make_shared<cl::Buffer>(
+        context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, sizeof(complex) * elemCount, uniformMtrxShadow.get());
+
+    return uniformMtrxBuffer;
+}
+
 void QEngineOCL::CArithmeticCall(OCLAPI api_call, bitCapIntOcl (&bciArgs)[BCI_ARG_LEN], bitCapIntOcl* controlPowers,
     const bitLenInt controlLen, unsigned char* values, bitCapIntOcl valuesPower)
 {
@@ -562,11 +782,8 @@ void QEngineOCL::CArithmeticCall(OCLAPI api_call, bitCapIntOcl (&bciArgs)[BCI_AR
 
     std::vector<BufferPtr> oclArgs = { stateBuffer, poolItem->ulongBuffer, nStateBuffer };
 
-    BufferPtr loadBuffer;
     if (values) {
-        loadBuffer = std::make_shared<cl::Buffer>(
-            context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, sizeof(unsigned char) * valuesPower, values);
-        oclArgs.push_back(loadBuffer);
+        oclArgs.push_back(GetValuesBuffer(values, valuesPower));
     }
     if (controlLen > 0) {
         oclArgs.push_back(controlBuffer);
@@ -588,6 +805,38 @@ void QEngineOCL::X(bitLenInt qubit)
     Apply2x2(0, qPowers[0], pauliX, 1, qPowers, false, SPECIAL_2X2::PAULIX);
 }
 
+/// Apply X ("not") gate to each bit in "length," starting from bit index "start," in a single sweep
+void QEngineOCL::X(bitLenInt start, bitLenInt length)
+{
+    // One bit keeps the xsingle special case; the multi-bit gate is a single-sweep, in-place permutation, sending
+    // each index to its XOR with the register mask, instead of one full pass per bit.
+    if (length < 2U) {
+        if (length == 1U) {
+            X(start);
+        }
+        return;
+    }
+
+    DirtyProbMask(bitRegMask(start, length));
+
+    // We don't actually have to wait, so this is empty:
+    EventVecPtr waitVec;
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl, bitRegMaskOcl(start, length), 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    cl::Event writeArgsEvent;
+    DISPATCH_TEMP_WRITE(waitVec, *(poolItem->ulongBuffer), sizeof(bitCapIntOcl) * 2, bciArgs, writeArgsEvent);
+
+    size_t ngc = FixWorkItemCount(maxQPowerOcl, nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    // Wait for buffer write from limited lifetime objects
+    writeArgsEvent.wait();
+
+    QueueCall(OCL_API_X_MASK, ngc, ngs, { stateBuffer, poolItem->ulongBuffer });
+}
+
 /// Apply Pauli Z matrix to bit
 void QEngineOCL::Z(bitLenInt qubit)
 {
@@ -600,16 +849,127 @@ void QEngineOCL::Z(bitLenInt qubit)
     Apply2x2(0, qPowers[0], pauliZ, 1, qPowers, false, SPECIAL_2X2::PAULIZ);
 }
 
+void QEngineOCL::BatchGate(const complex* mtrx, const bitCapIntOcl& qPower)
+{
+    bool isNewQubit = std::find(gateBatchQPowers.begin(), gateBatchQPowers.end(), qPower) == gateBatchQPowers.end();
+    if ((gateBatchTargets.size() >= GATE_BATCH_MAX_GATES) ||
+        (isNewQubit && (gateBatchQPowers.size() >= GATE_BATCH_MAX_QUBITS))) {
+        FlushGateBatch();
+        isNewQubit = true;
+    }
+
+    if (isNewQubit) {
+        gateBatchQPowers.push_back(qPower);
+    }
+    gateBatchMtrxs.insert(gateBatchMtrxs.end(), mtrx, mtrx + 4);
+    gateBatchTargets.push_back(qPower);
+}
+
+void QEngineOCL::FlushGateBatch()
+{
+    if (gateBatchTargets.size() == 0) {
+        return;
+    }
+
+    std::vector<complex> mtrxs = std::move(gateBatchMtrxs);
+    std::vector<bitCapIntOcl> targets = std::move(gateBatchTargets);
+    std::vector<bitCapIntOcl> qPowers = std::move(gateBatchQPowers);
+    gateBatchMtrxs.clear();
+    gateBatchTargets.clear();
+    gateBatchQPowers.clear();
+
+    if (targets.size() == 1U) {
+        // A lone gate keeps the specialized single-gate kernel treatment; replay it outside the batching path.
+        isBatchReplay = true;
+        bitCapInt qPowersSorted[1] = { (bitCapInt)targets[0] };
+        Apply2x2(0, qPowersSorted[0], &(mtrxs[0]), 1, qPowersSorted, false);
+        isBatchReplay = false;
+        return;
+    }
+
+    std::sort(qPowers.begin(), qPowers.end());
+
+    // The powers buffer carries the sorted distinct qubit powers, then each gate's power-of-2 position among them,
+    // (its stride within the work item's private amplitude block,) in application order:
+    std::vector<bitCapIntOcl> powersAndStrides(qPowers);
+    for (size_t i = 0; i < targets.size(); i++) {
+        powersAndStrides.push_back((bitCapIntOcl)ONE_BCI
+            << (bitCapIntOcl)(std::lower_bound(qPowers.begin(), qPowers.end(), targets[i]) - qPowers.begin()));
+    }
+
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    bitCapIntOcl maxI = maxQPowerOcl >> (bitCapIntOcl)qPowers.size();
+    bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxI, (bitCapIntOcl)targets.size(), (bitCapIntOcl)qPowers.size(), 0, 0, 0,
+        0, 0, 0, 0 };
+
+    // We don't actually have to wait, so this is empty:
+    EventVecPtr waitVec;
+
+    cl::Event writeArgsEvent;
+    DISPATCH_TEMP_WRITE(waitVec, *(poolItem->ulongBuffer), sizeof(bitCapIntOcl) * 3, bciArgs, writeArgsEvent);
+
+    // These are synchronous host-pointer copies at construction, so no events need tracking:
+    BufferPtr mtrxBuffer = std::make_shared<cl::Buffer>(
+        context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, sizeof(complex) * mtrxs.size(), &(mtrxs[0]));
+    BufferPtr batchPowersBuffer = std::make_shared<cl::Buffer>(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY,
+        sizeof(bitCapIntOcl) * powersAndStrides.size(), &(powersAndStrides[0]));
+
+    size_t ngc = FixWorkItemCount(maxI, nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    // Wait for buffer write from limited lifetime objects
+    writeArgsEvent.wait();
+
+    QueueCall(OCL_API_APPLY2X2_BATCH, ngc, ngs, { stateBuffer, mtrxBuffer, poolItem->ulongBuffer, batchPowersBuffer });
+}
+
 void QEngineOCL::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
     const bitCapInt* qPowersSorted, bool doCalcNorm, SPECIAL_2X2 special, real1 norm_thresh)
 {
+#if ENABLE_QSTATS
+    if (!isBatchReplay) {
+        apply2x2Count++;
+    }
+#endif
+
+    // Unitaries preserve the probabilities of any mask disjoint from their qubits, so only the involved qubits are
+    // marked dirty, (at enqueue, on the caller's thread).
+    DirtyProbPowers(qPowersSorted, bitCount);
+
+    // A deferred partial-norm reduction is joined only when this gate consumes the value, (for its normalization
+    // scale factor, or to prove a unit-norm fast path); until then, it runs behind the host-side work since its
+    // kernel queued. (Wider gates and non-normalizing calls preserve the total norm and leave the partials alone,
+    // so an outstanding reduction stays valid across them.)
+    if (doNormalize && (bitCount == 1)) {
+        JoinRunningNorm();
+    }
+
     bool isXGate = (special == SPECIAL_2X2::PAULIX) && (!doNormalize || (runningNorm == ONE_R1));
     bool isZGate = (special == SPECIAL_2X2::PAULIZ) && (!doNormalize || (runningNorm == ONE_R1));
 
+    // Single bit gates with diagonal or anti-diagonal matrices, (Z, S, T, RZ, and the phase/invert halves of
+    // controlled gates,) touch at most one amplitude product per matrix row, so they get the same special kernel
+    // treatment as X and Z, at general phase:
+    bool canSpecialize = (special == SPECIAL_2X2::NONE) && (bitCount == 1) &&
+        (!doNormalize || (!doCalcNorm && (runningNorm == ONE_R1)));
+    bool isPhaseGate = canSpecialize && (norm(mtrx[1]) == ZERO_R1) && (norm(mtrx[2]) == ZERO_R1);
+    bool isInvertGate = canSpecialize && (norm(mtrx[0]) == ZERO_R1) && (norm(mtrx[3]) == ZERO_R1);
+
     // Are we going to calculate the normalization factor, on the fly? We can't, if this call doesn't iterate through
     // every single permutation amplitude.
     doCalcNorm = (doCalcNorm || (runningNorm != ONE_R1)) && doNormalize && (!isXGate) && (!isZGate) && (bitCount == 1);
 
+    // A single-qubit gate with no normalization work joins the pending gate batch, so that a short program of gates
+    // costs one kernel enqueue, instead of one enqueue per gate:
+    if ((bitCount == 1) && !doCalcNorm && (offset1 == 0) && (offset2 == qPowersSorted[0]) && !isBatchReplay) {
+        if (!isXGate && !isZGate) {
+            runningNorm = ONE_R1;
+        }
+        BatchGate(mtrx, (bitCapIntOcl)qPowersSorted[0]);
+        return;
+    }
+
     // We grab the wait event queue. We will replace it with three new asynchronous events, to wait for.
     EventVecPtr waitVec;
     if (doCalcNorm) {
@@ -701,6 +1061,10 @@ void QEngineOCL::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* m
             kernelMask |= APPLY2X2_X;
         } else if (isZGate) {
             kernelMask |= APPLY2X2_Z;
+        } else if (isPhaseGate) {
+            kernelMask |= APPLY2X2_PHASE;
+        } else if (isInvertGate) {
+            kernelMask |= APPLY2X2_INVERT;
         } else if (doCalcNorm) {
             kernelMask |= APPLY2X2_NORM;
         }
@@ -725,6 +1089,12 @@ void QEngineOCL::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* m
     case APPLY2X2_SINGLE | APPLY2X2_Z:
         api_call = OCL_API_Z_SINGLE;
         break;
+    case APPLY2X2_SINGLE | APPLY2X2_PHASE:
+        api_call = OCL_API_PHASE_SINGLE;
+        break;
+    case APPLY2X2_SINGLE | APPLY2X2_INVERT:
+        api_call = OCL_API_INVERT_SINGLE;
+        break;
     case APPLY2X2_NORM | APPLY2X2_SINGLE:
         api_call = OCL_API_APPLY2X2_NORM_SINGLE;
         break;
@@ -743,6 +1113,12 @@ void QEngineOCL::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* m
     case APPLY2X2_SINGLE | APPLY2X2_WIDE | APPLY2X2_Z:
         api_call = OCL_API_Z_SINGLE_WIDE;
         break;
+    case APPLY2X2_SINGLE | APPLY2X2_WIDE | APPLY2X2_PHASE:
+        api_call = OCL_API_PHASE_SINGLE_WIDE;
+        break;
+    case APPLY2X2_SINGLE | APPLY2X2_WIDE | APPLY2X2_INVERT:
+        api_call = OCL_API_INVERT_SINGLE_WIDE;
+        break;
     case APPLY2X2_NORM | APPLY2X2_SINGLE | APPLY2X2_WIDE:
         api_call = OCL_API_APPLY2X2_NORM_SINGLE_WIDE;
         break;
@@ -789,9 +1165,11 @@ void QEngineOCL::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* m
     }
 
     if (doCalcNorm) {
-        // If we have calculated the norm of the state vector in this call, we need to sum the buffer of partial norm
-        // values into a single normalization constant.
-        WAIT_REAL1_SUM(*nrmBuffer, ngc / ngs, nrmArray, &runningNorm);
+        // The kernel leaves one partial norm per work group; rather than blocking on the reduction here, defer the
+        // readback and summation until the value is actually consumed, so it overlaps subsequent gate dispatch.
+        isNormPending = true;
+        nrmPendingGroups = ngc / ngs;
+        runningNorm = REAL1_DEFAULT_ARG;
     } else if ((bitCount == 1) && (!isXGate) && (!isZGate)) {
         runningNorm = ONE_R1;
     }
@@ -807,6 +1185,12 @@ void QEngineOCL::UniformlyControlledSingleBit(const bitLenInt* controls, const b
         return;
     }
 
+    // Only the target's amplitudes change, so masks disjoint from it keep their cached reductions.
+    DirtyProbQubit(qubitIndex);
+
+    // The normalization factor below consumes the running norm, so any deferred reduction is collected, first.
+    JoinRunningNorm();
+
     // We grab the wait event queue. We will replace it with three new asynchronous events, to wait for.
     EventVecPtr waitVec = ResetWaitEvents();
     PoolItemPtr poolItem = GetFreePoolItem();
@@ -823,10 +1207,7 @@ void QEngineOCL::UniformlyControlledSingleBit(const bitLenInt* controls, const b
     real1 nrm = (real1)(ONE_R1 / std::sqrt(runningNorm));
     DISPATCH_WRITE(waitVec, *nrmInBuffer, sizeof(real1), &nrm);
 
-    BufferPtr uniformBuffer = std::make_shared<cl::Buffer>(
-        context, CL_MEM_READ_ONLY, sizeof(complex) * 4U * pow2Ocl(controlLen + mtrxSkipLen));
-
-    DISPATCH_WRITE(waitVec, *uniformBuffer, sizeof(complex) * 4U * pow2Ocl(controlLen + mtrxSkipLen), mtrxs);
+    BufferPtr uniformBuffer = GetUniformMtrxBuffer(waitVec, mtrxs, pow2Ocl(controlLen + mtrxSkipLen));
 
     bitCapIntOcl* qPowers = new bitCapIntOcl[controlLen + mtrxSkipLen];
     for (bitLenInt i = 0; i < controlLen; i++) {
@@ -858,6 +1239,9 @@ void QEngineOCL::UniformlyControlledSingleBit(const bitLenInt* controls, const b
 
 void QEngineOCL::ApplyMx(OCLAPI api_call, bitCapIntOcl* bciArgs, complex nrm)
 {
+    // Collapse renormalizes every amplitude, so no cached reduction survives.
+    DirtyProbAll();
+
     // We don't actually have to wait, so this is empty:
     EventVecPtr waitVec;
     PoolItemPtr poolItem = GetFreePoolItem();
@@ -876,6 +1260,7 @@ void QEngineOCL::ApplyMx(OCLAPI api_call, bitCapIntOcl* bciArgs, complex nrm)
 
     QueueCall(api_call, ngc, ngs, { stateBuffer, poolItem->ulongBuffer, poolItem->cmplxBuffer });
 
+    isNormPending = false;
     runningNorm = ONE_R1;
 }
 
@@ -907,6 +1292,16 @@ void QEngineOCL::Compose(OCLAPI apiCall, bitCapIntOcl* bciArgs, QEngineOCLPtr to
 
     toCopy->Finish();
 
+    bool isSameContext = (toCopy->device_context->context_id == device_context->context_id);
+
+    if (!isSameContext && (apiCall != OCL_API_COMPOSE_MID) && (toCopy->maxQPowerOcl > QRACK_STREAM_CHUNK_ELEMS)) {
+        // For cross-device end-composition, tiles of the other engine's state vector stream to this device while the
+        // compose kernel consumes already-arrived tiles, overlapping PCIe transfer with compute. ("Mid" composition
+        // scatters each source tile across the whole output, so it takes the single-kernel path, below.)
+        ComposePipelined(bciArgs, toCopy);
+        return;
+    }
+
     PoolItemPtr poolItem = GetFreePoolItem();
     EventVecPtr waitVec = ResetWaitEvents();
 
@@ -931,8 +1326,6 @@ void QEngineOCL::Compose(OCLAPI apiCall, bitCapIntOcl* bciArgs, QEngineOCLPtr to
     BufferPtr otherStateBuffer;
     complex* otherStateVec;
 
-    bool isSameContext = (toCopy->device_context->context_id == device_context->context_id);
-
     if (!isSameContext) {
         toCopy->LockSync(CL_MAP_READ);
         otherStateVec = AllocStateVec(toCopy->maxQPowerOcl, true);
@@ -956,6 +1349,88 @@ void QEngineOCL::Compose(OCLAPI apiCall, bitCapIntOcl* bciArgs, QEngineOCLPtr to
     ResetStateBuffer(nStateBuffer);
 }
 
+void QEngineOCL::ComposePipelined(bitCapIntOcl* bciArgs, QEngineOCLPtr toCopy)
+{
+    bitCapIntOcl nMaxQPower = bciArgs[0];
+    bitCapIntOcl oQubitCount = bciArgs[1];
+    bitCapIntOcl startMask = bciArgs[2];
+    bitCapIntOcl endMask = bciArgs[3];
+
+    size_t nStateVecSize = nMaxQPower * sizeof(complex);
+    SetQubitCount(oQubitCount + toCopy->qubitCount);
+    bool forceAlloc = !stateVec && ((OclMemDenom * nStateVecSize) > maxMem);
+
+    // Drain the asynchronous dispatch queue, before raw enqueues against the primary queue.
+    clFinish();
+
+    complex* nStateVec = AllocStateVec(maxQPowerOcl, forceAlloc);
+    BufferPtr nStateBuffer = MakeStateVecBuffer(nStateVec);
+
+    // The other engine's state vector lands in a device-side staging buffer, one tile at a time.
+    BufferPtr otherStateBuffer =
+        std::make_shared<cl::Buffer>(context, CL_MEM_READ_ONLY, sizeof(complex) * toCopy->maxQPowerOcl);
+
+    toCopy->LockSync(CL_MAP_READ);
+
+    // The primary queue is in-order, so overlapping PCIe transfer with compute takes a second, dedicated transfer
+    // queue. (Cross-queue event dependencies are valid within one context.)
+    cl::CommandQueue xferQueue(context, device_context->device);
+
+    // Few enough tiles that per-dispatch overhead stays negligible, but enough that the first kernel starts while
+    // most of the transfer is still in flight. (Both lengths are powers of two, so the tiling is exact.)
+    bitCapIntOcl tileLen = QRACK_STREAM_CHUNK_ELEMS;
+    while ((toCopy->maxQPowerOcl / tileLen) > QRACK_COMPOSE_MAX_TILES) {
+        tileLen <<= ONE_BCI;
+    }
+    bitCapIntOcl tileCount = toCopy->maxQPowerOcl / tileLen;
+
+    // The slice arguments have to outlive their (nonblocking) buffer writes:
+    std::unique_ptr<bitCapIntOcl[]> sliceArgs(new bitCapIntOcl[5U * tileCount]);
+    std::vector<BufferPtr> sliceArgsBuffers(tileCount);
+
+    // We hold the kernel reservation across every tile dispatch. (The in-order queue copies the argument hooks at
+    // enqueue, so resetting them per tile is safe.)
+    OCLDeviceCall ocl = device_context->Reserve(OCL_API_COMPOSE_SLICE);
+
+    for (bitCapIntOcl tile = 0; tile < tileCount; tile++) {
+        bitCapIntOcl offset = tile * tileLen;
+
+        cl::Event writeEvent;
+        xferQueue.enqueueWriteBuffer(*otherStateBuffer, CL_FALSE, sizeof(complex) * offset, sizeof(complex) * tileLen,
+            toCopy->stateVec + offset, NULL, &writeEvent);
+
+        bitCapIntOcl sliceLen = tileLen << oQubitCount;
+        bitCapIntOcl* args = sliceArgs.get() + 5U * tile;
+        args[0] = sliceLen;
+        args[1] = oQubitCount;
+        args[2] = startMask;
+        args[3] = endMask;
+        args[4] = offset << oQubitCount;
+        sliceArgsBuffers[tile] = std::make_shared<cl::Buffer>(context, CL_MEM_READ_ONLY, sizeof(bitCapIntOcl) * 5U);
+        queue.enqueueWriteBuffer(*(sliceArgsBuffers[tile]), CL_FALSE, 0, sizeof(bitCapIntOcl) * 5U, args);
+
+        size_t ngc = FixWorkItemCount(sliceLen, nrmGroupCount);
+        size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+        ocl.call.setArg(0, *stateBuffer);
+        ocl.call.setArg(1, *otherStateBuffer);
+        ocl.call.setArg(2, *(sliceArgsBuffers[tile]));
+        ocl.call.setArg(3, *nStateBuffer);
+
+        // The slice kernel waits on only its own tile's transfer, so compute overlaps every later tile in flight:
+        std::vector<cl::Event> kernelWaitVec = { writeEvent };
+        queue.enqueueNDRangeKernel(ocl.call, cl::NullRange, cl::NDRange(ngc), cl::NDRange(ngs), &kernelWaitVec, NULL);
+    }
+
+    queue.finish();
+    xferQueue.finish();
+
+    toCopy->UnlockSync();
+
+    ResetStateVec(nStateVec);
+    ResetStateBuffer(nStateBuffer);
+}
+
 bitLenInt QEngineOCL::Compose(QEngineOCLPtr toCopy)
 {
     bitLenInt result = qubitCount;
@@ -1113,7 +1588,7 @@ void QEngineOCL::DecomposeDispose(bitLenInt start, bitLenInt length, QEngineOCLP
             queue.enqueueUnmapMemObject(*otherStateBuffer, otherStateVec, NULL, &waitUnmap);
             waitUnmap.wait();
             destination->UnlockSync();
-            FreeAligned(otherStateVec);
+            FreeStateVec(otherStateVec);
         } else if (!(destination->useHostRam) && destination->stateVec && oNStateVecSize <= destination->maxAlloc &&
             (2 * oNStateVecSize) <= destination->maxMem) {
 
@@ -1126,7 +1601,7 @@ void QEngineOCL::DecomposeDispose(bitLenInt start, bitLenInt length, QEngineOCLP
             wait_refs.clear();
 
             destination->stateBuffer = nSB;
-            FreeAligned(destination->stateVec);
+            FreeStateVec(destination->stateVec);
             destination->stateVec = NULL;
         }
     }
@@ -1249,9 +1724,17 @@ real1 QEngineOCL::Prob(bitLenInt qubit)
 
     bitCapIntOcl qPower = pow2Ocl(qubit);
 
+    real1 oneChance;
+    if (ProbCacheLookup(pow2(qubit), pow2(qubit), oneChance)) {
+        return oneChance;
+    }
+
     bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl >> ONE_BCI, qPower, 0, 0, 0, 0, 0, 0, 0, 0 };
 
-    return Probx(OCL_API_PROB, bciArgs);
+    oneChance = Probx(OCL_API_PROB, bciArgs);
+    ProbCacheStore(pow2(qubit), pow2(qubit), oneChance);
+
+    return oneChance;
 }
 
 // Returns probability of permutation of the register
@@ -1263,9 +1746,17 @@ real1 QEngineOCL::ProbReg(const bitLenInt& start, const bitLenInt& length, const
 
     bitCapIntOcl perm = (bitCapIntOcl)permutation << (bitCapIntOcl)start;
 
+    real1 prob;
+    if (ProbCacheLookup(bitRegMask(start, length), permutation << start, prob)) {
+        return prob;
+    }
+
     bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl >> length, perm, start, length, 0, 0, 0, 0, 0, 0 };
 
-    return Probx(OCL_API_PROBREG, bciArgs);
+    prob = Probx(OCL_API_PROBREG, bciArgs);
+    ProbCacheStore(bitRegMask(start, length), permutation << start, prob);
+
+    return prob;
 }
 
 void QEngineOCL::ProbRegAll(const bitLenInt& start, const bitLenInt& length, real1* probsArray)
@@ -1318,6 +1809,11 @@ void QEngineOCL::ProbRegAll(const bitLenInt& start, const bitLenInt& length, rea
 // Returns probability of permutation of the register
 real1 QEngineOCL::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
 {
+    real1 prob;
+    if (ProbCacheLookup(mask, permutation, prob)) {
+        return prob;
+    }
+
     bitCapIntOcl v = (bitCapIntOcl)mask; // count the number of bits set in v
     bitCapIntOcl oldV;
     bitLenInt length; // c accumulates the total bits set in v
@@ -1358,7 +1854,10 @@ real1 QEngineOCL::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
 
     delete[] skipPowers;
 
-    return clampProb(oneChance);
+    prob = clampProb(oneChance);
+    ProbCacheStore(mask, permutation, prob);
+
+    return prob;
 }
 
 void QEngineOCL::ProbMaskAll(const bitCapInt& mask, real1* probsArray)
@@ -1780,6 +2279,10 @@ void QEngineOCL::IFullAdd(bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt ca
 void QEngineOCL::FullAdx(
     bitLenInt inputBit1, bitLenInt inputBit2, bitLenInt carryInSumOut, bitLenInt carryOut, OCLAPI api_call)
 {
+    // In place, only the sum and carry-out bits change:
+    DirtyProbQubit(carryInSumOut);
+    DirtyProbQubit(carryOut);
+
     bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl >> (bitCapIntOcl)2U, pow2Ocl(inputBit1), pow2Ocl(inputBit2),
         pow2Ocl(carryInSumOut), pow2Ocl(carryOut), 0, 0, 0, 0, 0 };
 
@@ -1856,8 +2359,8 @@ void QEngineOCL::CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart,
         return;
     }
 
-    CMULModx(
-        OCL_API_CMULMODN_OUT, (bitCapIntOcl)toMul, (bitCapIntOcl)modN, inStart, outStart, length, controls, controlLen);
+    CMULModx(OCL_API_CMULMODN_OUT, (bitCapIntOcl)toMul, (bitCapIntOcl)modN, inStart, outStart, length,
+        controls, controlLen);
 }
 
 void QEngineOCL::CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
@@ -1889,8 +2392,8 @@ void QEngineOCL::CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart,
 
     SetReg(outStart, length, 0);
 
-    CMULModx(
-        OCL_API_CPOWMODN_OUT, (bitCapIntOcl)base, (bitCapIntOcl)modN, inStart, outStart, length, controls, controlLen);
+    CMULModx(OCL_API_CPOWMODN_OUT, (bitCapIntOcl)base, (bitCapIntOcl)modN, inStart, outStart, length, controls,
+        controlLen);
 }
 
 void QEngineOCL::xMULx(OCLAPI api_call, bitCapIntOcl* bciArgs, BufferPtr controlBuffer)
@@ -1946,10 +2449,26 @@ void QEngineOCL::MULModx(OCLAPI api_call, bitCapIntOcl toMod, bitCapIntOcl modN,
     bitCapIntOcl skipMask = pow2MaskOcl(outStart);
     bitCapIntOcl otherMask = (maxQPowerOcl - ONE_BCI) ^ (inMask | outMask);
 
+    // In place, only the out register's probabilities change:
+    DirtyProbMask(outMask);
+
     bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl >> (bitCapIntOcl)length, toMod, inMask, outMask, otherMask,
         length, inStart, outStart, skipMask, modN };
 
-    xMULx(api_call, bciArgs, NULL);
+    EventVecPtr waitVec = ResetWaitEvents();
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    cl::Event writeArgsEvent;
+    DISPATCH_TEMP_WRITE(waitVec, *(poolItem->ulongBuffer), sizeof(bitCapIntOcl) * 10, bciArgs, writeArgsEvent);
+
+    // Wait for buffer write from limited lifetime objects
+    writeArgsEvent.wait();
+    wait_refs.clear();
+
+    size_t ngc = FixWorkItemCount(bciArgs[0], nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    QueueCall(api_call, ngc, ngs, { stateBuffer, poolItem->ulongBuffer });
 }
 
 void QEngineOCL::CMULx(OCLAPI api_call, bitCapIntOcl toMod, const bitLenInt inOutStart, const bitLenInt carryStart,
@@ -1993,13 +2512,14 @@ void QEngineOCL::CMULModx(OCLAPI api_call, bitCapIntOcl toMod, bitCapIntOcl modN
     bitCapIntOcl inOutMask = lowMask << inOutStart;
     bitCapIntOcl carryMask = lowMask << carryStart;
 
+    // In place, only the out register's probabilities change:
+    DirtyProbMask(carryMask);
+
     bitCapIntOcl* skipPowers = new bitCapIntOcl[controlLen + length];
-    bitCapIntOcl* controlPowers = new bitCapIntOcl[controlLen];
     bitCapIntOcl controlMask = 0;
     for (bitLenInt i = 0; i < controlLen; i++) {
-        controlPowers[i] = pow2Ocl(controls[i]);
-        skipPowers[i] = controlPowers[i];
-        controlMask |= controlPowers[i];
+        skipPowers[i] = pow2Ocl(controls[i]);
+        controlMask |= skipPowers[i];
     }
     for (bitLenInt i = 0; i < length; i++) {
         skipPowers[i + controlLen] = pow2Ocl(carryStart + i);
@@ -2009,13 +2529,26 @@ void QEngineOCL::CMULModx(OCLAPI api_call, bitCapIntOcl toMod, bitCapIntOcl modN
     bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl, toMod, controlLen, controlMask, inOutMask, carryMask, modN,
         length, inOutStart, carryStart };
 
-    BufferPtr controlBuffer = std::make_shared<cl::Buffer>(context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY,
-        sizeof(bitCapIntOcl) * ((controlLen * 2) + length), skipPowers);
+    BufferPtr controlBuffer = std::make_shared<cl::Buffer>(
+        context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, sizeof(bitCapIntOcl) * (controlLen + length), skipPowers);
 
-    xMULx(api_call, bciArgs, controlBuffer);
+    EventVecPtr waitVec = ResetWaitEvents();
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    cl::Event writeArgsEvent;
+    DISPATCH_TEMP_WRITE(waitVec, *(poolItem->ulongBuffer), sizeof(bitCapIntOcl) * 10, bciArgs, writeArgsEvent);
+
+    // Wait for buffer write from limited lifetime objects
+    writeArgsEvent.wait();
+    wait_refs.clear();
+
+    // The kernel loop covers one item per all-controls-on, out==0 basis state:
+    size_t ngc = FixWorkItemCount(bciArgs[0] >> (bitCapIntOcl)(controlLen + length), nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    QueueCall(api_call, ngc, ngs, { stateBuffer, poolItem->ulongBuffer, controlBuffer });
 
     delete[] skipPowers;
-    delete[] controlPowers;
 }
 
 /** Set 8 bit register bits based on read from classical memory */
@@ -2090,6 +2623,39 @@ bitCapInt QEngineOCL::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bi
     return OpIndexed(OCL_API_INDEXEDSBC, 1, indexStart, indexLength, valueStart, valueLength, carryIndex, values);
 }
 
+/** Flip the carry for each superposed index whose classical table entry is less than "greaterPerm" */
+void QEngineOCL::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    DirtyProbQubit(carryIndex);
+
+    // The load, the comparison against the classical bound, and the carry flip fuse into one in-place kernel, where
+    // each work item owns a pair of amplitudes across the carry bit, so no new state vector is allocated. The total
+    // norm is preserved, so any deferred norm reduction stays valid.
+    bitLenInt valueBytes = (valueLength + 7) / 8;
+    bitCapIntOcl carryMask = pow2Ocl(carryIndex);
+    bitCapIntOcl inputMask = bitRegMaskOcl(indexStart, indexLength);
+    bitCapIntOcl bciArgs[BCI_ARG_LEN] = { maxQPowerOcl >> (bitCapIntOcl)ONE_BCI, indexStart, inputMask,
+        (bitCapIntOcl)greaterPerm, carryMask, valueBytes, 0, 0, 0, 0 };
+
+    // We don't actually have to wait, so this is empty:
+    EventVecPtr waitVec;
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    cl::Event writeArgsEvent;
+    DISPATCH_TEMP_WRITE(waitVec, *(poolItem->ulongBuffer), sizeof(bitCapIntOcl) * 6, bciArgs, writeArgsEvent);
+
+    size_t ngc = FixWorkItemCount(bciArgs[0], nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    BufferPtr loadBuffer = GetValuesBuffer(values, pow2Ocl(indexLength) * valueBytes);
+
+    // Wait for buffer write from limited lifetime objects
+    writeArgsEvent.wait();
+
+    QueueCall(OCL_API_INDEXEDCMP, ngc, ngs, { stateBuffer, poolItem->ulongBuffer, loadBuffer });
+}
+
 /** Set 8 bit register bits based on read from classical memory */
 void QEngineOCL::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
 {
@@ -2156,8 +2722,12 @@ void QEngineOCL::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenI
 /// Set arbitrary pure quantum state, in unsigned int permutation basis
 void QEngineOCL::SetQuantumState(const complex* inputState)
 {
+    DirtyProbAll();
+    truncationError = ZERO_R1;
+
     LockSync(CL_MAP_WRITE);
     std::copy(inputState, inputState + maxQPowerOcl, stateVec);
+    isNormPending = false;
     runningNorm = ONE_R1;
     UnlockSync();
 }
@@ -2178,6 +2748,11 @@ complex QEngineOCL::GetAmplitude(bitCapInt fullRegister)
 
 void QEngineOCL::SetAmplitude(bitCapInt perm, complex amp)
 {
+    DirtyProbAll();
+
+    // The adjustment below consumes the running norm, so any deferred reduction is collected, first.
+    JoinRunningNorm();
+
     runningNorm -= norm(GetAmplitude(perm));
     runningNorm += norm(amp);
 
@@ -2195,14 +2770,173 @@ void QEngineOCL::GetQuantumState(complex* outputState)
         NormalizeState();
     }
 
+    // Oracle-style circuits leave the state vector overwhelmingly zero. When few enough amplitudes are nonzero, it's
+    // cheaper to compact them on device and transfer only the (index, amplitude) pairs than to stream the whole dense
+    // vector over the bus. (The count itself is one device-bandwidth-bound sweep, so tiny vectors skip the check.)
+    if (maxQPowerOcl > QRACK_STREAM_CHUNK_ELEMS) {
+        bitCapIntOcl nonzeroCount = CountNonzero(ZERO_R1);
+        if (nonzeroCount <= (maxQPowerOcl / QRACK_SPARSE_OCL_DENOM)) {
+            std::map<bitCapInt, complex> sparseState;
+            GetSparseQuantumState(sparseState, ZERO_R1);
+            std::fill(outputState, outputState + maxQPowerOcl, ZERO_CMPLX);
+            std::map<bitCapInt, complex>::iterator it;
+            for (it = sparseState.begin(); it != sparseState.end(); it++) {
+                outputState[(bitCapIntOcl)it->first] = it->second;
+            }
+            return;
+        }
+    }
+
     LockSync(CL_MAP_READ);
     std::copy(stateVec, stateVec + maxQPowerOcl, outputState);
     UnlockSync();
 }
 
+/// Count the basis states with squared amplitude above "norm_thresh," without leaving the device
+bitCapIntOcl QEngineOCL::CountNonzero(real1 norm_thresh)
+{
+    if (norm_thresh < ZERO_R1) {
+        norm_thresh = amplitudeFloor;
+    }
+
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    real1 r1_args[1] = { norm_thresh };
+    cl::Event writeRealArgsEvent;
+    DISPATCH_LOC_WRITE(*(poolItem->realBuffer), sizeof(real1), r1_args, writeRealArgsEvent);
+
+    bitCapIntOcl bciArgs[1] = { maxQPowerOcl };
+    cl::Event writeBCIArgsEvent;
+    DISPATCH_LOC_WRITE(*(poolItem->ulongBuffer), sizeof(bitCapIntOcl), bciArgs, writeBCIArgsEvent);
+
+    size_t ngc = FixWorkItemCount(maxQPowerOcl, nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+    size_t groupCount = ngc / ngs;
+
+    BufferPtr countBuffer =
+        std::make_shared<cl::Buffer>(context, CL_MEM_READ_WRITE, sizeof(bitCapIntOcl) * groupCount);
+
+    // Wait for buffer write from limited lifetime objects
+    writeRealArgsEvent.wait();
+    writeBCIArgsEvent.wait();
+    wait_refs.clear();
+
+    WaitCall(OCL_API_NONZERO_COUNT, ngc, ngs, { stateBuffer, poolItem->ulongBuffer, poolItem->realBuffer, countBuffer },
+        sizeof(bitCapIntOcl) * ngs);
+
+    std::unique_ptr<bitCapIntOcl[]> counts(new bitCapIntOcl[groupCount]);
+    queue.enqueueReadBuffer(*countBuffer, CL_TRUE, 0, sizeof(bitCapIntOcl) * groupCount, counts.get());
+
+    bitCapIntOcl toRet = 0;
+    for (size_t i = 0; i < groupCount; i++) {
+        toRet += counts.get()[i];
+    }
+
+    return toRet;
+}
+
+/// Compact the above-threshold basis states into an (index, amplitude) map, transferring only the compacted pairs
+void QEngineOCL::GetSparseQuantumState(std::map<bitCapInt, complex>& outputMap, real1 norm_thresh)
+{
+    if (doNormalize) {
+        NormalizeState();
+    }
+
+    if (norm_thresh < ZERO_R1) {
+        norm_thresh = amplitudeFloor;
+    }
+
+    outputMap.clear();
+
+    bitCapIntOcl count = CountNonzero(norm_thresh);
+    if (count == 0) {
+        return;
+    }
+
+    PoolItemPtr poolItem = GetFreePoolItem();
+
+    real1 r1_args[1] = { norm_thresh };
+    cl::Event writeRealArgsEvent;
+    DISPATCH_LOC_WRITE(*(poolItem->realBuffer), sizeof(real1), r1_args, writeRealArgsEvent);
+
+    bitCapIntOcl bciArgs[1] = { maxQPowerOcl };
+    cl::Event writeBCIArgsEvent;
+    DISPATCH_LOC_WRITE(*(poolItem->ulongBuffer), sizeof(bitCapIntOcl), bciArgs, writeBCIArgsEvent);
+
+    BufferPtr indexBuffer = std::make_shared<cl::Buffer>(context, CL_MEM_WRITE_ONLY, sizeof(bitCapIntOcl) * count);
+    BufferPtr ampBuffer = std::make_shared<cl::Buffer>(context, CL_MEM_WRITE_ONLY, sizeof(complex) * count);
+    BufferPtr pairCountBuffer = std::make_shared<cl::Buffer>(context, CL_MEM_READ_WRITE, sizeof(unsigned int));
+    unsigned int pairCount = 0;
+    queue.enqueueWriteBuffer(*pairCountBuffer, CL_TRUE, 0, sizeof(unsigned int), &pairCount);
+
+    size_t ngc = FixWorkItemCount(maxQPowerOcl, nrmGroupCount);
+    size_t ngs = FixGroupSize(ngc, nrmGroupSize);
+
+    // Wait for buffer write from limited lifetime objects
+    writeRealArgsEvent.wait();
+    writeBCIArgsEvent.wait();
+    wait_refs.clear();
+
+    WaitCall(OCL_API_COMPACT_SPARSE, ngc, ngs,
+        { stateBuffer, poolItem->ulongBuffer, poolItem->realBuffer, indexBuffer, ampBuffer, pairCountBuffer });
+
+    std::unique_ptr<bitCapIntOcl[]> indices(new bitCapIntOcl[count]);
+    std::unique_ptr<complex[]> amps(new complex[count]);
+    queue.enqueueReadBuffer(*indexBuffer, CL_TRUE, 0, sizeof(bitCapIntOcl) * count, indices.get());
+    queue.enqueueReadBuffer(*ampBuffer, CL_TRUE, 0, sizeof(complex) * count, amps.get());
+
+    for (bitCapIntOcl i = 0; i < count; i++) {
+        outputMap[indices.get()[i]] = amps.get()[i];
+    }
+}
+
 /// Get all probabilities, in unsigned int permutation basis
 void QEngineOCL::GetProbs(real1* outputProbs) { ProbRegAll(0, qubitCount, outputProbs); }
 
+/// Stream the state vector out of the device through bounded LockSync-style mapped windows
+void QEngineOCL::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    if (doNormalize) {
+        NormalizeState();
+    }
+    clFinish();
+
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    for (bitCapIntOcl offset = 0; offset < maxQPowerOcl; offset += chunk) {
+        bitCapIntOcl length = ((maxQPowerOcl - offset) < chunk) ? (maxQPowerOcl - offset) : chunk;
+        complex* mapped = (complex*)queue.enqueueMapBuffer(
+            *stateBuffer, CL_TRUE, CL_MAP_READ, sizeof(complex) * offset, sizeof(complex) * length, NULL);
+        callback(mapped, offset, length);
+        cl::Event unmapEvent;
+        queue.enqueueUnmapMemObject(*stateBuffer, mapped, NULL, &unmapEvent);
+        unmapEvent.wait();
+    }
+}
+
+/// Stream all basis state probabilities out of the device through bounded mapped windows
+void QEngineOCL::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    if (doNormalize) {
+        NormalizeState();
+    }
+    clFinish();
+
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    bitCapIntOcl stagingLen = (maxQPowerOcl < chunk) ? maxQPowerOcl : chunk;
+    real1* probs = new real1[stagingLen];
+    for (bitCapIntOcl offset = 0; offset < maxQPowerOcl; offset += chunk) {
+        bitCapIntOcl length = ((maxQPowerOcl - offset) < chunk) ? (maxQPowerOcl - offset) : chunk;
+        complex* mapped = (complex*)queue.enqueueMapBuffer(
+            *stateBuffer, CL_TRUE, CL_MAP_READ, sizeof(complex) * offset, sizeof(complex) * length, NULL);
+        std::transform(mapped, mapped + length, probs, [](const complex& c) { return norm(c); });
+        cl::Event unmapEvent;
+        queue.enqueueUnmapMemObject(*stateBuffer, mapped, NULL, &unmapEvent);
+        unmapEvent.wait();
+        callback(probs, offset, length);
+    }
+    delete[] probs;
+}
+
 bool QEngineOCL::ApproxCompare(QEngineOCLPtr toCompare)
 {
     // If the qubit counts are unequal, these can't be approximately equal objects.
@@ -2250,7 +2984,7 @@ bool QEngineOCL::ApproxCompare(QEngineOCLPtr toCompare)
     WAIT_REAL1_SUM(*nrmBuffer, nrmGroupCount / nrmGroupSize, nrmArray, &sumSqrErr);
 
     if (!isSameContext) {
-        FreeAligned(otherStateVec);
+        FreeStateVec(otherStateVec);
     }
 
     return sumSqrErr < approxcompare_error;
@@ -2262,6 +2996,7 @@ QInterfacePtr QEngineOCL::Clone()
         doNormalize, randGlobalPhase, useHostRam, deviceID, hardware_rand_generator != NULL, false, amplitudeFloor);
 
     copyPtr->Finish();
+    JoinRunningNorm();
     copyPtr->runningNorm = runningNorm;
 
     EventVecPtr waitVec = ResetWaitEvents();
@@ -2273,7 +3008,8 @@ QInterfacePtr QEngineOCL::Clone()
 
 void QEngineOCL::NormalizeState(real1 nrm, real1 norm_thresh)
 {
-    // We might have async execution of gates still happening.
+    // We might have async execution of gates still happening, (and a deferred norm reduction to collect).
+    JoinRunningNorm();
     clFinish();
 
     if (nrm < ZERO_R1) {
@@ -2283,6 +3019,9 @@ void QEngineOCL::NormalizeState(real1 nrm, real1 norm_thresh)
         return;
     }
 
+    // Rescaling, (and especially threshold zeroing,) changes raw reduction sums, so all cached ones are dropped.
+    DirtyProbAll();
+
     if (norm_thresh < ZERO_R1) {
         norm_thresh = amplitudeFloor;
     }
@@ -2329,8 +3068,6 @@ void QEngineOCL::UpdateRunningNorm(real1 norm_thresh)
     cl::Event writeRealArgsEvent;
     DISPATCH_LOC_WRITE(*(poolItem->realBuffer), sizeof(real1), r1_args, writeRealArgsEvent);
 
-    runningNorm = ONE_R1;
-
     bitCapIntOcl bciArgs[1] = { maxQPowerOcl };
     cl::Event writeBCIArgsEvent;
     DISPATCH_LOC_WRITE(*(poolItem->ulongBuffer), sizeof(bitCapIntOcl), bciArgs, writeBCIArgsEvent);
@@ -2346,7 +3083,11 @@ void QEngineOCL::UpdateRunningNorm(real1 norm_thresh)
     QueueCall(OCL_API_UPDATENORM, ngc, ngs, { stateBuffer, poolItem->ulongBuffer, poolItem->realBuffer, nrmBuffer },
         sizeof(real1) * ngs);
 
-    WAIT_REAL1_SUM(*nrmBuffer, ngc / ngs, nrmArray, &runningNorm);
+    // The fresh reduction supersedes any outstanding one, and its own readback is deferred until the value is
+    // consumed, exactly as in Apply2x2().
+    isNormPending = true;
+    nrmPendingGroups = ngc / ngs;
+    runningNorm = REAL1_DEFAULT_ARG;
 }
 
 complex* QEngineOCL::AllocStateVec(bitCapInt elemCount, bool doForceAlloc)
@@ -2357,21 +3098,27 @@ complex* QEngineOCL::AllocStateVec(bitCapInt elemCount, bool doForceAlloc)
     }
 
     // elemCount is always a power of two, but might be smaller than QRACK_ALIGN_SIZE
+    size_t allocSize = sizeof(complex) * (bitCapIntOcl)elemCount;
+    if (allocSize < QRACK_ALIGN_SIZE) {
+        allocSize = QRACK_ALIGN_SIZE;
+    }
+
+    // Pinned (page-locked) host memory transfers at DMA speeds, where a pageable allocation transfers at
+    // staging-copy speeds, so we prefer it whenever the driver can pin this much. (FreeStateVec() recognizes
+    // pinned pointers and releases them through the OCLEngine singleton.)
+    complex* pinned = (complex*)OCLEngine::Instance()->AllocPinned(device_context, allocSize);
+    if (pinned) {
+        return pinned;
+    }
+
 #if defined(__APPLE__)
     void* toRet;
-    posix_memalign(&toRet, QRACK_ALIGN_SIZE,
-        ((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE) ? QRACK_ALIGN_SIZE
-                                                                         : sizeof(complex) * (bitCapIntOcl)elemCount);
+    posix_memalign(&toRet, QRACK_ALIGN_SIZE, allocSize);
     return (complex*)toRet;
 #elif defined(_WIN32) && !defined(__CYGWIN__)
-    return (complex*)_aligned_malloc(((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE)
-            ? QRACK_ALIGN_SIZE
-            : sizeof(complex) * (bitCapIntOcl)elemCount,
-        QRACK_ALIGN_SIZE);
+    return (complex*)_aligned_malloc(allocSize, QRACK_ALIGN_SIZE);
 #else
-    return (complex*)aligned_alloc(QRACK_ALIGN_SIZE,
-        ((sizeof(complex) * (bitCapIntOcl)elemCount) < QRACK_ALIGN_SIZE) ? QRACK_ALIGN_SIZE
-                                                                         : sizeof(complex) * (bitCapIntOcl)elemCount);
+    return (complex*)aligned_alloc(QRACK_ALIGN_SIZE, allocSize);
 #endif
 }
 
@@ -14,6 +14,81 @@
 
 namespace Qrack {
 
+void QEngine::DirtyProbQubit(const bitLenInt& qubit)
+{
+    // A qubit past the end of the versions vector can't appear in any cached entry, (ProbCacheStore() resizes first).
+    if (qubit < probCacheVersions.size()) {
+        probCacheVersions[qubit]++;
+    }
+}
+
+void QEngine::DirtyProbMask(const bitCapInt& mask)
+{
+    bitCapInt v = mask;
+    while (v) {
+        bitCapInt power = v & (~v + ONE_BCI);
+        v ^= power;
+        DirtyProbQubit(log2(power));
+    }
+}
+
+void QEngine::DirtyProbPowers(const bitCapInt* qPowersSorted, const bitLenInt& count)
+{
+    for (bitLenInt i = 0; i < count; i++) {
+        DirtyProbQubit(log2(qPowersSorted[i]));
+    }
+}
+
+void QEngine::DirtyProbAll() { probCache.clear(); }
+
+bool QEngine::ProbCacheLookup(const bitCapInt& mask, const bitCapInt& permutation, real1& prob)
+{
+    std::map<std::pair<bitCapInt, bitCapInt>, ProbCacheEntry>::iterator it =
+        probCache.find(std::make_pair(mask, permutation));
+    if (it == probCache.end()) {
+        return false;
+    }
+
+    ProbCacheEntry& entry = it->second;
+    bool isValid = (entry.nrm == runningNorm);
+
+    bitCapInt v = mask;
+    size_t i = 0;
+    while (isValid && v) {
+        bitCapInt power = v & (~v + ONE_BCI);
+        v ^= power;
+        isValid = (entry.versions[i] == probCacheVersions[log2(power)]);
+        i++;
+    }
+
+    if (!isValid) {
+        probCache.erase(it);
+        return false;
+    }
+
+    prob = entry.prob;
+    return true;
+}
+
+void QEngine::ProbCacheStore(const bitCapInt& mask, const bitCapInt& permutation, const real1& prob)
+{
+    if (probCacheVersions.size() < qubitCount) {
+        probCacheVersions.resize(qubitCount, 0U);
+    }
+
+    ProbCacheEntry& entry = probCache[std::make_pair(mask, permutation)];
+    entry.prob = prob;
+    entry.nrm = runningNorm;
+    entry.versions.clear();
+
+    bitCapInt v = mask;
+    while (v) {
+        bitCapInt power = v & (~v + ONE_BCI);
+        v ^= power;
+        entry.versions.push_back(probCacheVersions[log2(power)]);
+    }
+}
+
 /// PSEUDO-QUANTUM - Acts like a measurement gate, except with a specified forced result.
 bool QEngine::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
 {
@@ -10,8 +10,17 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <fstream>
+#include <stdexcept>
 #include <thread>
 
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "qengine_cpu.hpp"
 
 #if ENABLE_COMPLEX_X2
@@ -41,21 +50,45 @@ QEngineCPU::QEngineCPU(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_
     real1 norm_thresh, std::vector<bitLenInt> devList)
     : QEngine(qBitCount, rgp, doNorm, randomGlobalPhase, true, useHardwareRNG, norm_thresh)
     , isSparse(useSparseStateVec)
+    , isLazyPerm(true)
+    , lazyPerm(initState)
 {
     SetConcurrencyLevel(std::thread::hardware_concurrency());
 
+    // The buffer stays unfilled until the first operation that needs amplitude storage, (see MaterializeLazyPerm(),)
+    // so construction is O(1) past the allocation itself:
     stateVec = AllocStateVec(maxQPower);
-    stateVec->clear();
 
     if (phaseFac == complex(-999.0, -999.0)) {
-        stateVec->write(initState, GetNonunitaryPhase());
+        lazyPhase = GetNonunitaryPhase();
     } else {
-        stateVec->write(initState, phaseFac);
+        lazyPhase = phaseFac;
+    }
+}
+
+/**
+ * Write the deferred permutation-basis state into the buffer.
+ *
+ * Construction and SetPermutation() only record an index and phase, so a shot loop that resets the simulator
+ * thousands of times per circuit pays no zero-fill per reset; the single full write pass happens here, on the first
+ * operation that actually needs amplitude storage. (All synchronous methods reach this through Finish(); Apply2x2()
+ * handles the lazy state directly, which keeps permutation-preserving gates O(1), too.)
+ */
+void QEngineCPU::MaterializeLazyPerm()
+{
+    if (!isLazyPerm) {
+        return;
     }
+
+    isLazyPerm = false;
+    stateVec->clear();
+    stateVec->write(lazyPerm, lazyPhase);
 }
 
 complex QEngineCPU::GetAmplitude(bitCapInt perm)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -64,10 +97,14 @@ complex QEngineCPU::GetAmplitude(bitCapInt perm)
 
 void QEngineCPU::SetAmplitude(bitCapInt perm, complex amp)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
 
+    DirtyProbAll();
+
     runningNorm -= norm(stateVec->read(perm));
     runningNorm += norm(amp);
     stateVec->write(perm, amp);
@@ -75,20 +112,26 @@ void QEngineCPU::SetAmplitude(bitCapInt perm, complex amp)
 
 void QEngineCPU::SetPermutation(bitCapInt perm, complex phaseFac)
 {
-    stateVec->clear();
+    // Any earlier deferred permutation state is simply replaced, so it's dropped before the drain, not materialized:
+    isLazyPerm = false;
+    Finish();
+
+    DirtyProbAll();
+    truncationError = ZERO_R1;
+
+    isLazyPerm = true;
+    lazyPerm = perm;
 
     if (phaseFac == complex(-999.0, -999.0)) {
-        complex phase;
         if (randGlobalPhase) {
             real1 angle = Rand() * 2.0 * PI_R1;
-            phase = complex(cos(angle), sin(angle));
+            lazyPhase = complex(cos(angle), sin(angle));
         } else {
-            phase = complex(ONE_R1, ZERO_R1);
+            lazyPhase = complex(ONE_R1, ZERO_R1);
         }
-        stateVec->write(perm, phase);
     } else {
         real1 nrm = abs(phaseFac);
-        stateVec->write(perm, phaseFac / nrm);
+        lazyPhase = phaseFac / nrm;
     }
 
     runningNorm = ONE_R1;
@@ -97,6 +140,13 @@ void QEngineCPU::SetPermutation(bitCapInt perm, complex phaseFac)
 /// Set arbitrary pure quantum state, in unsigned int permutation basis
 void QEngineCPU::SetQuantumState(const complex* inputState)
 {
+    // copy_in() overwrites every amplitude, so a deferred permutation state needn't be materialized first:
+    isLazyPerm = false;
+    Finish();
+
+    DirtyProbAll();
+    truncationError = ZERO_R1;
+
     stateVec->copy_in(inputState);
     runningNorm = ONE_R1;
 }
@@ -104,6 +154,8 @@ void QEngineCPU::SetQuantumState(const complex* inputState)
 /// Get pure quantum state, in unsigned int permutation basis
 void QEngineCPU::GetQuantumState(complex* outputState)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -111,9 +163,132 @@ void QEngineCPU::GetQuantumState(complex* outputState)
     stateVec->copy_out(outputState);
 }
 
+/// Stream the state vector out through a bounded staging buffer, in strided blocks
+void QEngineCPU::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    Finish();
+
+    if (doNormalize && (runningNorm != ONE_R1)) {
+        NormalizeState();
+    }
+
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    bitCapIntOcl maxQPowerOcl = (bitCapIntOcl)maxQPower;
+    complex* staging = new complex[(maxQPowerOcl < chunk) ? maxQPowerOcl : chunk];
+    for (bitCapIntOcl offset = 0; offset < maxQPowerOcl; offset += chunk) {
+        bitCapIntOcl length = ((maxQPowerOcl - offset) < chunk) ? (maxQPowerOcl - offset) : chunk;
+        stateVec->copy_out(staging, offset, length);
+        callback(staging, offset, length);
+    }
+    delete[] staging;
+}
+
+/// Stream all basis state probabilities out through a bounded staging buffer, in strided blocks
+void QEngineCPU::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    Finish();
+
+    if (doNormalize && (runningNorm != ONE_R1)) {
+        NormalizeState();
+    }
+
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    bitCapIntOcl maxQPowerOcl = (bitCapIntOcl)maxQPower;
+    bitCapIntOcl stagingLen = (maxQPowerOcl < chunk) ? maxQPowerOcl : chunk;
+    complex* staging = new complex[stagingLen];
+    real1* probs = new real1[stagingLen];
+    for (bitCapIntOcl offset = 0; offset < maxQPowerOcl; offset += chunk) {
+        bitCapIntOcl length = ((maxQPowerOcl - offset) < chunk) ? (maxQPowerOcl - offset) : chunk;
+        stateVec->copy_out(staging, offset, length);
+        std::transform(staging, staging + length, probs, [](const complex& c) { return norm(c); });
+        callback(probs, offset, length);
+    }
+    delete[] probs;
+    delete[] staging;
+}
+
+/// Save the state vector to a snapshot file, streaming through a bounded staging buffer instead of a full copy
+void QEngineCPU::SaveState(const std::string& path)
+{
+    Finish();
+
+    if (doNormalize && (runningNorm != ONE_R1)) {
+        NormalizeState();
+    }
+
+    std::ofstream ofs(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        throw std::invalid_argument("SaveState() could not open file for writing");
+    }
+
+    WriteSnapshotHeader(ofs, qubitCount);
+
+    const bitCapIntOcl chunkElems = 0x40000U;
+    bitCapIntOcl maxQPowerOcl = (bitCapIntOcl)maxQPower;
+    complex* chunk = new complex[(maxQPowerOcl < chunkElems) ? maxQPowerOcl : chunkElems];
+    for (bitCapIntOcl offset = 0; offset < maxQPowerOcl; offset += chunkElems) {
+        bitCapIntOcl length = ((maxQPowerOcl - offset) < chunkElems) ? (maxQPowerOcl - offset) : chunkElems;
+        stateVec->copy_out(chunk, offset, length);
+        ofs.write((const char*)chunk, sizeof(complex) * length);
+    }
+    delete[] chunk;
+
+    if (!ofs) {
+        throw std::invalid_argument("SaveState() failed to write the snapshot");
+    }
+}
+
+/// Restore the state vector from a snapshot file, mapping its amplitude data copy-on-write as the live buffer
+void QEngineCPU::LoadState(const std::string& path)
+{
+// Snapshot files always hold full single-precision amplitudes, (SaveState() writes through copy_out(),) so a
+// half-storage build can't adopt the mapping in place and takes the converting read path below, instead.
+#if !ENABLE_COMPLEX_HALF && !(defined(_WIN32) && !defined(__CYGWIN__))
+    if (!isSparse) {
+        Finish();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("LoadState() could not open file for reading");
+        }
+
+        StateSnapshotHeader header;
+        size_t mappedLen = sizeof(complex) * (bitCapIntOcl)maxQPower;
+        struct stat st;
+        if ((::read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) || (fstat(fd, &st) != 0) ||
+            ((size_t)st.st_size < (QRACK_SNAPSHOT_DATA_OFFSET + mappedLen))) {
+            close(fd);
+            throw std::invalid_argument("LoadState() snapshot file is truncated");
+        }
+
+        try {
+            ValidateSnapshotHeader(header, qubitCount);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+
+        // MAP_PRIVATE is copy-on-write: the file's pages are adopted without a read pass, untouched amplitudes stay
+        // backed by the page cache, and later gates never write back to the snapshot.
+        void* mapped = mmap(NULL, mappedLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, QRACK_SNAPSHOT_DATA_OFFSET);
+        close(fd);
+
+        if (mapped != MAP_FAILED) {
+            ResetStateVec(std::make_shared<StateVectorArray>(maxQPower, (complex*)mapped, mappedLen));
+            runningNorm = ONE_R1;
+            return;
+        }
+    }
+#endif
+
+    QInterface::LoadState(path);
+}
+
 /// Get all probabilities, in unsigned int permutation basis
 void QEngineCPU::GetProbs(real1* outputProbs)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -127,6 +302,135 @@ void QEngineCPU::GetProbs(real1* outputProbs)
  * A fundamental operation used by almost all gates.
  */
 
+void QEngineCPU::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
+    const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh)
+{
+#if ENABLE_QSTATS
+    apply2x2Count++;
+#endif
+
+    // Unitaries preserve the probabilities of any mask disjoint from their qubits, so only the involved qubits are
+    // marked dirty, (at dispatch, on the caller's thread).
+    DirtyProbPowers(qPowersSorted, bitCount);
+
+    if (isLazyPerm) {
+        // On a deferred permutation-basis state, (see MaterializeLazyPerm(),) the kernel's pairs cover exactly the
+        // indices matching either offset under the gate's power mask, and only one amplitude is nonzero:
+        bitCapInt powerMask = 0;
+        for (bitLenInt i = 0; i < bitCount; i++) {
+            powerMask |= qPowersSorted[i];
+        }
+        const bool atOffset1 = ((lazyPerm & powerMask) == (offset1 & powerMask));
+        const bool atOffset2 = ((lazyPerm & powerMask) == (offset2 & powerMask));
+
+        if (!atOffset1 && !atOffset2) {
+            // Unmatched controls: the gate doesn't touch the one nonzero amplitude, so the state stays deferred.
+            return;
+        }
+
+        const bool isPhase = (norm(mtrx[1]) == ZERO_R1) && (norm(mtrx[2]) == ZERO_R1);
+        const bool isInvert = (norm(mtrx[0]) == ZERO_R1) && (norm(mtrx[3]) == ZERO_R1);
+        if ((isPhase || isInvert) && !(doNormalize && doCalcNorm)) {
+            // Phase and invert matrices map one basis state to one basis state, so the whole gate is an O(1) update
+            // of the stored index and phase, (the same cases Apply2x2Special() covers on a dense buffer):
+            if (isPhase) {
+                lazyPhase *= atOffset1 ? mtrx[0] : mtrx[3];
+            } else if (atOffset1) {
+                lazyPerm = (lazyPerm & ~powerMask) | (offset2 & powerMask);
+                lazyPhase *= mtrx[2];
+            } else {
+                lazyPerm = (lazyPerm & ~powerMask) | (offset1 & powerMask);
+                lazyPhase *= mtrx[1];
+            }
+            return;
+        }
+
+        // Any other matrix leaves at most two nonzero amplitudes, so materialization fuses into the gate: one
+        // write-only pass replaces both the reset's zero-fill and the general kernel's read-modify-write sweep.
+        const bitCapInt perm1 = (lazyPerm & ~powerMask) | (offset1 & powerMask);
+        const bitCapInt perm2 = (lazyPerm & ~powerMask) | (offset2 & powerMask);
+        const complex amp1 = (atOffset1 ? mtrx[0] : mtrx[1]) * lazyPhase;
+        const complex amp2 = (atOffset1 ? mtrx[2] : mtrx[3]) * lazyPhase;
+
+        if (doCalcNorm && doNormalize && (bitCount == 1)) {
+            runningNorm = norm(amp1) + norm(amp2);
+        }
+
+        isLazyPerm = false;
+        Dispatch([this, perm1, amp1, perm2, amp2]() {
+            stateVec->clear();
+            stateVec->write2(perm1, amp1, perm2, amp2);
+        });
+
+        return;
+    }
+
+    // The caller's matrix and sorted powers arrays may not outlive the deferred operation, so copy them:
+    BitOp mtrxCopy(new complex[4], std::default_delete<complex[]>());
+    std::copy(mtrx, mtrx + 4, mtrxCopy.get());
+    std::shared_ptr<bitCapInt> qPowersCopy(new bitCapInt[bitCount], std::default_delete<bitCapInt[]>());
+    std::copy(qPowersSorted, qPowersSorted + bitCount, qPowersCopy.get());
+
+    Dispatch([this, offset1, offset2, mtrxCopy, bitCount, qPowersCopy, doCalcNorm, norm_thresh]() {
+        Apply2x2Dispatched(offset1, offset2, mtrxCopy.get(), bitCount, qPowersCopy.get(), doCalcNorm, norm_thresh);
+    });
+}
+
+/**
+ * Single bit gates with diagonal or anti-diagonal matrices, (Z, S, T, RZ, and the phase/invert halves of controlled
+ * gates,) touch at most one amplitude product per matrix row. When no on-the-fly normalization is pending, we can
+ * skip the general 2x2 multiply, (and, for diagonal matrices, any identity row entirely,) roughly halving memory
+ * traffic. Returns "false" if the general case kernel is needed, instead.
+ */
+bool QEngineCPU::Apply2x2Special(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
+    const bitCapInt* qPowersSorted, bool doCalcNorm)
+{
+    if ((bitCount != 1U) || stateVec->is_sparse() || (doNormalize && (doCalcNorm || (runningNorm != ONE_R1)))) {
+        return false;
+    }
+
+    bool isPhase = (norm(mtrx[1]) == ZERO_R1) && (norm(mtrx[2]) == ZERO_R1);
+    bool isInvert = (norm(mtrx[0]) == ZERO_R1) && (norm(mtrx[3]) == ZERO_R1);
+    if (!isPhase && !isInvert) {
+        return false;
+    }
+
+    ParallelFunc fn;
+    if (isPhase) {
+        complex topLeft = mtrx[0];
+        complex bottomRight = mtrx[3];
+        if (topLeft == ONE_CMPLX) {
+            if (bottomRight == ONE_CMPLX) {
+                // Identity gate - no-op
+                return true;
+            }
+            fn = [&](const bitCapInt lcv, const int cpu) {
+                stateVec->write(lcv + offset2, bottomRight * stateVec->read(lcv + offset2));
+            };
+        } else if (bottomRight == ONE_CMPLX) {
+            fn = [&](const bitCapInt lcv, const int cpu) {
+                stateVec->write(lcv + offset1, topLeft * stateVec->read(lcv + offset1));
+            };
+        } else {
+            fn = [&](const bitCapInt lcv, const int cpu) {
+                stateVec->write2(lcv + offset1, topLeft * stateVec->read(lcv + offset1), lcv + offset2,
+                    bottomRight * stateVec->read(lcv + offset2));
+            };
+        }
+    } else {
+        complex topRight = mtrx[1];
+        complex bottomLeft = mtrx[2];
+        fn = [&](const bitCapInt lcv, const int cpu) {
+            complex Y0 = stateVec->read(lcv + offset1);
+            stateVec->write2(lcv + offset1, topRight * stateVec->read(lcv + offset2), lcv + offset2, bottomLeft * Y0);
+        };
+    }
+
+    par_for_mask(0, maxQPower, qPowersSorted, 1U, fn);
+
+    return true;
+}
+
 #if ENABLE_COMPLEX_X2
 
 union ComplexUnion {
@@ -141,9 +445,13 @@ union ComplexUnion {
     }
 };
 
-void QEngineCPU::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
-    const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh)
+void QEngineCPU::Apply2x2Dispatched(bitCapInt offset1, bitCapInt offset2, const complex* mtrx,
+    const bitLenInt bitCount, const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh)
 {
+    if (Apply2x2Special(offset1, offset2, mtrx, bitCount, qPowersSorted, doCalcNorm)) {
+        return;
+    }
+
     doCalcNorm = (doCalcNorm || (runningNorm != ONE_R1)) && doNormalize && (bitCount == 1);
 
     if (norm_thresh < ZERO_R1) {
@@ -221,9 +529,13 @@ void QEngineCPU::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* m
     }
 }
 #else
-void QEngineCPU::Apply2x2(bitCapInt offset1, bitCapInt offset2, const complex* mtrx, const bitLenInt bitCount,
-    const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh)
+void QEngineCPU::Apply2x2Dispatched(bitCapInt offset1, bitCapInt offset2, const complex* mtrx,
+    const bitLenInt bitCount, const bitCapInt* qPowersSorted, bool doCalcNorm, real1 norm_thresh)
 {
+    if (Apply2x2Special(offset1, offset2, mtrx, bitCount, qPowersSorted, doCalcNorm)) {
+        return;
+    }
+
     doCalcNorm = (doCalcNorm || (runningNorm != ONE_R1)) && doNormalize && (bitCount == 1);
 
     if (norm_thresh < ZERO_R1) {
@@ -303,12 +615,17 @@ void QEngineCPU::UniformlyControlledSingleBit(const bitLenInt* controls, const b
     bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
     const bitCapInt& mtrxSkipValueMask)
 {
+    Finish();
+
     // If there are no controls, the base case should be the non-controlled single bit gate.
     if (controlLen == 0) {
         ApplySingleBit(mtrxs + (bitCapIntOcl)(mtrxSkipValueMask * 4U), qubitIndex);
         return;
     }
 
+    // Only the target's amplitudes change, so masks disjoint from it keep their cached reductions.
+    DirtyProbQubit(qubitIndex);
+
     bitCapInt targetPower = pow2(qubitIndex);
 
     real1 nrm = ONE_R1 / std::sqrt(runningNorm);
@@ -376,6 +693,9 @@ void QEngineCPU::UniformlyControlledSingleBit(const bitLenInt* controls, const b
  */
 bitLenInt QEngineCPU::Compose(QEngineCPUPtr toCopy)
 {
+    Finish();
+    toCopy->Finish();
+
     // TODO: Sparse optimization
     bitLenInt result = qubitCount;
 
@@ -389,26 +709,44 @@ bitLenInt QEngineCPU::Compose(QEngineCPUPtr toCopy)
 
     bitLenInt nQubitCount = qubitCount + toCopy->qubitCount;
     bitCapInt nMaxQPower = pow2(nQubitCount);
+    bitCapInt oMaxQPower = maxQPower;
     bitCapInt startMask = maxQPower - ONE_BCI;
     bitCapInt endMask = (toCopy->maxQPower - ONE_BCI) << qubitCount;
 
     StateVectorPtr nStateVec = AllocStateVec(nMaxQPower);
     stateVec->isReadLocked = false;
 
-    ParallelFunc fn = [&](const bitCapInt lcv, const int cpu) {
-        nStateVec->write(lcv, stateVec->read(lcv & startMask) * toCopy->stateVec->read((lcv & endMask) >> qubitCount));
-    };
     if (stateVec->is_sparse() || toCopy->stateVec->is_sparse()) {
-        par_for_sparse_compose(
-            CastStateVecSparse()->iterable(), toCopy->CastStateVecSparse()->iterable(), qubitCount, fn);
-    } else {
-        par_for(0, nMaxQPower, fn);
+        // Writing the product set through write() would serialize on the destination shard locks, so the sparse
+        // tensor product bulk-builds the destination map by shard ownership instead:
+        std::dynamic_pointer_cast<StateVectorSparse>(nStateVec)
+            ->compose(CastStateVecSparse(), toCopy->CastStateVecSparse(), qubitCount);
+
+        SetQubitCount(nQubitCount);
+
+        ResetStateVec(nStateVec);
+
+        return result;
     }
 
+    // Dense path: the old amplitudes move into the low block of the fresh buffer first, so the old buffer is released
+    // before any upper page of the fresh one is touched, and peak committed footprint stays near the grown buffer
+    // plus "toCopy", rather than additionally the whole old buffer. (DecomposeDispose is the symmetric shrink.)
+    par_for(0, oMaxQPower, [&](const bitCapInt lcv, const int cpu) { nStateVec->write(lcv, stateVec->read(lcv)); });
+
     SetQubitCount(nQubitCount);
 
     ResetStateVec(nStateVec);
 
+    // The tensor product expands in place. Every upper block entry only reads the low block, so the upper blocks can
+    // fill in any order; the low block is its own source, so it scales last:
+    par_for(oMaxQPower, nMaxQPower, [&](const bitCapInt lcv, const int cpu) {
+        stateVec->write(lcv, stateVec->read(lcv & startMask) * toCopy->stateVec->read((lcv & endMask) >> result));
+    });
+
+    complex amp0 = toCopy->stateVec->read(0);
+    par_for(0, oMaxQPower, [&](const bitCapInt lcv, const int cpu) { stateVec->write(lcv, stateVec->read(lcv) * amp0); });
+
     return result;
 }
 
@@ -418,6 +756,9 @@ bitLenInt QEngineCPU::Compose(QEngineCPUPtr toCopy)
  */
 bitLenInt QEngineCPU::Compose(QEngineCPUPtr toCopy, bitLenInt start)
 {
+    Finish();
+    toCopy->Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -458,6 +799,8 @@ bitLenInt QEngineCPU::Compose(QEngineCPUPtr toCopy, bitLenInt start)
  */
 std::map<QInterfacePtr, bitLenInt> QEngineCPU::Compose(std::vector<QInterfacePtr> toCopy)
 {
+    Finish();
+
     std::map<QInterfacePtr, bitLenInt> ret;
 
     bitLenInt i;
@@ -476,6 +819,7 @@ std::map<QInterfacePtr, bitLenInt> QEngineCPU::Compose(std::vector<QInterfacePtr
 
     for (i = 0; i < toComposeCount; i++) {
         QEngineCPUPtr src = std::dynamic_pointer_cast<Qrack::QEngineCPU>(toCopy[i]);
+        src->Finish();
         if ((src->doNormalize) && (src->runningNorm != ONE_R1)) {
             src->NormalizeState();
         }
@@ -516,6 +860,16 @@ std::map<QInterfacePtr, bitLenInt> QEngineCPU::Compose(std::vector<QInterfacePtr
  */
 void QEngineCPU::DecomposeDispose(bitLenInt start, bitLenInt length, QEngineCPUPtr destination)
 {
+    Finish();
+    if (destination) {
+        // Every amplitude of the destination is written below, so any deferred permutation state is just dropped,
+        // rather than materialized by the drain:
+        if (length != 0) {
+            destination->isLazyPerm = false;
+        }
+        destination->Finish();
+    }
+
     if (length == 0) {
         return;
     }
@@ -600,7 +954,14 @@ void QEngineCPU::DecomposeDispose(bitLenInt start, bitLenInt length, QEngineCPUP
     } else {
         SetQubitCount(nLength);
     }
-    ResetStateVec(AllocStateVec(maxQPower));
+
+    // Everything the remainder depends on has already been reduced into the probability/angle arrays above, so, for
+    // a dense state vector, its amplitudes can be written straight back into the low portion of the existing buffer,
+    // which is then shrunk in place. (A second full-width allocation here would dominate peak memory footprint, at
+    // high widths.) A sparse state vector has no dense buffer to reuse, so it is simply replaced.
+    if (isSparse) {
+        ResetStateVec(AllocStateVec(maxQPower));
+    }
 
     par_for(0, remainderPower, [&](const bitCapInt lcv, const int cpu) {
         stateVec->write(lcv,
@@ -608,6 +969,15 @@ void QEngineCPU::DecomposeDispose(bitLenInt start, bitLenInt length, QEngineCPUP
                 complex(cos(remainderStateAngle[(bitCapIntOcl)lcv]), sin(remainderStateAngle[(bitCapIntOcl)lcv])));
     });
 
+    if (!isSparse) {
+        if (maxQPower > remainderPower) {
+            // The whole register was decomposed, and the minimum engine width is 1 qubit.
+            stateVec->write(remainderPower, ZERO_CMPLX);
+        }
+
+        CastStateVecArray()->shrink(maxQPower);
+    }
+
     delete[] remainderStateProb;
     delete[] remainderStateAngle;
     delete[] partStateProb;
@@ -623,6 +993,8 @@ void QEngineCPU::Dispose(bitLenInt start, bitLenInt length) { DecomposeDispose(s
 
 void QEngineCPU::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
 {
+    Finish();
+
     if (length == 0) {
         return;
     }
@@ -670,6 +1042,8 @@ void QEngineCPU::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPe
 /// PSEUDO-QUANTUM Direct measure of bit probability to be in |1> state
 real1 QEngineCPU::Prob(bitLenInt qubit)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -677,6 +1051,10 @@ real1 QEngineCPU::Prob(bitLenInt qubit)
     bitCapInt qPower = pow2(qubit);
     real1 oneChance = 0;
 
+    if (ProbCacheLookup(qPower, qPower, oneChance)) {
+        return oneChance;
+    }
+
     int numCores = GetConcurrencyLevel();
     real1* oneChanceBuff = new real1[numCores]();
 
@@ -698,12 +1076,17 @@ real1 QEngineCPU::Prob(bitLenInt qubit)
 
     delete[] oneChanceBuff;
 
-    return clampProb(oneChance);
+    oneChance = clampProb(oneChance);
+    ProbCacheStore(qPower, qPower, oneChance);
+
+    return oneChance;
 }
 
 /// PSEUDO-QUANTUM Direct measure of full register probability to be in permutation state
 real1 QEngineCPU::ProbAll(bitCapInt fullRegister)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
@@ -714,15 +1097,23 @@ real1 QEngineCPU::ProbAll(bitCapInt fullRegister)
 // Returns probability of permutation of the register
 real1 QEngineCPU::ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
 
+    bitCapInt regMask = bitRegMask(start, length);
+    bitCapInt perm = permutation << start;
+
+    real1 prob = ZERO_R1;
+    if (ProbCacheLookup(regMask, perm, prob)) {
+        return prob;
+    }
+
     int num_threads = GetConcurrencyLevel();
     real1* probs = new real1[num_threads]();
 
-    bitCapInt perm = permutation << start;
-
     ParallelFunc fn = [&](const bitCapInt lcv, const int cpu) { probs[cpu] += norm(stateVec->read(lcv | perm)); };
     stateVec->isReadLocked = false;
     if (stateVec->is_sparse()) {
@@ -732,23 +1123,71 @@ real1 QEngineCPU::ProbReg(const bitLenInt& start, const bitLenInt& length, const
     }
     stateVec->isReadLocked = true;
 
-    real1 prob = ZERO_R1;
     for (int thrd = 0; thrd < num_threads; thrd++) {
         prob += probs[thrd];
     }
 
     delete[] probs;
 
-    return clampProb(prob);
+    prob = clampProb(prob);
+    ProbCacheStore(regMask, perm, prob);
+
+    return prob;
+}
+
+// Returns the joint probability distribution over every permutation of the register, in one pass
+void QEngineCPU::ProbRegAll(const bitLenInt& start, const bitLenInt& length, real1* probsArray)
+{
+    Finish();
+
+    if (doNormalize && (runningNorm != ONE_R1)) {
+        NormalizeState();
+    }
+
+    bitCapIntOcl lengthPower = pow2Ocl(length);
+
+    if (stateVec->is_sparse() || (lengthPower < (bitCapIntOcl)GetConcurrencyLevel())) {
+        // Too few output permutations to spread across the pool, (or a sparse vector, with its own iteration
+        // machinery); the generic per-permutation ProbReg reductions are each parallel in themselves, instead.
+        QEngine::ProbRegAll(start, length, probsArray);
+        return;
+    }
+
+    bitCapInt maxJ = maxQPower >> length;
+    bitCapInt qMask = pow2(start) - ONE_BCI;
+
+    // This is a single traversal of the state vector, parallelized across output permutations rather than
+    // amplitudes, (on the same schedule as the OpenCL "probregall" kernel). Notably, MReg samples from this joint
+    // distribution, so an n bit register read costs one pass here plus one collapse, not a reduction per bit.
+    stateVec->isReadLocked = false;
+    par_for(0, lengthPower, [&](const bitCapInt lcv, const int cpu) {
+        bitCapInt perm = lcv << start;
+        real1 prob = ZERO_R1;
+        bitCapInt i;
+        for (bitCapInt j = 0; j < maxJ; j++) {
+            i = j & qMask;
+            i |= ((j ^ i) << length);
+            prob += norm(stateVec->read(i | perm));
+        }
+        probsArray[(bitCapIntOcl)lcv] = clampProb(prob);
+    });
+    stateVec->isReadLocked = true;
 }
 
 // Returns probability of permutation of the mask
 real1 QEngineCPU::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
 {
+    Finish();
+
     if (doNormalize && (runningNorm != ONE_R1)) {
         NormalizeState();
     }
 
+    real1 prob = ZERO_R1;
+    if (ProbCacheLookup(mask, permutation, prob)) {
+        return prob;
+    }
+
     bitCapInt v = mask; // count the number of bits set in v
     bitCapInt oldV;
     bitLenInt length; // c accumulates the total bits set in v
@@ -772,18 +1211,23 @@ real1 QEngineCPU::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
 
     delete[] skipPowers;
 
-    real1 prob = ZERO_R1;
     for (int thrd = 0; thrd < num_threads; thrd++) {
         prob += probs[thrd];
     }
 
     delete[] probs;
 
-    return clampProb(prob);
+    prob = clampProb(prob);
+    ProbCacheStore(mask, permutation, prob);
+
+    return prob;
 }
 
 bool QEngineCPU::ApproxCompare(QEngineCPUPtr toCompare)
 {
+    Finish();
+    toCompare->Finish();
+
     // If the qubit counts are unequal, these can't be approximately equal objects.
     if (qubitCount != toCompare->qubitCount) {
         return false;
@@ -838,6 +1282,8 @@ bool QEngineCPU::ApproxCompare(QEngineCPUPtr toCompare)
 /// For chips with a zero flag, flip the phase of the state where the register equals zero.
 void QEngineCPU::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
 {
+    Finish();
+
     par_for_skip(0, maxQPower, pow2(start), length,
         [&](const bitCapInt lcv, const int cpu) { stateVec->write(lcv, -stateVec->read(lcv)); });
 }
@@ -845,6 +1291,8 @@ void QEngineCPU::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
 /// The 6502 uses its carry flag also as a greater-than/less-than flag, for the CMP operation.
 void QEngineCPU::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
 {
+    Finish();
+
     bitCapInt regMask = bitRegMask(start, length);
     bitCapInt flagMask = pow2(flagIndex);
 
@@ -857,6 +1305,8 @@ void QEngineCPU::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLen
 /// This is an expedient for an adaptive Grover's search for a function's global minimum.
 void QEngineCPU::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
 {
+    Finish();
+
     bitCapInt regMask = bitRegMask(start, length);
 
     par_for(0, maxQPower, [&](const bitCapInt lcv, const int cpu) {
@@ -867,6 +1317,8 @@ void QEngineCPU::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenI
 
 void QEngineCPU::NormalizeState(real1 nrm, real1 norm_thresh)
 {
+    Finish();
+
     if (nrm < ZERO_R1) {
         nrm = runningNorm;
     }
@@ -874,10 +1326,14 @@ void QEngineCPU::NormalizeState(real1 nrm, real1 norm_thresh)
         return;
     }
 
+    // Rescaling, (and especially threshold zeroing,) changes raw reduction sums, so all cached ones are dropped.
+    DirtyProbAll();
+
     if (norm_thresh < ZERO_R1) {
         norm_thresh = amplitudeFloor;
     }
 
+    real1 nrmTotal = nrm;
     nrm = ONE_R1 / std::sqrt(nrm);
 
     if (norm_thresh <= ZERO_R1) {
@@ -886,13 +1342,27 @@ void QEngineCPU::NormalizeState(real1 nrm, real1 norm_thresh)
             stateVec->write(lcv, amp);
         });
     } else {
+        int numCores = GetConcurrencyLevel();
+        real1* discardedBuff = new real1[numCores]();
+
         par_for(0, maxQPower, [&](const bitCapInt lcv, const int cpu) {
             complex amp = stateVec->read(lcv);
             if (norm(amp) < norm_thresh) {
+                // (A zero write also erases a sparse vector's entry, so truncation compacts sparse storage.)
+                discardedBuff[cpu] += norm(amp);
                 amp = ZERO_CMPLX;
             }
             stateVec->write(lcv, nrm * amp);
         });
+
+        real1 discarded = ZERO_R1;
+        for (int i = 0; i < numCores; i++) {
+            discarded += discardedBuff[i];
+        }
+        delete[] discardedBuff;
+
+        // The discarded fraction of the pre-normalization total bounds the drift of any reported probability.
+        truncationError += discarded / nrmTotal;
     }
 
     runningNorm = ONE_R1;
@@ -903,20 +1373,52 @@ void QEngineCPU::UpdateRunningNorm(real1 norm_thresh)
     if (norm_thresh < ZERO_R1) {
         norm_thresh = amplitudeFloor;
     }
-    runningNorm = par_norm(maxQPower, stateVec, norm_thresh);
+
+    // A deferred permutation-basis state has exactly one amplitude, so the reduction is O(1), (and the state stays
+    // deferred, since nothing here needs the buffer):
+    if (isLazyPerm) {
+        const real1 nrm = norm(lazyPhase);
+        runningNorm = (nrm < norm_thresh) ? ZERO_R1 : nrm;
+        return;
+    }
+
+    // The reduction is deferred to the dispatch thread, in order behind any pending gates, so the caller overlaps it
+    // with its next work. (Every reader of runningNorm calls Finish(), first, which joins the reduction.)
+    Dispatch([this, norm_thresh]() { runningNorm = par_norm(maxQPower, stateVec, norm_thresh); });
 }
 
 StateVectorPtr QEngineCPU::AllocStateVec(bitCapInt elemCount)
 {
     if (isSparse) {
         return std::make_shared<StateVectorSparse>(elemCount);
-    } else {
-        return std::make_shared<StateVectorArray>(elemCount);
     }
+
+    // Hand back the pooled buffer when its capacity matches, so back-to-back arithmetic gates ping-pong between two
+    // slabs with no allocator traffic. (Reuse is equivalent to a fresh allocation: the buffer is not zeroed in
+    // either case, and call sites that need a cleared target already clear() it.)
+    if (pooledStateVec) {
+        StateVectorPtr toRet = pooledStateVec;
+        pooledStateVec = NULL;
+        if (toRet->get_capacity() == elemCount) {
+            return toRet;
+        }
+    }
+
+    return std::make_shared<StateVectorArray>(elemCount);
 }
 
 void QEngineCPU::ResetStateVec(StateVectorPtr sv)
 {
+    // Every whole-state-vector rewrite, (arithmetic, Compose, register-wide X, and the like,) lands here.
+    DirtyProbAll();
+
+    // A same-capacity swap is the arithmetic gate pattern: pool the outgoing dense buffer for the next
+    // AllocStateVec, instead of paying an allocator round trip (and first-touch page faults, at full register
+    // width) on every gate. Width-changing swaps, like Compose and Dispose, free the old buffer as before.
+    if (!isSparse && stateVec && (stateVec->get_capacity() == sv->get_capacity())) {
+        pooledStateVec = stateVec;
+    }
+
     // Removing this first line would not be a leak, but it's good to have the internal interface:
     FreeStateVec();
     stateVec = sv;
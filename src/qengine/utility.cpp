@@ -16,11 +16,16 @@ namespace Qrack {
 
 QInterfacePtr QEngineCPU::Clone()
 {
+    Finish();
+
     QInterfacePtr clone =
         CreateQuantumInterface(QINTERFACE_CPU, qubitCount, 0, rand_generator, complex(ONE_R1, ZERO_R1), doNormalize,
             randGlobalPhase, false, 0, (hardware_rand_generator == NULL) ? false : true, isSparse);
     if (stateVec) {
-        std::dynamic_pointer_cast<QEngineCPU>(clone)->stateVec->copy(stateVec);
+        // copy() overwrites every amplitude of the fresh engine, so its deferred |0> needn't be materialized:
+        QEngineCPUPtr cloneCpu = std::dynamic_pointer_cast<QEngineCPU>(clone);
+        cloneCpu->isLazyPerm = false;
+        cloneCpu->stateVec->copy(stateVec);
     }
     return clone;
 }
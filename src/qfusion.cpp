@@ -0,0 +1,819 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QFusion adds an optional "gate fusion" layer on top of a QEngine or QUnit.
+// Single bit gates are buffered in per-bit 2x2 complex matrices, to reduce the cost
+// of successive application of single bit gates to the same bit.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include "qfactory.hpp"
+#include "qfusion.hpp"
+
+namespace Qrack {
+
+QFusion::QFusion(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp,
+    complex phaseFac, bool doNorm, bool randomGlobalPhase, bool useHostMem, int deviceID, bool useHardwareRNG,
+    bool useSparseStateVec, real1 norm_thresh)
+    : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
+    , bitBuffers(qBitCount)
+    , bitControls(qBitCount)
+{
+    qReg = CreateQuantumInterface(eng, qBitCount, initState, rgp, phaseFac, doNorm, randomGlobalPhase, useHostMem,
+        deviceID, useHardwareRNG, useSparseStateVec, norm_thresh);
+}
+
+QFusion::QFusion(QInterfacePtr target)
+    : QInterface(target->GetQubitCount())
+    , qReg(target)
+    , bitBuffers(target->GetQubitCount())
+    , bitControls(target->GetQubitCount())
+{
+    // Intentionally left blank.
+}
+
+void QFusion::EraseControlRefs(const BitBufferPtr& bfr, const bitLenInt& qubitIndex)
+{
+    bitLenInt start = qubitIndex;
+    bitLenInt length = 1U;
+    if (bfr->isArithmetic) {
+        ArithmeticBuffer* aBfr = dynamic_cast<ArithmeticBuffer*>(bfr.get());
+        start = aBfr->start;
+        length = aBfr->length;
+    }
+
+    for (bitLenInt i = 0; i < bfr->controls.size(); i++) {
+        std::vector<bitLenInt>& controlled = bitControls[bfr->controls[i]];
+        for (bitLenInt j = 0; j < length; j++) {
+            std::vector<bitLenInt>::iterator found = std::find(controlled.begin(), controlled.end(), start + j);
+            if (found != controlled.end()) {
+                controlled.erase(found);
+            }
+        }
+    }
+}
+
+void QFusion::DiscardBit(const bitLenInt& qubitIndex)
+{
+    BitBufferPtr bfr = bitBuffers[qubitIndex];
+    if (bfr == NULL) {
+        return;
+    }
+
+    EraseControlRefs(bfr, qubitIndex);
+
+    if (bfr->isArithmetic) {
+        ArithmeticBuffer* aBfr = dynamic_cast<ArithmeticBuffer*>(bfr.get());
+        for (bitLenInt i = 0; i < aBfr->length; i++) {
+            bitBuffers[aBfr->start + i] = NULL;
+        }
+    } else {
+        bitBuffers[qubitIndex] = NULL;
+    }
+}
+
+void QFusion::FlushBit(const bitLenInt& qubitIndex)
+{
+    // Buffers controlled by this bit were queued first, so they have to be applied first, to preserve order:
+    std::vector<bitLenInt> controlledBits(bitControls[qubitIndex]);
+    for (bitLenInt i = 0; i < controlledBits.size(); i++) {
+        FlushBit(controlledBits[i]);
+    }
+
+    BitBufferPtr bfr = bitBuffers[qubitIndex];
+    if (bfr == NULL) {
+        return;
+    }
+
+    if (bfr->IsIdentity()) {
+        // (Approximately or exactly) the identity operator can be thrown away, instead of applied.
+        DiscardBit(qubitIndex);
+        return;
+    }
+
+    EraseControlRefs(bfr, qubitIndex);
+    bfr->Apply(qReg, qubitIndex, &bitBuffers);
+}
+
+void QFusion::FlushReg(const bitLenInt& start, const bitLenInt& length)
+{
+    for (bitLenInt i = 0; i < length; i++) {
+        FlushBit(start + i);
+    }
+}
+
+void QFusion::FlushList(const bitLenInt* bitList, const bitLenInt& bitListLen)
+{
+    for (bitLenInt i = 0; i < bitListLen; i++) {
+        FlushBit(bitList[i]);
+    }
+}
+
+void QFusion::FlushMask(const bitCapInt& mask)
+{
+    for (bitLenInt i = 0; i < qubitCount; i++) {
+        if (bitSlice(i, mask)) {
+            FlushBit(i);
+        }
+    }
+}
+
+void QFusion::FlushAll()
+{
+    for (bitLenInt i = 0; i < qubitCount; i++) {
+        FlushBit(i);
+    }
+}
+
+void QFusion::DiscardAll()
+{
+    std::fill(bitBuffers.begin(), bitBuffers.end(), (BitBufferPtr)NULL);
+    for (bitLenInt i = 0; i < qubitCount; i++) {
+        bitControls[i].clear();
+    }
+}
+
+void QFusion::BufferGate(const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& qubitIndex, const complex* mtrx)
+{
+    // Below the fusion threshold, the overhead of buffering is higher than the cost of (cheap) direct application:
+    if (qubitCount < MIN_FUSION_BITS) {
+        if (controlLen == 0) {
+            qReg->ApplySingleBit(mtrx, qubitIndex);
+        } else if (anti) {
+            qReg->ApplyAntiControlledSingleBit(controls, controlLen, qubitIndex, mtrx);
+        } else {
+            qReg->ApplyControlledSingleBit(controls, controlLen, qubitIndex, mtrx);
+        }
+        return;
+    }
+
+    bitLenInt i;
+
+    // Buffers already controlled by the target bit can't be reordered after the new gate:
+    std::vector<bitLenInt> controlledBits(bitControls[qubitIndex]);
+    for (i = 0; i < controlledBits.size(); i++) {
+        FlushBit(controlledBits[i]);
+    }
+
+    // A pending buffer on a control bit has to be applied before the bit is used as a control. (If a control bit has
+    // no buffer of its own, buffers it controls can legally stay queued, since gates that merely share a control
+    // commute.)
+    for (i = 0; i < controlLen; i++) {
+        if (bitBuffers[controls[i]]) {
+            FlushBit(controls[i]);
+        }
+    }
+
+    BitBufferPtr nBfr = std::make_shared<GateBuffer>(anti, controls, controlLen, mtrx);
+    if (!nBfr->Combinable(bitBuffers[qubitIndex])) {
+        // Flush the old buffer, to maintain the buffer per bit as a single 2x2 matrix:
+        FlushBit(qubitIndex);
+    }
+
+    BitBufferPtr bfr = bitBuffers[qubitIndex];
+    BitBufferPtr cBfr = nBfr->LeftRightCompose(bfr);
+
+#if ENABLE_QSTATS
+    if (bfr) {
+        // The new gate was composed into an already-pending buffer, instead of costing a state vector sweep.
+        fusionHitCount++;
+    }
+#endif
+
+    if (cBfr->IsIdentity()) {
+        // The composition cancels out, and the buffer can be thrown away.
+        if (bfr) {
+            DiscardBit(qubitIndex);
+        }
+        return;
+    }
+
+    bitBuffers[qubitIndex] = cBfr;
+
+    if (bfr == NULL) {
+        // ("Combinable" buffers have the same controls, so the back references are already registered, otherwise.)
+        for (i = 0; i < controlLen; i++) {
+            bitControls[controls[i]].push_back(qubitIndex);
+        }
+    }
+}
+
+void QFusion::BufferArithmetic(
+    bitLenInt* controls, bitLenInt controlLen, int toAdd, bitLenInt inOutStart, bitLenInt length)
+{
+    if (qubitCount < MIN_FUSION_BITS) {
+        if (controlLen == 0) {
+            if (toAdd > 0) {
+                qReg->INC(toAdd, inOutStart, length);
+            } else if (toAdd < 0) {
+                qReg->DEC(-toAdd, inOutStart, length);
+            }
+        } else {
+            if (toAdd > 0) {
+                qReg->CINC(toAdd, inOutStart, length, controls, controlLen);
+            } else if (toAdd < 0) {
+                qReg->CDEC(-toAdd, inOutStart, length, controls, controlLen);
+            }
+        }
+        return;
+    }
+
+    bitLenInt i, j;
+
+    // Buffers controlled by any bit of the register can't be reordered after the new arithmetic:
+    for (i = 0; i < length; i++) {
+        std::vector<bitLenInt> controlledBits(bitControls[inOutStart + i]);
+        for (j = 0; j < controlledBits.size(); j++) {
+            FlushBit(controlledBits[j]);
+        }
+    }
+
+    // A pending buffer on a control bit has to be applied before the bit is used as a control:
+    for (i = 0; i < controlLen; i++) {
+        if (bitBuffers[controls[i]]) {
+            FlushBit(controls[i]);
+        }
+    }
+
+    BitBufferPtr nBfr = std::make_shared<ArithmeticBuffer>(false, controls, controlLen, inOutStart, length, toAdd);
+    for (i = 0; i < length; i++) {
+        if (!nBfr->Combinable(bitBuffers[inOutStart + i])) {
+            FlushReg(inOutStart, length);
+            break;
+        }
+    }
+
+    BitBufferPtr bfr = bitBuffers[inOutStart];
+    BitBufferPtr cBfr = nBfr->LeftRightCompose(bfr);
+
+    // Keep the accumulated offset reduced modulo the width of the register, so it can't overflow:
+    ArithmeticBuffer* aBfr = dynamic_cast<ArithmeticBuffer*>(cBfr.get());
+    aBfr->toAdd %= (int)pow2Ocl(length);
+
+    if (cBfr->IsIdentity()) {
+        if (bfr) {
+            DiscardBit(inOutStart);
+        }
+        return;
+    }
+
+    for (i = 0; i < length; i++) {
+        bitBuffers[inOutStart + i] = cBfr;
+    }
+
+    if (bfr == NULL) {
+        for (i = 0; i < controlLen; i++) {
+            for (j = 0; j < length; j++) {
+                bitControls[controls[i]].push_back(inOutStart + j);
+            }
+        }
+    }
+}
+
+void QFusion::ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex) { BufferGate(false, NULL, 0, qubitIndex, mtrx); }
+
+void QFusion::ApplyControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    BufferGate(false, controls, controlLen, target, mtrx);
+}
+
+void QFusion::ApplyAntiControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    BufferGate(true, controls, controlLen, target, mtrx);
+}
+
+void QFusion::UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+    bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+    const bitCapInt& mtrxSkipValueMask)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubitIndex);
+    qReg->UniformlyControlledSingleBit(
+        controls, controlLen, qubitIndex, mtrxs, mtrxSkipPowers, mtrxSkipLen, mtrxSkipValueMask);
+}
+
+void QFusion::SetQuantumState(const complex* inputState)
+{
+    // The new state vector overwrites any pending operations:
+    DiscardAll();
+    qReg->SetQuantumState(inputState);
+}
+
+void QFusion::GetQuantumState(complex* outputState)
+{
+    FlushAll();
+    qReg->GetQuantumState(outputState);
+}
+
+void QFusion::GetProbs(real1* outputProbs)
+{
+    FlushAll();
+    qReg->GetProbs(outputProbs);
+}
+
+complex QFusion::GetAmplitude(bitCapInt perm)
+{
+    FlushAll();
+    return qReg->GetAmplitude(perm);
+}
+
+void QFusion::SetAmplitude(bitCapInt perm, complex amp)
+{
+    FlushAll();
+    qReg->SetAmplitude(perm, amp);
+}
+
+void QFusion::SetPermutation(bitCapInt perm, complex phaseFac)
+{
+    // The new state vector overwrites any pending operations:
+    DiscardAll();
+    qReg->SetPermutation(perm, phaseFac);
+}
+
+bitLenInt QFusion::Compose(QFusionPtr toCopy)
+{
+    FlushAll();
+    toCopy->FlushAll();
+    bitLenInt toReturn = qReg->Compose(toCopy->qReg);
+    SetQubitCount(qReg->GetQubitCount());
+    return toReturn;
+}
+
+bitLenInt QFusion::Compose(QFusionPtr toCopy, bitLenInt start)
+{
+    FlushAll();
+    toCopy->FlushAll();
+    bitLenInt toReturn = qReg->Compose(toCopy->qReg, start);
+    SetQubitCount(qReg->GetQubitCount());
+    return toReturn;
+}
+
+void QFusion::Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest)
+{
+    QFusionPtr destFusion = std::dynamic_pointer_cast<QFusion>(dest);
+    FlushAll();
+    destFusion->DiscardAll();
+    qReg->Decompose(start, length, destFusion->qReg);
+    SetQubitCount(qReg->GetQubitCount());
+    destFusion->SetQubitCount(destFusion->qReg->GetQubitCount());
+}
+
+void QFusion::Dispose(bitLenInt start, bitLenInt length)
+{
+    FlushAll();
+    qReg->Dispose(start, length);
+    SetQubitCount(qReg->GetQubitCount());
+}
+
+void QFusion::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
+{
+    FlushAll();
+    qReg->Dispose(start, length, disposedPerm);
+    SetQubitCount(qReg->GetQubitCount());
+}
+
+void QFusion::CSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->CSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QFusion::AntiCSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->AntiCSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QFusion::CSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->CSqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QFusion::AntiCSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->AntiCSqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QFusion::CISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->CISqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QFusion::AntiCISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    FlushList(controls, controlLen);
+    FlushBit(qubit1);
+    FlushBit(qubit2);
+    qReg->AntiCISqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+bool QFusion::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
+{
+    // A single bit unitary on a different bit commutes with the measurement projector, so only the measured bit needs
+    // to be flushed:
+    FlushBit(qubit);
+    return qReg->ForceM(qubit, result, doForce, doApply);
+}
+
+bitCapInt QFusion::ForceM(const bitLenInt* bits, const bitLenInt& length, const bool* values, bool doApply)
+{
+    FlushList(bits, length);
+    return qReg->ForceM(bits, length, values, doApply);
+}
+
+bitCapInt QFusion::ForceMReg(bitLenInt start, bitLenInt length, bitCapInt result, bool doForce, bool doApply)
+{
+    FlushReg(start, length);
+    return qReg->ForceMReg(start, length, result, doForce, doApply);
+}
+
+void QFusion::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    qReg->ROL(shift, start, length);
+}
+
+void QFusion::ROR(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    qReg->ROR(shift, start, length);
+}
+
+void QFusion::INC(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    if (length > (bitLenInt)(sizeof(int) * bitsInByte - 2U)) {
+        // Wider than the buffered offset type; apply directly.
+        FlushReg(start, length);
+        qReg->INC(toAdd, start, length);
+        return;
+    }
+    BufferArithmetic(NULL, 0, (int)(bitCapIntOcl)(toAdd & pow2Mask(length)), start, length);
+}
+
+void QFusion::CINC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
+{
+    if (length > (bitLenInt)(sizeof(int) * bitsInByte - 2U)) {
+        FlushList(controls, controlLen);
+        FlushReg(inOutStart, length);
+        qReg->CINC(toAdd, inOutStart, length, controls, controlLen);
+        return;
+    }
+    BufferArithmetic(controls, controlLen, (int)(bitCapIntOcl)(toAdd & pow2Mask(length)), inOutStart, length);
+}
+
+void QFusion::DEC(bitCapInt toSub, bitLenInt start, bitLenInt length)
+{
+    if (length > (bitLenInt)(sizeof(int) * bitsInByte - 2U)) {
+        FlushReg(start, length);
+        qReg->DEC(toSub, start, length);
+        return;
+    }
+    BufferArithmetic(NULL, 0, -(int)(bitCapIntOcl)(toSub & pow2Mask(length)), start, length);
+}
+
+void QFusion::CDEC(bitCapInt toSub, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
+{
+    if (length > (bitLenInt)(sizeof(int) * bitsInByte - 2U)) {
+        FlushList(controls, controlLen);
+        FlushReg(inOutStart, length);
+        qReg->CDEC(toSub, inOutStart, length, controls, controlLen);
+        return;
+    }
+    BufferArithmetic(controls, controlLen, -(int)(bitCapIntOcl)(toSub & pow2Mask(length)), inOutStart, length);
+}
+
+void QFusion::INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->INCC(toAdd, start, length, carryIndex);
+}
+
+void QFusion::INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex)
+{
+    FlushReg(start, length);
+    FlushBit(overflowIndex);
+    qReg->INCS(toAdd, start, length, overflowIndex);
+}
+
+void QFusion::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(overflowIndex);
+    FlushBit(carryIndex);
+    qReg->INCSC(toAdd, start, length, overflowIndex, carryIndex);
+}
+
+void QFusion::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->INCSC(toAdd, start, length, carryIndex);
+}
+
+void QFusion::INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    qReg->INCBCD(toAdd, start, length);
+}
+
+void QFusion::INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->INCBCDC(toAdd, start, length, carryIndex);
+}
+
+void QFusion::DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->DECC(toSub, start, length, carryIndex);
+}
+
+void QFusion::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(overflowIndex);
+    FlushBit(carryIndex);
+    qReg->DECSC(toSub, start, length, overflowIndex, carryIndex);
+}
+
+void QFusion::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->DECSC(toSub, start, length, carryIndex);
+}
+
+void QFusion::DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    FlushReg(start, length);
+    FlushBit(carryIndex);
+    qReg->DECBCDC(toSub, start, length, carryIndex);
+}
+
+void QFusion::MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    FlushReg(inOutStart, length);
+    FlushReg(carryStart, length);
+    qReg->MUL(toMul, inOutStart, carryStart, length);
+}
+
+void QFusion::DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    FlushReg(inOutStart, length);
+    FlushReg(carryStart, length);
+    qReg->DIV(toDiv, inOutStart, carryStart, length);
+}
+
+void QFusion::MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->MULModNOut(toMul, modN, inStart, outStart, length);
+}
+
+void QFusion::IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->IMULModNOut(toMul, modN, inStart, outStart, length);
+}
+
+void QFusion::POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->POWModNOut(base, modN, inStart, outStart, length);
+}
+
+void QFusion::CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    FlushList(controls, controlLen);
+    FlushReg(inOutStart, length);
+    FlushReg(carryStart, length);
+    qReg->CMUL(toMul, inOutStart, carryStart, length, controls, controlLen);
+}
+
+void QFusion::CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    FlushList(controls, controlLen);
+    FlushReg(inOutStart, length);
+    FlushReg(carryStart, length);
+    qReg->CDIV(toDiv, inOutStart, carryStart, length, controls, controlLen);
+}
+
+void QFusion::CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    FlushList(controls, controlLen);
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->CMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QFusion::CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    FlushList(controls, controlLen);
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->CIMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QFusion::CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    FlushList(controls, controlLen);
+    FlushReg(inStart, length);
+    FlushReg(outStart, length);
+    qReg->CPOWModNOut(base, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QFusion::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    qReg->ZeroPhaseFlip(start, length);
+}
+
+void QFusion::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
+{
+    FlushReg(start, length);
+    FlushBit(flagIndex);
+    qReg->CPhaseFlipIfLess(greaterPerm, start, length, flagIndex);
+}
+
+void QFusion::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    qReg->PhaseFlipIfLess(greaterPerm, start, length);
+}
+
+void QFusion::PhaseFlip()
+{
+    // A global phase flip commutes with any pending buffer, so nothing needs to be flushed:
+    qReg->PhaseFlip();
+}
+
+bitCapInt QFusion::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    unsigned char* values, bool resetValue)
+{
+    FlushReg(indexStart, indexLength);
+    FlushReg(valueStart, valueLength);
+    return qReg->IndexedLDA(indexStart, indexLength, valueStart, valueLength, values, resetValue);
+}
+
+bitCapInt QFusion::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    FlushReg(indexStart, indexLength);
+    FlushReg(valueStart, valueLength);
+    FlushBit(carryIndex);
+    return qReg->IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+}
+
+bitCapInt QFusion::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    FlushReg(indexStart, indexLength);
+    FlushReg(valueStart, valueLength);
+    FlushBit(carryIndex);
+    return qReg->IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+}
+
+void QFusion::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    FlushReg(indexStart, indexLength);
+    FlushBit(carryIndex);
+    qReg->IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, values);
+}
+
+void QFusion::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
+{
+    FlushReg(start, length);
+    qReg->Hash(start, length, values);
+}
+
+void QFusion::Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (qubitIndex1 == qubitIndex2) {
+        return;
+    }
+    FlushBit(qubitIndex1);
+    FlushBit(qubitIndex2);
+    qReg->Swap(qubitIndex1, qubitIndex2);
+}
+
+void QFusion::ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    FlushBit(qubitIndex1);
+    FlushBit(qubitIndex2);
+    qReg->ISwap(qubitIndex1, qubitIndex2);
+}
+
+void QFusion::SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    FlushBit(qubitIndex1);
+    FlushBit(qubitIndex2);
+    qReg->SqrtSwap(qubitIndex1, qubitIndex2);
+}
+
+void QFusion::ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    FlushBit(qubitIndex1);
+    FlushBit(qubitIndex2);
+    qReg->ISqrtSwap(qubitIndex1, qubitIndex2);
+}
+
+void QFusion::FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    FlushBit(qubitIndex1);
+    FlushBit(qubitIndex2);
+    qReg->FSim(theta, phi, qubitIndex1, qubitIndex2);
+}
+
+real1 QFusion::Prob(bitLenInt qubitIndex)
+{
+    // A single bit unitary on a different bit can't change this bit's marginal probability:
+    FlushBit(qubitIndex);
+    return qReg->Prob(qubitIndex);
+}
+
+real1 QFusion::ProbAll(bitCapInt fullRegister)
+{
+    FlushAll();
+    return qReg->ProbAll(fullRegister);
+}
+
+real1 QFusion::ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation)
+{
+    FlushReg(start, length);
+    return qReg->ProbReg(start, length, permutation);
+}
+
+real1 QFusion::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
+{
+    FlushMask(mask);
+    return qReg->ProbMask(mask, permutation);
+}
+
+bool QFusion::ApproxCompare(QFusionPtr toCompare)
+{
+    FlushAll();
+    toCompare->FlushAll();
+    return qReg->ApproxCompare(toCompare->qReg);
+}
+
+void QFusion::UpdateRunningNorm(real1 norm_thresh)
+{
+    FlushAll();
+    qReg->UpdateRunningNorm(norm_thresh);
+}
+
+void QFusion::NormalizeState(real1 nrm, real1 norm_thresh)
+{
+    FlushAll();
+    qReg->NormalizeState(nrm, norm_thresh);
+}
+
+bool QFusion::TrySeparate(bitLenInt start, bitLenInt length)
+{
+    FlushReg(start, length);
+    return qReg->TrySeparate(start, length);
+}
+
+QInterfacePtr QFusion::Clone()
+{
+    FlushAll();
+    return std::make_shared<QFusion>(qReg->Clone());
+}
+} // namespace Qrack
@@ -10,6 +10,7 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include "qcircuit.hpp"
 #include "qinterface.hpp"
 
 #define C_SQRT1_2 complex(M_SQRT1_2, ZERO_R1)
@@ -330,4 +331,81 @@ void QInterface::TimeEvolve(Hamiltonian h, real1 timeDiff)
     }
 }
 
+void QInterface::TimeEvolve(Hamiltonian h, real1 timeDiff, bitCapInt trotterSteps)
+{
+    // Record one Trotter slice into a QCircuit: each op's exponential is computed exactly once for the timestep,
+    // commuting terms on the same target and control set fuse at record time, and the fused slice is replayed per
+    // step, (through the engine's asynchronous gate dispatch).
+    QCircuit slice;
+
+    for (bitLenInt i = 0; i < h.size(); i++) {
+        HamiltonianOpPtr op = h[i];
+        complex* opMtrx = op->matrix.get();
+
+        bitCapIntOcl maxJ = 4;
+        if (op->uniform) {
+            maxJ *= pow2Ocl(op->controlLen);
+        }
+
+        std::unique_ptr<complex[]> mtrx(new complex[maxJ]);
+        for (bitCapIntOcl j = 0; j < maxJ; j++) {
+            mtrx[j] = opMtrx[j] * (-timeDiff);
+        }
+
+        std::set<bitLenInt> ctrls(op->controls, op->controls + op->controlLen);
+
+        // QCircuitGate payload permutation bit "k" is the k-th lowest control index, while the op's "toggles" and
+        // uniform payload indexes follow the order of its "controls" array, so map between the two conventions:
+        std::vector<bitLenInt> sorted(ctrls.begin(), ctrls.end());
+        std::vector<bitLenInt> ctrlMap(op->controlLen);
+        for (bitLenInt j = 0; j < op->controlLen; j++) {
+            ctrlMap[j] = std::distance(sorted.begin(), std::find(sorted.begin(), sorted.end(), op->controls[j]));
+        }
+
+        // An X conjugation of a control, as "toggles" requests, is the same as flipping that bit of the activation
+        // permutation:
+        bitCapInt toggleMask = 0;
+        if (op->toggles) {
+            for (bitLenInt j = 0; j < op->controlLen; j++) {
+                if (op->toggles[j]) {
+                    toggleMask |= pow2(ctrlMap[j]);
+                }
+            }
+        }
+
+        if (op->uniform) {
+            complex expMtrx[4];
+            for (bitCapIntOcl j = 0; j < pow2Ocl(op->controlLen); j++) {
+                exp2x2(mtrx.get() + (j * 4U), expMtrx);
+                bitCapInt perm = 0;
+                for (bitLenInt k = 0; k < op->controlLen; k++) {
+                    if ((j >> k) & ONE_BCI) {
+                        perm |= pow2(ctrlMap[k]);
+                    }
+                }
+                slice.AppendGate(std::make_shared<QCircuitGate>(op->targetBit, expMtrx, ctrls, perm ^ toggleMask));
+            }
+        } else {
+            // (As in Exp(), the matrix is imaginary exponentiated.)
+            complex timesI[4];
+            complex toApply[4];
+            for (bitLenInt j = 0; j < 4; j++) {
+                timesI[j] = complex(ZERO_R1, ONE_R1) * mtrx[j];
+            }
+            exp2x2(timesI, toApply);
+
+            if (op->controlLen == 0) {
+                slice.AppendGate(std::make_shared<QCircuitGate>(op->targetBit, toApply));
+            } else {
+                bitCapInt perm = op->anti ? 0 : pow2Mask(op->controlLen);
+                slice.AppendGate(std::make_shared<QCircuitGate>(op->targetBit, toApply, ctrls, perm ^ toggleMask));
+            }
+        }
+    }
+
+    for (bitCapInt step = 0; step < trotterSteps; step++) {
+        slice.Run(this);
+    }
+}
+
 } // namespace Qrack
@@ -10,6 +10,11 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
 #include "qinterface.hpp"
 
 namespace Qrack {
@@ -675,30 +680,28 @@ std::map<bitCapInt, int> QInterface::MultiShotMeasureMask(
     real1* probsArray = new real1[subsetCap];
     ProbMaskAll(mask, probsArray);
 
-    real1 totProb = 0;
-    for (j = 0; j < subsetCap; j++) {
-        totProb += probsArray[j];
+    // The distribution is reduced exactly once; every shot after that is just a binary search against its
+    // cumulative form.
+    for (j = 1; j < subsetCap; j++) {
+        probsArray[j] += probsArray[j - 1U];
     }
+    real1 totProb = probsArray[subsetCap - 1U];
 
     std::map<bitCapInt, int> results;
-    real1 maskProb, cumProb;
     bitCapInt key;
     for (unsigned int shot = 0; shot < shots; shot++) {
-        maskProb = Rand();
-        cumProb = ZERO_R1;
-        for (j = 0; j < subsetCap; j++) {
-            cumProb += probsArray[j];
-            if ((maskProb < cumProb) || (cumProb >= totProb)) {
-                key = 0;
-                for (i = 0; i < qPowerCount; i++) {
-                    if (j & pow2(i)) {
-                        key |= maskMap[i];
-                    }
-                }
-                results[key]++;
-                break;
+        j = (bitCapIntOcl)std::distance(
+            probsArray, std::lower_bound(probsArray, probsArray + subsetCap, Rand() * totProb));
+        if (j >= subsetCap) {
+            j = subsetCap - 1U;
+        }
+        key = 0;
+        for (i = 0; i < qPowerCount; i++) {
+            if (j & pow2(i)) {
+                key |= maskMap[i];
             }
         }
+        results[key]++;
     }
 
     delete[] probsArray;
@@ -706,4 +709,135 @@ std::map<bitCapInt, int> QInterface::MultiShotMeasureMask(
     return results;
 }
 
+void QInterface::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    // Generic fallback: a full copy, streamed out in chunks. (Engines that can produce the state incrementally
+    // override this with a bounded staging buffer.)
+    complex* stateVec = new complex[(bitCapIntOcl)maxQPower];
+    GetQuantumState(stateVec);
+
+    for (bitCapInt offset = 0; offset < maxQPower; offset += chunkElems) {
+        bitCapInt length = ((maxQPower - offset) < chunkElems) ? (maxQPower - offset) : chunkElems;
+        callback(stateVec + (bitCapIntOcl)offset, offset, length);
+    }
+
+    delete[] stateVec;
+}
+
+void QInterface::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    real1* probsArray = new real1[(bitCapIntOcl)maxQPower];
+    GetProbs(probsArray);
+
+    for (bitCapInt offset = 0; offset < maxQPower; offset += chunkElems) {
+        bitCapInt length = ((maxQPower - offset) < chunkElems) ? (maxQPower - offset) : chunkElems;
+        callback(probsArray + (bitCapIntOcl)offset, offset, length);
+    }
+
+    delete[] probsArray;
+}
+
+void QInterface::ValidateSnapshotHeader(const StateSnapshotHeader& header, const bitLenInt& qubitCount)
+{
+    if (std::memcmp(header.magic, "QRKS", 4U) != 0) {
+        throw std::invalid_argument("LoadState() file is not a Qrack state snapshot");
+    }
+    if (header.version != QRACK_SNAPSHOT_VERSION) {
+        throw std::invalid_argument("LoadState() snapshot format version is not supported");
+    }
+    if (header.ampBytes != sizeof(complex)) {
+        throw std::invalid_argument("LoadState() snapshot amplitude precision does not match this build");
+    }
+    if (header.endianTag != 0x0102030405060708ULL) {
+        throw std::invalid_argument("LoadState() snapshot byte order does not match this platform");
+    }
+    if (header.qubitCount != qubitCount) {
+        throw std::invalid_argument("LoadState() snapshot qubit count does not match this instance");
+    }
+}
+
+void QInterface::WriteSnapshotHeader(std::ostream& os, const bitLenInt& qubitCount)
+{
+    StateSnapshotHeader header;
+    std::memcpy(header.magic, "QRKS", 4U);
+    header.version = QRACK_SNAPSHOT_VERSION;
+    header.qubitCount = qubitCount;
+    header.ampBytes = sizeof(complex);
+    header.endianTag = 0x0102030405060708ULL;
+    os.write((const char*)&header, sizeof(header));
+
+    std::vector<char> pad(QRACK_SNAPSHOT_DATA_OFFSET - sizeof(header), 0);
+    os.write(&(pad[0]), pad.size());
+}
+
+void QInterface::SaveState(const std::string& path)
+{
+    complex* stateVec = new complex[(bitCapIntOcl)maxQPower];
+    GetQuantumState(stateVec);
+
+    std::ofstream ofs(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        delete[] stateVec;
+        throw std::invalid_argument("SaveState() could not open file for writing");
+    }
+
+    WriteSnapshotHeader(ofs, qubitCount);
+    ofs.write((const char*)stateVec, sizeof(complex) * (bitCapIntOcl)maxQPower);
+
+    delete[] stateVec;
+
+    if (!ofs) {
+        throw std::invalid_argument("SaveState() failed to write the snapshot");
+    }
+}
+
+void QInterface::LoadState(const std::string& path)
+{
+    std::ifstream ifs(path.c_str(), std::ios::binary);
+    if (!ifs) {
+        throw std::invalid_argument("LoadState() could not open file for reading");
+    }
+
+    StateSnapshotHeader header;
+    ifs.read((char*)&header, sizeof(header));
+    if (!ifs) {
+        throw std::invalid_argument("LoadState() snapshot file is truncated");
+    }
+    ValidateSnapshotHeader(header, qubitCount);
+
+    ifs.seekg(QRACK_SNAPSHOT_DATA_OFFSET);
+
+    complex* stateVec = new complex[(bitCapIntOcl)maxQPower];
+    ifs.read((char*)stateVec, sizeof(complex) * (bitCapIntOcl)maxQPower);
+    if (!ifs) {
+        delete[] stateVec;
+        throw std::invalid_argument("LoadState() snapshot file is truncated");
+    }
+
+    SetQuantumState(stateVec);
+    delete[] stateVec;
+}
+
+#if ENABLE_QSTATS
+QInterfaceStats QInterface::GetStats()
+{
+    QInterfaceStats stats;
+    stats.apply2x2Count = apply2x2Count;
+    stats.fusionHits = fusionHitCount;
+    stats.separationTries = separationTryCount;
+    stats.separationHits = separationHitCount;
+    // A monolithic engine is one fully-entangled "shard":
+    stats.maxShardWidth = qubitCount;
+    return stats;
+}
+
+void QInterface::ResetStats()
+{
+    apply2x2Count = 0;
+    fusionHitCount = 0;
+    separationTryCount = 0;
+    separationHitCount = 0;
+}
+#endif
+
 } // namespace Qrack
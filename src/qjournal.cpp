@@ -0,0 +1,1481 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QJournal is an optional append-only operation journal layered over any QInterface
+// engine. Each dispatched gate is recorded compactly (opcode, qubits, parameters) as
+// it is forwarded, and Replay() rebuilds the state deterministically from a journal
+// file, so a crashed or migrated run recovers from a snapshot plus a gate tail
+// instead of requiring a full 2^n dump per gate.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include <cstring>
+#include <stdexcept>
+
+#include "qfactory.hpp"
+#include "qjournal.hpp"
+
+namespace Qrack {
+
+QJournal::QJournal(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp,
+    complex phaseFac, bool doNorm, bool randomGlobalPhase, bool useHostMem, int deviceId, bool useHardwareRNG,
+    bool useSparseStateVec, real1 norm_thresh)
+    : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
+    , engineType(eng)
+    , deviceID(deviceId)
+    , useHostRam(useHostMem)
+    , useRDRAND(useHardwareRNG)
+    , isSparse(useSparseStateVec)
+{
+    qReg = CreateQuantumInterface(engineType, qBitCount, initState, rgp, phaseFac, doNorm, randomGlobalPhase,
+        useHostMem, deviceId, useHardwareRNG, useSparseStateVec, norm_thresh);
+}
+
+QInterfacePtr QJournal::MakeEngine(bitLenInt length, bitCapInt perm)
+{
+    return CreateQuantumInterface(engineType, length, perm, rand_generator, CMPLX_DEFAULT_ARG, doNormalize,
+        randGlobalPhase, useHostRam, deviceID, useRDRAND, isSparse, amplitudeFloor);
+}
+
+void QJournal::StartJournal(const std::string& path)
+{
+    if (Journaling()) {
+        StopJournal();
+    }
+
+    journalPath = path;
+    journalStream.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!journalStream) {
+        throw std::invalid_argument("StartJournal() could not open journal file for writing");
+    }
+
+    JournalFileHeader header;
+    std::memcpy(header.magic, "QRKJ", 4U);
+    header.version = QRACK_JOURNAL_VERSION;
+    header.qubitCount = qubitCount;
+    header.ampBytes = sizeof(complex);
+    header.endianTag = 0x0102030405060708ULL;
+    journalStream.write((const char*)&header, sizeof(header));
+    EndRecord();
+}
+
+void QJournal::StopJournal()
+{
+    if (Journaling()) {
+        journalStream.close();
+    }
+}
+
+void QJournal::Checkpoint(const std::string& snapshotPath)
+{
+    if (!Journaling()) {
+        throw std::invalid_argument("Checkpoint() requires an open journal");
+    }
+
+    qReg->SaveState(snapshotPath);
+
+    // With the snapshot durable, the journal restarts from it:
+    journalStream.close();
+    StartJournal(journalPath);
+}
+
+void QJournal::WriteOp(const JournalOpCode& op)
+{
+    uint8_t opByte = (uint8_t)op;
+    journalStream.write((const char*)&opByte, sizeof(opByte));
+}
+
+void QJournal::WriteBit(const bitLenInt& bit)
+{
+    uint32_t val = (uint32_t)bit;
+    journalStream.write((const char*)&val, sizeof(val));
+}
+
+void QJournal::WriteCap(const bitCapInt& cap)
+{
+    uint64_t val = (uint64_t)cap;
+    journalStream.write((const char*)&val, sizeof(val));
+}
+
+void QJournal::WriteReal(const real1& r) { journalStream.write((const char*)&r, sizeof(r)); }
+
+void QJournal::WriteCmplx(const complex& c) { journalStream.write((const char*)&c, sizeof(c)); }
+
+void QJournal::WriteMtrx(const complex* mtrx) { journalStream.write((const char*)mtrx, 4U * sizeof(complex)); }
+
+void QJournal::WriteControls(const bitLenInt* controls, const bitLenInt& controlLen)
+{
+    WriteBit(controlLen);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        WriteBit(controls[i]);
+    }
+}
+
+void QJournal::WriteBytes(const unsigned char* data, size_t byteCount)
+{
+    journalStream.write((const char*)data, byteCount);
+}
+
+void QJournal::EndRecord()
+{
+    // Flushed per record, so anything short of the record being appended cannot survive a crash:
+    journalStream.flush();
+    if (!journalStream) {
+        throw std::invalid_argument("QJournal failed to append to the journal file");
+    }
+}
+
+void QJournal::LogState()
+{
+    if (!Journaling()) {
+        return;
+    }
+
+    std::unique_ptr<complex[]> stateVec(new complex[(bitCapIntOcl)maxQPower]);
+    qReg->GetQuantumState(stateVec.get());
+
+    WriteOp(JOURNAL_OP_STATE);
+    WriteBit(qubitCount);
+    journalStream.write((const char*)stateVec.get(), sizeof(complex) * (bitCapIntOcl)maxQPower);
+    EndRecord();
+}
+
+bitLenInt QJournal::ReadBit(std::ifstream& ifs)
+{
+    uint32_t val = 0;
+    ifs.read((char*)&val, sizeof(val));
+    return (bitLenInt)val;
+}
+
+bitCapInt QJournal::ReadCap(std::ifstream& ifs)
+{
+    uint64_t val = 0;
+    ifs.read((char*)&val, sizeof(val));
+    return (bitCapInt)val;
+}
+
+real1 QJournal::ReadReal(std::ifstream& ifs)
+{
+    real1 val = ZERO_R1;
+    ifs.read((char*)&val, sizeof(val));
+    return val;
+}
+
+complex QJournal::ReadCmplx(std::ifstream& ifs)
+{
+    complex val = ZERO_CMPLX;
+    ifs.read((char*)&val, sizeof(val));
+    return val;
+}
+
+std::vector<bitLenInt> QJournal::ReadControls(std::ifstream& ifs)
+{
+    bitLenInt controlLen = ReadBit(ifs);
+    if (!ifs) {
+        return std::vector<bitLenInt>();
+    }
+    std::vector<bitLenInt> controls(controlLen);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        controls[i] = ReadBit(ifs);
+    }
+    return controls;
+}
+
+void QJournal::Replay(const std::string& path)
+{
+    if (Journaling()) {
+        throw std::invalid_argument("Replay() requires journaling to be stopped");
+    }
+
+    std::ifstream ifs(path.c_str(), std::ios::binary);
+    if (!ifs) {
+        throw std::invalid_argument("Replay() could not open journal file for reading");
+    }
+
+    JournalFileHeader header;
+    ifs.read((char*)&header, sizeof(header));
+    if (!ifs) {
+        throw std::invalid_argument("Replay() journal file is truncated");
+    }
+    if (std::memcmp(header.magic, "QRKJ", 4U) != 0) {
+        throw std::invalid_argument("Replay() file is not a Qrack operation journal");
+    }
+    if (header.version != QRACK_JOURNAL_VERSION) {
+        throw std::invalid_argument("Replay() journal format version is not supported");
+    }
+    if (header.ampBytes != sizeof(complex)) {
+        throw std::invalid_argument("Replay() journal amplitude precision does not match this build");
+    }
+    if (header.endianTag != 0x0102030405060708ULL) {
+        throw std::invalid_argument("Replay() journal byte order does not match this platform");
+    }
+    if (header.qubitCount != qubitCount) {
+        throw std::invalid_argument("Replay() journal starting qubit count does not match this instance");
+    }
+
+    while (true) {
+        uint8_t op = 0;
+        ifs.read((char*)&op, sizeof(op));
+        if (!ifs) {
+            // Clean end of the journal.
+            break;
+        }
+        if (!ReplayOp(ifs, (JournalOpCode)op)) {
+            // A torn trailing record, from a crash mid-append; everything before it has been applied.
+            break;
+        }
+    }
+}
+
+bool QJournal::ReplayOp(std::ifstream& ifs, const JournalOpCode& op)
+{
+    switch (op) {
+    case JOURNAL_OP_SINGLE_BIT: {
+        bitLenInt target = ReadBit(ifs);
+        complex mtrx[4];
+        ifs.read((char*)mtrx, sizeof(mtrx));
+        if (!ifs) {
+            return false;
+        }
+        ApplySingleBit(mtrx, target);
+        break;
+    }
+    case JOURNAL_OP_CTRLD_SINGLE_BIT:
+    case JOURNAL_OP_ANTI_CTRLD_SINGLE_BIT: {
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        bitLenInt target = ReadBit(ifs);
+        complex mtrx[4];
+        ifs.read((char*)mtrx, sizeof(mtrx));
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_CTRLD_SINGLE_BIT) {
+            ApplyControlledSingleBit(&(controls[0]), controls.size(), target, mtrx);
+        } else {
+            ApplyAntiControlledSingleBit(&(controls[0]), controls.size(), target, mtrx);
+        }
+        break;
+    }
+    case JOURNAL_OP_UNIFORMLY_CTRLD_SINGLE_BIT: {
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        bitLenInt target = ReadBit(ifs);
+        bitLenInt skipLen = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        std::vector<bitCapInt> skipPowers(skipLen);
+        for (bitLenInt i = 0; i < skipLen; i++) {
+            skipPowers[i] = ReadCap(ifs);
+        }
+        bitCapInt skipValueMask = ReadCap(ifs);
+        bitCapIntOcl mtrxCount = pow2Ocl(controls.size() + skipLen);
+        std::unique_ptr<complex[]> mtrxs(new complex[4U * mtrxCount]);
+        ifs.read((char*)mtrxs.get(), 4U * mtrxCount * sizeof(complex));
+        if (!ifs) {
+            return false;
+        }
+        UniformlyControlledSingleBit(controls.size() ? &(controls[0]) : NULL, controls.size(), target, mtrxs.get(),
+            skipLen ? &(skipPowers[0]) : NULL, skipLen, skipValueMask);
+        break;
+    }
+    case JOURNAL_OP_SWAP:
+    case JOURNAL_OP_ISWAP:
+    case JOURNAL_OP_SQRTSWAP:
+    case JOURNAL_OP_ISQRTSWAP: {
+        bitLenInt qubit1 = ReadBit(ifs);
+        bitLenInt qubit2 = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_SWAP) {
+            Swap(qubit1, qubit2);
+        } else if (op == JOURNAL_OP_ISWAP) {
+            ISwap(qubit1, qubit2);
+        } else if (op == JOURNAL_OP_SQRTSWAP) {
+            SqrtSwap(qubit1, qubit2);
+        } else {
+            ISqrtSwap(qubit1, qubit2);
+        }
+        break;
+    }
+    case JOURNAL_OP_FSIM: {
+        real1 theta = ReadReal(ifs);
+        real1 phi = ReadReal(ifs);
+        bitLenInt qubit1 = ReadBit(ifs);
+        bitLenInt qubit2 = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        FSim(theta, phi, qubit1, qubit2);
+        break;
+    }
+    case JOURNAL_OP_CSWAP:
+    case JOURNAL_OP_ANTI_CSWAP:
+    case JOURNAL_OP_CSQRTSWAP:
+    case JOURNAL_OP_ANTI_CSQRTSWAP:
+    case JOURNAL_OP_CISQRTSWAP:
+    case JOURNAL_OP_ANTI_CISQRTSWAP: {
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        bitLenInt qubit1 = ReadBit(ifs);
+        bitLenInt qubit2 = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        const bitLenInt* ctrls = controls.size() ? &(controls[0]) : NULL;
+        if (op == JOURNAL_OP_CSWAP) {
+            CSwap(ctrls, controls.size(), qubit1, qubit2);
+        } else if (op == JOURNAL_OP_ANTI_CSWAP) {
+            AntiCSwap(ctrls, controls.size(), qubit1, qubit2);
+        } else if (op == JOURNAL_OP_CSQRTSWAP) {
+            CSqrtSwap(ctrls, controls.size(), qubit1, qubit2);
+        } else if (op == JOURNAL_OP_ANTI_CSQRTSWAP) {
+            AntiCSqrtSwap(ctrls, controls.size(), qubit1, qubit2);
+        } else if (op == JOURNAL_OP_CISQRTSWAP) {
+            CISqrtSwap(ctrls, controls.size(), qubit1, qubit2);
+        } else {
+            AntiCISqrtSwap(ctrls, controls.size(), qubit1, qubit2);
+        }
+        break;
+    }
+    case JOURNAL_OP_FORCE_M: {
+        bitLenInt qubit = ReadBit(ifs);
+        uint8_t outcome = 0;
+        ifs.read((char*)&outcome, sizeof(outcome));
+        if (!ifs) {
+            return false;
+        }
+        ForceM(qubit, outcome != 0, true, true);
+        break;
+    }
+    case JOURNAL_OP_SET_PERMUTATION: {
+        bitCapInt perm = ReadCap(ifs);
+        complex phaseFac = ReadCmplx(ifs);
+        if (!ifs) {
+            return false;
+        }
+        SetPermutation(perm, phaseFac);
+        break;
+    }
+    case JOURNAL_OP_SET_AMPLITUDE: {
+        bitCapInt perm = ReadCap(ifs);
+        complex amp = ReadCmplx(ifs);
+        if (!ifs) {
+            return false;
+        }
+        SetAmplitude(perm, amp);
+        break;
+    }
+    case JOURNAL_OP_STATE: {
+        bitLenInt nQubitCount = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        bitCapIntOcl nMaxQPower = pow2Ocl(nQubitCount);
+        std::unique_ptr<complex[]> stateVec(new complex[nMaxQPower]);
+        ifs.read((char*)stateVec.get(), sizeof(complex) * nMaxQPower);
+        if (!ifs) {
+            return false;
+        }
+        if (nQubitCount != qubitCount) {
+            SetQubitCount(nQubitCount);
+            qReg = MakeEngine(nQubitCount, 0);
+        }
+        qReg->SetQuantumState(stateVec.get());
+        break;
+    }
+    case JOURNAL_OP_ROL:
+    case JOURNAL_OP_ROR: {
+        bitLenInt shift = ReadBit(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_ROL) {
+            ROL(shift, start, length);
+        } else {
+            ROR(shift, start, length);
+        }
+        break;
+    }
+    case JOURNAL_OP_INC:
+    case JOURNAL_OP_INCBCD: {
+        bitCapInt toAdd = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_INC) {
+            INC(toAdd, start, length);
+        } else {
+            INCBCD(toAdd, start, length);
+        }
+        break;
+    }
+    case JOURNAL_OP_CINC: {
+        bitCapInt toAdd = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        if (!ifs) {
+            return false;
+        }
+        CINC(toAdd, start, length, controls.size() ? &(controls[0]) : NULL, controls.size());
+        break;
+    }
+    case JOURNAL_OP_INCC:
+    case JOURNAL_OP_INCBCDC:
+    case JOURNAL_OP_INCSC_NO_OVERFLOW:
+    case JOURNAL_OP_DECC:
+    case JOURNAL_OP_DECBCDC:
+    case JOURNAL_OP_DECSC_NO_OVERFLOW: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        bitLenInt carryIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_INCC) {
+            INCC(toMod, start, length, carryIndex);
+        } else if (op == JOURNAL_OP_INCBCDC) {
+            INCBCDC(toMod, start, length, carryIndex);
+        } else if (op == JOURNAL_OP_INCSC_NO_OVERFLOW) {
+            INCSC(toMod, start, length, carryIndex);
+        } else if (op == JOURNAL_OP_DECC) {
+            DECC(toMod, start, length, carryIndex);
+        } else if (op == JOURNAL_OP_DECBCDC) {
+            DECBCDC(toMod, start, length, carryIndex);
+        } else {
+            DECSC(toMod, start, length, carryIndex);
+        }
+        break;
+    }
+    case JOURNAL_OP_INCS: {
+        bitCapInt toAdd = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        bitLenInt overflowIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        INCS(toAdd, start, length, overflowIndex);
+        break;
+    }
+    case JOURNAL_OP_INCSC:
+    case JOURNAL_OP_DECSC: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        bitLenInt overflowIndex = ReadBit(ifs);
+        bitLenInt carryIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_INCSC) {
+            INCSC(toMod, start, length, overflowIndex, carryIndex);
+        } else {
+            DECSC(toMod, start, length, overflowIndex, carryIndex);
+        }
+        break;
+    }
+    case JOURNAL_OP_MUL:
+    case JOURNAL_OP_DIV: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitLenInt inOutStart = ReadBit(ifs);
+        bitLenInt carryStart = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_MUL) {
+            MUL(toMod, inOutStart, carryStart, length);
+        } else {
+            DIV(toMod, inOutStart, carryStart, length);
+        }
+        break;
+    }
+    case JOURNAL_OP_MULMODNOUT:
+    case JOURNAL_OP_IMULMODNOUT:
+    case JOURNAL_OP_POWMODNOUT: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitCapInt modN = ReadCap(ifs);
+        bitLenInt inStart = ReadBit(ifs);
+        bitLenInt outStart = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_MULMODNOUT) {
+            MULModNOut(toMod, modN, inStart, outStart, length);
+        } else if (op == JOURNAL_OP_IMULMODNOUT) {
+            IMULModNOut(toMod, modN, inStart, outStart, length);
+        } else {
+            POWModNOut(toMod, modN, inStart, outStart, length);
+        }
+        break;
+    }
+    case JOURNAL_OP_CMUL:
+    case JOURNAL_OP_CDIV: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitLenInt inOutStart = ReadBit(ifs);
+        bitLenInt carryStart = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_CMUL) {
+            CMUL(toMod, inOutStart, carryStart, length, controls.size() ? &(controls[0]) : NULL, controls.size());
+        } else {
+            CDIV(toMod, inOutStart, carryStart, length, controls.size() ? &(controls[0]) : NULL, controls.size());
+        }
+        break;
+    }
+    case JOURNAL_OP_CMULMODNOUT:
+    case JOURNAL_OP_CIMULMODNOUT:
+    case JOURNAL_OP_CPOWMODNOUT: {
+        bitCapInt toMod = ReadCap(ifs);
+        bitCapInt modN = ReadCap(ifs);
+        bitLenInt inStart = ReadBit(ifs);
+        bitLenInt outStart = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        std::vector<bitLenInt> controls = ReadControls(ifs);
+        if (!ifs) {
+            return false;
+        }
+        bitLenInt* ctrls = controls.size() ? &(controls[0]) : NULL;
+        if (op == JOURNAL_OP_CMULMODNOUT) {
+            CMULModNOut(toMod, modN, inStart, outStart, length, ctrls, controls.size());
+        } else if (op == JOURNAL_OP_CIMULMODNOUT) {
+            CIMULModNOut(toMod, modN, inStart, outStart, length, ctrls, controls.size());
+        } else {
+            CPOWModNOut(toMod, modN, inStart, outStart, length, ctrls, controls.size());
+        }
+        break;
+    }
+    case JOURNAL_OP_ZEROPHASEFLIP: {
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        ZeroPhaseFlip(start, length);
+        break;
+    }
+    case JOURNAL_OP_CPHASEFLIPIFLESS: {
+        bitCapInt greaterPerm = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        bitLenInt flagIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        CPhaseFlipIfLess(greaterPerm, start, length, flagIndex);
+        break;
+    }
+    case JOURNAL_OP_PHASEFLIPIFLESS: {
+        bitCapInt greaterPerm = ReadCap(ifs);
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        PhaseFlipIfLess(greaterPerm, start, length);
+        break;
+    }
+    case JOURNAL_OP_PHASEFLIP: {
+        PhaseFlip();
+        break;
+    }
+    case JOURNAL_OP_INDEXEDLDA: {
+        bitLenInt indexStart = ReadBit(ifs);
+        bitLenInt indexLength = ReadBit(ifs);
+        bitLenInt valueStart = ReadBit(ifs);
+        bitLenInt valueLength = ReadBit(ifs);
+        uint8_t resetValue = 0;
+        ifs.read((char*)&resetValue, sizeof(resetValue));
+        if (!ifs) {
+            return false;
+        }
+        size_t byteCount = (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U);
+        std::vector<unsigned char> values(byteCount);
+        ifs.read((char*)&(values[0]), byteCount);
+        if (!ifs) {
+            return false;
+        }
+        IndexedLDA(indexStart, indexLength, valueStart, valueLength, &(values[0]), resetValue != 0);
+        break;
+    }
+    case JOURNAL_OP_INDEXEDADC:
+    case JOURNAL_OP_INDEXEDSBC: {
+        bitLenInt indexStart = ReadBit(ifs);
+        bitLenInt indexLength = ReadBit(ifs);
+        bitLenInt valueStart = ReadBit(ifs);
+        bitLenInt valueLength = ReadBit(ifs);
+        bitLenInt carryIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        size_t byteCount = (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U);
+        std::vector<unsigned char> values(byteCount);
+        ifs.read((char*)&(values[0]), byteCount);
+        if (!ifs) {
+            return false;
+        }
+        if (op == JOURNAL_OP_INDEXEDADC) {
+            IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, &(values[0]));
+        } else {
+            IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, &(values[0]));
+        }
+        break;
+    }
+    case JOURNAL_OP_HASH: {
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        size_t byteCount = (size_t)pow2Ocl(length) * ((length + 7U) / 8U);
+        std::vector<unsigned char> values(byteCount);
+        ifs.read((char*)&(values[0]), byteCount);
+        if (!ifs) {
+            return false;
+        }
+        Hash(start, length, &(values[0]));
+        break;
+    }
+    case JOURNAL_OP_DISPOSE: {
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        Dispose(start, length);
+        break;
+    }
+    case JOURNAL_OP_DISPOSE_PERM: {
+        bitLenInt start = ReadBit(ifs);
+        bitLenInt length = ReadBit(ifs);
+        bitCapInt disposedPerm = ReadCap(ifs);
+        if (!ifs) {
+            return false;
+        }
+        Dispose(start, length, disposedPerm);
+        break;
+    }
+    case JOURNAL_OP_NORMALIZE: {
+        real1 nrm = ReadReal(ifs);
+        real1 norm_thresh = ReadReal(ifs);
+        if (!ifs) {
+            return false;
+        }
+        NormalizeState(nrm, norm_thresh);
+        break;
+    }
+    case JOURNAL_OP_UPDATE_RUNNING_NORM: {
+        real1 norm_thresh = ReadReal(ifs);
+        if (!ifs) {
+            return false;
+        }
+        UpdateRunningNorm(norm_thresh);
+        break;
+    }
+    case JOURNAL_OP_INDEXEDCMP: {
+        bitLenInt indexStart = ReadBit(ifs);
+        bitLenInt indexLength = ReadBit(ifs);
+        bitLenInt valueLength = ReadBit(ifs);
+        bitCapInt greaterPerm = ReadCap(ifs);
+        bitLenInt carryIndex = ReadBit(ifs);
+        if (!ifs) {
+            return false;
+        }
+        size_t byteCount = (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U);
+        std::vector<unsigned char> values(byteCount);
+        ifs.read((char*)&(values[0]), byteCount);
+        if (!ifs) {
+            return false;
+        }
+        IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, &(values[0]));
+        break;
+    }
+    default:
+        throw std::invalid_argument("Replay() journal contains an unknown opcode");
+    }
+
+    return true;
+}
+
+void QJournal::SetQuantumState(const complex* inputState)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_STATE);
+        WriteBit(qubitCount);
+        journalStream.write((const char*)inputState, sizeof(complex) * (bitCapIntOcl)maxQPower);
+        EndRecord();
+    }
+    qReg->SetQuantumState(inputState);
+}
+
+void QJournal::SetAmplitude(bitCapInt perm, complex amp)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_SET_AMPLITUDE);
+        WriteCap(perm);
+        WriteCmplx(amp);
+        EndRecord();
+    }
+    qReg->SetAmplitude(perm, amp);
+}
+
+void QJournal::SetPermutation(bitCapInt perm, complex phaseFac)
+{
+    if (Journaling()) {
+        // The CMPLX_DEFAULT_ARG sentinel is recorded as-is; a random global phase on replay is unobservable.
+        WriteOp(JOURNAL_OP_SET_PERMUTATION);
+        WriteCap(perm);
+        WriteCmplx(phaseFac);
+        EndRecord();
+    }
+    qReg->SetPermutation(perm, phaseFac);
+}
+
+bitLenInt QJournal::Compose(QJournalPtr toCopy)
+{
+    bitLenInt result = qReg->Compose(toCopy->qReg);
+    SetQubitCount(qubitCount + toCopy->qubitCount);
+    LogState();
+    return result;
+}
+
+bitLenInt QJournal::Compose(QJournalPtr toCopy, bitLenInt start)
+{
+    bitLenInt result = qReg->Compose(toCopy->qReg, start);
+    SetQubitCount(qubitCount + toCopy->qubitCount);
+    LogState();
+    return result;
+}
+
+void QJournal::Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest)
+{
+    QJournalPtr destJrnl = std::dynamic_pointer_cast<QJournal>(dest);
+    qReg->Decompose(start, length, destJrnl ? destJrnl->qReg : dest);
+    SetQubitCount(qubitCount - length);
+    LogState();
+}
+
+void QJournal::Dispose(bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DISPOSE);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->Dispose(start, length);
+    SetQubitCount(qubitCount - length);
+}
+
+void QJournal::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DISPOSE_PERM);
+        WriteBit(start);
+        WriteBit(length);
+        WriteCap(disposedPerm);
+        EndRecord();
+    }
+    qReg->Dispose(start, length, disposedPerm);
+    SetQubitCount(qubitCount - length);
+}
+
+void QJournal::ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_SINGLE_BIT);
+        WriteBit(qubitIndex);
+        WriteMtrx(mtrx);
+        EndRecord();
+    }
+    qReg->ApplySingleBit(mtrx, qubitIndex);
+}
+
+void QJournal::ApplyControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CTRLD_SINGLE_BIT);
+        WriteControls(controls, controlLen);
+        WriteBit(target);
+        WriteMtrx(mtrx);
+        EndRecord();
+    }
+    qReg->ApplyControlledSingleBit(controls, controlLen, target, mtrx);
+}
+
+void QJournal::ApplyAntiControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ANTI_CTRLD_SINGLE_BIT);
+        WriteControls(controls, controlLen);
+        WriteBit(target);
+        WriteMtrx(mtrx);
+        EndRecord();
+    }
+    qReg->ApplyAntiControlledSingleBit(controls, controlLen, target, mtrx);
+}
+
+void QJournal::UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen,
+    bitLenInt qubitIndex, const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+    const bitCapInt& mtrxSkipValueMask)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_UNIFORMLY_CTRLD_SINGLE_BIT);
+        WriteControls(controls, controlLen);
+        WriteBit(qubitIndex);
+        WriteBit(mtrxSkipLen);
+        for (bitLenInt i = 0; i < mtrxSkipLen; i++) {
+            WriteCap(mtrxSkipPowers[i]);
+        }
+        WriteCap(mtrxSkipValueMask);
+        journalStream.write((const char*)mtrxs, 4U * pow2Ocl(controlLen + mtrxSkipLen) * sizeof(complex));
+        EndRecord();
+    }
+    qReg->UniformlyControlledSingleBit(
+        controls, controlLen, qubitIndex, mtrxs, mtrxSkipPowers, mtrxSkipLen, mtrxSkipValueMask);
+}
+
+void QJournal::CSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->CSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QJournal::AntiCSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ANTI_CSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->AntiCSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QJournal::CSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CSQRTSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->CSqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QJournal::AntiCSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ANTI_CSQRTSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->AntiCSqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QJournal::CISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CISQRTSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->CISqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+void QJournal::AntiCISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ANTI_CISQRTSWAP);
+        WriteControls(controls, controlLen);
+        WriteBit(qubit1);
+        WriteBit(qubit2);
+        EndRecord();
+    }
+    qReg->AntiCISqrtSwap(controls, controlLen, qubit1, qubit2);
+}
+
+bool QJournal::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
+{
+    bool toRet = qReg->ForceM(qubit, result, doForce, doApply);
+    if (doApply && Journaling()) {
+        // The measured outcome is recorded and forced on replay, so replay never depends on RNG state.
+        WriteOp(JOURNAL_OP_FORCE_M);
+        WriteBit(qubit);
+        uint8_t outcome = toRet ? 1U : 0U;
+        journalStream.write((const char*)&outcome, sizeof(outcome));
+        EndRecord();
+    }
+    return toRet;
+}
+
+void QJournal::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ROL);
+        WriteBit(shift);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->ROL(shift, start, length);
+}
+
+void QJournal::ROR(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ROR);
+        WriteBit(shift);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->ROR(shift, start, length);
+}
+
+void QJournal::INC(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INC);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->INC(toAdd, start, length);
+}
+
+void QJournal::CINC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CINC);
+        WriteCap(toAdd);
+        WriteBit(inOutStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CINC(toAdd, inOutStart, length, controls, controlLen);
+}
+
+void QJournal::INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCC);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->INCC(toAdd, start, length, carryIndex);
+}
+
+void QJournal::INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCS);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(overflowIndex);
+        EndRecord();
+    }
+    qReg->INCS(toAdd, start, length, overflowIndex);
+}
+
+void QJournal::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCSC);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(overflowIndex);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->INCSC(toAdd, start, length, overflowIndex, carryIndex);
+}
+
+void QJournal::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCSC_NO_OVERFLOW);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->INCSC(toAdd, start, length, carryIndex);
+}
+
+void QJournal::INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCBCD);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->INCBCD(toAdd, start, length);
+}
+
+void QJournal::INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INCBCDC);
+        WriteCap(toAdd);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->INCBCDC(toAdd, start, length, carryIndex);
+}
+
+void QJournal::DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DECC);
+        WriteCap(toSub);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->DECC(toSub, start, length, carryIndex);
+}
+
+void QJournal::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DECSC);
+        WriteCap(toSub);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(overflowIndex);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->DECSC(toSub, start, length, overflowIndex, carryIndex);
+}
+
+void QJournal::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DECSC_NO_OVERFLOW);
+        WriteCap(toSub);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->DECSC(toSub, start, length, carryIndex);
+}
+
+void QJournal::DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DECBCDC);
+        WriteCap(toSub);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(carryIndex);
+        EndRecord();
+    }
+    qReg->DECBCDC(toSub, start, length, carryIndex);
+}
+
+void QJournal::MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_MUL);
+        WriteCap(toMul);
+        WriteBit(inOutStart);
+        WriteBit(carryStart);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->MUL(toMul, inOutStart, carryStart, length);
+}
+
+void QJournal::DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_DIV);
+        WriteCap(toDiv);
+        WriteBit(inOutStart);
+        WriteBit(carryStart);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->DIV(toDiv, inOutStart, carryStart, length);
+}
+
+void QJournal::MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_MULMODNOUT);
+        WriteCap(toMul);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->MULModNOut(toMul, modN, inStart, outStart, length);
+}
+
+void QJournal::IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_IMULMODNOUT);
+        WriteCap(toMul);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->IMULModNOut(toMul, modN, inStart, outStart, length);
+}
+
+void QJournal::POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_POWMODNOUT);
+        WriteCap(base);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->POWModNOut(base, modN, inStart, outStart, length);
+}
+
+void QJournal::CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CMUL);
+        WriteCap(toMul);
+        WriteBit(inOutStart);
+        WriteBit(carryStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CMUL(toMul, inOutStart, carryStart, length, controls, controlLen);
+}
+
+void QJournal::CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CDIV);
+        WriteCap(toDiv);
+        WriteBit(inOutStart);
+        WriteBit(carryStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CDIV(toDiv, inOutStart, carryStart, length, controls, controlLen);
+}
+
+void QJournal::CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CMULMODNOUT);
+        WriteCap(toMul);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QJournal::CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CIMULMODNOUT);
+        WriteCap(toMul);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CIMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QJournal::CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CPOWMODNOUT);
+        WriteCap(base);
+        WriteCap(modN);
+        WriteBit(inStart);
+        WriteBit(outStart);
+        WriteBit(length);
+        WriteControls(controls, controlLen);
+        EndRecord();
+    }
+    qReg->CPOWModNOut(base, modN, inStart, outStart, length, controls, controlLen);
+}
+
+void QJournal::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ZEROPHASEFLIP);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->ZeroPhaseFlip(start, length);
+}
+
+void QJournal::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_CPHASEFLIPIFLESS);
+        WriteCap(greaterPerm);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBit(flagIndex);
+        EndRecord();
+    }
+    qReg->CPhaseFlipIfLess(greaterPerm, start, length, flagIndex);
+}
+
+void QJournal::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_PHASEFLIPIFLESS);
+        WriteCap(greaterPerm);
+        WriteBit(start);
+        WriteBit(length);
+        EndRecord();
+    }
+    qReg->PhaseFlipIfLess(greaterPerm, start, length);
+}
+
+void QJournal::PhaseFlip()
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_PHASEFLIP);
+        EndRecord();
+    }
+    qReg->PhaseFlip();
+}
+
+bitCapInt QJournal::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    unsigned char* values, bool resetValue)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INDEXEDLDA);
+        WriteBit(indexStart);
+        WriteBit(indexLength);
+        WriteBit(valueStart);
+        WriteBit(valueLength);
+        uint8_t reset = resetValue ? 1U : 0U;
+        journalStream.write((const char*)&reset, sizeof(reset));
+        WriteBytes(values, (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U));
+        EndRecord();
+    }
+    return qReg->IndexedLDA(indexStart, indexLength, valueStart, valueLength, values, resetValue);
+}
+
+bitCapInt QJournal::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INDEXEDADC);
+        WriteBit(indexStart);
+        WriteBit(indexLength);
+        WriteBit(valueStart);
+        WriteBit(valueLength);
+        WriteBit(carryIndex);
+        WriteBytes(values, (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U));
+        EndRecord();
+    }
+    return qReg->IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+}
+
+bitCapInt QJournal::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INDEXEDSBC);
+        WriteBit(indexStart);
+        WriteBit(indexLength);
+        WriteBit(valueStart);
+        WriteBit(valueLength);
+        WriteBit(carryIndex);
+        WriteBytes(values, (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U));
+        EndRecord();
+    }
+    return qReg->IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+}
+
+void QJournal::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_INDEXEDCMP);
+        WriteBit(indexStart);
+        WriteBit(indexLength);
+        WriteBit(valueLength);
+        WriteCap(greaterPerm);
+        WriteBit(carryIndex);
+        WriteBytes(values, (size_t)pow2Ocl(indexLength) * ((valueLength + 7U) / 8U));
+        EndRecord();
+    }
+    qReg->IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, values);
+}
+
+void QJournal::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_HASH);
+        WriteBit(start);
+        WriteBit(length);
+        WriteBytes(values, (size_t)pow2Ocl(length) * ((length + 7U) / 8U));
+        EndRecord();
+    }
+    qReg->Hash(start, length, values);
+}
+
+void QJournal::Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_SWAP);
+        WriteBit(qubitIndex1);
+        WriteBit(qubitIndex2);
+        EndRecord();
+    }
+    qReg->Swap(qubitIndex1, qubitIndex2);
+}
+
+void QJournal::ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ISWAP);
+        WriteBit(qubitIndex1);
+        WriteBit(qubitIndex2);
+        EndRecord();
+    }
+    qReg->ISwap(qubitIndex1, qubitIndex2);
+}
+
+void QJournal::SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_SQRTSWAP);
+        WriteBit(qubitIndex1);
+        WriteBit(qubitIndex2);
+        EndRecord();
+    }
+    qReg->SqrtSwap(qubitIndex1, qubitIndex2);
+}
+
+void QJournal::ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_ISQRTSWAP);
+        WriteBit(qubitIndex1);
+        WriteBit(qubitIndex2);
+        EndRecord();
+    }
+    qReg->ISqrtSwap(qubitIndex1, qubitIndex2);
+}
+
+void QJournal::FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_FSIM);
+        WriteReal(theta);
+        WriteReal(phi);
+        WriteBit(qubitIndex1);
+        WriteBit(qubitIndex2);
+        EndRecord();
+    }
+    qReg->FSim(theta, phi, qubitIndex1, qubitIndex2);
+}
+
+void QJournal::UpdateRunningNorm(real1 norm_thresh)
+{
+    if (Journaling()) {
+        WriteOp(JOURNAL_OP_UPDATE_RUNNING_NORM);
+        WriteReal(norm_thresh);
+        EndRecord();
+    }
+    qReg->UpdateRunningNorm(norm_thresh);
+}
+
+void QJournal::NormalizeState(real1 nrm, real1 norm_thresh)
+{
+    if (Journaling()) {
+        // The REAL1_DEFAULT_ARG sentinels are recorded as-is; the defaults re-derive deterministically on replay.
+        WriteOp(JOURNAL_OP_NORMALIZE);
+        WriteReal(nrm);
+        WriteReal(norm_thresh);
+        EndRecord();
+    }
+    qReg->NormalizeState(nrm, norm_thresh);
+}
+
+QInterfacePtr QJournal::Clone()
+{
+    // The clone starts with journaling off; a journal records one instance's dispatch stream.
+    QJournalPtr clone = std::make_shared<QJournal>(engineType, qubitCount, 0, rand_generator, ONE_CMPLX, doNormalize,
+        randGlobalPhase, useHostRam, deviceID, useRDRAND, isSparse, amplitudeFloor);
+    clone->qReg = qReg->Clone();
+    return clone;
+}
+
+} // namespace Qrack
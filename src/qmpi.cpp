@@ -0,0 +1,934 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QMPI distributes a state vector across the ranks of an MPI communicator, one
+// contiguous slice of amplitudes per rank, so that the total state vector can
+// exceed the memory of any single node.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "qfactory.hpp"
+#include "qmpi.hpp"
+
+namespace Qrack {
+
+QMPI::QMPI(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp, complex phaseFac,
+    bool doNorm, bool randomGlobalPhase, bool useHostMem, int deviceId, bool useHardwareRNG, bool useSparseStateVec,
+    real1 norm_thresh)
+    : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
+    , engineType(eng)
+    , deviceID(deviceId)
+    , useHostRam(useHostMem)
+    , useRDRAND(useHardwareRNG)
+    , isSparse(useSparseStateVec)
+{
+    // QMPI attaches to MPI_COMM_WORLD as-is, initializing MPI only if the caller has not already done so.
+    int isInit = 0;
+    MPI_Initialized(&isInit);
+    if (!isInit) {
+        MPI_Init(NULL, NULL);
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &rankCount);
+
+    if (!isPowerOfTwo((bitCapInt)rankCount)) {
+        throw std::invalid_argument("QMPI requires a power-of-two MPI rank count");
+    }
+    splitQubits = log2((bitCapInt)rankCount);
+
+    SetQubitCount(qBitCount);
+
+    qSlice = MakeSlice(qubitsPerSlice, 0);
+    SetPermutation(initState, phaseFac);
+}
+
+QInterfacePtr QMPI::MakeSlice(bitLenInt length, bitCapInt perm)
+{
+    // Slices are always created with normalization off and a deterministic global phase: the relative phase and norm
+    // BETWEEN ranks' slices is physically meaningful, so no slice may independently adjust its own.
+    return CreateQuantumInterface(engineType, length, perm, rand_generator, ONE_CMPLX, false, false, useHostRam,
+        deviceID, useRDRAND, isSparse, amplitudeFloor);
+}
+
+QInterfacePtr QMPI::GatherFull()
+{
+    std::unique_ptr<complex[]> stateVec(new complex[(bitCapIntOcl)maxQPower]);
+    GetQuantumState(stateVec.get());
+
+    QInterfacePtr whole = MakeSlice(qubitCount, 0);
+    whole->SetQuantumState(stateVec.get());
+    return whole;
+}
+
+void QMPI::ScatterFull(QInterfacePtr whole, bitLenInt nQubitCount)
+{
+    SetQubitCount(nQubitCount);
+
+    std::unique_ptr<complex[]> stateVec(new complex[(bitCapIntOcl)maxQPower]);
+    whole->GetQuantumState(stateVec.get());
+
+    qSlice = MakeSlice(qubitsPerSlice, 0);
+    qSlice->SetQuantumState(stateVec.get() + ((bitCapIntOcl)rank * SliceLength()));
+}
+
+void QMPI::LocalOrGatherOp(bitLenInt highestQubit, std::function<void(QInterfacePtr)> fn)
+{
+    if (highestQubit < qubitsPerSlice) {
+        // Every qubit is in-slice, so the operation is block-diagonal in the split qubits and every rank just
+        // applies it to its own slice, with no communication.
+        fn(qSlice);
+        return;
+    }
+
+    QInterfacePtr whole = GatherFull();
+    fn(whole);
+    ScatterFull(whole, whole->GetQubitCount());
+}
+
+void QMPI::ScaleSlice(const complex& scale)
+{
+    if (scale == ONE_CMPLX) {
+        return;
+    }
+    // A scalar matrix passes the engine's IsIdentity() global phase check and would be skipped, so the factor is
+    // split across two complementary phase gates, neither of which is an identity.
+    qSlice->ApplySinglePhase(ONE_CMPLX, scale, 0);
+    qSlice->ApplySinglePhase(scale, ONE_CMPLX, 0);
+}
+
+real1 QMPI::SliceNorm()
+{
+    real1 total = ZERO_R1;
+    qSlice->GetProbsChunked([&](const real1* chunk, const bitCapInt& offset, const bitCapInt& length) {
+        for (bitCapIntOcl i = 0; i < (bitCapIntOcl)length; i++) {
+            total += chunk[i];
+        }
+    });
+    return total;
+}
+
+real1 QMPI::AllSum(real1 part)
+{
+    double localPart = (double)part;
+    double total = 0.0;
+    MPI_Allreduce(&localPart, &total, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return (real1)total;
+}
+
+void QMPI::BcastChunked(void* buffer, size_t byteCount, int root)
+{
+    const size_t maxChunk = (size_t)QRACK_STREAM_CHUNK_ELEMS * sizeof(complex);
+    char* buff = (char*)buffer;
+    for (size_t off = 0; off < byteCount; off += maxChunk) {
+        size_t len = ((off + maxChunk) < byteCount) ? maxChunk : (byteCount - off);
+        MPI_Bcast(buff + off, (int)len, MPI_BYTE, root, MPI_COMM_WORLD);
+    }
+}
+
+void QMPI::ExchangeSlices(const int& partner)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    std::unique_ptr<complex[]> amps(new complex[sliceLen]);
+    qSlice->GetQuantumState(amps.get());
+
+    const bitCapIntOcl chunk = QRACK_STREAM_CHUNK_ELEMS;
+    for (bitCapIntOcl off = 0; off < sliceLen; off += chunk) {
+        bitCapIntOcl len = ((off + chunk) < sliceLen) ? chunk : (sliceLen - off);
+        MPI_Sendrecv_replace(amps.get() + off, (int)(len * sizeof(complex)), MPI_BYTE, partner, 0, partner, 0,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+
+    qSlice->SetQuantumState(amps.get());
+}
+
+void QMPI::ApplySplitSingleBit(const bitLenInt* intraControls, const bitLenInt& intraControlLen, const bool& anti,
+    const int& metaMask, const int& metaPerm, const complex* mtrx, const bitLenInt& target)
+{
+    if ((rank & metaMask) != metaPerm) {
+        // Rank-selecting controls deselect this whole slice, (and its partner rank, identically).
+        return;
+    }
+
+    int targetPow = 1 << (int)(target - qubitsPerSlice);
+    // Whether this slice holds the target's |0> half of each amplitude pair:
+    bool isUpper = !(rank & targetPow);
+    bool isDiag = (mtrx[1] == ZERO_CMPLX) && (mtrx[2] == ZERO_CMPLX);
+    bool isAntiDiag = (mtrx[0] == ZERO_CMPLX) && (mtrx[3] == ZERO_CMPLX);
+
+    if ((intraControlLen == 0) && isDiag) {
+        // A diagonal operator never couples the slice pair, so it reduces to per-slice phase factors.
+        ScaleSlice(isUpper ? mtrx[0] : mtrx[3]);
+        return;
+    }
+
+    int partner = rank ^ targetPow;
+
+    if ((intraControlLen == 0) && isAntiDiag) {
+        // An anti-diagonal operator is a whole-slice exchange with the partner rank, plus a per-slice factor.
+        ExchangeSlices(partner);
+        ScaleSlice(isUpper ? mtrx[1] : mtrx[2]);
+        return;
+    }
+
+    bitCapIntOcl intraMask = 0;
+    for (bitLenInt i = 0; i < intraControlLen; i++) {
+        intraMask |= pow2Ocl(intraControls[i]);
+    }
+    bitCapIntOcl intraPerm = anti ? 0 : intraMask;
+
+    // The general case streams the partner rank's amplitudes one chunk at a time against a host copy of this rank's
+    // slice; each rank combines only the matrix row its own slice holds, so the traffic is one slice each way.
+    bitCapIntOcl sliceLen = SliceLength();
+    std::unique_ptr<complex[]> mine(new complex[sliceLen]);
+    qSlice->GetQuantumState(mine.get());
+
+    const bitCapIntOcl chunk = (sliceLen < QRACK_STREAM_CHUNK_ELEMS) ? sliceLen : QRACK_STREAM_CHUNK_ELEMS;
+    std::unique_ptr<complex[]> theirs(new complex[chunk]);
+    for (bitCapIntOcl off = 0; off < sliceLen; off += chunk) {
+        bitCapIntOcl len = ((off + chunk) < sliceLen) ? chunk : (sliceLen - off);
+        MPI_Sendrecv(mine.get() + off, (int)(len * sizeof(complex)), MPI_BYTE, partner, 0, theirs.get(),
+            (int)(len * sizeof(complex)), MPI_BYTE, partner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        for (bitCapIntOcl k = 0; k < len; k++) {
+            if (((off + k) & intraMask) != intraPerm) {
+                continue;
+            }
+            complex a = isUpper ? mine[off + k] : theirs[k];
+            complex b = isUpper ? theirs[k] : mine[off + k];
+            mine[off + k] = isUpper ? ((mtrx[0] * a) + (mtrx[1] * b)) : ((mtrx[2] * a) + (mtrx[3] * b));
+        }
+    }
+
+    qSlice->SetQuantumState(mine.get());
+}
+
+void QMPI::ApplyEitherControlledSingleBit(const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex* mtrx)
+{
+    std::vector<bitLenInt> intraControls;
+    int metaMask = 0;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        if (controls[i] < qubitsPerSlice) {
+            intraControls.push_back(controls[i]);
+        } else {
+            metaMask |= 1 << (int)(controls[i] - qubitsPerSlice);
+        }
+    }
+    int metaPerm = anti ? 0 : metaMask;
+
+    if (target >= qubitsPerSlice) {
+        ApplySplitSingleBit(intraControls.size() ? &(intraControls[0]) : NULL, intraControls.size(), anti, metaMask,
+            metaPerm, mtrx, target);
+        return;
+    }
+
+    if ((rank & metaMask) != metaPerm) {
+        return;
+    }
+    if (intraControls.size() == 0) {
+        qSlice->ApplySingleBit(mtrx, target);
+    } else if (anti) {
+        qSlice->ApplyAntiControlledSingleBit(&(intraControls[0]), intraControls.size(), target, mtrx);
+    } else {
+        qSlice->ApplyControlledSingleBit(&(intraControls[0]), intraControls.size(), target, mtrx);
+    }
+}
+
+void QMPI::SetQuantumState(const complex* inputState)
+{
+    // Every rank passes the identical full-width state and keeps only its own slice of it.
+    qSlice->SetQuantumState(inputState + ((bitCapIntOcl)rank * SliceLength()));
+}
+
+void QMPI::GetQuantumState(complex* outputState)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    qSlice->GetQuantumState(outputState + ((bitCapIntOcl)rank * sliceLen));
+    for (int r = 0; r < rankCount; r++) {
+        BcastChunked(outputState + ((bitCapIntOcl)r * sliceLen), (size_t)sliceLen * sizeof(complex), r);
+    }
+}
+
+void QMPI::GetProbs(real1* outputProbs)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    qSlice->GetProbs(outputProbs + ((bitCapIntOcl)rank * sliceLen));
+    for (int r = 0; r < rankCount; r++) {
+        BcastChunked(outputProbs + ((bitCapIntOcl)r * sliceLen), (size_t)sliceLen * sizeof(real1), r);
+    }
+}
+
+void QMPI::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    // Slices stream in rank order, one broadcast chunk at a time, so no full-width host buffer is ever needed; the
+    // non-owner ranks mirror the owner's chunk loop exactly.
+    bitCapIntOcl sliceLen = SliceLength();
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    std::unique_ptr<complex[]> buff(new complex[(sliceLen < chunk) ? sliceLen : chunk]);
+    for (int r = 0; r < rankCount; r++) {
+        bitCapIntOcl sliceOffset = (bitCapIntOcl)r * sliceLen;
+        if (rank == r) {
+            qSlice->GetQuantumStateChunked(
+                [&](const complex* amps, const bitCapInt& offset, const bitCapInt& length) {
+                    std::copy(amps, amps + (bitCapIntOcl)length, buff.get());
+                    BcastChunked(buff.get(), (size_t)(bitCapIntOcl)length * sizeof(complex), r);
+                    callback(buff.get(), sliceOffset + offset, length);
+                },
+                chunkElems);
+        } else {
+            for (bitCapIntOcl off = 0; off < sliceLen; off += chunk) {
+                bitCapIntOcl len = ((off + chunk) < sliceLen) ? chunk : (sliceLen - off);
+                BcastChunked(buff.get(), (size_t)len * sizeof(complex), r);
+                callback(buff.get(), sliceOffset + off, len);
+            }
+        }
+    }
+}
+
+void QMPI::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    bitCapIntOcl chunk = (bitCapIntOcl)chunkElems;
+    std::unique_ptr<real1[]> buff(new real1[(sliceLen < chunk) ? sliceLen : chunk]);
+    for (int r = 0; r < rankCount; r++) {
+        bitCapIntOcl sliceOffset = (bitCapIntOcl)r * sliceLen;
+        if (rank == r) {
+            qSlice->GetProbsChunked(
+                [&](const real1* probs, const bitCapInt& offset, const bitCapInt& length) {
+                    std::copy(probs, probs + (bitCapIntOcl)length, buff.get());
+                    BcastChunked(buff.get(), (size_t)(bitCapIntOcl)length * sizeof(real1), r);
+                    callback(buff.get(), sliceOffset + offset, length);
+                },
+                chunkElems);
+        } else {
+            for (bitCapIntOcl off = 0; off < sliceLen; off += chunk) {
+                bitCapIntOcl len = ((off + chunk) < sliceLen) ? chunk : (sliceLen - off);
+                BcastChunked(buff.get(), (size_t)len * sizeof(real1), r);
+                callback(buff.get(), sliceOffset + off, len);
+            }
+        }
+    }
+}
+
+complex QMPI::GetAmplitude(bitCapInt perm)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    int owner = (int)((bitCapIntOcl)perm / sliceLen);
+    complex amp = ZERO_CMPLX;
+    if (rank == owner) {
+        amp = qSlice->GetAmplitude((bitCapIntOcl)perm & (sliceLen - 1U));
+    }
+    BcastChunked(&amp, sizeof(complex), owner);
+    return amp;
+}
+
+void QMPI::SetAmplitude(bitCapInt perm, complex amp)
+{
+    // SPMD callers pass the identical amplitude on every rank, so only the owner needs to act.
+    bitCapIntOcl sliceLen = SliceLength();
+    if (rank == (int)((bitCapIntOcl)perm / sliceLen)) {
+        qSlice->SetAmplitude((bitCapIntOcl)perm & (sliceLen - 1U), amp);
+    }
+}
+
+void QMPI::SetPermutation(bitCapInt perm, complex phaseFac)
+{
+    if (phaseFac == CMPLX_DEFAULT_ARG) {
+        if (randGlobalPhase) {
+            // Rank 0's draw decides, so per-node RNG streams cannot diverge the global phase.
+            real1 angle = Rand() * 2.0 * PI_R1;
+            BcastChunked(&angle, sizeof(real1), 0);
+            phaseFac = complex(cos(angle), sin(angle));
+        } else {
+            phaseFac = ONE_CMPLX;
+        }
+    }
+
+    bitCapIntOcl sliceLen = SliceLength();
+    if (rank == (int)((bitCapIntOcl)perm / sliceLen)) {
+        qSlice->SetPermutation((bitCapIntOcl)perm & (sliceLen - 1U), phaseFac);
+    } else {
+        qSlice->SetPermutation(0);
+        qSlice->SetAmplitude(0, ZERO_CMPLX);
+    }
+}
+
+bitLenInt QMPI::Compose(QMPIPtr toCopy)
+{
+    QInterfacePtr whole = GatherFull();
+    bitLenInt result = whole->Compose(toCopy->GatherFull());
+    ScatterFull(whole, qubitCount + toCopy->qubitCount);
+    return result;
+}
+
+bitLenInt QMPI::Compose(QMPIPtr toCopy, bitLenInt start)
+{
+    QInterfacePtr whole = GatherFull();
+    bitLenInt result = whole->Compose(toCopy->GatherFull(), start);
+    ScatterFull(whole, qubitCount + toCopy->qubitCount);
+    return result;
+}
+
+void QMPI::Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest)
+{
+    QMPIPtr destMpi = std::dynamic_pointer_cast<QMPI>(dest);
+    QInterfacePtr whole = GatherFull();
+    QInterfacePtr destWhole = destMpi->GatherFull();
+    whole->Decompose(start, length, destWhole);
+    ScatterFull(whole, qubitCount - length);
+    destMpi->ScatterFull(destWhole, destMpi->qubitCount);
+}
+
+void QMPI::Dispose(bitLenInt start, bitLenInt length)
+{
+    QInterfacePtr whole = GatherFull();
+    whole->Dispose(start, length);
+    ScatterFull(whole, qubitCount - length);
+}
+
+void QMPI::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
+{
+    QInterfacePtr whole = GatherFull();
+    whole->Dispose(start, length, disposedPerm);
+    ScatterFull(whole, qubitCount - length);
+}
+
+void QMPI::ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex)
+{
+    if (qubitIndex < qubitsPerSlice) {
+        qSlice->ApplySingleBit(mtrx, qubitIndex);
+        return;
+    }
+
+    ApplySplitSingleBit(NULL, 0, false, 0, 0, mtrx, qubitIndex);
+}
+
+void QMPI::ApplyControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    ApplyEitherControlledSingleBit(false, controls, controlLen, target, mtrx);
+}
+
+void QMPI::ApplyAntiControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    ApplyEitherControlledSingleBit(true, controls, controlLen, target, mtrx);
+}
+
+void QMPI::UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen, bitLenInt qubitIndex,
+    const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+    const bitCapInt& mtrxSkipValueMask)
+{
+    bitLenInt maxIndex = qubitIndex;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) {
+        engine->UniformlyControlledSingleBit(
+            controls, controlLen, qubitIndex, mtrxs, mtrxSkipPowers, mtrxSkipLen, mtrxSkipValueMask);
+    });
+}
+
+void QMPI::CSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) { engine->CSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QMPI::AntiCSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) { engine->AntiCSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QMPI::CSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) { engine->CSqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QMPI::AntiCSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(
+        maxIndex, [&](QInterfacePtr engine) { engine->AntiCSqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QMPI::CISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) { engine->CISqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QMPI::AntiCISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    bitLenInt maxIndex = std::max(qubit1, qubit2);
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(
+        maxIndex, [&](QInterfacePtr engine) { engine->AntiCISqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+bool QMPI::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
+{
+    if (doNormalize) {
+        NormalizeState();
+    }
+
+    real1 oneChance = Prob(qubit);
+    if (!doForce) {
+        if (oneChance >= ONE_R1) {
+            result = true;
+        } else if (oneChance <= ZERO_R1) {
+            result = false;
+        } else {
+            // Rank 0's draw decides, so per-node RNG streams cannot diverge the measurement outcome.
+            real1 prob = Rand();
+            BcastChunked(&prob, sizeof(real1), 0);
+            result = (prob <= oneChance);
+        }
+    }
+
+    real1 nrmlzr;
+    if (result) {
+        nrmlzr = oneChance;
+    } else {
+        nrmlzr = ONE_R1 - oneChance;
+    }
+
+    if (nrmlzr <= ZERO_R1) {
+        throw "ERROR: Forced a measurement result with 0 probability";
+    }
+
+    if (doApply) {
+        complex phase;
+        if (randGlobalPhase) {
+            real1 angle = Rand() * 2.0 * PI_R1;
+            BcastChunked(&angle, sizeof(real1), 0);
+            phase = complex(cos(angle), sin(angle));
+        } else {
+            phase = ONE_CMPLX;
+        }
+        complex nrmFac = phase / (real1)(std::sqrt(nrmlzr));
+
+        if (qubit < qubitsPerSlice) {
+            // Zero the discarded branch and renormalize the kept one, identically in every slice:
+            if (result) {
+                qSlice->ApplySinglePhase(ZERO_CMPLX, nrmFac, qubit);
+            } else {
+                qSlice->ApplySinglePhase(nrmFac, ZERO_CMPLX, qubit);
+            }
+        } else if (((rank >> (int)(qubit - qubitsPerSlice)) & 1) == (result ? 1 : 0)) {
+            ScaleSlice(nrmFac);
+        } else {
+            // This rank's whole slice is the discarded branch.
+            qSlice->SetPermutation(0);
+            qSlice->SetAmplitude(0, ZERO_CMPLX);
+        }
+    }
+
+    return result;
+}
+
+void QMPI::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    LocalOrGatherOp(start + length - 1U, [&](QInterfacePtr engine) { engine->ROL(shift, start, length); });
+}
+
+void QMPI::ROR(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    LocalOrGatherOp(start + length - 1U, [&](QInterfacePtr engine) { engine->ROR(shift, start, length); });
+}
+
+void QMPI::INC(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    LocalOrGatherOp(start + length - 1U, [&](QInterfacePtr engine) { engine->INC(toAdd, start, length); });
+}
+
+void QMPI::CINC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
+{
+    bitLenInt maxIndex = inOutStart + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(
+        maxIndex, [&](QInterfacePtr engine) { engine->CINC(toAdd, inOutStart, length, controls, controlLen); });
+}
+
+void QMPI::INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->INCC(toAdd, start, length, carryIndex); });
+}
+
+void QMPI::INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), overflowIndex),
+        [&](QInterfacePtr engine) { engine->INCS(toAdd, start, length, overflowIndex); });
+}
+
+void QMPI::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max(std::max((bitLenInt)(start + length - 1U), overflowIndex), carryIndex),
+        [&](QInterfacePtr engine) { engine->INCSC(toAdd, start, length, overflowIndex, carryIndex); });
+}
+
+void QMPI::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->INCSC(toAdd, start, length, carryIndex); });
+}
+
+void QMPI::INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    LocalOrGatherOp(start + length - 1U, [&](QInterfacePtr engine) { engine->INCBCD(toAdd, start, length); });
+}
+
+void QMPI::INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->INCBCDC(toAdd, start, length, carryIndex); });
+}
+
+void QMPI::DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->DECC(toSub, start, length, carryIndex); });
+}
+
+void QMPI::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max(std::max((bitLenInt)(start + length - 1U), overflowIndex), carryIndex),
+        [&](QInterfacePtr engine) { engine->DECSC(toSub, start, length, overflowIndex, carryIndex); });
+}
+
+void QMPI::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->DECSC(toSub, start, length, carryIndex); });
+}
+
+void QMPI::DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), carryIndex),
+        [&](QInterfacePtr engine) { engine->DECBCDC(toSub, start, length, carryIndex); });
+}
+
+void QMPI::MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    LocalOrGatherOp(std::max(inOutStart, carryStart) + length - 1U,
+        [&](QInterfacePtr engine) { engine->MUL(toMul, inOutStart, carryStart, length); });
+}
+
+void QMPI::DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    LocalOrGatherOp(std::max(inOutStart, carryStart) + length - 1U,
+        [&](QInterfacePtr engine) { engine->DIV(toDiv, inOutStart, carryStart, length); });
+}
+
+void QMPI::MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    LocalOrGatherOp(std::max(inStart, outStart) + length - 1U,
+        [&](QInterfacePtr engine) { engine->MULModNOut(toMul, modN, inStart, outStart, length); });
+}
+
+void QMPI::IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    LocalOrGatherOp(std::max(inStart, outStart) + length - 1U,
+        [&](QInterfacePtr engine) { engine->IMULModNOut(toMul, modN, inStart, outStart, length); });
+}
+
+void QMPI::POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    LocalOrGatherOp(std::max(inStart, outStart) + length - 1U,
+        [&](QInterfacePtr engine) { engine->POWModNOut(base, modN, inStart, outStart, length); });
+}
+
+void QMPI::CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    bitLenInt maxIndex = std::max(inOutStart, carryStart) + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex,
+        [&](QInterfacePtr engine) { engine->CMUL(toMul, inOutStart, carryStart, length, controls, controlLen); });
+}
+
+void QMPI::CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    bitLenInt maxIndex = std::max(inOutStart, carryStart) + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex,
+        [&](QInterfacePtr engine) { engine->CDIV(toDiv, inOutStart, carryStart, length, controls, controlLen); });
+}
+
+void QMPI::CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    bitLenInt maxIndex = std::max(inStart, outStart) + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) {
+        engine->CMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QMPI::CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    bitLenInt maxIndex = std::max(inStart, outStart) + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) {
+        engine->CIMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QMPI::CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    bitLenInt maxIndex = std::max(inStart, outStart) + length - 1U;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        maxIndex = std::max(maxIndex, controls[i]);
+    }
+    LocalOrGatherOp(maxIndex, [&](QInterfacePtr engine) {
+        engine->CPOWModNOut(base, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QMPI::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
+{
+    if ((start + length) <= qubitsPerSlice) {
+        qSlice->ZeroPhaseFlip(start, length);
+        return;
+    }
+
+    // The register's rank-selecting bits just deselect ranks; the in-slice remainder flips locally.
+    int metaMask = (int)(bitRegMask(start, length) >> qubitsPerSlice);
+    if ((rank & metaMask) != 0) {
+        return;
+    }
+    if (start < qubitsPerSlice) {
+        qSlice->ZeroPhaseFlip(start, qubitsPerSlice - start);
+    } else {
+        ScaleSlice(-ONE_CMPLX);
+    }
+}
+
+void QMPI::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
+{
+    LocalOrGatherOp(std::max((bitLenInt)(start + length - 1U), flagIndex),
+        [&](QInterfacePtr engine) { engine->CPhaseFlipIfLess(greaterPerm, start, length, flagIndex); });
+}
+
+void QMPI::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
+{
+    LocalOrGatherOp(
+        start + length - 1U, [&](QInterfacePtr engine) { engine->PhaseFlipIfLess(greaterPerm, start, length); });
+}
+
+void QMPI::PhaseFlip() { ScaleSlice(-ONE_CMPLX); }
+
+bitCapInt QMPI::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    unsigned char* values, bool resetValue)
+{
+    // The return value is an expectation over the whole state, which couples every slice, so the QRAM operations
+    // always take the gather fallback, (keeping the SPMD return value identical on every rank).
+    QInterfacePtr whole = GatherFull();
+    bitCapInt toRet = whole->IndexedLDA(indexStart, indexLength, valueStart, valueLength, values, resetValue);
+    ScatterFull(whole, qubitCount);
+    return toRet;
+}
+
+bitCapInt QMPI::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    QInterfacePtr whole = GatherFull();
+    bitCapInt toRet = whole->IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    ScatterFull(whole, qubitCount);
+    return toRet;
+}
+
+bitCapInt QMPI::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    QInterfacePtr whole = GatherFull();
+    bitCapInt toRet = whole->IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    ScatterFull(whole, qubitCount);
+    return toRet;
+}
+
+void QMPI::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    // Unlike the other QRAM operations, there is no expectation return value coupling every slice, so the local path
+    // is available whenever the index register and carry both fall within one slice.
+    LocalOrGatherOp(std::max((bitLenInt)(indexStart + indexLength - 1U), carryIndex), [&](QInterfacePtr engine) {
+        engine->IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, values);
+    });
+}
+
+void QMPI::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
+{
+    LocalOrGatherOp(start + length - 1U, [&](QInterfacePtr engine) { engine->Hash(start, length, values); });
+}
+
+void QMPI::Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (qubitIndex1 == qubitIndex2) {
+        return;
+    }
+
+    if ((qubitIndex1 < qubitsPerSlice) && (qubitIndex2 < qubitsPerSlice)) {
+        qSlice->Swap(qubitIndex1, qubitIndex2);
+        return;
+    }
+
+    if ((qubitIndex1 >= qubitsPerSlice) && (qubitIndex2 >= qubitsPerSlice)) {
+        // Swapping two rank-selecting qubits permutes slice ownership, between ranks whose two bits differ.
+        int qPow1 = 1 << (int)(qubitIndex1 - qubitsPerSlice);
+        int qPow2 = 1 << (int)(qubitIndex2 - qubitsPerSlice);
+        if (((bool)(rank & qPow1)) != ((bool)(rank & qPow2))) {
+            ExchangeSlices(rank ^ (qPow1 | qPow2));
+        }
+        return;
+    }
+
+    // A swap split across the slice boundary decomposes into three CNOTs, each of which has a distributed
+    // implementation, instead of gathering.
+    const complex pauliX[4] = { ZERO_CMPLX, ONE_CMPLX, ONE_CMPLX, ZERO_CMPLX };
+    bitLenInt q1 = qubitIndex1;
+    bitLenInt q2 = qubitIndex2;
+    ApplyControlledSingleBit(&q1, 1, q2, pauliX);
+    ApplyControlledSingleBit(&q2, 1, q1, pauliX);
+    ApplyControlledSingleBit(&q1, 1, q2, pauliX);
+}
+
+void QMPI::ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    LocalOrGatherOp(std::max(qubitIndex1, qubitIndex2),
+        [&](QInterfacePtr engine) { engine->ISwap(qubitIndex1, qubitIndex2); });
+}
+
+void QMPI::SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    LocalOrGatherOp(std::max(qubitIndex1, qubitIndex2),
+        [&](QInterfacePtr engine) { engine->SqrtSwap(qubitIndex1, qubitIndex2); });
+}
+
+void QMPI::ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    LocalOrGatherOp(std::max(qubitIndex1, qubitIndex2),
+        [&](QInterfacePtr engine) { engine->ISqrtSwap(qubitIndex1, qubitIndex2); });
+}
+
+void QMPI::FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    LocalOrGatherOp(std::max(qubitIndex1, qubitIndex2),
+        [&](QInterfacePtr engine) { engine->FSim(theta, phi, qubitIndex1, qubitIndex2); });
+}
+
+real1 QMPI::Prob(bitLenInt qubitIndex)
+{
+    real1 oneChance = ZERO_R1;
+    if (qubitIndex < qubitsPerSlice) {
+        // Slices never normalize themselves, so raw per-slice probabilities sum directly.
+        oneChance = qSlice->Prob(qubitIndex);
+    } else if (rank & (1 << (int)(qubitIndex - qubitsPerSlice))) {
+        // Whole slices are the |1> branch of a rank-selecting qubit.
+        oneChance = SliceNorm();
+    }
+    return clampProb(AllSum(oneChance));
+}
+
+real1 QMPI::ProbAll(bitCapInt fullRegister)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    int owner = (int)((bitCapIntOcl)fullRegister / sliceLen);
+    real1 toRet = ZERO_R1;
+    if (rank == owner) {
+        toRet = qSlice->ProbAll((bitCapIntOcl)fullRegister & (sliceLen - 1U));
+    }
+    BcastChunked(&toRet, sizeof(real1), owner);
+    return toRet;
+}
+
+real1 QMPI::ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation)
+{
+    return ProbMask(bitRegMask(start, length), permutation << start);
+}
+
+real1 QMPI::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
+{
+    bitCapIntOcl sliceLen = SliceLength();
+    bitCapIntOcl intraMask = (bitCapIntOcl)mask & (sliceLen - 1U);
+    bitCapIntOcl intraPerm = (bitCapIntOcl)permutation & intraMask;
+    int metaMask = (int)(mask >> qubitsPerSlice);
+    int metaPerm = ((int)(permutation >> qubitsPerSlice)) & metaMask;
+
+    real1 part = ZERO_R1;
+    if ((rank & metaMask) == metaPerm) {
+        part = intraMask ? qSlice->ProbMask(intraMask, intraPerm) : SliceNorm();
+    }
+    return clampProb(AllSum(part));
+}
+
+bool QMPI::ApproxCompare(QMPIPtr toCompare)
+{
+    // Each rank gathers both full states, so every rank returns the identical verdict.
+    return GatherFull()->ApproxCompare(toCompare->GatherFull());
+}
+
+void QMPI::UpdateRunningNorm(real1 norm_thresh) { qSlice->UpdateRunningNorm(norm_thresh); }
+
+void QMPI::NormalizeState(real1 nrm, real1 norm_thresh)
+{
+    if (nrm < ZERO_R1) {
+        // The global norm couples every slice, so it is summed across the ranks before each slice rescales.
+        nrm = AllSum(SliceNorm());
+    }
+    qSlice->NormalizeState(nrm, norm_thresh);
+}
+
+QInterfacePtr QMPI::Clone()
+{
+    QMPIPtr clone = std::make_shared<QMPI>(engineType, qubitCount, 0, rand_generator, ONE_CMPLX, doNormalize,
+        randGlobalPhase, useHostRam, deviceID, useRDRAND, isSparse, amplitudeFloor);
+    clone->qSlice = qSlice->Clone();
+    return clone;
+}
+
+} // namespace Qrack
@@ -0,0 +1,860 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2019. All rights reserved.
+//
+// QPager breaks a state vector up into pages of contiguous amplitudes, each of which
+// fits a single QEngine allocation, so that the total state vector can exceed the
+// maximum single allocation of an (OpenCL) device.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include <cstdlib>
+#include <string>
+
+#include "qfactory.hpp"
+#include "qpager.hpp"
+
+namespace Qrack {
+
+QPager::QPager(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp,
+    complex phaseFac, bool doNorm, bool randomGlobalPhase, bool useHostMem, int deviceId, bool useHardwareRNG,
+    bool useSparseStateVec, real1 norm_thresh, std::vector<bitLenInt> devList)
+    : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
+    , engineType(eng)
+    , deviceID(deviceId)
+    , useHostRam(useHostMem)
+    , useRDRAND(useHardwareRNG)
+    , isSparse(useSparseStateVec)
+{
+    if (devList.size() > 0) {
+        for (bitLenInt i = 0; i < devList.size(); i++) {
+            deviceIDs.push_back(devList[i]);
+        }
+    } else {
+#if ENABLE_OPENCL
+        if (engineType == QINTERFACE_OPENCL) {
+            // Shard across every available device, with the (or the requested) default device first.
+            int devCount = OCLEngine::Instance()->GetDeviceCount();
+            int defaultDev = (deviceID < 0) ? OCLEngine::Instance()->GetDefaultDeviceID() : deviceID;
+            deviceIDs.push_back(defaultDev);
+            for (int i = 0; i < devCount; i++) {
+                if (i != defaultDev) {
+                    deviceIDs.push_back(i);
+                }
+            }
+        }
+#endif
+        if (deviceIDs.size() == 0) {
+            deviceIDs.push_back(deviceID);
+        }
+    }
+
+    if (getenv("QRACK_MAX_PAGE_QB")) {
+        maxPageQubits = (bitLenInt)std::stoi(std::string(getenv("QRACK_MAX_PAGE_QB")));
+        if (maxPageQubits < 1U) {
+            maxPageQubits = 1U;
+        }
+    } else {
+#if ENABLE_OPENCL
+        if (engineType == QINTERFACE_OPENCL) {
+            // Pages are sized to the largest single allocation the device allows, (also leaving room for the
+            // temporary buffers of OclMemDenom,) which is the allocation limit paging exists to exceed.
+            DeviceContextPtr deviceContext = OCLEngine::Instance()->GetDeviceContextPtr(deviceID);
+            bitCapIntOcl maxAlloc =
+                (bitCapIntOcl)deviceContext->device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() / sizeof(complex);
+            maxPageQubits = log2(maxAlloc);
+        } else
+#endif
+        {
+            maxPageQubits = DEFAULT_MAX_PAGE_QUBITS;
+        }
+    }
+
+    SetQubitCount(qBitCount);
+
+    bitCapIntOcl pageCount = pow2Ocl(qubitCount - qubitsPerPage);
+    for (bitCapIntOcl i = 0; i < pageCount; i++) {
+        qPages.push_back(MakePage(qubitsPerPage, 0, PageDevice(i, pageCount)));
+    }
+
+    SetPermutation(initState, phaseFac);
+}
+
+QInterfacePtr QPager::MakePage(bitLenInt length, bitCapInt perm, int devID)
+{
+    // Pages are always created with normalization off and a deterministic global phase: the relative phase and norm
+    // BETWEEN pages is physically meaningful, so no page may independently adjust its own.
+    return CreateQuantumInterface(engineType, length, perm, rand_generator, ONE_CMPLX, false, false, useHostRam,
+        devID, useRDRAND, isSparse, amplitudeFloor);
+}
+
+void QPager::CombineEngines()
+{
+    if (qPages.size() == 1U) {
+        return;
+    }
+
+    bitCapIntOcl pageLen = PageLength();
+    std::unique_ptr<complex[]> stateVec(new complex[(bitCapIntOcl)maxQPower]);
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        qPages[i]->GetQuantumState(stateVec.get() + (i * pageLen));
+    }
+
+    QInterfacePtr nPage = MakePage(qubitCount, 0, deviceIDs[0]);
+    nPage->SetQuantumState(stateVec.get());
+
+    qPages.resize(1);
+    qPages[0] = nPage;
+}
+
+void QPager::SeparateEngines()
+{
+    if ((qPages.size() > 1U) || (qubitCount <= qubitsPerPage)) {
+        return;
+    }
+
+    bitCapIntOcl pageCount = pow2Ocl(qubitCount - qubitsPerPage);
+    bitCapIntOcl pageLen = pow2Ocl(qubitsPerPage);
+    std::unique_ptr<complex[]> stateVec(new complex[(bitCapIntOcl)maxQPower]);
+    qPages[0]->GetQuantumState(stateVec.get());
+
+    std::vector<QInterfacePtr> nPages;
+    for (bitCapIntOcl i = 0; i < pageCount; i++) {
+        QInterfacePtr nPage = MakePage(qubitsPerPage, 0, PageDevice(i, pageCount));
+        nPage->SetQuantumState(stateVec.get() + (i * pageLen));
+        nPages.push_back(nPage);
+    }
+
+    qPages = nPages;
+}
+
+void QPager::CombineAndOp(std::function<void(QInterfacePtr)> fn)
+{
+    CombineEngines();
+    fn(qPages[0]);
+    SeparateEngines();
+}
+
+void QPager::ScalePage(QInterfacePtr page, const complex& scale)
+{
+    if (scale == ONE_CMPLX) {
+        return;
+    }
+    // A scalar matrix passes the engine's IsIdentity() global phase check and would be skipped, so the factor is
+    // split across two complementary phase gates, neither of which is an identity.
+    page->ApplySinglePhase(ONE_CMPLX, scale, 0);
+    page->ApplySinglePhase(scale, ONE_CMPLX, 0);
+}
+
+void QPager::ApplyHighSingleBit(const bitLenInt* intraControls, const bitLenInt& intraControlLen, const bool& anti,
+    const bitCapIntOcl& metaMask, const bitCapIntOcl& metaPerm, const complex* mtrx, const bitLenInt& target)
+{
+    bitCapIntOcl targetPow = pow2Ocl(target - qubitsPerPage);
+    bool isDiag = (mtrx[1] == ZERO_CMPLX) && (mtrx[2] == ZERO_CMPLX);
+    bool isAntiDiag = (mtrx[0] == ZERO_CMPLX) && (mtrx[3] == ZERO_CMPLX);
+
+    bitCapIntOcl intraMask = 0;
+    for (bitLenInt i = 0; i < intraControlLen; i++) {
+        intraMask |= pow2Ocl(intraControls[i]);
+    }
+    bitCapIntOcl intraPerm = anti ? 0 : intraMask;
+
+    bitCapIntOcl pageLen = PageLength();
+    std::unique_ptr<complex[]> amps0;
+    std::unique_ptr<complex[]> amps1;
+
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        if ((i & targetPow) || ((i & metaMask) != metaPerm)) {
+            continue;
+        }
+        bitCapIntOcl j = i | targetPow;
+
+        if ((intraControlLen == 0) && isDiag) {
+            // A diagonal operator never couples the page pair, so it reduces to per-page phase factors.
+            ScalePage(qPages[i], mtrx[0]);
+            ScalePage(qPages[j], mtrx[3]);
+            continue;
+        }
+
+        if ((intraControlLen == 0) && isAntiDiag) {
+            // An anti-diagonal operator is a page swap, (without touching any amplitudes, for X).
+            std::swap(qPages[i], qPages[j]);
+            ScalePage(qPages[i], mtrx[1]);
+            ScalePage(qPages[j], mtrx[2]);
+            continue;
+        }
+
+        // The general case streams one page pair at a time through host memory, so only two pages (plus the
+        // transfer buffers) need to be resident at once.
+        if (amps0 == NULL) {
+            amps0.reset(new complex[pageLen]);
+            amps1.reset(new complex[pageLen]);
+        }
+        qPages[i]->GetQuantumState(amps0.get());
+        qPages[j]->GetQuantumState(amps1.get());
+        for (bitCapIntOcl k = 0; k < pageLen; k++) {
+            if ((k & intraMask) != intraPerm) {
+                continue;
+            }
+            complex a = amps0[k];
+            complex b = amps1[k];
+            amps0[k] = (mtrx[0] * a) + (mtrx[1] * b);
+            amps1[k] = (mtrx[2] * a) + (mtrx[3] * b);
+        }
+        qPages[i]->SetQuantumState(amps0.get());
+        qPages[j]->SetQuantumState(amps1.get());
+    }
+}
+
+void QPager::ApplyEitherControlledSingleBit(const bool& anti, const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex* mtrx)
+{
+    std::vector<bitLenInt> intraControls;
+    bitCapIntOcl metaMask = 0;
+    for (bitLenInt i = 0; i < controlLen; i++) {
+        if (controls[i] < qubitsPerPage) {
+            intraControls.push_back(controls[i]);
+        } else {
+            metaMask |= pow2Ocl(controls[i] - qubitsPerPage);
+        }
+    }
+    bitCapIntOcl metaPerm = anti ? 0 : metaMask;
+
+    if (target >= qubitsPerPage) {
+        ApplyHighSingleBit(intraControls.size() ? &(intraControls[0]) : NULL, intraControls.size(), anti, metaMask,
+            metaPerm, mtrx, target);
+        return;
+    }
+
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        if ((i & metaMask) != metaPerm) {
+            continue;
+        }
+        if (intraControls.size() == 0) {
+            qPages[i]->ApplySingleBit(mtrx, target);
+        } else if (anti) {
+            qPages[i]->ApplyAntiControlledSingleBit(&(intraControls[0]), intraControls.size(), target, mtrx);
+        } else {
+            qPages[i]->ApplyControlledSingleBit(&(intraControls[0]), intraControls.size(), target, mtrx);
+        }
+    }
+}
+
+void QPager::SetQuantumState(const complex* inputState)
+{
+    bitCapIntOcl pageLen = PageLength();
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        qPages[i]->SetQuantumState(inputState + (i * pageLen));
+    }
+}
+
+void QPager::GetQuantumState(complex* outputState)
+{
+    bitCapIntOcl pageLen = PageLength();
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        qPages[i]->GetQuantumState(outputState + (i * pageLen));
+    }
+}
+
+void QPager::GetProbs(real1* outputProbs)
+{
+    bitCapIntOcl pageLen = PageLength();
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        qPages[i]->GetProbs(outputProbs + (i * pageLen));
+    }
+}
+
+void QPager::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    // Pages stream independently, so no full-width host buffer is ever needed:
+    bitCapIntOcl pageLen = PageLength();
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        bitCapIntOcl pageOffset = i * pageLen;
+        qPages[i]->GetQuantumStateChunked(
+            [&](const complex* chunk, const bitCapInt& offset, const bitCapInt& length) {
+                callback(chunk, pageOffset + offset, length);
+            },
+            chunkElems);
+    }
+}
+
+void QPager::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    bitCapIntOcl pageLen = PageLength();
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        bitCapIntOcl pageOffset = i * pageLen;
+        qPages[i]->GetProbsChunked(
+            [&](const real1* chunk, const bitCapInt& offset, const bitCapInt& length) {
+                callback(chunk, pageOffset + offset, length);
+            },
+            chunkElems);
+    }
+}
+
+complex QPager::GetAmplitude(bitCapInt perm)
+{
+    bitCapIntOcl pageLen = PageLength();
+    return qPages[(bitCapIntOcl)perm / pageLen]->GetAmplitude((bitCapIntOcl)perm & (pageLen - 1U));
+}
+
+void QPager::SetAmplitude(bitCapInt perm, complex amp)
+{
+    bitCapIntOcl pageLen = PageLength();
+    qPages[(bitCapIntOcl)perm / pageLen]->SetAmplitude((bitCapIntOcl)perm & (pageLen - 1U), amp);
+}
+
+void QPager::SetPermutation(bitCapInt perm, complex phaseFac)
+{
+    if (phaseFac == CMPLX_DEFAULT_ARG) {
+        if (randGlobalPhase) {
+            real1 angle = Rand() * 2.0 * PI_R1;
+            phaseFac = complex(cos(angle), sin(angle));
+        } else {
+            phaseFac = ONE_CMPLX;
+        }
+    }
+
+    bitCapIntOcl pageLen = PageLength();
+    bitCapIntOcl pagePerm = (bitCapIntOcl)perm / pageLen;
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        if (i == pagePerm) {
+            qPages[i]->SetPermutation((bitCapIntOcl)perm & (pageLen - 1U), phaseFac);
+        } else {
+            qPages[i]->SetPermutation(0);
+            qPages[i]->SetAmplitude(0, ZERO_CMPLX);
+        }
+    }
+}
+
+bitLenInt QPager::Compose(QPagerPtr toCopy)
+{
+    bitLenInt result;
+    CombineEngines();
+    toCopy->CombineEngines();
+    result = qPages[0]->Compose(toCopy->qPages[0]);
+    SetQubitCount(qubitCount + toCopy->qubitCount);
+    SeparateEngines();
+    toCopy->SeparateEngines();
+    return result;
+}
+
+bitLenInt QPager::Compose(QPagerPtr toCopy, bitLenInt start)
+{
+    bitLenInt result;
+    CombineEngines();
+    toCopy->CombineEngines();
+    result = qPages[0]->Compose(toCopy->qPages[0], start);
+    SetQubitCount(qubitCount + toCopy->qubitCount);
+    SeparateEngines();
+    toCopy->SeparateEngines();
+    return result;
+}
+
+void QPager::Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest)
+{
+    QPagerPtr destPager = std::dynamic_pointer_cast<QPager>(dest);
+    CombineEngines();
+    destPager->CombineEngines();
+    qPages[0]->Decompose(start, length, destPager->qPages[0]);
+    SetQubitCount(qubitCount - length);
+    SeparateEngines();
+    destPager->SeparateEngines();
+}
+
+void QPager::Dispose(bitLenInt start, bitLenInt length)
+{
+    CombineEngines();
+    qPages[0]->Dispose(start, length);
+    SetQubitCount(qubitCount - length);
+    SeparateEngines();
+}
+
+void QPager::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
+{
+    CombineEngines();
+    qPages[0]->Dispose(start, length, disposedPerm);
+    SetQubitCount(qubitCount - length);
+    SeparateEngines();
+}
+
+void QPager::ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex)
+{
+    if (qubitIndex < qubitsPerPage) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->ApplySingleBit(mtrx, qubitIndex);
+        }
+        return;
+    }
+
+    ApplyHighSingleBit(NULL, 0, false, 0, 0, mtrx, qubitIndex);
+}
+
+void QPager::ApplyControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    ApplyEitherControlledSingleBit(false, controls, controlLen, target, mtrx);
+}
+
+void QPager::ApplyAntiControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    ApplyEitherControlledSingleBit(true, controls, controlLen, target, mtrx);
+}
+
+void QPager::UniformlyControlledSingleBit(const bitLenInt* controls, const bitLenInt& controlLen, bitLenInt qubitIndex,
+    const complex* mtrxs, const bitCapInt* mtrxSkipPowers, const bitLenInt mtrxSkipLen,
+    const bitCapInt& mtrxSkipValueMask)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->UniformlyControlledSingleBit(
+            controls, controlLen, qubitIndex, mtrxs, mtrxSkipPowers, mtrxSkipLen, mtrxSkipValueMask);
+    });
+}
+
+void QPager::CSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->CSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QPager::AntiCSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->AntiCSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QPager::CSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->CSqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QPager::AntiCSqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->AntiCSqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QPager::CISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->CISqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+void QPager::AntiCISqrtSwap(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& qubit1, const bitLenInt& qubit2)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->AntiCISqrtSwap(controls, controlLen, qubit1, qubit2); });
+}
+
+bool QPager::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
+{
+    bool toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->ForceM(qubit, result, doForce, doApply); });
+    return toRet;
+}
+
+bitCapInt QPager::ForceM(const bitLenInt* bits, const bitLenInt& length, const bool* values, bool doApply)
+{
+    bitCapInt toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->ForceM(bits, length, values, doApply); });
+    return toRet;
+}
+
+bitCapInt QPager::ForceMReg(bitLenInt start, bitLenInt length, bitCapInt result, bool doForce, bool doApply)
+{
+    bitCapInt toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->ForceMReg(start, length, result, doForce, doApply); });
+    return toRet;
+}
+
+void QPager::ROL(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->ROL(shift, start, length); });
+}
+
+void QPager::ROR(bitLenInt shift, bitLenInt start, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->ROR(shift, start, length); });
+}
+
+void QPager::INC(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INC(toAdd, start, length); });
+}
+
+void QPager::CINC(bitCapInt toAdd, bitLenInt inOutStart, bitLenInt length, bitLenInt* controls, bitLenInt controlLen)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->CINC(toAdd, inOutStart, length, controls, controlLen); });
+}
+
+void QPager::INCC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCC(toAdd, start, length, carryIndex); });
+}
+
+void QPager::INCS(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCS(toAdd, start, length, overflowIndex); });
+}
+
+void QPager::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCSC(toAdd, start, length, overflowIndex, carryIndex); });
+}
+
+void QPager::INCSC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCSC(toAdd, start, length, carryIndex); });
+}
+
+void QPager::INCBCD(bitCapInt toAdd, bitLenInt start, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCBCD(toAdd, start, length); });
+}
+
+void QPager::INCBCDC(bitCapInt toAdd, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->INCBCDC(toAdd, start, length, carryIndex); });
+}
+
+void QPager::DECC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->DECC(toSub, start, length, carryIndex); });
+}
+
+void QPager::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt overflowIndex, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->DECSC(toSub, start, length, overflowIndex, carryIndex); });
+}
+
+void QPager::DECSC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->DECSC(toSub, start, length, carryIndex); });
+}
+
+void QPager::DECBCDC(bitCapInt toSub, bitLenInt start, bitLenInt length, bitLenInt carryIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->DECBCDC(toSub, start, length, carryIndex); });
+}
+
+void QPager::MUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->MUL(toMul, inOutStart, carryStart, length); });
+}
+
+void QPager::DIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->DIV(toDiv, inOutStart, carryStart, length); });
+}
+
+void QPager::MULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->MULModNOut(toMul, modN, inStart, outStart, length); });
+}
+
+void QPager::IMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->IMULModNOut(toMul, modN, inStart, outStart, length); });
+}
+
+void QPager::POWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->POWModNOut(base, modN, inStart, outStart, length); });
+}
+
+void QPager::CMUL(bitCapInt toMul, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    CombineAndOp(
+        [&](QInterfacePtr engine) { engine->CMUL(toMul, inOutStart, carryStart, length, controls, controlLen); });
+}
+
+void QPager::CDIV(bitCapInt toDiv, bitLenInt inOutStart, bitLenInt carryStart, bitLenInt length, bitLenInt* controls,
+    bitLenInt controlLen)
+{
+    CombineAndOp(
+        [&](QInterfacePtr engine) { engine->CDIV(toDiv, inOutStart, carryStart, length, controls, controlLen); });
+}
+
+void QPager::CMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->CMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QPager::CIMULModNOut(bitCapInt toMul, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->CIMULModNOut(toMul, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QPager::CPOWModNOut(bitCapInt base, bitCapInt modN, bitLenInt inStart, bitLenInt outStart, bitLenInt length,
+    bitLenInt* controls, bitLenInt controlLen)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->CPOWModNOut(base, modN, inStart, outStart, length, controls, controlLen);
+    });
+}
+
+void QPager::ZeroPhaseFlip(bitLenInt start, bitLenInt length)
+{
+    // The flip condition factors into an in-page condition and a page index condition, so this never couples pages.
+    bitLenInt end = start + length;
+    bitCapIntOcl metaMask = 0;
+    for (bitLenInt i = (start < qubitsPerPage) ? qubitsPerPage : start; i < end; i++) {
+        metaMask |= pow2Ocl(i - qubitsPerPage);
+    }
+    bitLenInt intraLen = (start < qubitsPerPage) ? (((end < qubitsPerPage) ? end : qubitsPerPage) - start) : 0;
+
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        if (i & metaMask) {
+            continue;
+        }
+        if (intraLen) {
+            qPages[i]->ZeroPhaseFlip(start, intraLen);
+        } else {
+            ScalePage(qPages[i], -ONE_CMPLX);
+        }
+    }
+}
+
+void QPager::CPhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length, bitLenInt flagIndex)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->CPhaseFlipIfLess(greaterPerm, start, length, flagIndex); });
+}
+
+void QPager::PhaseFlipIfLess(bitCapInt greaterPerm, bitLenInt start, bitLenInt length)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->PhaseFlipIfLess(greaterPerm, start, length); });
+}
+
+void QPager::PhaseFlip()
+{
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        ScalePage(qPages[i], -ONE_CMPLX);
+    }
+}
+
+bitCapInt QPager::IndexedLDA(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    unsigned char* values, bool resetValue)
+{
+    bitCapInt toRet;
+    CombineAndOp([&](QInterfacePtr engine) {
+        toRet = engine->IndexedLDA(indexStart, indexLength, valueStart, valueLength, values, resetValue);
+    });
+    return toRet;
+}
+
+bitCapInt QPager::IndexedADC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    bitCapInt toRet;
+    CombineAndOp([&](QInterfacePtr engine) {
+        toRet = engine->IndexedADC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    });
+    return toRet;
+}
+
+bitCapInt QPager::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueStart, bitLenInt valueLength,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    bitCapInt toRet;
+    CombineAndOp([&](QInterfacePtr engine) {
+        toRet = engine->IndexedSBC(indexStart, indexLength, valueStart, valueLength, carryIndex, values);
+    });
+    return toRet;
+}
+
+void QPager::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->IndexedCMP(indexStart, indexLength, valueLength, greaterPerm, carryIndex, values);
+    });
+}
+
+void QPager::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
+{
+    CombineAndOp([&](QInterfacePtr engine) { engine->Hash(start, length, values); });
+}
+
+void QPager::Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (qubitIndex1 == qubitIndex2) {
+        return;
+    }
+
+    if ((qubitIndex1 < qubitsPerPage) && (qubitIndex2 < qubitsPerPage)) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->Swap(qubitIndex1, qubitIndex2);
+        }
+        return;
+    }
+
+    if ((qubitIndex1 >= qubitsPerPage) && (qubitIndex2 >= qubitsPerPage)) {
+        // Swapping two page-selecting qubits is a pure page index permutation.
+        bitCapIntOcl qPow1 = pow2Ocl(qubitIndex1 - qubitsPerPage);
+        bitCapIntOcl qPow2 = pow2Ocl(qubitIndex2 - qubitsPerPage);
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            if ((i & qPow1) && !(i & qPow2)) {
+                std::swap(qPages[i], qPages[(i & ~qPow1) | qPow2]);
+            }
+        }
+        return;
+    }
+
+    CombineAndOp([&](QInterfacePtr engine) { engine->Swap(qubitIndex1, qubitIndex2); });
+}
+
+void QPager::ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if ((qubitIndex1 < qubitsPerPage) && (qubitIndex2 < qubitsPerPage)) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->ISwap(qubitIndex1, qubitIndex2);
+        }
+        return;
+    }
+
+    CombineAndOp([&](QInterfacePtr engine) { engine->ISwap(qubitIndex1, qubitIndex2); });
+}
+
+void QPager::SqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if ((qubitIndex1 < qubitsPerPage) && (qubitIndex2 < qubitsPerPage)) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->SqrtSwap(qubitIndex1, qubitIndex2);
+        }
+        return;
+    }
+
+    CombineAndOp([&](QInterfacePtr engine) { engine->SqrtSwap(qubitIndex1, qubitIndex2); });
+}
+
+void QPager::ISqrtSwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if ((qubitIndex1 < qubitsPerPage) && (qubitIndex2 < qubitsPerPage)) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->ISqrtSwap(qubitIndex1, qubitIndex2);
+        }
+        return;
+    }
+
+    CombineAndOp([&](QInterfacePtr engine) { engine->ISqrtSwap(qubitIndex1, qubitIndex2); });
+}
+
+void QPager::FSim(real1 theta, real1 phi, bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if ((qubitIndex1 < qubitsPerPage) && (qubitIndex2 < qubitsPerPage)) {
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            qPages[i]->FSim(theta, phi, qubitIndex1, qubitIndex2);
+        }
+        return;
+    }
+
+    CombineAndOp([&](QInterfacePtr engine) { engine->FSim(theta, phi, qubitIndex1, qubitIndex2); });
+}
+
+real1 QPager::Prob(bitLenInt qubitIndex)
+{
+    if (qPages.size() == 1U) {
+        return qPages[0]->Prob(qubitIndex);
+    }
+
+    real1 oneChance = ZERO_R1;
+
+    if (qubitIndex < qubitsPerPage) {
+        // Pages never normalize themselves, so raw per-page probabilities sum directly.
+        for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+            oneChance += qPages[i]->Prob(qubitIndex);
+        }
+        return clampProb(oneChance);
+    }
+
+    bitCapIntOcl qPow = pow2Ocl(qubitIndex - qubitsPerPage);
+    bitCapIntOcl pageLen = PageLength();
+    std::unique_ptr<real1[]> probs(new real1[pageLen]);
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        if (!(i & qPow)) {
+            continue;
+        }
+        qPages[i]->GetProbs(probs.get());
+        for (bitCapIntOcl k = 0; k < pageLen; k++) {
+            oneChance += probs[k];
+        }
+    }
+
+    return clampProb(oneChance);
+}
+
+real1 QPager::ProbAll(bitCapInt fullRegister)
+{
+    bitCapIntOcl pageLen = PageLength();
+    return qPages[(bitCapIntOcl)fullRegister / pageLen]->ProbAll((bitCapIntOcl)fullRegister & (pageLen - 1U));
+}
+
+real1 QPager::ProbReg(const bitLenInt& start, const bitLenInt& length, const bitCapInt& permutation)
+{
+    real1 toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->ProbReg(start, length, permutation); });
+    return toRet;
+}
+
+real1 QPager::ProbMask(const bitCapInt& mask, const bitCapInt& permutation)
+{
+    real1 toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->ProbMask(mask, permutation); });
+    return toRet;
+}
+
+bool QPager::ApproxCompare(QPagerPtr toCompare)
+{
+    bool toRet;
+    CombineEngines();
+    toCompare->CombineEngines();
+    toRet = qPages[0]->ApproxCompare(toCompare->qPages[0]);
+    SeparateEngines();
+    toCompare->SeparateEngines();
+    return toRet;
+}
+
+void QPager::UpdateRunningNorm(real1 norm_thresh)
+{
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        qPages[i]->UpdateRunningNorm(norm_thresh);
+    }
+}
+
+void QPager::NormalizeState(real1 nrm, real1 norm_thresh)
+{
+    CombineAndOp([&](QInterfacePtr engine) {
+        engine->UpdateRunningNorm(norm_thresh);
+        engine->NormalizeState(nrm, norm_thresh);
+    });
+}
+
+bool QPager::TrySeparate(bitLenInt start, bitLenInt length)
+{
+    bool toRet;
+    CombineAndOp([&](QInterfacePtr engine) { toRet = engine->TrySeparate(start, length); });
+    return toRet;
+}
+
+QInterfacePtr QPager::Clone()
+{
+    std::vector<bitLenInt> devList(deviceIDs.begin(), deviceIDs.end());
+    QPagerPtr clone = std::make_shared<QPager>(engineType, qubitCount, 0, rand_generator, ONE_CMPLX, doNormalize,
+        randGlobalPhase, useHostRam, deviceID, useRDRAND, isSparse, amplitudeFloor, devList);
+    for (bitCapIntOcl i = 0; i < qPages.size(); i++) {
+        clone->qPages[i] = qPages[i]->Clone();
+    }
+    return clone;
+}
+
+} // namespace Qrack
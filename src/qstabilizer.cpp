@@ -0,0 +1,617 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2020. All rights reserved.
+//
+// QStabilizer is a CHP-style Clifford circuit simulator, after the algorithm of
+// Aaronson and Gottesman, "Improved simulation of stabilizer circuits,"
+// https://arxiv.org/abs/quant-ph/0406196
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include <algorithm>
+#include <ctime>
+#include <stdexcept>
+
+#include "qstabilizer.hpp"
+
+namespace Qrack {
+
+QStabilizer::QStabilizer(bitLenInt n, bitCapInt perm, qrack_rand_gen_ptr rgp)
+    : qubitCount(n)
+    , x((n << 1U) + 1U, std::vector<bool>(n))
+    , z((n << 1U) + 1U, std::vector<bool>(n))
+    , r((n << 1U) + 1U)
+    , rand_distribution(0.0, 1.0)
+{
+    if (rgp == NULL) {
+        rand_generator = std::make_shared<qrack_rand_gen>();
+        rand_generator->seed(std::time(0));
+    } else {
+        rand_generator = rgp;
+    }
+
+    SetPermutation(perm);
+}
+
+void QStabilizer::SetPermutation(bitCapInt perm)
+{
+    bitLenInt i;
+    bitLenInt rowCount = (qubitCount << 1U) + 1U;
+
+    std::fill(r.begin(), r.end(), 0);
+
+    for (i = 0; i < rowCount; i++) {
+        std::fill(x[i].begin(), x[i].end(), false);
+        std::fill(z[i].begin(), z[i].end(), false);
+    }
+
+    for (i = 0; i < qubitCount; i++) {
+        x[i][i] = true;
+        z[qubitCount + i][i] = true;
+        // A "1" bit of the permutation means the qubit is stabilized by -Z instead of +Z:
+        if ((perm >> i) & ONE_BCI) {
+            r[qubitCount + i] = 2;
+        }
+    }
+}
+
+/// Phase exponent of i contributed to a Pauli product by single-qubit components (x1, z1) times (x2, z2)
+int8_t QStabilizer::PhaseExp(const bool& x1, const bool& z1, const bool& x2, const bool& z2)
+{
+    if (x1 && z1) {
+        // Y
+        return (int8_t)z2 - (int8_t)x2;
+    }
+    if (x1) {
+        // X
+        return z2 * (2 * (int8_t)x2 - 1);
+    }
+    if (z1) {
+        // Z
+        return x2 * (1 - 2 * (int8_t)z2);
+    }
+    return 0;
+}
+
+void QStabilizer::RowCopy(const bitLenInt& i, const bitLenInt& k)
+{
+    x[i] = x[k];
+    z[i] = z[k];
+    r[i] = r[k];
+}
+
+void QStabilizer::RowSwap(const bitLenInt& i, const bitLenInt& k)
+{
+    std::swap(x[i], x[k]);
+    std::swap(z[i], z[k]);
+    std::swap(r[i], r[k]);
+}
+
+void QStabilizer::RowSet(const bitLenInt& i, const bitLenInt& b)
+{
+    std::fill(x[i].begin(), x[i].end(), false);
+    std::fill(z[i].begin(), z[i].end(), false);
+    r[i] = 0;
+
+    if (b < qubitCount) {
+        x[i][b] = true;
+    } else {
+        z[i][b - qubitCount] = true;
+    }
+}
+
+void QStabilizer::RowMult(const bitLenInt& i, const bitLenInt& k)
+{
+    int e = r[i] + r[k];
+    for (bitLenInt j = 0; j < qubitCount; j++) {
+        e += PhaseExp(x[k][j], z[k][j], x[i][j], z[i][j]);
+    }
+    r[i] = (uint8_t)(((e % 4) + 4) % 4);
+
+    for (bitLenInt j = 0; j < qubitCount; j++) {
+        x[i][j] = x[i][j] ^ x[k][j];
+        z[i][j] = z[i][j] ^ z[k][j];
+    }
+}
+
+void QStabilizer::CNOT(bitLenInt control, bitLenInt target)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        if (x[i][control] && z[i][target] && (x[i][target] == z[i][control])) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+        x[i][target] = x[i][target] ^ x[i][control];
+        z[i][control] = z[i][control] ^ z[i][target];
+    }
+}
+
+void QStabilizer::CZ(bitLenInt control, bitLenInt target)
+{
+    H(target);
+    CNOT(control, target);
+    H(target);
+}
+
+void QStabilizer::CY(bitLenInt control, bitLenInt target)
+{
+    IS(target);
+    CNOT(control, target);
+    S(target);
+}
+
+void QStabilizer::H(bitLenInt qubit)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        bool tmp = x[i][qubit];
+        x[i][qubit] = z[i][qubit];
+        z[i][qubit] = tmp;
+        if (x[i][qubit] && z[i][qubit]) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+    }
+}
+
+void QStabilizer::S(bitLenInt qubit)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        if (x[i][qubit] && z[i][qubit]) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+        z[i][qubit] = z[i][qubit] ^ x[i][qubit];
+    }
+}
+
+void QStabilizer::IS(bitLenInt qubit)
+{
+    Z(qubit);
+    S(qubit);
+}
+
+void QStabilizer::X(bitLenInt qubit)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        if (z[i][qubit]) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+    }
+}
+
+void QStabilizer::Y(bitLenInt qubit)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        if (x[i][qubit] != z[i][qubit]) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+    }
+}
+
+void QStabilizer::Z(bitLenInt qubit)
+{
+    bitLenInt rowCount = qubitCount << 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        if (x[i][qubit]) {
+            r[i] = (r[i] + 2) & 0x3;
+        }
+    }
+}
+
+void QStabilizer::Swap(bitLenInt qubit1, bitLenInt qubit2)
+{
+    if (qubit1 == qubit2) {
+        return;
+    }
+
+    // Swapping qubits is just a column swap, with no phase effect:
+    bitLenInt rowCount = (qubitCount << 1U) + 1U;
+    for (bitLenInt i = 0; i < rowCount; i++) {
+        bool tmp = x[i][qubit1];
+        x[i][qubit1] = x[i][qubit2];
+        x[i][qubit2] = tmp;
+        tmp = z[i][qubit1];
+        z[i][qubit1] = z[i][qubit2];
+        z[i][qubit2] = tmp;
+    }
+}
+
+void QStabilizer::ISwap(bitLenInt qubit1, bitLenInt qubit2)
+{
+    // ISWAP = CZ * (S x S) * SWAP
+    Swap(qubit1, qubit2);
+    S(qubit1);
+    S(qubit2);
+    CZ(qubit1, qubit2);
+}
+
+bool QStabilizer::IsSeparableZ(const bitLenInt& target)
+{
+    // The target qubit's Z measurement is deterministic, (hence the qubit is a separable Z eigenstate,) exactly when
+    // no stabilizer generator has an X component on it.
+    for (bitLenInt p = 0; p < qubitCount; p++) {
+        if (x[p + qubitCount][target]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool QStabilizer::IsSeparableX(const bitLenInt& target)
+{
+    H(target);
+    bool isSeparable = IsSeparableZ(target);
+    H(target);
+    return isSeparable;
+}
+
+bool QStabilizer::IsSeparableY(const bitLenInt& target)
+{
+    // (H * S^-1) maps the Y basis to the Z basis:
+    IS(target);
+    H(target);
+    bool isSeparable = IsSeparableZ(target);
+    H(target);
+    S(target);
+    return isSeparable;
+}
+
+uint8_t QStabilizer::IsSeparable(const bitLenInt& target)
+{
+    if (IsSeparableZ(target)) {
+        return 1;
+    }
+    if (IsSeparableX(target)) {
+        return 2;
+    }
+    if (IsSeparableY(target)) {
+        return 3;
+    }
+    return 0;
+}
+
+bool QStabilizer::ForceM(const bitLenInt& target, bool result, bool doForce)
+{
+    bitLenInt elemCount = qubitCount << 1U;
+    bitLenInt i, p;
+
+    // Is the outcome random, i.e. does some stabilizer generator anticommute with the measurement?
+    for (p = qubitCount; p < elemCount; p++) {
+        if (x[p][target]) {
+            break;
+        }
+    }
+
+    if (p < elemCount) {
+        bool outcome = doForce ? result : (Rand() <= (ONE_R1 / 2));
+
+        // Multiply the anticommuting generator into every other anticommuting row, to leave a single witness:
+        for (i = 0; i < elemCount; i++) {
+            if ((i != p) && x[i][target]) {
+                RowMult(i, p);
+            }
+        }
+
+        // The old generator becomes the measurement's destabilizer, and the new generator is (+/-) Z on the target:
+        RowCopy(p - qubitCount, p);
+        RowSet(p, target + qubitCount);
+        r[p] = outcome ? 2 : 0;
+
+        return outcome;
+    }
+
+    // The outcome is deterministic: accumulate the product of stabilizer generators indexed by the destabilizers
+    // that anticommute with the measurement, which is (+/-) Z on the target, into the scratch row.
+    bitLenInt scratch = elemCount;
+    RowSet(scratch, target + qubitCount);
+    r[scratch] = 0;
+    x[scratch][target] = false;
+    z[scratch][target] = false;
+
+    for (i = 0; i < qubitCount; i++) {
+        if (x[i][target]) {
+            RowMult(scratch, i + qubitCount);
+        }
+    }
+
+    bool outcome = (r[scratch] == 2);
+
+    if (doForce && (result != outcome)) {
+        throw std::invalid_argument("ForceM() forced a measurement result with 0 probability");
+    }
+
+    return outcome;
+}
+
+real1 QStabilizer::Prob(const bitLenInt& qubit)
+{
+    if (!IsSeparableZ(qubit)) {
+        return ONE_R1 / 2;
+    }
+    return ForceM(qubit, false, false) ? ONE_R1 : ZERO_R1;
+}
+
+bitLenInt QStabilizer::Compose(QStabilizerPtr toCopy)
+{
+    // The tableau of an unentangled tensor product is block diagonal in the two subsystems' generators:
+    bitLenInt n1 = qubitCount;
+    bitLenInt n2 = toCopy->qubitCount;
+    bitLenInt nTot = n1 + n2;
+    bitLenInt i, j;
+
+    std::vector<std::vector<bool>> nX((nTot << 1U) + 1U, std::vector<bool>(nTot));
+    std::vector<std::vector<bool>> nZ((nTot << 1U) + 1U, std::vector<bool>(nTot));
+    std::vector<uint8_t> nR((nTot << 1U) + 1U);
+
+    for (i = 0; i < n1; i++) {
+        for (j = 0; j < n1; j++) {
+            // Destabilizers, then stabilizers:
+            nX[i][j] = x[i][j];
+            nZ[i][j] = z[i][j];
+            nX[nTot + i][j] = x[n1 + i][j];
+            nZ[nTot + i][j] = z[n1 + i][j];
+        }
+        nR[i] = r[i];
+        nR[nTot + i] = r[n1 + i];
+    }
+
+    for (i = 0; i < n2; i++) {
+        for (j = 0; j < n2; j++) {
+            nX[n1 + i][n1 + j] = toCopy->x[i][j];
+            nZ[n1 + i][n1 + j] = toCopy->z[i][j];
+            nX[nTot + n1 + i][n1 + j] = toCopy->x[n2 + i][j];
+            nZ[nTot + n1 + i][n1 + j] = toCopy->z[n2 + i][j];
+        }
+        nR[n1 + i] = toCopy->r[i];
+        nR[nTot + n1 + i] = toCopy->r[n2 + i];
+    }
+
+    x = nX;
+    z = nZ;
+    r = nR;
+    qubitCount = nTot;
+
+    return n1;
+}
+
+bool QStabilizer::CanDecomposeDispose(const bitLenInt& start, const bitLenInt& length)
+{
+    for (bitLenInt i = 0; i < length; i++) {
+        if (IsSeparable(start + i) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void QStabilizer::DecomposeDispose(const bitLenInt& start, const bitLenInt& length, QStabilizerPtr dest)
+{
+    // ("dest," if not NULL, is assumed to be a fresh |0...0> register of "length" qubits, per the QInterface
+    // Decompose() contract.)
+    for (bitLenInt i = length; i > 0; i--) {
+        bitLenInt q = start + (i - 1U);
+
+        uint8_t basis = IsSeparable(q);
+
+        // Rotate the qubit's eigenbasis onto Z:
+        if (basis == 2) {
+            H(q);
+        } else if (basis == 3) {
+            IS(q);
+            H(q);
+        }
+
+        bool value = M(q);
+        DisposeDeterministicZ(q);
+
+        if (dest) {
+            bitLenInt dq = i - 1U;
+            if (value) {
+                dest->X(dq);
+            }
+            // Rotate the copied eigenstate back out of the Z basis:
+            if (basis == 2) {
+                dest->H(dq);
+            } else if (basis == 3) {
+                dest->H(dq);
+                dest->S(dq);
+            }
+        }
+    }
+}
+
+void QStabilizer::DisposeDeterministicZ(const bitLenInt& target)
+{
+    bitLenInt elemCount = qubitCount << 1U;
+    bitLenInt i;
+
+    // The destabilizer rows that anticommute with Z on the target index a product of stabilizer generators equal to
+    // (+/-) Z on the target. Accumulate that product into the first such row, so it becomes an explicit generator,
+    // (fixing the symplectic destabilizer pairing as we go):
+    std::vector<bitLenInt> indices;
+    for (i = 0; i < qubitCount; i++) {
+        if (x[i][target]) {
+            indices.push_back(i);
+        }
+    }
+
+    bitLenInt p = indices[0];
+    for (i = 1; i < indices.size(); i++) {
+        RowMult(p + qubitCount, indices[i] + qubitCount);
+        RowMult(indices[i], p);
+    }
+
+    // Now, only rows p and (p + qubitCount) touch the target column with X or Z; multiply the Z generator into any
+    // remaining row with a Z component on the target:
+    for (i = 0; i < elemCount; i++) {
+        if ((i != p) && (i != (p + qubitCount)) && z[i][target]) {
+            RowMult(i, p + qubitCount);
+        }
+    }
+
+    // Delete the target's column from every row, and the generator pair that acted on it:
+    bitLenInt rowCount = elemCount + 1U;
+    for (i = 0; i < rowCount; i++) {
+        x[i].erase(x[i].begin() + target);
+        z[i].erase(z[i].begin() + target);
+    }
+
+    x.erase(x.begin() + (p + qubitCount));
+    z.erase(z.begin() + (p + qubitCount));
+    r.erase(r.begin() + (p + qubitCount));
+    x.erase(x.begin() + p);
+    z.erase(z.begin() + p);
+    r.erase(r.begin() + p);
+
+    qubitCount--;
+}
+
+bitLenInt QStabilizer::Gaussian()
+{
+    bitLenInt elemCount = qubitCount << 1U;
+    bitLenInt i = qubitCount;
+    bitLenInt j, k, k2;
+
+    for (j = 0; j < qubitCount; j++) {
+        for (k = i; k < elemCount; k++) {
+            if (x[k][j]) {
+                break;
+            }
+        }
+        if (k < elemCount) {
+            RowSwap(i, k);
+            RowSwap(i - qubitCount, k - qubitCount);
+            for (k2 = i + 1U; k2 < elemCount; k2++) {
+                if (x[k2][j]) {
+                    RowMult(k2, i);
+                    RowMult(i - qubitCount, k2 - qubitCount);
+                }
+            }
+            i++;
+        }
+    }
+
+    bitLenInt g = i - qubitCount;
+
+    for (j = 0; j < qubitCount; j++) {
+        for (k = i; k < elemCount; k++) {
+            if (z[k][j]) {
+                break;
+            }
+        }
+        if (k < elemCount) {
+            RowSwap(i, k);
+            RowSwap(i - qubitCount, k - qubitCount);
+            for (k2 = i + 1U; k2 < elemCount; k2++) {
+                if (z[k2][j]) {
+                    RowMult(k2, i);
+                    RowMult(i - qubitCount, k2 - qubitCount);
+                }
+            }
+            i++;
+        }
+    }
+
+    return g;
+}
+
+void QStabilizer::Seed(const bitLenInt& g)
+{
+    bitLenInt elemCount = qubitCount << 1U;
+    bitLenInt scratch = elemCount;
+    bitLenInt min = 0;
+    int e;
+    bitLenInt i, j;
+
+    std::fill(x[scratch].begin(), x[scratch].end(), false);
+    std::fill(z[scratch].begin(), z[scratch].end(), false);
+    r[scratch] = 0;
+
+    for (i = elemCount; i > (qubitCount + g); i--) {
+        bitLenInt row = i - 1U;
+        e = r[row];
+        for (j = qubitCount; j > 0; j--) {
+            if (z[row][j - 1U]) {
+                min = j - 1U;
+                if (x[scratch][min]) {
+                    e = (e + 2) & 0x3;
+                }
+            }
+        }
+        if (e == 2) {
+            x[scratch][min] = true;
+        }
+    }
+}
+
+void QStabilizer::SetBasisState(const real1& nrm, complex* outputState)
+{
+    bitLenInt scratch = qubitCount << 1U;
+    bitLenInt j;
+
+    uint8_t e = r[scratch];
+    for (j = 0; j < qubitCount; j++) {
+        // Pauli phase "i," for Y:
+        if (x[scratch][j] && z[scratch][j]) {
+            e = (e + 1) & 0x3;
+        }
+    }
+
+    complex amp;
+    switch (e) {
+    case 0:
+        amp = complex(nrm, ZERO_R1);
+        break;
+    case 1:
+        amp = complex(ZERO_R1, nrm);
+        break;
+    case 2:
+        amp = complex(-nrm, ZERO_R1);
+        break;
+    case 3:
+    default:
+        amp = complex(ZERO_R1, -nrm);
+        break;
+    }
+
+    bitCapIntOcl perm = 0;
+    for (j = 0; j < qubitCount; j++) {
+        if (x[scratch][j]) {
+            perm |= (bitCapIntOcl)ONE_BCI << j;
+        }
+    }
+
+    outputState[perm] = amp;
+}
+
+void QStabilizer::GetQuantumState(complex* outputState)
+{
+    bitCapIntOcl t, t2;
+    bitLenInt i;
+
+    bitCapIntOcl maxQPower = (bitCapIntOcl)ONE_BCI << qubitCount;
+    std::fill(outputState, outputState + maxQPower, complex(ZERO_R1, ZERO_R1));
+
+    bitLenInt g = Gaussian();
+    bitCapIntOcl permCount = (bitCapIntOcl)ONE_BCI << g;
+    real1 nrm = sqrt(ONE_R1 / permCount);
+
+    Seed(g);
+    SetBasisState(nrm, outputState);
+
+    for (t = 0; t < (permCount - 1U); t++) {
+        t2 = t ^ (t + 1U);
+        for (i = 0; i < g; i++) {
+            if (t2 & ((bitCapIntOcl)ONE_BCI << i)) {
+                RowMult(qubitCount << 1U, qubitCount + i);
+            }
+        }
+        SetBasisState(nrm, outputState);
+    }
+}
+
+} // namespace Qrack
@@ -0,0 +1,462 @@
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// (C) Daniel Strano and the Qrack contributors 2017-2020. All rights reserved.
+//
+// QStabilizerHybrid fronts a Qrack::QStabilizer Clifford tableau simulator with the
+// QInterface API. While every operation applied is a Clifford gate, (or a measurement,)
+// the state is tracked in O(n^2) memory; the first non-Clifford operation converts the
+// tableau to a ket and transparently switches to a state vector engine.
+//
+// Licensed under the GNU Lesser General Public License V3.
+// See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
+// for details.
+
+#include "qfactory.hpp"
+#include "qstabilizerhybrid.hpp"
+
+namespace Qrack {
+
+QStabilizerHybrid::QStabilizerHybrid(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState,
+    qrack_rand_gen_ptr rgp, complex phaseFac, bool doNorm, bool randomGlobalPhase, bool useHostMem, int deviceID,
+    bool useHardwareRNG, bool useSparseStateVec, real1 norm_thresh)
+    : QInterface(qBitCount, rgp, doNorm, useHardwareRNG, randomGlobalPhase, norm_thresh)
+    , engineType(eng)
+    , engine(NULL)
+    , devID(deviceID)
+    , phaseFactor(phaseFac)
+    , useHostRam(useHostMem)
+    , useRDRAND(useHardwareRNG)
+    , isSparse(useSparseStateVec)
+{
+    stabilizer = std::make_shared<QStabilizer>(qubitCount, initState, rand_generator);
+}
+
+void QStabilizerHybrid::SwitchToEngine()
+{
+    if (engine) {
+        return;
+    }
+
+    complex* stateVec = new complex[(bitCapIntOcl)maxQPower];
+    stabilizer->GetQuantumState(stateVec);
+
+    engine = CreateQuantumInterface(engineType, qubitCount, 0, rand_generator, phaseFactor, doNormalize,
+        randGlobalPhase, useHostRam, devID, useRDRAND, isSparse, amplitudeFloor);
+    engine->SetQuantumState(stateVec);
+
+    delete[] stateVec;
+    stabilizer = NULL;
+}
+
+bool QStabilizerHybrid::IsHGate(const complex* mtrx)
+{
+    return (norm(mtrx[0] - mtrx[1]) <= REAL1_EPSILON) && (norm(mtrx[0] - mtrx[2]) <= REAL1_EPSILON) &&
+        (norm(mtrx[0] + mtrx[3]) <= REAL1_EPSILON) && (abs(norm(mtrx[0]) - (ONE_R1 / 2)) <= REAL1_EPSILON);
+}
+
+void QStabilizerHybrid::SetQuantumState(const complex* inputState)
+{
+    SwitchToEngine();
+    engine->SetQuantumState(inputState);
+}
+
+void QStabilizerHybrid::GetQuantumState(complex* outputState)
+{
+    if (stabilizer) {
+        stabilizer->GetQuantumState(outputState);
+    } else {
+        engine->GetQuantumState(outputState);
+    }
+}
+
+void QStabilizerHybrid::GetProbs(real1* outputProbs)
+{
+    if (stabilizer) {
+        bitCapIntOcl maxQPowerOcl = (bitCapIntOcl)maxQPower;
+        complex* stateVec = new complex[maxQPowerOcl];
+        stabilizer->GetQuantumState(stateVec);
+        for (bitCapIntOcl i = 0; i < maxQPowerOcl; i++) {
+            outputProbs[i] = norm(stateVec[i]);
+        }
+        delete[] stateVec;
+    } else {
+        engine->GetProbs(outputProbs);
+    }
+}
+
+complex QStabilizerHybrid::GetAmplitude(bitCapInt perm)
+{
+    SwitchToEngine();
+    return engine->GetAmplitude(perm);
+}
+
+void QStabilizerHybrid::SetAmplitude(bitCapInt perm, complex amp)
+{
+    SwitchToEngine();
+    engine->SetAmplitude(perm, amp);
+}
+
+void QStabilizerHybrid::SetPermutation(bitCapInt perm, complex phaseFac)
+{
+    engine = NULL;
+    stabilizer = std::make_shared<QStabilizer>(qubitCount, perm, rand_generator);
+}
+
+bitLenInt QStabilizerHybrid::Compose(QStabilizerHybridPtr toCopy)
+{
+    bitLenInt toRet;
+
+    if (stabilizer && toCopy->stabilizer) {
+        toRet = stabilizer->Compose(toCopy->stabilizer);
+    } else {
+        SwitchToEngine();
+        toCopy->SwitchToEngine();
+        toRet = engine->Compose(toCopy->engine);
+    }
+
+    SetQubitCount(qubitCount + toCopy->qubitCount);
+
+    return toRet;
+}
+
+bitLenInt QStabilizerHybrid::Compose(QStabilizerHybridPtr toCopy, bitLenInt start)
+{
+    bitLenInt oldCount = qubitCount;
+    bitLenInt length = toCopy->qubitCount;
+
+    if (start == qubitCount) {
+        return Compose(toCopy);
+    }
+
+    if (stabilizer && toCopy->stabilizer) {
+        // Compose at the end, then bubble the appended qubits into place:
+        stabilizer->Compose(toCopy->stabilizer);
+        for (bitLenInt i = 0; i < length; i++) {
+            for (bitLenInt j = oldCount + i; j > (start + i); j--) {
+                stabilizer->Swap(j, j - 1U);
+            }
+        }
+        SetQubitCount(qubitCount + length);
+        return start;
+    }
+
+    SwitchToEngine();
+    toCopy->SwitchToEngine();
+    bitLenInt toRet = engine->Compose(toCopy->engine, start);
+    SetQubitCount(qubitCount + length);
+
+    return toRet;
+}
+
+void QStabilizerHybrid::Decompose(bitLenInt start, bitLenInt length, QInterfacePtr dest)
+{
+    QStabilizerHybridPtr destHybrid = std::dynamic_pointer_cast<QStabilizerHybrid>(dest);
+
+    if (stabilizer && destHybrid->stabilizer && stabilizer->CanDecomposeDispose(start, length)) {
+        destHybrid->stabilizer->SetPermutation(0);
+        stabilizer->DecomposeDispose(start, length, destHybrid->stabilizer);
+    } else {
+        SwitchToEngine();
+        destHybrid->SwitchToEngine();
+        engine->Decompose(start, length, destHybrid->engine);
+    }
+
+    SetQubitCount(qubitCount - length);
+}
+
+void QStabilizerHybrid::Dispose(bitLenInt start, bitLenInt length)
+{
+    if (stabilizer && stabilizer->CanDecomposeDispose(start, length)) {
+        stabilizer->DecomposeDispose(start, length, NULL);
+    } else {
+        SwitchToEngine();
+        engine->Dispose(start, length);
+    }
+
+    SetQubitCount(qubitCount - length);
+}
+
+void QStabilizerHybrid::Dispose(bitLenInt start, bitLenInt length, bitCapInt disposedPerm)
+{
+    if (stabilizer && stabilizer->CanDecomposeDispose(start, length)) {
+        stabilizer->DecomposeDispose(start, length, NULL);
+    } else {
+        SwitchToEngine();
+        engine->Dispose(start, length, disposedPerm);
+    }
+
+    SetQubitCount(qubitCount - length);
+}
+
+void QStabilizerHybrid::ApplySingleBit(const complex* mtrx, bitLenInt qubitIndex)
+{
+    if (engine) {
+        engine->ApplySingleBit(mtrx, qubitIndex);
+        return;
+    }
+
+    if ((norm(mtrx[1]) <= REAL1_EPSILON) && (norm(mtrx[2]) <= REAL1_EPSILON)) {
+        ApplySinglePhase(mtrx[0], mtrx[3], qubitIndex);
+        return;
+    }
+
+    if ((norm(mtrx[0]) <= REAL1_EPSILON) && (norm(mtrx[3]) <= REAL1_EPSILON)) {
+        ApplySingleInvert(mtrx[1], mtrx[2], qubitIndex);
+        return;
+    }
+
+    if (IsHGate(mtrx)) {
+        stabilizer->H(qubitIndex);
+        return;
+    }
+
+    SwitchToEngine();
+    engine->ApplySingleBit(mtrx, qubitIndex);
+}
+
+void QStabilizerHybrid::ApplySinglePhase(const complex topLeft, const complex bottomRight, bitLenInt qubitIndex)
+{
+    if (engine) {
+        engine->ApplySinglePhase(topLeft, bottomRight, qubitIndex);
+        return;
+    }
+
+    // In stabilizer mode, the state is tracked up to global phase, so only the relative phase matters:
+    complex ratio = bottomRight / topLeft;
+
+    if (norm(ratio - ONE_CMPLX) <= REAL1_EPSILON) {
+        return;
+    }
+    if (norm(ratio + ONE_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->Z(qubitIndex);
+        return;
+    }
+    if (norm(ratio - I_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->S(qubitIndex);
+        return;
+    }
+    if (norm(ratio + I_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->IS(qubitIndex);
+        return;
+    }
+
+    SwitchToEngine();
+    engine->ApplySinglePhase(topLeft, bottomRight, qubitIndex);
+}
+
+void QStabilizerHybrid::ApplySingleInvert(const complex topRight, const complex bottomLeft, bitLenInt qubitIndex)
+{
+    if (engine) {
+        engine->ApplySingleInvert(topRight, bottomLeft, qubitIndex);
+        return;
+    }
+
+    // An anti-diagonal gate is X followed by the phase gate diag(topRight, bottomLeft), (which falls back for us, if
+    // that residual phase is not Clifford):
+    stabilizer->X(qubitIndex);
+    ApplySinglePhase(topRight, bottomLeft, qubitIndex);
+}
+
+void QStabilizerHybrid::ApplyControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    if (!engine && (controlLen == 1U)) {
+        if ((norm(mtrx[1]) <= REAL1_EPSILON) && (norm(mtrx[2]) <= REAL1_EPSILON)) {
+            ApplyControlledSinglePhase(controls, controlLen, target, mtrx[0], mtrx[3]);
+            return;
+        }
+
+        if ((norm(mtrx[0]) <= REAL1_EPSILON) && (norm(mtrx[3]) <= REAL1_EPSILON)) {
+            ApplyControlledSingleInvert(controls, controlLen, target, mtrx[1], mtrx[2]);
+            return;
+        }
+    }
+
+    SwitchToEngine();
+    engine->ApplyControlledSingleBit(controls, controlLen, target, mtrx);
+}
+
+void QStabilizerHybrid::ApplyControlledSinglePhase(const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex topLeft, const complex bottomRight)
+{
+    if (engine || (controlLen != 1U)) {
+        SwitchToEngine();
+        engine->ApplyControlledSinglePhase(controls, controlLen, target, topLeft, bottomRight);
+        return;
+    }
+
+    // The controlled phase gate diag(1, 1, topLeft, bottomRight) is the phase gate diag(1, topLeft) on the control,
+    // followed by CZ, if the ratio of the target phases is -1, (or by nothing, if it is 1).
+    complex ratio = bottomRight / topLeft;
+    bool isCZ;
+
+    if (norm(ratio - ONE_CMPLX) <= REAL1_EPSILON) {
+        isCZ = false;
+    } else if (norm(ratio + ONE_CMPLX) <= REAL1_EPSILON) {
+        isCZ = true;
+    } else {
+        SwitchToEngine();
+        engine->ApplyControlledSinglePhase(controls, controlLen, target, topLeft, bottomRight);
+        return;
+    }
+
+    if (norm(topLeft - ONE_CMPLX) <= REAL1_EPSILON) {
+        // Identity phase on the control
+    } else if (norm(topLeft + ONE_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->Z(controls[0]);
+    } else if (norm(topLeft - I_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->S(controls[0]);
+    } else if (norm(topLeft + I_CMPLX) <= REAL1_EPSILON) {
+        stabilizer->IS(controls[0]);
+    } else {
+        SwitchToEngine();
+        engine->ApplyControlledSinglePhase(controls, controlLen, target, topLeft, bottomRight);
+        return;
+    }
+
+    if (isCZ) {
+        stabilizer->CZ(controls[0], target);
+    }
+}
+
+void QStabilizerHybrid::ApplyControlledSingleInvert(const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex topRight, const complex bottomLeft)
+{
+    if (engine || (controlLen != 1U)) {
+        SwitchToEngine();
+        engine->ApplyControlledSingleInvert(controls, controlLen, target, topRight, bottomLeft);
+        return;
+    }
+
+    // A controlled anti-diagonal gate is CNOT followed by the controlled phase gate diag(1, 1, topRight, bottomLeft),
+    // (which falls back for us, if that residual phase is not Clifford):
+    stabilizer->CNOT(controls[0], target);
+    ApplyControlledSinglePhase(controls, controlLen, target, topRight, bottomLeft);
+}
+
+void QStabilizerHybrid::ApplyAntiControlledSingleBit(
+    const bitLenInt* controls, const bitLenInt& controlLen, const bitLenInt& target, const complex* mtrx)
+{
+    if (!engine && (controlLen == 1U)) {
+        if ((norm(mtrx[1]) <= REAL1_EPSILON) && (norm(mtrx[2]) <= REAL1_EPSILON)) {
+            ApplyAntiControlledSinglePhase(controls, controlLen, target, mtrx[0], mtrx[3]);
+            return;
+        }
+
+        if ((norm(mtrx[0]) <= REAL1_EPSILON) && (norm(mtrx[3]) <= REAL1_EPSILON)) {
+            ApplyAntiControlledSingleInvert(controls, controlLen, target, mtrx[1], mtrx[2]);
+            return;
+        }
+    }
+
+    SwitchToEngine();
+    engine->ApplyAntiControlledSingleBit(controls, controlLen, target, mtrx);
+}
+
+void QStabilizerHybrid::ApplyAntiControlledSinglePhase(const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex topLeft, const complex bottomRight)
+{
+    if (engine || (controlLen != 1U)) {
+        SwitchToEngine();
+        engine->ApplyAntiControlledSinglePhase(controls, controlLen, target, topLeft, bottomRight);
+        return;
+    }
+
+    // Conjugate the control by X, to invert its sense. (The controlled gate might itself force a switch to the state
+    // vector engine, so the closing X goes to whichever representation is current.)
+    stabilizer->X(controls[0]);
+    ApplyControlledSinglePhase(controls, controlLen, target, topLeft, bottomRight);
+    if (stabilizer) {
+        stabilizer->X(controls[0]);
+    } else {
+        engine->X(controls[0]);
+    }
+}
+
+void QStabilizerHybrid::ApplyAntiControlledSingleInvert(const bitLenInt* controls, const bitLenInt& controlLen,
+    const bitLenInt& target, const complex topRight, const complex bottomLeft)
+{
+    if (engine || (controlLen != 1U)) {
+        SwitchToEngine();
+        engine->ApplyAntiControlledSingleInvert(controls, controlLen, target, topRight, bottomLeft);
+        return;
+    }
+
+    stabilizer->X(controls[0]);
+    ApplyControlledSingleInvert(controls, controlLen, target, topRight, bottomLeft);
+    if (stabilizer) {
+        stabilizer->X(controls[0]);
+    } else {
+        engine->X(controls[0]);
+    }
+}
+
+void QStabilizerHybrid::Swap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (stabilizer) {
+        stabilizer->Swap(qubitIndex1, qubitIndex2);
+    } else {
+        engine->Swap(qubitIndex1, qubitIndex2);
+    }
+}
+
+void QStabilizerHybrid::ISwap(bitLenInt qubitIndex1, bitLenInt qubitIndex2)
+{
+    if (stabilizer) {
+        stabilizer->ISwap(qubitIndex1, qubitIndex2);
+    } else {
+        engine->ISwap(qubitIndex1, qubitIndex2);
+    }
+}
+
+bool QStabilizerHybrid::ForceM(bitLenInt qubit, bool result, bool doForce, bool doApply)
+{
+    if (engine) {
+        return engine->ForceM(qubit, result, doForce, doApply);
+    }
+
+    if (!doApply && !stabilizer->IsSeparableZ(qubit)) {
+        // A random outcome can't be sampled from the tableau without collapsing it:
+        SwitchToEngine();
+        return engine->ForceM(qubit, result, doForce, doApply);
+    }
+
+    return stabilizer->ForceM(qubit, result, doForce);
+}
+
+real1 QStabilizerHybrid::Prob(bitLenInt qubitIndex)
+{
+    if (stabilizer) {
+        return stabilizer->Prob(qubitIndex);
+    }
+    return engine->Prob(qubitIndex);
+}
+
+real1 QStabilizerHybrid::ProbAll(bitCapInt fullRegister)
+{
+    SwitchToEngine();
+    return engine->ProbAll(fullRegister);
+}
+
+bool QStabilizerHybrid::ApproxCompare(QStabilizerHybridPtr toCompare)
+{
+    SwitchToEngine();
+    toCompare->SwitchToEngine();
+    return engine->ApproxCompare(toCompare->engine);
+}
+
+QInterfacePtr QStabilizerHybrid::Clone()
+{
+    QStabilizerHybridPtr clone = std::make_shared<QStabilizerHybrid>(engineType, qubitCount, 0, rand_generator,
+        phaseFactor, doNormalize, randGlobalPhase, useHostRam, devID, useRDRAND, isSparse, amplitudeFloor);
+
+    if (stabilizer) {
+        clone->stabilizer = stabilizer->Clone();
+    } else {
+        clone->stabilizer = NULL;
+        clone->engine = engine->Clone();
+    }
+
+    return clone;
+}
+} // namespace Qrack
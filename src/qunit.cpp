@@ -22,6 +22,7 @@
 // for details.
 
 #include <ctime>
+#include <future>
 #include <initializer_list>
 #include <map>
 
@@ -48,6 +49,10 @@
     (!shard.isProbDirty && !shard.isPlusMinus && (IS_NORM_ZERO(shard.amp0) || IS_NORM_ZERO(shard.amp1)))
 #define UNSAFE_CACHED_ONE(shard) (!shard.isProbDirty && !shard.isPlusMinus && IS_NORM_ZERO(shard.amp0))
 #define UNSAFE_CACHED_ZERO(shard) (!shard.isProbDirty && !shard.isPlusMinus && IS_NORM_ZERO(shard.amp1))
+/* Maximum probability reductions paid by the background separation pass, per Finish(): */
+#define FINISH_SEPARATION_BUDGET 4U
+/* Maximum controls fused into one uniformly controlled flush pass, (2^n "mtrxs" entries): */
+#define BULK_PHASE_MAX_CTRLS 8U
 
 namespace Qrack {
 
@@ -63,7 +68,12 @@ QUnit::QUnit(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qra
     , useRDRAND(useHardwareRNG)
     , isSparse(useSparseStateVec)
     , freezeBasis(false)
+    , separabilityThreshold(ZERO_R1)
 {
+    if (getenv("QRACK_QUNIT_SEPARABILITY_THRESHOLD")) {
+        separabilityThreshold = (real1)std::stof(std::string(getenv("QRACK_QUNIT_SEPARABILITY_THRESHOLD")));
+    }
+
     shards.resize(qBitCount);
 
     bool bitState;
@@ -76,8 +86,13 @@ QUnit::QUnit(QInterfaceEngine eng, bitLenInt qBitCount, bitCapInt initState, qra
 
 QInterfacePtr QUnit::MakeEngine(bitLenInt length, bitCapInt perm)
 {
+    // With an auto subengine, shards re-resolve the state vector flavor at their current width, since sparse
+    // bookkeeping only pays off above the calibrated crossover:
+    bool nSparse =
+        (engine == QINTERFACE_AUTO) ? EngineCalibration::Instance().SelectSparse(length, isSparse) : isSparse;
+
     return CreateQuantumInterface(engine, length, perm, rand_generator, phaseFactor, doNormalize, randGlobalPhase,
-        useHostRam, devID, useRDRAND, isSparse);
+        useHostRam, devID, useRDRAND, nSparse);
 }
 
 void QUnit::SetPermutation(bitCapInt perm, complex phaseFac)
@@ -134,6 +149,26 @@ void QUnit::GetProbs(real1* outputProbs)
     clone->shards[0].unit->GetProbs(outputProbs);
 }
 
+void QUnit::GetQuantumStateChunked(StateChunkCallback callback, bitCapInt chunkElems)
+{
+    ToPermBasisAll();
+    EndAllEmulation();
+
+    QUnitPtr clone = std::dynamic_pointer_cast<QUnit>(Clone());
+    clone->OrderContiguous(clone->EntangleAll());
+    clone->shards[0].unit->GetQuantumStateChunked(callback, chunkElems);
+}
+
+void QUnit::GetProbsChunked(ProbChunkCallback callback, bitCapInt chunkElems)
+{
+    ToPermBasisAll();
+    EndAllEmulation();
+
+    QUnitPtr clone = std::dynamic_pointer_cast<QUnit>(Clone());
+    clone->OrderContiguous(clone->EntangleAll());
+    clone->shards[0].unit->GetProbsChunked(callback, chunkElems);
+}
+
 complex QUnit::GetAmplitude(bitCapInt perm)
 {
     ToPermBasisAll();
@@ -438,24 +473,142 @@ bool QUnit::TrySeparate(bitLenInt start, bitLenInt length)
 {
     bool didSeparate = false;
     for (bitLenInt i = 0; i < length; i++) {
-        if (shards[start + i].unit->GetQubitCount() == 1) {
+        QEngineShard& shard = shards[start + i];
+        if (shard.unit->GetQubitCount() == 1) {
             return true;
         }
 
+        // If nothing has touched this shard since the last failed check, success is no more plausible now, so the
+        // probability reduction isn't worth paying again.
+        if (shard.isSepChecked) {
+            continue;
+        }
+
         // This is usually all that's worth trying:
-        QEngineShard& shard = shards[start + i];
         real1 prob;
         if (shard.isPlusMinus || QUEUED_PHASE(shard)) {
-            prob = ProbBase(start);
+            prob = ProbBase(start + i);
         } else {
-            prob = Prob(start);
+            prob = Prob(start + i);
+        }
+        shard.isSepChecked = true;
+        if (IS_ZERO_R1(prob) || IS_ONE_R1(prob)) {
+            didSeparate = true;
+            continue;
+        }
+
+        // The qubit isn't exactly separable on the Z axis, but a configured error budget pays for a full Schmidt
+        // decomposition pass, which can still cut a *weakly* entangled qubit loose:
+        if ((separabilityThreshold > ZERO_R1) && (shard.unit->GetQubitCount() > 1U)) {
+            didSeparate |= TrySchmidtSeparate(start + i);
         }
-        didSeparate |= (IS_ZERO_R1(prob) || IS_ONE_R1(prob));
     }
 
     return didSeparate;
 }
 
+bool QUnit::TrySchmidtSeparate(bitLenInt qubit)
+{
+    QEngineShard& shard = shards[qubit];
+    QInterfacePtr unit = shard.unit;
+    bitLenInt mapped = shard.mapped;
+
+    // Bloch vector components, from the qubit's |1> probability in the Z, X, and Y bases, in turn:
+    real1 z = ONE_R1 - 2 * unit->Prob(mapped);
+    unit->H(mapped);
+    real1 x = ONE_R1 - 2 * unit->Prob(mapped);
+    unit->H(mapped);
+    unit->IS(mapped);
+    unit->H(mapped);
+    real1 y = ONE_R1 - 2 * unit->Prob(mapped);
+    unit->H(mapped);
+    unit->S(mapped);
+
+    // The squared Schmidt coefficients of the qubit against the rest of its unit are the eigenvalues of its reduced
+    // density matrix, (1 +/- r) / 2 for Bloch vector length "r". The secondary coefficient is the fidelity cost of
+    // forcing the qubit into its dominant Schmidt vector, so it's what the configured error budget is spent on.
+    real1 xyNorm = sqrt(x * x + y * y);
+    real1 r = sqrt(xyNorm * xyNorm + z * z);
+    if (r > ONE_R1) {
+        r = ONE_R1;
+    }
+    real1 secondary = (ONE_R1 - r) / 2;
+    if (secondary > separabilityThreshold) {
+        return false;
+    }
+
+    // The dominant Schmidt vector is the Bloch vector direction, as a pure state:
+    real1 theta = atan2(xyNorm, z);
+    real1 phi = atan2(y, x);
+    complex amp0 = complex((real1)cos(theta / 2), ZERO_R1);
+    complex amp1 = complex((real1)cos(phi), (real1)sin(phi)) * (real1)sin(theta / 2);
+
+    // Rows are the Schmidt basis bras, ("amp0" is real,) so the dominant vector maps onto |0>:
+    complex mtrx[4] = { amp0, std::conj(amp1), -amp1, amp0 };
+    unit->ApplySingleBit(mtrx, mapped);
+
+    // The residual |1> branch carries at most "separabilityThreshold" probability. Discarding it perturbs every
+    // partner amplitude within the accepted error, so the partners are all dirty:
+    for (bitLenInt i = 0; i < qubitCount; i++) {
+        if ((shards[i].unit == unit) && (i != qubit)) {
+            shards[i].MakeDirty();
+        }
+    }
+
+    SeparateBit(false, qubit);
+
+    if (secondary > amplitudeFloor) {
+        unit->NormalizeState(ONE_R1 - secondary);
+    }
+
+    // The fresh single qubit unit takes the (approximate) marginal state back:
+    shard.isEmulated = true;
+    shard.amp0 = amp0;
+    shard.amp1 = amp1;
+
+    return true;
+}
+
+#if ENABLE_QSTATS
+QInterfaceStats QUnit::GetStats()
+{
+    // Separation counters live on the QUnit itself; sweep and fusion counters live on the component engines.
+    QInterfaceStats stats = QInterface::GetStats();
+    stats.maxShardWidth = 0;
+
+    std::vector<QInterfacePtr> units;
+    for (auto&& shard : shards) {
+        if (std::find(units.begin(), units.end(), shard.unit) != units.end()) {
+            continue;
+        }
+        units.push_back(shard.unit);
+
+        QInterfaceStats unitStats = shard.unit->GetStats();
+        stats.apply2x2Count += unitStats.apply2x2Count;
+        stats.fusionHits += unitStats.fusionHits;
+        if (unitStats.maxShardWidth > stats.maxShardWidth) {
+            stats.maxShardWidth = unitStats.maxShardWidth;
+        }
+    }
+
+    return stats;
+}
+
+void QUnit::ResetStats()
+{
+    QInterface::ResetStats();
+
+    std::vector<QInterfacePtr> units;
+    for (auto&& shard : shards) {
+        if (std::find(units.begin(), units.end(), shard.unit) != units.end()) {
+            continue;
+        }
+        units.push_back(shard.unit);
+        shard.unit->ResetStats();
+    }
+}
+#endif
+
 void QUnit::OrderContiguous(QInterfacePtr unit)
 {
     /* Before we call OrderContinguous, when we are cohering lists of shards, we should always proactively sort the
@@ -639,6 +792,10 @@ real1 QUnit::ProbAll(bitCapInt perm) { return clampProb(norm(GetAmplitude(perm))
 
 void QUnit::SeparateBit(bool value, bitLenInt qubit, bool doDispose)
 {
+#if ENABLE_QSTATS
+    separationHitCount++;
+#endif
+
     QInterfacePtr unit = shards[qubit].unit;
     bitLenInt mapped = shards[qubit].mapped;
 
@@ -3013,6 +3170,26 @@ bitCapInt QUnit::IndexedSBC(bitLenInt indexStart, bitLenInt indexLength, bitLenI
     return toRet;
 }
 
+void QUnit::IndexedCMP(bitLenInt indexStart, bitLenInt indexLength, bitLenInt valueLength, bitCapInt greaterPerm,
+    bitLenInt carryIndex, unsigned char* values)
+{
+    if (CheckBitsPermutation(indexStart, indexLength)) {
+        bitCapInt value = GetIndexedEigenstate(indexStart, indexLength, 0, valueLength, values);
+        if (value < greaterPerm) {
+            X(carryIndex);
+        }
+        return;
+    }
+
+    EntangleRange(indexStart, indexLength, carryIndex, 1);
+
+    shards[indexStart].unit->IndexedCMP(
+        shards[indexStart].mapped, indexLength, valueLength, greaterPerm, shards[carryIndex].mapped, values);
+
+    DirtyShardRangePhase(indexStart, indexLength);
+    shards[carryIndex].MakeDirty();
+}
+
 void QUnit::Hash(bitLenInt start, bitLenInt length, unsigned char* values)
 {
     if (CheckBitsPlus(start, length)) {
@@ -3040,13 +3217,27 @@ bool QUnit::ParallelUnitApply(ParallelUnitFn fn, real1 param1, real1 param2)
         QInterfacePtr toFind = shards[i].unit;
         if (find(units.begin(), units.end(), toFind) == units.end()) {
             units.push_back(toFind);
-            if (!fn(toFind, param1, param2)) {
-                return false;
-            }
         }
     }
 
-    return true;
+    // Distinct units are independent subsystems, so the operation is issued to all of them concurrently, instead of
+    // sweeping them one at a time while the rest of the machine idles. (Gate-by-gate ordering within any one unit is
+    // still program order, enforced by that unit's own dispatch queue.)
+    std::vector<std::future<bool>> futures(units.size());
+    for (size_t i = 0; i < units.size(); i++) {
+        QInterfacePtr unit = units[i];
+        futures[i] =
+            std::async(std::launch::async, [fn, unit, param1, param2]() { return fn(unit, param1, param2); });
+    }
+
+    bool toRet = true;
+    for (size_t i = 0; i < futures.size(); i++) {
+        if (!futures[i].get()) {
+            toRet = false;
+        }
+    }
+
+    return toRet;
 }
 
 void QUnit::UpdateRunningNorm(real1 norm_thresh)
@@ -3077,6 +3268,20 @@ void QUnit::Finish()
         unit->Finish();
         return true;
     });
+
+    // With every queue drained, spend a small, fixed budget attempting to separate entangled shards. Only qubits
+    // touched since their last separation check are candidates, so the budget is spent where success is plausible,
+    // and shard size is the dominant cost driver for everything that follows, so occasional successes more than pay
+    // for the checks.
+    bitLenInt budget = FINISH_SEPARATION_BUDGET;
+    for (bitLenInt i = 0; (i < qubitCount) && (budget > 0); i++) {
+        QEngineShard& shard = shards[i];
+        if ((shard.unit->GetQubitCount() == 1U) || shard.isSepChecked) {
+            continue;
+        }
+        budget--;
+        TrySeparate(i);
+    }
 }
 
 void QUnit::Dump()
@@ -3185,6 +3390,107 @@ void QUnit::ApplyBuffer(
     freezeBasis = false;
 }
 
+void QUnit::ApplyBulkPhaseBuffers(const bitLenInt& bitIndex, ShardToPhaseMap& bufferMap, const bool& isControl,
+    const bool& isAnti, const std::set<bitLenInt>& exceptPartners)
+{
+    QEngineShard& shard = shards[bitIndex];
+
+    if (shard.isPlusMinus || shard.IsInvertTarget() || UNSAFE_CACHED_CLASSICAL(shard)) {
+        // The per-buffer path has cheaper shortcuts for a classical shard, and commutation through |+>/|-> basis or
+        // queued inversions is per-buffer logic; leave all of these to ApplyBufferMap().
+        return;
+    }
+
+    // Every buffer in the map is a diagonal operator over (control, target), so all of them sharing this shard
+    // compose into one diagonal gate, applied in a single "uniformly controlled" state vector sweep. (When this shard
+    // is the common control, the roles just swap: the fused gate is a phase on this shard, "uniformly controlled" by
+    // the buffers' targets.) Collect the buffers that have no cheaper flush than an engine application:
+    std::vector<ShardToPhaseMap::iterator> bulk;
+    ShardToPhaseMap::iterator phaseShard;
+    for (phaseShard = bufferMap.begin(); phaseShard != bufferMap.end(); phaseShard++) {
+        QEngineShardPtr partner = phaseShard->first;
+        PhaseShardPtr buffer = phaseShard->second;
+
+        if (buffer->isInvert || IS_SAME(buffer->cmplxDiff, buffer->cmplxSame)) {
+            continue;
+        }
+        if (partner->isPlusMinus || partner->IsInvertTarget() || UNSAFE_CACHED_CLASSICAL((*partner))) {
+            continue;
+        }
+        if (exceptPartners.find(FindShardIndex(*partner)) != exceptPartners.end()) {
+            continue;
+        }
+
+        bulk.push_back(phaseShard);
+    }
+
+    // With fewer than 2 buffers bound for the engine, there's nothing to fuse.
+    while (bulk.size() > 1U) {
+        bitLenInt controlLen = (bulk.size() < BULK_PHASE_MAX_CTRLS) ? bulk.size() : BULK_PHASE_MAX_CTRLS;
+        bitCapIntOcl permCount = (bitCapIntOcl)ONE_BCI << controlLen;
+
+        std::vector<bitLenInt> controls(controlLen);
+        complex* mtrxs = new complex[permCount * 4U];
+        bitCapIntOcl perm;
+        bitLenInt i;
+        for (perm = 0; perm < permCount; perm++) {
+            complex topLeft = ONE_CMPLX;
+            complex bottomRight = ONE_CMPLX;
+            for (i = 0; i < controlLen; i++) {
+                PhaseShardPtr buffer = bulk[i]->second;
+                bool isSet = ((perm >> i) & 1U) != 0;
+                if (isControl) {
+                    // This shard is the control; the buffer's target selects which factor its shared qubit value
+                    // picks up. (Matching ApplyBuffer(): an anti-control buffer fires on 0, with "cmplxSame" on top.)
+                    if (isAnti) {
+                        topLeft *= isSet ? buffer->cmplxDiff : buffer->cmplxSame;
+                    } else {
+                        bottomRight *= isSet ? buffer->cmplxSame : buffer->cmplxDiff;
+                    }
+                } else if (isAnti != isSet) {
+                    topLeft *= isAnti ? buffer->cmplxSame : buffer->cmplxDiff;
+                    bottomRight *= isAnti ? buffer->cmplxDiff : buffer->cmplxSame;
+                }
+            }
+            mtrxs[(perm * 4U) + 0U] = topLeft;
+            mtrxs[(perm * 4U) + 1U] = ZERO_CMPLX;
+            mtrxs[(perm * 4U) + 2U] = ZERO_CMPLX;
+            mtrxs[(perm * 4U) + 3U] = bottomRight;
+        }
+
+        for (i = 0; i < controlLen; i++) {
+            controls[i] = FindShardIndex(*(bulk[i]->first));
+        }
+
+        // (All participating bits are in |0>/|1> basis, by the eligibility checks above, so freezing is safe, and it
+        // keeps Entangle() from recursively re-flushing the very buffers being applied here.)
+        freezeBasis = true;
+        UniformlyControlledSingleBit(&(controls[0]), controlLen, bitIndex, mtrxs, NULL, 0, 0);
+        freezeBasis = false;
+
+        delete[] mtrxs;
+
+        for (i = 0; i < controlLen; i++) {
+            QEngineShardPtr partner = bulk[i]->first;
+            bufferMap.erase(partner);
+            if (isControl) {
+                if (isAnti) {
+                    shard.RemovePhaseAntiTarget(partner);
+                } else {
+                    shard.RemovePhaseTarget(partner);
+                }
+            } else {
+                if (isAnti) {
+                    shard.RemovePhaseAntiControl(partner);
+                } else {
+                    shard.RemovePhaseControl(partner);
+                }
+            }
+        }
+        bulk.erase(bulk.begin(), bulk.begin() + controlLen);
+    }
+}
+
 void QUnit::ApplyBufferMap(const bitLenInt& bitIndex, ShardToPhaseMap bufferMap, const RevertExclusivity& exclusivity,
     const bool& isControl, const bool& isAnti, std::set<bitLenInt> exceptPartners, const bool& dumpSkipped)
 {
@@ -3192,6 +3498,11 @@ void QUnit::ApplyBufferMap(const bitLenInt& bitIndex, ShardToPhaseMap bufferMap,
 
     ShardToPhaseMap::iterator phaseShard;
 
+    if (exclusivity != ONLY_INVERT) {
+        // Compile all engine-bound phase buffers sharing this shard into one diagonal kernel pass:
+        ApplyBulkPhaseBuffers(bitIndex, bufferMap, isControl, isAnti, exceptPartners);
+    }
+
     while (bufferMap.size() > 0) {
         phaseShard = bufferMap.begin();
         QEngineShardPtr partner = phaseShard->first;
@@ -3434,6 +3745,10 @@ void QUnit::CheckShardSeparable(const bitLenInt& target)
         }
     }
 
+#if ENABLE_QSTATS
+    separationTryCount++;
+#endif
+
     if (IS_NORM_ZERO(shard.amp0) || IS_NORM_ZERO(shard.amp1)) {
         if (shard.unit->GetQubitCount() == 2U) {
             bitLenInt partnerIndex;
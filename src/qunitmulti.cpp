@@ -11,12 +11,30 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <thread>
+
 #include "qunitmulti.hpp"
 #include "common/oclengine.hpp"
 #include "qfactory.hpp"
 
 namespace Qrack {
 
+// A move between discrete devices must project at least this factor of kernel-time improvement before it is taken.
+// (Unified-memory devices migrate for any improvement.)
+#define QUNITMULTI_MIGRATION_HYSTERESIS 2
+
+// Shards narrower than this are launch-latency-bound on a discrete accelerator, (the kernel dispatch round-trip
+// exceeds the whole amplitude sweep,) so they are tiered onto the host CPU pseudo-device, instead, and only shards at
+// or above this width compete for the accelerators.
+#define QUNITMULTI_CPU_CROSSOVER_QUBITS 12
+
+// When a measured per-host calibration profile is on disk, its crossover supersedes the built-in constant:
+static bitLenInt CpuCrossoverQubits()
+{
+    EngineCalibration& cal = EngineCalibration::Instance();
+    return cal.IsCalibrated() ? cal.GetOclCrossoverQubits() : (bitLenInt)QUNITMULTI_CPU_CROSSOVER_QUBITS;
+}
+
 QUnitMulti::QUnitMulti(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_ptr rgp, complex phaseFac, bool doNorm,
     bool randomGlobalPhase, bool useHostMem, int deviceID, bool useHardwareRNG, bool useSparseStateVec,
     real1 norm_thresh, std::vector<bitLenInt> devList)
@@ -24,9 +42,9 @@ QUnitMulti::QUnitMulti(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_
           useHardwareRNG, useSparseStateVec, norm_thresh)
 {
     // Notice that this constructor does not take an engine type parameter, and it always passes QINTERFACE_OPENCL to
-    // the QUnit constructor. For QUnitMulti, the "shard" engines are therefore guaranteed to always be QEngineOCL
-    // types, and it's safe to assume that they can be cast from QInterfacePtr types to QEngineOCLPtr types in this
-    // class.
+    // the QUnit constructor. Shard engines are QEngineOCL types on the accelerator devices, or QEngineCPU types on
+    // the host CPU pseudo-device appended below; any QInterfacePtr that casts to a null QEngineOCLPtr in this class
+    // is therefore a CPU-resident shard.
 
     std::vector<DeviceContextPtr> deviceContext = OCLEngine::Instance()->GetDeviceContextPtrVector();
 
@@ -36,6 +54,7 @@ QUnitMulti::QUnitMulti(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_
         for (bitLenInt i = 0; i < deviceContext.size(); i++) {
             DeviceInfo deviceInfo;
             deviceInfo.id = i;
+            deviceInfo.isCpu = false;
             deviceList.push_back(deviceInfo);
         }
 
@@ -46,26 +65,93 @@ QUnitMulti::QUnitMulti(bitLenInt qBitCount, bitCapInt initState, qrack_rand_gen_
         for (bitLenInt i = 0; i < devList.size(); i++) {
             DeviceInfo deviceInfo;
             deviceInfo.id = devList[i];
+            deviceInfo.isCpu = false;
             deviceList.push_back(deviceInfo);
         }
     }
 
     for (bitLenInt i = 0; i < deviceList.size(); i++) {
-        deviceList[i].maxSize = deviceContext[deviceList[i].id]->device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+        cl::Device& device = deviceContext[deviceList[i].id]->device;
+        deviceList[i].maxSize = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+        deviceList[i].throughput =
+            (size_t)device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * (size_t)device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
+        if (deviceList[i].throughput == 0) {
+            deviceList[i].throughput = 1U;
+        }
+        deviceList[i].isHostUnified = (device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() == CL_TRUE);
     }
 
     if (devList.size() == 0) {
         std::sort(deviceList.begin() + 1, deviceList.end(), std::greater<DeviceInfo>());
     }
 
+    // The host CPU joins the list as a pseudo-device, always last, so shards below the crossover width can be
+    // scheduled onto QEngineCPU instances. Its throughput proxy never competes across the crossover tier, (the
+    // scheduler only weighs devices within a shard's tier,) so the core count alone suffices.
+    DeviceInfo cpuInfo;
+    cpuInfo.id = -1;
+    cpuInfo.isCpu = true;
+    cpuInfo.maxSize = maxQPower;
+    cpuInfo.throughput = std::thread::hardware_concurrency();
+    if (cpuInfo.throughput == 0) {
+        cpuInfo.throughput = 1U;
+    }
+    cpuInfo.isHostUnified = true;
+    deviceList.push_back(cpuInfo);
+    cpuDeviceIndex = deviceList.size() - 1U;
+
     RedistributeSingleQubits();
 }
 
+QInterfacePtr QUnitMulti::MakeEngine(bitLenInt length, bitCapInt perm)
+{
+    // Below the crossover width, kernels are launch-latency-bound on a discrete device and run faster on the host:
+    if (length < CpuCrossoverQubits()) {
+        return CreateQuantumInterface(QINTERFACE_CPU, length, perm, rand_generator, phaseFactor, doNormalize,
+            randGlobalPhase, useHostRam, -1, useRDRAND, isSparse);
+    }
+
+    return CreateQuantumInterface(QINTERFACE_OPENCL, length, perm, rand_generator, phaseFactor, doNormalize,
+        randGlobalPhase, useHostRam, defaultDeviceID, useRDRAND, isSparse);
+}
+
+void QUnitMulti::SetUnitDevice(QInterfacePtr unit, bitLenInt devIndex)
+{
+    DeviceInfo& dev = deviceList[devIndex];
+    QEngineOCLPtr qOCL = std::dynamic_pointer_cast<QEngineOCL>(unit);
+
+    if (qOCL && !dev.isCpu) {
+        qOCL->SetDevice(dev.id);
+        return;
+    }
+
+    if (!qOCL && dev.isCpu) {
+        // Already a host engine
+        return;
+    }
+
+    // The move crosses the host/accelerator boundary, which changes the engine type, so the state passes through a
+    // host buffer and every shard rebinds to the replacement engine.
+    QInterfacePtr nUnit = CreateQuantumInterface(dev.isCpu ? QINTERFACE_CPU : QINTERFACE_OPENCL,
+        unit->GetQubitCount(), 0, rand_generator, phaseFactor, doNormalize, randGlobalPhase, useHostRam,
+        dev.isCpu ? -1 : dev.id, useRDRAND, isSparse);
+
+    std::unique_ptr<complex[]> amps(new complex[(bitCapIntOcl)unit->GetMaxQPower()]);
+    unit->GetQuantumState(amps.get());
+    nUnit->SetQuantumState(amps.get());
+
+    for (auto&& shard : shards) {
+        if (shard.unit == unit) {
+            shard.unit = nUnit;
+        }
+    }
+}
+
 void QUnitMulti::RedistributeSingleQubits()
 {
+    // Single-qubit engines are always below the crossover width, so they all belong on the host pseudo-device:
     for (bitLenInt i = 0; i < qubitCount; i++) {
-        std::dynamic_pointer_cast<QEngineOCL>(shards[i].unit)
-            ->SetDevice(deviceList[(int)((real1)(i * deviceList.size()) / qubitCount)].id);
+        SetUnitDevice(shards[i].unit, cpuDeviceIndex);
     }
 }
 
@@ -81,10 +167,15 @@ std::vector<QEngineInfo> QUnitMulti::GetQInfos()
         if (std::find(qips.begin(), qips.end(), shard.unit) == qips.end()) {
             qips.push_back(shard.unit);
             qOCL = std::dynamic_pointer_cast<QEngineOCL>(shard.unit);
-            deviceIndex = std::distance(deviceList.begin(),
-                std::find_if(
-                    deviceList.begin(), deviceList.end(), [&](DeviceInfo di) { return di.id == qOCL->GetDeviceID(); }));
-            qinfos.push_back(QEngineInfo(qOCL, deviceIndex));
+            if (qOCL) {
+                deviceIndex = std::distance(deviceList.begin(),
+                    std::find_if(deviceList.begin(), deviceList.end(),
+                        [&](DeviceInfo di) { return di.id == qOCL->GetDeviceID(); }));
+            } else {
+                // A shard that isn't a QEngineOCL resides on the host pseudo-device.
+                deviceIndex = cpuDeviceIndex;
+            }
+            qinfos.push_back(QEngineInfo(shard.unit, deviceIndex));
         }
     }
 
@@ -106,60 +197,106 @@ void QUnitMulti::RedistributeQEngines()
 
     std::vector<bitCapInt> devSizes(deviceList.size());
     std::fill(devSizes.begin(), devSizes.end(), 0U);
+    const bitCapInt crossoverPower = pow2(CpuCrossoverQubits());
     bitCapInt sz;
-    bitLenInt devID, devIndex;
+    bitLenInt devIndex, bestIndex;
     bitLenInt i, j;
+    bool onCpu, haveBest;
+    real1 time, bestTime;
 
     for (i = 0; i < qinfos.size(); i++) {
         // If the engine adds negligible load, we can let any given unit keep its
         // residency on this device.
         // In fact, single qubit units will be handled entirely by the CPU, anyway.
-        if (qinfos[i].unit->GetMaxQPower() <= 2U) {
+        sz = qinfos[i].unit->GetMaxQPower();
+        if (sz <= 2U) {
             continue;
         }
 
-        // If the original OpenCL device has equal load to the least, we prefer the original.
-        devID = qinfos[i].unit->GetDeviceID();
         devIndex = qinfos[i].deviceIndex;
-        sz = devSizes[devIndex];
-
-        // If the original device has 0 determined load, don't switch the unit.
-        if (sz > 0) {
-            // If the default OpenCL device has equal load to the least, we prefer the default.
-            if (devSizes[0] < sz) {
-                devID = deviceList[0].id;
-                devIndex = 0;
-                sz = devSizes[0];
+
+        // A shard below the crossover width is launch-latency-bound on an accelerator and belongs on the host
+        // pseudo-device; a wider shard belongs on the accelerators. The throughput balance below only weighs devices
+        // within the shard's tier.
+        onCpu = (sz < crossoverPower);
+
+        // The placement objective is projected kernel time, not raw buffer size: a device's load is the amplitudes
+        // it sweeps per gate, divided by its relative throughput. (A shard currently on the wrong side of the
+        // crossover has no standing time to beat.)
+        bestIndex = devIndex;
+        haveBest = (deviceList[devIndex].isCpu == onCpu);
+        bestTime = haveBest ? (((real1)(bitCapIntOcl)(devSizes[devIndex] + sz)) / deviceList[devIndex].throughput)
+                            : ZERO_R1;
+
+        for (j = 0; j < deviceList.size(); j++) {
+            if ((j == devIndex) || (deviceList[j].isCpu != onCpu) || ((devSizes[j] + sz) > deviceList[j].maxSize)) {
+                continue;
+            }
+            time = ((real1)(bitCapIntOcl)(devSizes[j] + sz)) / deviceList[j].throughput;
+            if (!haveBest || (time < bestTime)) {
+                haveBest = true;
+                bestIndex = j;
+                bestTime = time;
             }
+        }
 
-            // Find the device with the lowest load.
-            for (j = 0; j < deviceList.size(); j++) {
-                if ((devSizes[j] < sz) && ((devSizes[j] + qinfos[i].unit->GetMaxQPower()) <= deviceList[j].maxSize)) {
-                    devID = deviceList[j].id;
-                    devIndex = j;
-                    sz = devSizes[j];
+        if (bestIndex != devIndex) {
+            if (deviceList[devIndex].isCpu != onCpu) {
+                // A move that corrects the tier repays itself in launch latency (or sweep time) on every gate:
+                SetUnitDevice(qinfos[i].unit, bestIndex);
+            } else {
+                // Migration ships the whole state vector across the host bus (twice, for discrete devices), so a
+                // move is only taken when the projected win repays it; otherwise large buffers bounce between
+                // devices on every Compose/Decompose for marginal gains.
+                real1 hysteresis = (deviceList[devIndex].isHostUnified && deviceList[bestIndex].isHostUnified)
+                    ? ONE_R1
+                    : (real1)QUNITMULTI_MIGRATION_HYSTERESIS;
+                time = ((real1)(bitCapIntOcl)(devSizes[devIndex] + sz)) / deviceList[devIndex].throughput;
+                if ((bestTime * hysteresis) < time) {
+                    SetUnitDevice(qinfos[i].unit, bestIndex);
+                } else {
+                    bestIndex = devIndex;
                 }
             }
-
-            // Add this unit to the device with the lowest load.
-            qinfos[i].unit->SetDevice(devID);
         }
 
-        // Update the size of buffers handles by this device.
-        devSizes[devIndex] += qinfos[i].unit->GetMaxQPower();
+        // Update the size of buffers handled by this device.
+        devSizes[bestIndex] += sz;
     }
 }
 
 void QUnitMulti::Detach(bitLenInt start, bitLenInt length, QUnitMultiPtr dest)
 {
+    if (dest && (length > 1)) {
+        // Entangle both ranges up-front, (exactly as the base method is about to, idempotently,) so that the source
+        // and destination engine types can be matched before the base method decomposes across the pair.
+        for (bitLenInt i = 0; i < length; i++) {
+            RevertBasis2Qb(start + i);
+        }
+
+        EntangleRange(start, length);
+        OrderContiguous(shards[start].unit);
+        dest->EntangleRange(0, length);
+        dest->OrderContiguous(dest->shards[0].unit);
+
+        bool isSrcCpu = !std::dynamic_pointer_cast<QEngineOCL>(shards[start].unit);
+        bool isDestCpu = !std::dynamic_pointer_cast<QEngineOCL>(dest->shards[0].unit);
+        if (isSrcCpu != isDestCpu) {
+            dest->SetUnitDevice(dest->shards[0].unit, isSrcCpu ? dest->cpuDeviceIndex : 0);
+        }
+    }
+
     QUnit::Detach(start, length, dest);
     RedistributeQEngines();
+    if (dest) {
+        dest->RedistributeQEngines();
+    }
 }
 
 QInterfacePtr QUnitMulti::EntangleInCurrentBasis(
     std::vector<bitLenInt*>::iterator first, std::vector<bitLenInt*>::iterator last)
 {
-    QEngineOCLPtr unit1 = std::dynamic_pointer_cast<QEngineOCL>(shards[**first].unit);
+    QInterfacePtr unit1 = shards[**first].unit;
 
     // If already fully entangled, just return unit1.
     bool isAlreadyEntangled = true;
@@ -171,9 +308,7 @@ QInterfacePtr QUnitMulti::EntangleInCurrentBasis(
         }
     }
 
-    // This does nothing if the first unit is the default device:
-    if (!isAlreadyEntangled && deviceList[0].id != unit1->GetDeviceID()) {
-        // Check if size exceeds single device capacity:
+    if (!isAlreadyEntangled) {
         bitLenInt qubitCount = 0;
         std::map<QInterfacePtr, bool> found;
 
@@ -185,9 +320,25 @@ QInterfacePtr QUnitMulti::EntangleInCurrentBasis(
             }
         }
 
-        // If device capacity is exceeded, put on default device:
-        if (pow2(qubitCount) > std::dynamic_pointer_cast<QEngineOCL>(unit1)->GetMaxSize()) {
-            unit1->SetDevice(deviceList[0].id);
+        // Entangling composes the group's engines pairwise, which requires a uniform engine type, and the composed
+        // width decides the tier: below the crossover, accelerator units drop to the host; at or above it, host
+        // units are promoted to an accelerator, first.
+        bool onCpu = (qubitCount < CpuCrossoverQubits());
+        for (auto&& qi : found) {
+            QInterfacePtr unit = qi.first;
+            bool unitOnCpu = !std::dynamic_pointer_cast<QEngineOCL>(unit);
+            if (unitOnCpu != onCpu) {
+                SetUnitDevice(unit, onCpu ? cpuDeviceIndex : 0);
+            }
+        }
+
+        // This does nothing if the first unit is the default device (or the host):
+        QEngineOCLPtr unit1OCL = std::dynamic_pointer_cast<QEngineOCL>(shards[**first].unit);
+        if (unit1OCL && (deviceList[0].id != unit1OCL->GetDeviceID())) {
+            // If device capacity is exceeded, put on default device:
+            if (pow2(qubitCount) > unit1OCL->GetMaxSize()) {
+                unit1OCL->SetDevice(deviceList[0].id);
+            }
         }
     }
 
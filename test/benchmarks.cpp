@@ -45,6 +45,40 @@ double formatTime(double t, bool logNormal)
     }
 }
 
+std::string engineName(QInterfaceEngine type)
+{
+    switch (type) {
+    case QINTERFACE_CPU:
+        return "CPU";
+    case QINTERFACE_OPENCL:
+        return "OpenCL";
+    case QINTERFACE_QFUSION:
+        return "QFusion";
+    case QINTERFACE_QPAGER:
+        return "QPager";
+    case QINTERFACE_STABILIZER_HYBRID:
+        return "QStabilizerHybrid";
+    case QINTERFACE_QUNIT:
+        return "QUnit";
+    case QINTERFACE_QUNIT_MULTI:
+        return "QUnitMulti";
+    default:
+        return "Unknown";
+    }
+}
+
+std::string engineStackName()
+{
+    std::string toRet = engineName(testEngineType);
+    if (testSubEngineType != testEngineType) {
+        toRet += "->" + engineName(testSubEngineType);
+    }
+    if (sparse) {
+        toRet += " (Sparse)";
+    }
+    return toRet;
+}
+
 QInterfacePtr MakeRandQubit()
 {
     QInterfacePtr qubit = CreateQuantumInterface(testEngineType, testSubEngineType, 1U, 0, rng, ONE_CMPLX,
@@ -95,6 +129,8 @@ void benchmarkLoopVariable(std::function<void(QInterfacePtr, bitLenInt)> fn, bit
 
     for (numBits = mnQbts; numBits <= mxQbts; numBits++) {
 
+        size_t allocStart = StateVectorArray::alloc_count();
+
         if (isBinaryOutput) {
             mOutputFile << std::endl << ">>> '" << Catch::getResultCapture().getCurrentTestName() << "':" << std::endl;
             mOutputFile << ITERATIONS << " iterations" << std::endl;
@@ -178,31 +214,45 @@ void benchmarkLoopVariable(std::function<void(QInterfacePtr, bitLenInt)> fn, bit
 
         std::sort(trialClocks, trialClocks + ITERATIONS);
 
-        std::cout << (int)numBits << ", "; /* # of Qubits */
-        std::cout << formatTime(avgt, logNormal) << ","; /* Average Time (ms) */
-        std::cout << formatTime(stdet, logNormal) << ","; /* Sample Std. Deviation (ms) */
-        std::cout << formatTime(trialClocks[0], logNormal) << ","; /* Fastest (ms) */
+        double fastestt = formatTime(trialClocks[0], logNormal);
+        double slowestt = formatTime(trialClocks[ITERATIONS - 1], logNormal);
+        double q1t, mediant, q3t;
         if (ITERATIONS % 4 == 0) {
-            std::cout << formatTime((trialClocks[ITERATIONS / 4 - 1] + trialClocks[ITERATIONS / 4]) / 2, logNormal)
-                      << ","; /* 1st Quartile (ms) */
+            q1t = formatTime((trialClocks[ITERATIONS / 4 - 1] + trialClocks[ITERATIONS / 4]) / 2, logNormal);
+            q3t = formatTime((trialClocks[(3 * ITERATIONS) / 4 - 1] + trialClocks[(3 * ITERATIONS) / 4]) / 2, logNormal);
         } else {
-            std::cout << formatTime(trialClocks[ITERATIONS / 4 - 1] / 2, logNormal) << ","; /* 1st Quartile (ms) */
+            q1t = formatTime(trialClocks[ITERATIONS / 4 - 1] / 2, logNormal);
+            q3t = formatTime(trialClocks[(3 * ITERATIONS) / 4 - 1] / 2, logNormal);
         }
         if (ITERATIONS % 2 == 0) {
-            std::cout << formatTime((trialClocks[ITERATIONS / 2 - 1] + trialClocks[ITERATIONS / 2]) / 2, logNormal)
-                      << ","; /* Median (ms) */
-        } else {
-            std::cout << formatTime(trialClocks[ITERATIONS / 2 - 1] / 2, logNormal) << ","; /* Median (ms) */
-        }
-        if (ITERATIONS % 4 == 0) {
-            std::cout << formatTime(
-                             (trialClocks[(3 * ITERATIONS) / 4 - 1] + trialClocks[(3 * ITERATIONS) / 4]) / 2, logNormal)
-                      << ","; /* 3rd Quartile (ms) */
+            mediant = formatTime((trialClocks[ITERATIONS / 2 - 1] + trialClocks[ITERATIONS / 2]) / 2, logNormal);
         } else {
-            std::cout << formatTime(trialClocks[(3 * ITERATIONS) / 4 - 1] / 2, logNormal)
-                      << ","; /* 3rd Quartile (ms) */
+            mediant = formatTime(trialClocks[ITERATIONS / 2 - 1] / 2, logNormal);
         }
-        std::cout << formatTime(trialClocks[ITERATIONS - 1], logNormal) << std::endl; /* Slowest (ms) */
+
+        std::cout << (int)numBits << ", "; /* # of Qubits */
+        std::cout << formatTime(avgt, logNormal) << ","; /* Average Time (ms) */
+        std::cout << formatTime(stdet, logNormal) << ","; /* Sample Std. Deviation (ms) */
+        std::cout << fastestt << ","; /* Fastest (ms) */
+        std::cout << q1t << ","; /* 1st Quartile (ms) */
+        std::cout << mediant << ","; /* Median (ms) */
+        std::cout << q3t << ","; /* 3rd Quartile (ms) */
+        std::cout << slowestt << std::endl; /* Slowest (ms) */
+
+        BenchmarkResult result;
+        result.testName = Catch::getResultCapture().getCurrentTestName();
+        result.engineStack = engineStackName();
+        result.deviceId = device_id;
+        result.qubitCount = (int)numBits;
+        result.avgMs = formatTime(avgt, logNormal);
+        result.stdevMs = formatTime(stdet, logNormal);
+        result.fastestMs = fastestt;
+        result.q1Ms = q1t;
+        result.medianMs = mediant;
+        result.q3Ms = q3t;
+        result.slowestMs = slowestt;
+        result.allocCount = StateVectorArray::alloc_count() - allocStart;
+        benchmarkResults.push_back(result);
     }
 }
 
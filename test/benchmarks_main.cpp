@@ -10,7 +10,9 @@
 // See LICENSE.md in the project root or https://www.gnu.org/licenses/lgpl-3.0.en.html
 // for details.
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <random>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +37,143 @@ bool single_qubit_run = false;
 std::string mOutputFileName;
 std::ofstream mOutputFile;
 bool isBinaryOutput = false;
+std::vector<BenchmarkResult> benchmarkResults;
+std::string benchmarkOutputFileName;
+std::string benchmarkBaselineFileName;
+double benchmarkMaxRegression = 25.0;
+
+std::string benchmarkResultKey(const std::string& test, const std::string& engine, int device, int qubits)
+{
+    return test + "|" + engine + "|" + std::to_string(device) + "|" + std::to_string(qubits);
+}
+
+void writeBenchmarkJson(std::ostream& os)
+{
+    os << "[" << std::endl;
+    for (size_t i = 0; i < benchmarkResults.size(); i++) {
+        const BenchmarkResult& r = benchmarkResults[i];
+        os << "  { \"test\": \"" << r.testName << "\", \"engine\": \"" << r.engineStack
+           << "\", \"device\": " << r.deviceId << ", \"qubits\": " << r.qubitCount << ", \"avg_ms\": " << r.avgMs
+           << ", \"stddev_ms\": " << r.stdevMs << ", \"fastest_ms\": " << r.fastestMs << ", \"q1_ms\": " << r.q1Ms
+           << ", \"median_ms\": " << r.medianMs << ", \"q3_ms\": " << r.q3Ms << ", \"slowest_ms\": " << r.slowestMs
+           << ", \"allocs\": " << r.allocCount << " }" << (((i + 1U) < benchmarkResults.size()) ? "," : "")
+           << std::endl;
+    }
+    os << "]" << std::endl;
+}
+
+void writeBenchmarkMatrixSummary(std::ostream& os)
+{
+    // One column per swept configuration and one row per (test, width), so the whole sweep reads as a single
+    // comparative table, instead of one report section per process:
+    std::vector<std::string> configs;
+    std::vector<std::string> rowKeys;
+    std::map<std::string, std::map<std::string, double>> medians;
+
+    for (size_t i = 0; i < benchmarkResults.size(); i++) {
+        const BenchmarkResult& r = benchmarkResults[i];
+        std::string config = r.engineStack + ((r.deviceId >= 0) ? ("@dev" + std::to_string(r.deviceId)) : "");
+        if (std::find(configs.begin(), configs.end(), config) == configs.end()) {
+            configs.push_back(config);
+        }
+        std::string rowKey = r.testName + ", " + std::to_string(r.qubitCount);
+        if (medians.find(rowKey) == medians.end()) {
+            rowKeys.push_back(rowKey);
+        }
+        medians[rowKey][config] = r.medianMs;
+    }
+
+    os << std::endl << "############ Matrix summary: median times (ms) ############" << std::endl;
+    os << "Test, Qubits";
+    for (size_t i = 0; i < configs.size(); i++) {
+        os << ", " << configs[i];
+    }
+    os << std::endl;
+
+    for (size_t i = 0; i < rowKeys.size(); i++) {
+        os << rowKeys[i];
+        std::map<std::string, double>& row = medians[rowKeys[i]];
+        for (size_t j = 0; j < configs.size(); j++) {
+            std::map<std::string, double>::iterator it = row.find(configs[j]);
+            if (it == row.end()) {
+                os << ", -";
+            } else {
+                os << ", " << it->second;
+            }
+        }
+        os << std::endl;
+    }
+}
+
+bool parseJsonString(const std::string& line, const std::string& key, std::string* out)
+{
+    size_t pos = line.find("\"" + key + "\": \"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += key.size() + 5U;
+    size_t end = line.find("\"", pos);
+    if (end == std::string::npos) {
+        return false;
+    }
+    *out = line.substr(pos, end - pos);
+    return true;
+}
+
+bool parseJsonNumber(const std::string& line, const std::string& key, double* out)
+{
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    *out = atof(line.c_str() + pos + key.size() + 4U);
+    return true;
+}
+
+int checkBenchmarkBaseline()
+{
+    std::ifstream baselineFile(benchmarkBaselineFileName);
+    if (!baselineFile.is_open()) {
+        std::cout << "Baseline error: Could not read " << benchmarkBaselineFileName << std::endl;
+        return 1;
+    }
+
+    // The baseline is our own --json-output format, one record per line, so a line-oriented scan stands in for a
+    // full JSON parser without adding a dependency.
+    std::map<std::string, double> baselineMedians;
+    std::string line, test, engine;
+    double device, qubits, median;
+    while (std::getline(baselineFile, line)) {
+        if (!parseJsonString(line, "test", &test) || !parseJsonString(line, "engine", &engine) ||
+            !parseJsonNumber(line, "device", &device) || !parseJsonNumber(line, "qubits", &qubits) ||
+            !parseJsonNumber(line, "median_ms", &median)) {
+            continue;
+        }
+        baselineMedians[benchmarkResultKey(test, engine, (int)device, (int)qubits)] = median;
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < benchmarkResults.size(); i++) {
+        const BenchmarkResult& r = benchmarkResults[i];
+        std::map<std::string, double>::iterator it =
+            baselineMedians.find(benchmarkResultKey(r.testName, r.engineStack, r.deviceId, r.qubitCount));
+        if (it == baselineMedians.end()) {
+            continue;
+        }
+        if (r.medianMs > (it->second * (1.0 + benchmarkMaxRegression / 100.0))) {
+            std::cout << "REGRESSION: '" << r.testName << "' (" << r.engineStack << ", " << r.qubitCount
+                      << " qubits): median " << r.medianMs << " ms vs. baseline " << it->second << " ms" << std::endl;
+            regressions++;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " benchmark(s) regressed by more than " << benchmarkMaxRegression << "%!"
+                  << std::endl;
+    }
+
+    return regressions;
+}
 
 int main(int argc, char* argv[])
 {
@@ -45,6 +184,7 @@ int main(int argc, char* argv[])
     bool cpu = false;
     bool opencl_single = false;
     bool opencl_multi = false;
+    bool matrix = false;
 
     int mxQbts = 24;
 
@@ -77,7 +217,19 @@ int main(int argc, char* argv[])
                                                "human-readable.)") |
         Opt(single_qubit_run)["--single"]("Only run single (maximum) qubit count for tests") |
         Opt(sparse)["--sparse"](
-            "(For QEngineCPU, under QUnit:) Use a state vector optimized for sparse representation and iteration.");
+            "(For QEngineCPU, under QUnit:) Use a state vector optimized for sparse representation and iteration.") |
+        Opt(benchmarkOutputFileName, "json-output")["--json-output"](
+            "Specifies a file name for machine-readable benchmark statistics, written as a JSON array with one "
+            "record per test, engine stack, qubit width, and device") |
+        Opt(benchmarkBaselineFileName, "baseline")["--baseline"](
+            "Specifies a stored --json-output file to compare against. If any median time regresses by more than "
+            "--max-regression percent, the run exits with a nonzero status") |
+        Opt(benchmarkMaxRegression, "max-regression")["--max-regression"](
+            "Maximum allowed median time regression against the --baseline file, in percent (default value 25)") |
+        Opt(matrix)["--matrix"](
+            "Sweep every (engine stack x OpenCL device x sparse/dense) combination within this one process, reusing "
+            "the compiled OpenCL context between runs, and append a comparative median table to the report. "
+            "Overrides the --layer and --proc selections. (Float/double precision is fixed at build time.)");
 
     session.cli(cli);
 
@@ -153,7 +305,54 @@ int main(int argc, char* argv[])
 
     int num_failed = 0;
 
-    if (num_failed == 0 && qengine) {
+    if (matrix) {
+        // The nightly sweep used to launch one process per configuration, re-paying OpenCL compile and context setup
+        // each time; here the whole matrix shares this process's context singleton, and the accumulated results land
+        // in one report (and one --json-output file).
+        struct MatrixConfig {
+            QInterfaceEngine engine;
+            QInterfaceEngine subEngine;
+            bool isSparse;
+            int devId;
+            std::string banner;
+        };
+
+        std::vector<MatrixConfig> matrixConfigs = {
+            { QINTERFACE_CPU, QINTERFACE_CPU, false, -1, "QEngine -> CPU" },
+            { QINTERFACE_CPU, QINTERFACE_CPU, true, -1, "QEngine -> CPU (Sparse)" },
+            { QINTERFACE_QUNIT, QINTERFACE_CPU, false, -1, "QUnit -> QEngine -> CPU" },
+            { QINTERFACE_QUNIT, QINTERFACE_CPU, true, -1, "QUnit -> QEngine -> CPU (Sparse)" },
+        };
+
+#if ENABLE_OPENCL
+        CreateQuantumInterface(QINTERFACE_OPENCL, 1, 0).reset(); /* Get the OpenCL banner out of the way. */
+        const int deviceCount = (int)(OCLEngine::Instance()->GetDeviceContextPtrVector().size());
+        for (int d = 0; d < deviceCount; d++) {
+            matrixConfigs.push_back(
+                { QINTERFACE_OPENCL, QINTERFACE_OPENCL, false, d, "QEngine -> OpenCL, device " + std::to_string(d) });
+            matrixConfigs.push_back({ QINTERFACE_QUNIT, QINTERFACE_OPENCL, false, d,
+                "QUnit -> QEngine -> OpenCL, device " + std::to_string(d) });
+        }
+        if (deviceCount > 1) {
+            matrixConfigs.push_back({ QINTERFACE_QUNIT_MULTI, QINTERFACE_OPENCL, false, -1, "QUnitMulti (OpenCL)" });
+        }
+#endif
+
+        for (size_t i = 0; (num_failed == 0) && (i < matrixConfigs.size()); i++) {
+            testEngineType = matrixConfigs[i].engine;
+            testSubEngineType = matrixConfigs[i].subEngine;
+            sparse = matrixConfigs[i].isSparse;
+            device_id = matrixConfigs[i].devId;
+            session.config().stream() << "############ " << matrixConfigs[i].banner << " ############" << std::endl;
+            num_failed = session.run();
+        }
+
+        if (num_failed == 0) {
+            writeBenchmarkMatrixSummary(session.config().stream());
+        }
+    }
+
+    if (num_failed == 0 && !matrix && qengine) {
         /* Perform the run against the default (software) variant. */
         if (num_failed == 0 && cpu) {
             testEngineType = QINTERFACE_CPU;
@@ -173,7 +372,7 @@ int main(int argc, char* argv[])
 #endif
     }
 
-    if (num_failed == 0 && qunit) {
+    if (num_failed == 0 && !matrix && qunit) {
         testEngineType = QINTERFACE_QUNIT;
         if (num_failed == 0 && cpu) {
             if (sparse) {
@@ -203,10 +402,29 @@ int main(int argc, char* argv[])
 #endif
     }
 
+#if ENABLE_OPENCL
+    if (OCLEngine::IsProfilingEnabled()) {
+        OCLEngine::Instance()->DumpKernelProfiles(session.config().stream());
+    }
+#endif
+
     if (mOutputFileName.compare("")) {
         mOutputFile.close();
     }
 
+    if (benchmarkOutputFileName.compare("")) {
+        std::ofstream benchmarkOutputFile(benchmarkOutputFileName, std::ios::out);
+        if (!benchmarkOutputFile.is_open()) {
+            std::cout << "Benchmark output error: Could not write to " << benchmarkOutputFileName << std::endl;
+        } else {
+            writeBenchmarkJson(benchmarkOutputFile);
+        }
+    }
+
+    if ((num_failed == 0) && benchmarkBaselineFileName.compare("")) {
+        num_failed = checkBenchmarkBaseline();
+    }
+
     return num_failed;
 }
 
@@ -38,6 +38,8 @@ int main(int argc, char* argv[])
     Catch::Session session;
 
     bool qengine = false;
+    bool qfusion = false;
+    bool qpager = false;
     bool qunit = false;
     bool cpu = false;
     bool opencl_single = false;
@@ -49,6 +51,8 @@ int main(int argc, char* argv[])
      * Allow specific layers and processor types to be enabled.
      */
     auto cli = session.cli() | Opt(qengine)["--layer-qengine"]("Enable Basic QEngine tests") |
+        Opt(qfusion)["--layer-qfusion"]("Enable gate fusion layer tests") |
+        Opt(qpager)["--layer-qpager"]("Enable state vector paging layer tests") |
         Opt(qunit)["--layer-qunit"]("Enable QUnit implementation tests") |
         Opt(cpu)["--proc-cpu"]("Enable the CPU-based implementation tests") |
         Opt(opencl_single)["--proc-opencl-single"]("Single (parallel) processor OpenCL tests") |
@@ -101,8 +105,10 @@ int main(int argc, char* argv[])
 #endif
     session.config().stream() << std::endl;
 
-    if (!qengine && !qunit) {
+    if (!qengine && !qfusion && !qpager && !qunit) {
         qunit = true;
+        qpager = true;
+        qfusion = true;
         qengine = true;
     }
 
@@ -134,6 +140,42 @@ int main(int argc, char* argv[])
 #endif
     }
 
+    if (num_failed == 0 && qfusion) {
+        testEngineType = QINTERFACE_QFUSION;
+        if (num_failed == 0 && cpu) {
+            session.config().stream() << "############ QFusion -> QEngine -> CPU ############" << std::endl;
+            testSubEngineType = QINTERFACE_CPU;
+            num_failed = session.run();
+        }
+
+#if ENABLE_OPENCL
+        if (num_failed == 0 && opencl_single) {
+            session.config().stream() << "############ QFusion -> QEngine -> OpenCL ############" << std::endl;
+            testSubEngineType = QINTERFACE_OPENCL;
+            CreateQuantumInterface(QINTERFACE_OPENCL, 1, 0).reset(); /* Get the OpenCL banner out of the way. */
+            num_failed = session.run();
+        }
+#endif
+    }
+
+    if (num_failed == 0 && qpager) {
+        testEngineType = QINTERFACE_QPAGER;
+        if (num_failed == 0 && cpu) {
+            session.config().stream() << "############ QPager -> QEngine -> CPU ############" << std::endl;
+            testSubEngineType = QINTERFACE_CPU;
+            num_failed = session.run();
+        }
+
+#if ENABLE_OPENCL
+        if (num_failed == 0 && opencl_single) {
+            session.config().stream() << "############ QPager -> QEngine -> OpenCL ############" << std::endl;
+            testSubEngineType = QINTERFACE_OPENCL;
+            CreateQuantumInterface(QINTERFACE_OPENCL, 1, 0).reset(); /* Get the OpenCL banner out of the way. */
+            num_failed = session.run();
+        }
+#endif
+    }
+
     if (num_failed == 0 && qunit) {
         testEngineType = QINTERFACE_QUNIT;
         if (num_failed == 0 && cpu) {
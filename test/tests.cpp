@@ -17,6 +17,7 @@
 #include <stdlib.h>
 
 #include "catch.hpp"
+#include "qcircuit.hpp"
 #include "qfactory.hpp"
 #include "qneuron.hpp"
 
@@ -269,6 +270,67 @@ TEST_CASE("test_exp2x2_log2x2")
     REQUIRE_FLOAT(imag(mtrx1[3]), ZERO_R1);
 }
 
+TEST_CASE("test_stabilizer_clifford")
+{
+    // A Clifford-only circuit stays in the O(n^2) tableau representation, so this GHZ state is far wider than any
+    // state vector could be:
+    QInterfacePtr qReg = CreateQuantumInterface(QINTERFACE_STABILIZER_HYBRID, QINTERFACE_CPU, 50, 0, rng);
+
+    qReg->H(0);
+    for (bitLenInt i = 0; i < 49U; i++) {
+        qReg->CNOT(i, i + 1U);
+    }
+
+    REQUIRE_FLOAT(qReg->Prob(49), ONE_R1 / 2);
+
+    bool result = qReg->M(0);
+    for (bitLenInt i = 1; i < 50U; i++) {
+        REQUIRE(qReg->M(i) == result);
+    }
+
+    // Separable eigenstates split off of the tableau directly:
+    qReg->SetPermutation(0);
+    qReg->H(1);
+    qReg->S(1);
+    QInterfacePtr qReg2 = CreateQuantumInterface(QINTERFACE_STABILIZER_HYBRID, QINTERFACE_CPU, 1, 0, rng);
+    qReg->Decompose(1, 1, qReg2);
+
+    complex ket[2];
+    qReg2->GetQuantumState(ket);
+    REQUIRE_FLOAT(norm(ket[0]), ONE_R1 / 2);
+    REQUIRE_FLOAT(imag(ket[1] / ket[0]), ONE_R1);
+}
+
+TEST_CASE("test_stabilizer_t_fallback")
+{
+    // The first non-Clifford gate converts the tableau to a ket, transparently:
+    QInterfacePtr qReg = CreateQuantumInterface(QINTERFACE_STABILIZER_HYBRID, QINTERFACE_CPU, 2, 0, rng);
+
+    qReg->H(0);
+    qReg->T(0);
+    qReg->H(0);
+
+    // |<0|HTH|0>|^2 = cos^2(pi/8):
+    REQUIRE_FLOAT(qReg->Prob(0), (ONE_R1 - (real1)(M_SQRT1_2)) / 2);
+
+    // Clifford gates keep working against the state vector engine:
+    qReg->CNOT(0, 1);
+    REQUIRE_FLOAT(qReg->Prob(1), qReg->Prob(0));
+}
+
+TEST_CASE("test_engine_auto")
+{
+    // Whether or not a calibration profile is on disk, QINTERFACE_AUTO resolves to a working engine for any width:
+    QInterfacePtr qReg = CreateQuantumInterface(QINTERFACE_AUTO, 8, 0x2D, rng);
+    REQUIRE(!!qReg);
+    REQUIRE_THAT(qReg, HasProbability(0, 8, 0x2D));
+
+    // A QUnit with an auto subengine re-resolves the choice per shard width, through the same profile:
+    qReg = CreateQuantumInterface(QINTERFACE_QUNIT, QINTERFACE_AUTO, 8, 0x2D, rng);
+    qReg->X(0, 8);
+    REQUIRE_THAT(qReg, HasProbability(0, 8, 0xD2));
+}
+
 #if ENABLE_OPENCL
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_oclengine")
 {
@@ -301,6 +363,150 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_qengine_getmaxqpower")
     REQUIRE((qftReg->GetMaxQPower() == 1048576U));
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_save_load_state")
+{
+    const std::string path = "qrack_snapshot_test.tmp";
+
+    qftReg->SetPermutation(0x55F00);
+    qftReg->H(0, 4);
+    qftReg->SaveState(path);
+
+    // Clobber the state, and restore it from the snapshot:
+    qftReg->SetPermutation(0);
+    qftReg->LoadState(path);
+    REQUIRE_THAT(qftReg, HasProbability(8, 12, 0x55F));
+
+    // The restored (and, on QEngineCPU, memory-mapped) buffer is a live state vector, like any other:
+    qftReg->H(0, 4);
+    REQUIRE_THAT(qftReg, HasProbability(0x55F00));
+
+    remove(path.c_str());
+}
+
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_get_state_chunked")
+{
+    bitCapInt maxQPower = qftReg->GetMaxQPower();
+
+    qftReg->SetPermutation(0x55F00);
+    qftReg->H(0, 4);
+
+    std::unique_ptr<complex[]> fullState(new complex[(bitCapIntOcl)maxQPower]);
+    qftReg->GetQuantumState(fullState.get());
+
+    // Deliberately small chunks, so the callback fires many times per extraction:
+    std::unique_ptr<complex[]> chunkedState(new complex[(bitCapIntOcl)maxQPower]);
+    qftReg->GetQuantumStateChunked(
+        [&](const complex* chunk, const bitCapInt& offset, const bitCapInt& length) {
+            std::copy(chunk, chunk + (bitCapIntOcl)length, chunkedState.get() + (bitCapIntOcl)offset);
+        },
+        16U);
+
+    for (bitCapIntOcl i = 0; i < (bitCapIntOcl)maxQPower; i++) {
+        REQUIRE_FLOAT(norm(fullState.get()[i] - chunkedState.get()[i]), ZERO_R1);
+    }
+
+    std::unique_ptr<real1[]> chunkedProbs(new real1[(bitCapIntOcl)maxQPower]);
+    qftReg->GetProbsChunked(
+        [&](const real1* chunk, const bitCapInt& offset, const bitCapInt& length) {
+            std::copy(chunk, chunk + (bitCapIntOcl)length, chunkedProbs.get() + (bitCapIntOcl)offset);
+        },
+        16U);
+
+    for (bitCapIntOcl i = 0; i < (bitCapIntOcl)maxQPower; i++) {
+        REQUIRE_FLOAT(chunkedProbs.get()[i], norm(fullState.get()[i]));
+    }
+}
+
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_journal_replay")
+{
+    const std::string journalPath = "qrack_journal_test.tmp";
+    const std::string snapshotPath = "qrack_journal_snapshot_test.tmp";
+
+    // randomGlobalPhase is off, so the recording and replaying instances can be compared directly:
+    QJournalPtr qRecord = std::dynamic_pointer_cast<QJournal>(
+        CreateQuantumInterface(QINTERFACE_JOURNAL, QINTERFACE_CPU, 8, 0, rng, ONE_CMPLX, false, false));
+    QJournalPtr qReplay = std::dynamic_pointer_cast<QJournal>(
+        CreateQuantumInterface(QINTERFACE_JOURNAL, QINTERFACE_CPU, 8, 0, rng, ONE_CMPLX, false, false));
+
+    qRecord->StartJournal(journalPath);
+    qRecord->H(0);
+    qRecord->CNOT(0, 1);
+    qRecord->INC(5, 2, 4);
+    bool outcome = qRecord->M(0);
+    qRecord->StopJournal();
+
+    // Replay rebuilds the state on a second instance, forcing the recorded measurement outcome:
+    qReplay->Replay(journalPath);
+    REQUIRE_FLOAT(qReplay->Prob(0), outcome ? ONE_R1 : ZERO_R1);
+    REQUIRE(qReplay->ApproxCompare(qRecord));
+
+    // A checkpoint snapshot plus the truncated journal tail is a complete recovery pair:
+    qRecord->StartJournal(journalPath);
+    qRecord->X(6);
+    qRecord->Checkpoint(snapshotPath);
+    qRecord->H(7);
+    qRecord->StopJournal();
+
+    qReplay->SetPermutation(0);
+    qReplay->LoadState(snapshotPath);
+    qReplay->Replay(journalPath);
+    REQUIRE(qReplay->ApproxCompare(qRecord));
+
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+}
+
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_qcircuit")
+{
+    complex pauliX[4] = { ZERO_CMPLX, ONE_CMPLX, ONE_CMPLX, ZERO_CMPLX };
+    complex hadamard[4] = { complex(M_SQRT1_2, ZERO_R1), complex(M_SQRT1_2, ZERO_R1), complex(M_SQRT1_2, ZERO_R1),
+        complex(-M_SQRT1_2, ZERO_R1) };
+    complex tGate[4] = { ONE_CMPLX, ZERO_CMPLX, ZERO_CMPLX, complex(M_SQRT1_2, M_SQRT1_2) };
+    bitLenInt control[1] = { 0 };
+
+    QCircuitPtr circuit = std::make_shared<QCircuit>();
+
+    // Both T gates fuse into the leading H on bit 0, (the second commutes backward past the CNOT control, since it's
+    // diagonal,) leaving (T*T*H)(0), H(1), CNOT, H(1) - the H gates framing the CNOT target cannot fuse:
+    circuit->ApplySingleBit(hadamard, 0);
+    circuit->ApplySingleBit(hadamard, 1);
+    circuit->ApplySingleBit(tGate, 0);
+    circuit->ApplyControlledSingleBit(control, 1U, 1U, pauliX);
+    circuit->ApplySingleBit(tGate, 0);
+    circuit->ApplySingleBit(hadamard, 1);
+    REQUIRE(circuit->GetGateCount() == 4U);
+
+    // An immediate inverse cancels out of the recording entirely:
+    circuit->ApplySingleBit(hadamard, 2);
+    circuit->ApplySingleBit(hadamard, 2);
+    REQUIRE(circuit->GetGateCount() == 4U);
+
+    qftReg->SetPermutation(0);
+    circuit->Run(qftReg);
+
+    // Compare against applying the same gates directly, without recording:
+    QInterfacePtr qftReg2 = qftReg->Clone();
+    qftReg2->SetPermutation(0);
+    qftReg2->ApplySingleBit(hadamard, 0);
+    qftReg2->ApplySingleBit(hadamard, 1);
+    qftReg2->ApplySingleBit(tGate, 0);
+    qftReg2->ApplyControlledSingleBit(control, 1U, 1U, pauliX);
+    qftReg2->ApplySingleBit(tGate, 0);
+    qftReg2->ApplySingleBit(hadamard, 1);
+
+    for (bitCapIntOcl i = 0; i < 8U; i++) {
+        REQUIRE_FLOAT(norm(qftReg->GetAmplitude(i)), norm(qftReg2->GetAmplitude(i)));
+    }
+
+    // The recording is not consumed - replaying it on a fresh register reproduces the same state:
+    QInterfacePtr qftReg3 = qftReg->Clone();
+    qftReg3->SetPermutation(0);
+    circuit->Run(qftReg3);
+    for (bitCapIntOcl i = 0; i < 8U; i++) {
+        REQUIRE_FLOAT(norm(qftReg3->GetAmplitude(i)), norm(qftReg2->GetAmplitude(i)));
+    }
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_cnot")
 {
     qftReg->SetPermutation(0x55F00);
@@ -3215,6 +3421,40 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_tryseparate")
     REQUIRE_THAT(qftReg, HasProbability(0, 8, 1));
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_schmidt_separate")
+{
+    Qrack::QUnitPtr qUnit = std::dynamic_pointer_cast<Qrack::QUnit>(qftReg);
+    if (!qUnit) {
+        // The Schmidt decomposition separation pass is a QUnit layer feature.
+        return;
+    }
+
+    qUnit->SetSeparabilityThreshold(0.001);
+
+    // (A small controlled rotation genuinely entangles the pair; it can't be held in a phase buffer.) The squared
+    // secondary Schmidt coefficient of either qubit is under sin(0.005)^2, well within the error budget:
+    qftReg->SetPermutation(0);
+    qftReg->H(0);
+    qftReg->CRY(0.01, 0, 1);
+
+    REQUIRE(qftReg->TrySeparate(0));
+
+    qftReg->CRY(-0.01, 0, 1);
+    qftReg->H(0);
+    REQUIRE_THAT(qftReg, HasProbability(0, 8, 0));
+
+    // A maximally entangled pair is far outside the budget, and must survive the pass:
+    qftReg->SetPermutation(0);
+    qftReg->H(0);
+    qftReg->CRY(M_PI, 0, 1);
+
+    REQUIRE(!qftReg->TrySeparate(0));
+
+    qftReg->CRY(-M_PI, 0, 1);
+    qftReg->H(0);
+    REQUIRE_THAT(qftReg, HasProbability(0, 8, 0));
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_zero_phase_flip")
 {
     qftReg->SetReg(0, 8, 0x01);
@@ -3343,6 +3583,32 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_sbc_superposition_reg")
     cl_free(testPage);
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_cmp_superposition_reg")
+{
+    int j;
+
+    unsigned char* testPage = cl_alloc(256);
+    for (j = 0; j < 256; j++) {
+        testPage[j] = j;
+    }
+
+    // Eigenstate index: values[3] = 3 < 4 flips the carry at bit 8, and 3 < 3 does not.
+    qftReg->SetPermutation(3);
+    qftReg->IndexedCMP(0, 8, 8, 4, 8, testPage);
+    REQUIRE_THAT(qftReg, HasProbability(0, 16, 0x103));
+    qftReg->IndexedCMP(0, 8, 8, 3, 8, testPage);
+    REQUIRE_THAT(qftReg, HasProbability(0, 16, 0x103));
+
+    // Superposed index: the carry entangles with the comparison, and the operation is its own inverse.
+    qftReg->SetPermutation(0);
+    qftReg->H(0, 8);
+    qftReg->IndexedCMP(0, 8, 8, 0x80, 8, testPage);
+    qftReg->IndexedCMP(0, 8, 8, 0x80, 8, testPage);
+    qftReg->H(0, 8);
+    REQUIRE_THAT(qftReg, HasProbability(0, 16, 0));
+    cl_free(testPage);
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_superposition_reg_long")
 {
     int j;
@@ -3545,6 +3811,35 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_probmask")
     REQUIRE(qftReg->ProbMask(0x3, 0x3) < 0.01);
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_prob_cache")
+{
+    // Repeated queries of the same mask, interleaved with gates that do and don't touch its qubits, exercise the
+    // QEngine probability cache and its per-qubit invalidation:
+    qftReg->SetPermutation(0x01);
+    qftReg->H(0);
+    REQUIRE_FLOAT(qftReg->Prob(0), 0.5);
+    REQUIRE_FLOAT(qftReg->Prob(0), 0.5);
+
+    // A gate on a disjoint qubit leaves the cached result valid, (and correct):
+    qftReg->X(4);
+    REQUIRE_FLOAT(qftReg->Prob(0), 0.5);
+    REQUIRE(qftReg->Prob(4) > 0.99);
+
+    // A gate on the queried qubit invalidates it:
+    qftReg->H(0);
+    REQUIRE(qftReg->Prob(0) > 0.99);
+
+    qftReg->SetPermutation(0x21);
+    REQUIRE(qftReg->ProbReg(4, 4, 0x2) > 0.99);
+    REQUIRE(qftReg->ProbReg(4, 4, 0x2) > 0.99);
+    REQUIRE(qftReg->ProbMask(0xF3, 0x21) > 0.99);
+    qftReg->X(4);
+    REQUIRE(qftReg->ProbReg(4, 4, 0x2) < 0.01);
+    REQUIRE(qftReg->ProbReg(4, 4, 0x3) > 0.99);
+    REQUIRE(qftReg->ProbMask(0xF3, 0x21) < 0.01);
+    REQUIRE(qftReg->ProbMask(0xF3, 0x31) > 0.99);
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_probmaskall")
 {
     // We're trying to hit a hardware-specific case of the method, by allocating 1 qubit, but it might not work if the
@@ -3667,6 +3962,23 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_normalize")
     REQUIRE_FLOAT(norm(qftReg->GetAmplitude(0x03)), ONE_R1);
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_amplitude_floor")
+{
+    // A small rotation on half a Bell pair leaves low-probability amplitudes, which a normalization sweep with a
+    // threshold above their norm should truncate away. (The pair is entangled, so layers like QUnit can't answer
+    // from cached separable amplitudes and must query the truncated engine state.)
+    qftReg->SetPermutation(0);
+    qftReg->H(0);
+    qftReg->CNOT(0, 1);
+    qftReg->RY((real1)0.2f, 0);
+    REQUIRE(qftReg->ProbMask(0x3, 0x1) > 0.004);
+
+    qftReg->NormalizeState(ONE_R1 + REAL1_EPSILON, (real1)0.05f);
+    REQUIRE(qftReg->ProbMask(0x3, 0x1) < 0.0001);
+    REQUIRE(qftReg->ProbMask(0x3, 0x0) > 0.45);
+    REQUIRE(qftReg->ProbMask(0x3, 0x3) > 0.45);
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_grover")
 {
     int i;
@@ -4428,6 +4740,45 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_timeevolve_uniform")
     REQUIRE_FLOAT(abs((ONE_R1 - qftReg->Prob(0)) - cos(aParam * tDiff) * cos(aParam * tDiff)), 0);
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_timeevolve_trotter")
+{
+    real1 aParam = (real1)1e-4;
+    real1 tDiff = 2.1f;
+    real1 e0 = sqrt(ONE_R1 - aParam * aParam);
+    bitCapInt trotterSteps = 5U;
+
+    BitOp o2neg1(new complex[4], std::default_delete<complex[]>());
+    o2neg1.get()[0] = complex(e0, ZERO_R1);
+    o2neg1.get()[1] = complex(-aParam, ZERO_R1);
+    o2neg1.get()[2] = complex(-aParam, ZERO_R1);
+    o2neg1.get()[3] = complex(e0, ZERO_R1);
+
+    HamiltonianOpPtr h0 = std::make_shared<HamiltonianOp>(0, o2neg1);
+    Hamiltonian h(1);
+    h[0] = h0;
+
+    // The compiled overload exponentiates each op once and replays the fused slice per step, so the result matches
+    // "trotterSteps" sequential TimeEvolve() calls:
+    qftReg->SetPermutation(0);
+    qftReg->TimeEvolve(h, tDiff, trotterSteps);
+
+    real1 totalT = tDiff * trotterSteps;
+    REQUIRE_FLOAT(abs(qftReg->Prob(0) - sin(aParam * totalT) * sin(aParam * totalT)), 0);
+    REQUIRE_FLOAT(abs((ONE_R1 - qftReg->Prob(0)) - cos(aParam * totalT) * cos(aParam * totalT)), 0);
+
+    // An anti-controlled op with a control "toggle" is activated when the control bit is set:
+    bitLenInt controls[1] = { 1 };
+    bool controlToggles[1] = { true };
+    HamiltonianOpPtr h1 = std::make_shared<HamiltonianOp>(controls, 1, 0, o2neg1, true, controlToggles);
+    h[0] = h1;
+
+    qftReg->SetPermutation(2);
+    qftReg->TimeEvolve(h, tDiff, trotterSteps);
+
+    REQUIRE_FLOAT(abs(qftReg->Prob(0) - sin(aParam * totalT) * sin(aParam * totalT)), 0);
+    REQUIRE_FLOAT(abs((ONE_R1 - qftReg->Prob(0)) - cos(aParam * totalT) * cos(aParam * totalT)), 0);
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_qfusion_controlled")
 {
     bitLenInt controls[2] = { 1, 2 };
@@ -4492,6 +4843,53 @@ TEST_CASE_METHOD(QInterfaceTestFixture, "test_qneuron")
     }
 }
 
+TEST_CASE_METHOD(QInterfaceTestFixture, "test_qneuron_batch")
+{
+    const bitLenInt InputCount = 4;
+    const bitLenInt OutputCount = 4;
+    const bitCapInt InputPower = 1U << InputCount;
+    const bitCapInt OutputPower = 1U << OutputCount;
+    const real1 eta = 0.5;
+
+    qftReg->Dispose(0, qftReg->GetQubitCount() - (InputCount + OutputCount));
+
+    bitLenInt inputIndices[InputCount];
+    for (bitLenInt i = 0; i < InputCount; i++) {
+        inputIndices[i] = i;
+    }
+
+    std::vector<QNeuronPtr> outputLayer;
+    for (bitLenInt i = 0; i < OutputCount; i++) {
+        outputLayer.push_back(std::make_shared<QNeuron>(qftReg, inputIndices, InputCount, InputCount + i));
+    }
+
+    // Train the network to associate powers of 2 with their log2(), with the whole (classical) dataset batched per
+    // neuron:
+    bitCapInt perm, comp, test;
+    std::vector<bitCapInt> inputs;
+    for (perm = 0; perm < InputPower; perm++) {
+        inputs.push_back(perm);
+    }
+    for (bitLenInt i = 0; i < OutputCount; i++) {
+        std::vector<bool> expected;
+        for (perm = 0; perm < InputPower; perm++) {
+            comp = (~perm) + 1U;
+            expected.push_back((comp & pow2(i)) != 0);
+        }
+        outputLayer[i]->LearnBatch(inputs, expected, eta);
+    }
+
+    for (perm = 0; perm < InputPower; perm++) {
+        qftReg->SetPermutation(perm);
+        for (bitLenInt i = 0; i < OutputCount; i++) {
+            outputLayer[i]->Predict();
+        }
+        comp = qftReg->MReg(InputCount, OutputCount);
+        test = ((~perm) + 1U) & (OutputPower - 1);
+        REQUIRE(comp == test);
+    }
+}
+
 TEST_CASE_METHOD(QInterfaceTestFixture, "test_bell_m")
 {
     bitCapInt qPowers[2] = { 1, 2 };
@@ -16,6 +16,7 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "qfactory.hpp"
 
@@ -41,6 +42,32 @@ extern std::string mOutputFileName;
 extern std::ofstream mOutputFile;
 extern bool isBinaryOutput;
 
+/*
+ * One row of benchmark statistics, per test case, engine stack, qubit width, and device. Collected by
+ * benchmarkLoopVariable and optionally serialized to JSON (and compared against a stored baseline) by the benchmarks
+ * main().
+ */
+struct BenchmarkResult {
+    std::string testName;
+    std::string engineStack;
+    int deviceId;
+    int qubitCount;
+    double avgMs;
+    double stdevMs;
+    double fastestMs;
+    double q1Ms;
+    double medianMs;
+    double q3Ms;
+    double slowestMs;
+    // Host state vector buffer allocations over the width trial. (CPU-based engines only; 0 for pure OpenCL.)
+    size_t allocCount;
+};
+
+extern std::vector<BenchmarkResult> benchmarkResults;
+extern std::string benchmarkOutputFileName;
+extern std::string benchmarkBaselineFileName;
+extern double benchmarkMaxRegression;
+
 /* Declare the stream-to-probability prior to including catch.hpp. */
 namespace Qrack {
 